@@ -0,0 +1,27 @@
+// benchmarks run by ManaBench
+
+#pragma once
+
+#include "ManaGlobals.h"
+#include "utils/CommandLine.h"
+
+namespace Mana {
+
+// Each benchmark reads its options (--{key} {value}) from |commandLine|,
+// prints what it measured to stdout, and returns 0, or 1 if it couldn't
+// run. See the table in ManaBench.cpp.
+int BenchThreadQueue(CommandLine& commandLine);
+int BenchEventQueues(CommandLine& commandLine);
+int BenchAudioMixer(CommandLine& commandLine);
+int BenchReadVsMap(CommandLine& commandLine);
+int BenchAsyncIO(CommandLine& commandLine);
+int BenchFrameArena(CommandLine& commandLine);
+int BenchLogLatency(CommandLine& commandLine);
+int BenchProcessUpdate(CommandLine& commandLine);
+
+// --{key} as a number, or |defaultValue| without it
+U64 GetBenchOption(CommandLine& commandLine,
+                   const char* pKey,
+                   U64 defaultValue);
+
+}  // namespace Mana
@@ -0,0 +1,124 @@
+#include "Bench.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+#include "audio/AudioMixer.h"
+#include "audio/AudioMixerKernels.h"
+#include "audio/AudioSink.h"
+#include "utils/Timer.h"
+
+namespace Mana {
+
+namespace {
+
+const U32 SAMPLE_RATE = 44100;
+
+// a second of 16 bit pcm sine, so voices loop over real samples
+bool WriteSineWav(const char* pFilePath, U16 channels) {
+  FILE* pFile = fopen(pFilePath, "wb");
+  if (!pFile) {
+    return false;
+  }
+
+  U32 frames = SAMPLE_RATE;
+  U32 dataBytes = frames * channels * sizeof(I16);
+  U32 riffBytes = 36 + dataBytes;
+  U32 fmtBytes = 16;
+  U16 formatTag = 1;  // pcm
+  U32 byteRate = SAMPLE_RATE * channels * sizeof(I16);
+  U16 blockAlign = (U16)(channels * sizeof(I16));
+  U16 bits = 16;
+  fwrite("RIFF", 1, 4, pFile);
+  fwrite(&riffBytes, sizeof(riffBytes), 1, pFile);
+  fwrite("WAVEfmt ", 1, 8, pFile);
+  fwrite(&fmtBytes, sizeof(fmtBytes), 1, pFile);
+  fwrite(&formatTag, sizeof(formatTag), 1, pFile);
+  fwrite(&channels, sizeof(channels), 1, pFile);
+  fwrite(&SAMPLE_RATE, sizeof(SAMPLE_RATE), 1, pFile);
+  fwrite(&byteRate, sizeof(byteRate), 1, pFile);
+  fwrite(&blockAlign, sizeof(blockAlign), 1, pFile);
+  fwrite(&bits, sizeof(bits), 1, pFile);
+  fwrite("data", 1, 4, pFile);
+  fwrite(&dataBytes, sizeof(dataBytes), 1, pFile);
+
+  std::vector<I16> pcm(frames * channels);
+  for (size_t i = 0; i < pcm.size(); ++i) {
+    pcm[i] = (I16)(20000.0 * sin((double)i * 0.0137 + channels));
+  }
+  bool bOk = fwrite(pcm.data(), sizeof(I16), pcm.size(), pFile) == pcm.size();
+  return fclose(pFile) == 0 && bOk;
+}
+
+const char* GetLevelName(MixKernelLevel level) {
+  switch (level) {
+    case MixKernelLevel::SSE2:
+      return "SSE2";
+    case MixKernelLevel::AVX2:
+      return "AVX2";
+    default:
+      return "scalar";
+  }
+}
+
+}  // namespace
+
+// How many voices AudioMixer mixes per millisecond of CPU time, with each
+// kernel level the CPU has: --voices looping voices (half mono, half
+// stereo, all panned) mixed --blocks times in --frames frame blocks into
+// a NullAudioSink.
+int BenchAudioMixer(CommandLine& commandLine) {
+  U64 voices = GetBenchOption(commandLine, "voices", 64);
+  U64 frames = GetBenchOption(commandLine, "frames", 1024);
+  U64 blocks = GetBenchOption(commandLine, "blocks", 2000);
+  if (voices == 0 || frames == 0 || blocks == 0) {
+    return 1;
+  }
+
+  if (!WriteSineWav("ManaBenchMono.wav", 1) ||
+      !WriteSineWav("ManaBenchStereo.wav", 2)) {
+    printf("can't write the test sounds\n");
+    return 1;
+  }
+
+  double audioMs = blocks * frames * 1000.0 / SAMPLE_RATE;
+  MixKernelLevel best = DetectMixKernelLevel();
+  int returnCode = 0;
+  printf("level   voices/ms  x realtime (%llu voices)\n", voices);
+  for (int level = 0; level <= (int)best; ++level) {
+    SetMixKernelLevel((MixKernelLevel)level);
+    NullAudioSink sink;
+    AudioMixer mixer(&sink, SAMPLE_RATE);
+    if (!mixer.Init()) {
+      returnCode = 1;
+      break;
+    }
+    for (U64 i = 0; i < voices; ++i) {
+      const xchar* pFilePath =
+          i & 1 ? _X("ManaBenchStereo.wav") : _X("ManaBenchMono.wav");
+      AudioFileHandle voice =
+          mixer.Load(pFilePath, AudioCategory::Sound, AudioFormat::Wav);
+      mixer.SetPan(voice, (float)i / (float)voices * 2.0f - 1.0f);
+      mixer.Play(voice, AudioBase::LOOP_INFINITE);
+    }
+
+    Timer timer;
+    for (U64 block = 0; block < blocks; ++block) {
+      mixer.Mix(frames);
+    }
+    double cpuMs = timer.GetMicroseconds() / 1000.0;
+    mixer.Uninit();
+
+    // voices mixed per ms of CPU, each for 1 ms of audio
+    double realtime = audioMs / cpuMs;
+    printf("%-6s  %9.1f  %10.1f\n", GetLevelName((MixKernelLevel)level),
+           voices * realtime, realtime);
+  }
+
+  SetMixKernelLevel(best);
+  remove("ManaBenchMono.wav");
+  remove("ManaBenchStereo.wav");
+  return returnCode;
+}
+
+}  // namespace Mana
@@ -0,0 +1,240 @@
+#include "Bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include "target/TargetOS.h"
+#include "utils/AsyncIO.h"
+#include "utils/File.h"
+#include "utils/Hash.h"
+#include "utils/MappedFile.h"
+#include "utils/Strings.h"
+#include "utils/Timer.h"
+
+#ifdef OS_WIN
+#include <psapi.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Mana {
+
+namespace {
+
+const char* BENCH_FILE = "ManaBenchFile.bin";
+const xchar* BENCH_FILE_X = _X("ManaBenchFile.bin");
+
+// the process's resident set in KB, or 0 if there's no way to tell
+U64 GetResidentKb() {
+#ifdef OS_WIN
+  PROCESS_MEMORY_COUNTERS counters = {};
+  if (!K32GetProcessMemoryInfo(GetCurrentProcess(), &counters,
+                               sizeof(counters))) {
+    return 0;
+  }
+  return counters.WorkingSetSize / 1024;
+#else
+  FILE* pFile = fopen("/proc/self/statm", "r");
+  if (!pFile) {
+    return 0;
+  }
+  unsigned long long pages = 0;
+  unsigned long long resident = 0;
+  int fields = fscanf(pFile, "%llu %llu", &pages, &resident);
+  fclose(pFile);
+  return fields == 2 ? resident * 4 : 0;  // 4 KB pages
+#endif
+}
+
+bool WriteBenchFile(U64 megabytes) {
+  FILE* pFile = fopen(BENCH_FILE, "wb");
+  if (!pFile) {
+    return false;
+  }
+  std::string block(1 << 20, 'm');
+  bool bOk = true;
+  for (U64 i = 0; i < megabytes && bOk; ++i) {
+    block[i % block.size()] = (char)i;
+    bOk = fwrite(block.data(), 1, block.size(), pFile) == block.size();
+  }
+  return fclose(pFile) == 0 && bOk;
+}
+
+void PrintRun(U64 megabytes,
+              const char* pName,
+              U64 micros,
+              U64 residentBefore,
+              U64 residentAfter,
+              U64 hash) {
+  printf("%6llu  %-12s  %9.1f  %+11lld  %016llx\n", megabytes, pName,
+         micros / 1000.0, (long long)(residentAfter - residentBefore), hash);
+}
+
+// small files for BenchAsyncIO
+std::string GetSmallFileName(U64 index) {
+  char name[48];
+  snprintf(name, sizeof(name), "ManaBenchSmall%04llu.bin", index);
+  return name;
+}
+
+// Asks the OS to drop the files from its cache, so the next read goes
+// to the disk. Returns false if it can't (then every run is warm).
+bool DropFromCache(const std::vector<std::string>& files) {
+#if defined(OS_WIN)
+  (void)files;
+  return false;
+#else
+  for (const std::string& file : files) {
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+  }
+  return true;
+#endif
+}
+
+std::atomic<U64> g_asyncBytes(0);
+std::atomic<U64> g_asyncFailed(0);
+
+void OnBenchRead(const AsyncReadResult& result) {
+  if (result.bSuccess) {
+    g_asyncBytes.fetch_add(result.bytesRead, std::memory_order_relaxed);
+  } else {
+    g_asyncFailed.fetch_add(1, std::memory_order_relaxed);
+  }
+  delete[] result.pBuffer;
+}
+
+}  // namespace
+
+// Reading --files (1000) small files of 1-16 KB one after another with
+// File::ReadAllBytes, against queueing them all on AsyncIO at once.
+// Warm runs read files that were just written, so they're in the OS's
+// cache. Cold runs first drop them from it (not on Windows), which is
+// what a game's first load of a level looks like.
+int BenchAsyncIO(CommandLine& commandLine) {
+  U64 fileCount = GetBenchOption(commandLine, "files", 1000);
+
+  std::vector<std::string> files;
+  std::vector<AsyncReadRequest> requests(fileCount);
+  srand(1);
+  for (U64 i = 0; i < fileCount; ++i) {
+    files.push_back(GetSmallFileName(i));
+    std::string bytes(1024 + rand() % (15 * 1024), (char)i);
+    FILE* pFile = fopen(files.back().c_str(), "wb");
+    bool bWritten =
+        pFile && fwrite(bytes.data(), 1, bytes.size(), pFile) == bytes.size();
+    if (pFile) {
+      bWritten = fclose(pFile) == 0 && bWritten;
+    }
+    if (!bWritten) {
+      printf("can't write %s\n", files.back().c_str());
+      return 1;
+    }
+
+    requests[i].path = Utf8ToXString(files.back());
+    requests[i].callback = OnBenchRead;
+  }
+
+  AsyncIO asyncIO;
+  if (!asyncIO.Init()) {
+    printf("AsyncIO Init failed\n");
+    return 1;
+  }
+  const char* BACKENDS[] = {"none", "thread pool", "io_uring",
+                            "completion port"};
+  printf("%llu files, AsyncIO backend: %s\n", fileCount,
+         BACKENDS[(int)asyncIO.GetBackend()]);
+
+  printf("cache  how           ms       bytes\n");
+  for (int cold = 0; cold < 2; ++cold) {
+    if (cold && !DropFromCache(files)) {
+      break;
+    }
+    const char* pCache = cold ? "cold" : "warm";
+
+    Timer timer;
+    U64 bytes = 0;
+    for (const AsyncReadRequest& request : requests) {
+      File file;
+      bytes += file.ReadAllBytes(request.path.c_str());
+    }
+    printf("%-5s  ReadAllBytes  %7.2f  %llu\n", pCache,
+           timer.GetMicroseconds() / 1000.0, bytes);
+
+    if (cold) {
+      DropFromCache(files);
+    }
+    g_asyncBytes = 0;
+    timer.Reset();
+    asyncIO.ReadAsyncBatch(requests.data(), requests.size());
+    asyncIO.WaitIdle();
+    printf("%-5s  AsyncIO       %7.2f  %llu\n", pCache,
+           timer.GetMicroseconds() / 1000.0, g_asyncBytes.load());
+  }
+  asyncIO.Uninit();
+
+  for (const std::string& file : files) {
+    remove(file.c_str());
+  }
+  return g_asyncFailed.load() == 0 ? 0 : 1;
+}
+
+// Reading a whole file with File::ReadAllBytes against mapping it with
+// MappedFile, for files of 1 MB up to --max-mb (500). Both hash every
+// byte, so the mapping's pages are all read in too. The file was just
+// written, so it's in the OS's cache: this measures the copies, not the
+// disk. Resident memory is measured while the buffer is still open. The
+// mapping's pages count too, but they're the cache's, which the OS can
+// drop under pressure; the heap buffer is a second copy it can't.
+int BenchReadVsMap(CommandLine& commandLine) {
+  U64 maxMegabytes = GetBenchOption(commandLine, "max-mb", 500);
+  const U64 SIZES[] = {1, 16, 128, 500};
+
+  printf("    MB  how           ms         resident KB  hash\n");
+  int returnCode = 0;
+  for (U64 megabytes : SIZES) {
+    if (megabytes > maxMegabytes) {
+      break;
+    }
+    if (!WriteBenchFile(megabytes)) {
+      printf("can't write a %llu MB file\n", megabytes);
+      returnCode = 1;
+      break;
+    }
+
+    {
+      U64 residentBefore = GetResidentKb();
+      Timer timer;
+      File file;
+      size_t size = file.ReadAllBytes(BENCH_FILE_X);
+      U64 hash = HashBytes64(file.GetBuffer(), size);
+      U64 micros = timer.GetMicroseconds();
+      PrintRun(megabytes, "ReadAllBytes", micros, residentBefore,
+               GetResidentKb(), hash);
+    }
+
+    {
+      U64 residentBefore = GetResidentKb();
+      Timer timer;
+      MappedFile file;
+      file.Open(BENCH_FILE_X);
+      U64 hash = HashBytes64(file.GetBuffer(), file.GetFileSize());
+      U64 micros = timer.GetMicroseconds();
+      PrintRun(megabytes, file.IsMapped() ? "MappedFile" : "(not mapped)",
+               micros, residentBefore, GetResidentKb(), hash);
+    }
+  }
+
+  remove(BENCH_FILE);
+  return returnCode;
+}
+
+}  // namespace Mana
@@ -0,0 +1,168 @@
+#include "Bench.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "concurrency/Mutex.h"
+#include "utils/Log.h"
+
+namespace Mana {
+
+namespace {
+
+const char* OLD_LOG_FILE = "ManaBenchOld.log";
+// calls between pauses in the paced runs, about one frame's worth
+const U64 CALLS_PER_FRAME = 128;
+const U32 FRAME_PAUSE_MICROS = 200;
+const U32 THREADS = 4;
+
+// the messages a ManaLogLnInfo call site would queue
+const LogSite FRAME_SITE = {Verbosity::Info, Channel::Perf, true,
+                            _X("frame %d update took %.3f ms, %d voices"),
+                            __FILE__, __LINE__};
+const LogSite THREAD_SITE = {Verbosity::Info, Channel::Perf, true,
+                             _X("thread %u frame %d"), __FILE__, __LINE__};
+
+Mutex g_oldLogLock;
+
+// How logging used to work: format on the calling thread, then open,
+// append to and close the file under a lock.
+void OldLog(const char* pFormat, ...) {
+  char message[256];
+  int prefix = snprintf(message, sizeof(message), "[INFO] [PERF]: ");
+  va_list args;
+  va_start(args, pFormat);
+  int length = vsnprintf(message + prefix, sizeof(message) - prefix - 1,
+                         pFormat, args);
+  va_end(args);
+  size_t size = std::min((size_t)(prefix + length), sizeof(message) - 2);
+  message[size++] = '\n';
+
+  ScopedMutex lock(g_oldLogLock);
+  FILE* pFile = fopen(OLD_LOG_FILE, "ab");
+  if (pFile) {
+    fwrite(message, 1, size, pFile);
+    fclose(pFile);
+  }
+}
+
+U64 GetNanoseconds() {
+  return (U64)std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void PauseForFrame(U64 call) {
+  if (call % CALLS_PER_FRAME == CALLS_PER_FRAME - 1) {
+    std::this_thread::sleep_for(std::chrono::microseconds(FRAME_PAUSE_MICROS));
+  }
+}
+
+void PrintLatencies(const char* pName, std::vector<U64>& nanos) {
+  std::sort(nanos.begin(), nanos.end());
+  size_t count = nanos.size();
+  printf("%-30s  %7llu  %7llu  %8llu  %8llu\n", pName, nanos[count / 2],
+         nanos[count * 99 / 100], nanos[count * 999 / 1000], nanos.back());
+}
+
+}  // namespace
+
+// How long a log call holds up the thread that makes it, over --calls
+// (20000) calls: the old logger, LogInfo (formats on the caller, then
+// queues the text), and LogDeferred, which is what the ManaLog macros call
+// (queues the arguments, and the writer thread formats them).
+// Paced runs pause FRAME_PAUSE_MICROS every CALLS_PER_FRAME calls like a
+// game loop would, so the writer keeps up. The burst doesn't, so it shows
+// what a full ring costs: its calls are dropped, not blocked.
+// Calls LogInit itself in release builds, where the macros compile out.
+int BenchLogLatency(CommandLine& commandLine) {
+  U64 calls = GetBenchOption(commandLine, "calls", 20000);
+  if (calls < THREADS) {
+    printf("--calls must be at least %u\n", THREADS);
+    return 1;
+  }
+
+  bool bOwnLog = !IsLogInitialized();
+  if (bOwnLog && !LogInit("ManaBench.log")) {
+    printf("LogInit failed\n");
+    return 1;
+  }
+
+  printf("%-30s  %7s  %7s  %8s  %8s\n", "ns per call", "median", "p99",
+         "p99.9", "max");
+  std::vector<U64> nanos(calls);
+
+  remove(OLD_LOG_FILE);
+  for (U64 i = 0; i < calls; ++i) {
+    U64 start = GetNanoseconds();
+    OldLog("frame %d update took %.3f ms, %d voices", (int)i, 1.5,
+           (int)(i % 32));
+    nanos[i] = GetNanoseconds() - start;
+    PauseForFrame(i);
+  }
+  remove(OLD_LOG_FILE);
+  PrintLatencies("old (open, append, close)", nanos);
+
+  for (U64 i = 0; i < calls; ++i) {
+    U64 start = GetNanoseconds();
+    LogInfo(Channel::Perf, true, _X("frame %d update took %.3f ms, %d voices"),
+            (int)i, 1.5, (int)(i % 32));
+    nanos[i] = GetNanoseconds() - start;
+    PauseForFrame(i);
+  }
+  PrintLatencies("LogInfo (paced)", nanos);
+
+  for (U64 i = 0; i < calls; ++i) {
+    U64 start = GetNanoseconds();
+    LogDeferred(FRAME_SITE, (int)i, 1.5, (int)(i % 32));
+    nanos[i] = GetNanoseconds() - start;
+    PauseForFrame(i);
+  }
+  PrintLatencies("LogDeferred (paced)", nanos);
+
+  LogFlush();
+  LogStats before = GetLogStats();
+  for (U64 i = 0; i < calls; ++i) {
+    U64 start = GetNanoseconds();
+    LogDeferred(FRAME_SITE, (int)i, 1.5, (int)(i % 32));
+    nanos[i] = GetNanoseconds() - start;
+  }
+  PrintLatencies("LogDeferred (burst)", nanos);
+  LogFlush();
+  LogStats after = GetLogStats();
+
+  std::vector<std::vector<U64>> threadNanos(THREADS);
+  std::vector<std::thread> threads;
+  for (U32 t = 0; t < THREADS; ++t) {
+    threadNanos[t].resize(calls / THREADS);
+    threads.emplace_back([&threadNanos, t]() {
+      std::vector<U64>& latencies = threadNanos[t];
+      for (size_t i = 0; i < latencies.size(); ++i) {
+        U64 start = GetNanoseconds();
+        LogDeferred(THREAD_SITE, t, (int)i);
+        latencies[i] = GetNanoseconds() - start;
+        PauseForFrame(i);
+      }
+    });
+  }
+  nanos.clear();
+  for (U32 t = 0; t < THREADS; ++t) {
+    threads[t].join();
+    nanos.insert(nanos.end(), threadNanos[t].begin(), threadNanos[t].end());
+  }
+  PrintLatencies("LogDeferred (4 threads, paced)", nanos);
+
+  printf("burst: %llu logged, %llu dropped\n",
+         after.messagesLogged - before.messagesLogged,
+         after.messagesDropped - before.messagesDropped);
+
+  if (bOwnLog) {
+    LogShutdown();
+  }
+  return 0;
+}
+
+}  // namespace Mana
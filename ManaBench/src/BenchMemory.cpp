@@ -0,0 +1,114 @@
+#include "Bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "utils/ArenaAllocator.h"
+#include "utils/LinearArena.h"
+#include "utils/Timer.h"
+
+namespace Mana {
+
+namespace {
+
+const size_t ALLOCS_PER_FRAME = 2000;
+const size_t VECTORS_PER_FRAME = 64;
+const int VECTOR_LENGTH = 200;
+
+void PrintRun(const char* pName, U64 micros, U64 allocs, U64 checksum) {
+  printf("%-26s  %8.1f  %7.1f  %llx\n", pName, micros / 1000.0,
+         micros * 1000.0 / allocs, checksum);
+}
+
+}  // namespace
+
+// Per-frame scratch memory from the heap against a LinearArena, like
+// g_pFrameArena, over --frames (2000) frames. Each frame allocates
+// ALLOCS_PER_FRAME blocks of 16-256 bytes and frees them (or resets the
+// arena), then fills VECTORS_PER_FRAME vectors of VECTOR_LENGTH ints with
+// std::allocator or ArenaAllocator, like a system gathering its work for
+// the frame.
+int BenchFrameArena(CommandLine& commandLine) {
+  U64 frames = GetBenchOption(commandLine, "frames", 2000);
+
+  std::vector<size_t> sizes(ALLOCS_PER_FRAME);
+  srand(2);
+  for (size_t& size : sizes) {
+    size = 16 + rand() % 241;
+  }
+
+  LinearArena arena;
+  if (!arena.Init(4 * 1024 * 1024)) {
+    printf("LinearArena Init failed\n");
+    return 1;
+  }
+
+  printf("how                         total ms  ns each  checksum\n");
+  std::vector<unsigned char*> blocks(ALLOCS_PER_FRAME);
+  U64 checksum = 0;
+  Timer timer;
+  for (U64 frame = 0; frame < frames; ++frame) {
+    for (size_t i = 0; i < ALLOCS_PER_FRAME; ++i) {
+      blocks[i] = (unsigned char*)malloc(sizes[i]);
+      memset(blocks[i], (int)i, 16);
+    }
+    for (size_t i = 0; i < ALLOCS_PER_FRAME; ++i) {
+      checksum += blocks[i][15];
+      free(blocks[i]);
+    }
+  }
+  PrintRun("malloc/free blocks", timer.GetMicroseconds(),
+           frames * ALLOCS_PER_FRAME, checksum);
+
+  checksum = 0;
+  timer.Reset();
+  for (U64 frame = 0; frame < frames; ++frame) {
+    arena.Reset();
+    for (size_t i = 0; i < ALLOCS_PER_FRAME; ++i) {
+      blocks[i] = (unsigned char*)arena.Allocate(sizes[i]);
+      memset(blocks[i], (int)i, 16);
+    }
+    for (size_t i = 0; i < ALLOCS_PER_FRAME; ++i) {
+      checksum += blocks[i][15];
+    }
+  }
+  PrintRun("LinearArena blocks", timer.GetMicroseconds(),
+           frames * ALLOCS_PER_FRAME, checksum);
+
+  // a vector grows about 9 times on its way to VECTOR_LENGTH
+  U64 vectors = frames * VECTORS_PER_FRAME;
+  checksum = 0;
+  timer.Reset();
+  for (U64 frame = 0; frame < frames; ++frame) {
+    for (size_t v = 0; v < VECTORS_PER_FRAME; ++v) {
+      std::vector<int> values;
+      for (int i = 0; i < VECTOR_LENGTH; ++i) {
+        values.push_back(i);
+      }
+      checksum += values.back();
+    }
+  }
+  PrintRun("std::allocator vectors", timer.GetMicroseconds(), vectors,
+           checksum);
+
+  checksum = 0;
+  timer.Reset();
+  for (U64 frame = 0; frame < frames; ++frame) {
+    arena.Reset();
+    for (size_t v = 0; v < VECTORS_PER_FRAME; ++v) {
+      std::vector<int, ArenaAllocator<int>> values{ArenaAllocator<int>(&arena)};
+      for (int i = 0; i < VECTOR_LENGTH; ++i) {
+        values.push_back(i);
+      }
+      checksum += values.back();
+    }
+  }
+  PrintRun("ArenaAllocator vectors", timer.GetMicroseconds(), vectors,
+           checksum);
+  printf("arena high water: %zu bytes\n", arena.GetHighWater());
+
+  return 0;
+}
+
+}  // namespace Mana
@@ -0,0 +1,112 @@
+#include "Bench.h"
+
+#include <math.h>
+#include <stdio.h>
+#include "concurrency/JobSystem.h"
+#include "mainloop/ProcessManager.h"
+#include "utils/Timer.h"
+
+namespace Mana {
+
+namespace {
+
+const unsigned long DELTA_MS = 16;
+// ticks before timing, so pools and the update order are built
+const U64 WARMUP_TICKS = 50;
+
+// about the least a process can do: steps a tween |steps_| times
+class TweenProcess : public ProcessBase {
+ public:
+  TweenProcess(U32 steps, bool bExclusive) : steps_(steps) {
+    if (!bExclusive) {
+      SetAccess(PROCESS_ACCESS_NONE, PROCESS_ACCESS_NONE);
+    }
+  }
+
+  void VOnUpdate(unsigned long deltaMs) override {
+    for (U32 i = 0; i < steps_; ++i) {
+      time_ += deltaMs * 0.001f;
+      value_ = value_ * 0.9f + sinf(time_) * 0.1f;
+    }
+  }
+
+ private:
+  U32 steps_;
+  float time_ = 0.0f;
+  float value_ = 0.0f;
+};
+
+// microseconds per UpdateProcesses over |ticks|
+double TimeTicks(U64 processes,
+                 U32 steps,
+                 bool bExclusive,
+                 bool bParallel,
+                 U64 ticks) {
+  ProcessManager manager;
+  manager.SetParallel(bParallel);
+  for (U64 i = 0; i < processes; ++i) {
+    manager.AttachProcess(
+        ProcessManager::CreateProcess<TweenProcess>(steps, bExclusive));
+  }
+  for (U64 tick = 0; tick < WARMUP_TICKS; ++tick) {
+    manager.UpdateProcesses(DELTA_MS);
+  }
+
+  Timer timer;
+  for (U64 tick = 0; tick < ticks; ++tick) {
+    manager.UpdateProcesses(DELTA_MS);
+  }
+  return (double)timer.GetMicroseconds() / ticks;
+}
+
+}  // namespace
+
+// One ProcessManager tick of --processes (10000) trivial processes, on
+// the calling thread against in parallel on g_pJobSystem, averaged over
+// --ticks (1000). Exclusive processes (the default access) always update
+// on the calling thread, so they show what the access bookkeeping costs.
+// With 1 tween step, a process is cheaper than handing it to a job, so
+// 20 steps shows where parallel pays off. --workers (0, one per hardware
+// thread) sets the JobSystem's worker count.
+int BenchProcessUpdate(CommandLine& commandLine) {
+  U64 processes = GetBenchOption(commandLine, "processes", 10000);
+  U64 ticks = GetBenchOption(commandLine, "ticks", 1000);
+  U32 workers = (U32)GetBenchOption(commandLine, "workers", 0);
+  if (ticks == 0) {
+    printf("--ticks must be at least 1\n");
+    return 1;
+  }
+
+  bool bOwnJobSystem = !g_pJobSystem;
+  if (bOwnJobSystem) {
+    g_pJobSystem = new JobSystem();
+    if (!g_pJobSystem->Init(workers)) {
+      printf("JobSystem Init failed\n");
+      delete g_pJobSystem;
+      g_pJobSystem = nullptr;
+      return 1;
+    }
+  }
+  printf("%llu processes, %u job workers\n", processes,
+         g_pJobSystem->GetWorkerCount());
+
+  printf("steps  access     how       us per tick\n");
+  const U32 STEPS[] = {1, 20};
+  for (U32 steps : STEPS) {
+    printf("%5u  exclusive  serial    %11.1f\n", steps,
+           TimeTicks(processes, steps, true, false, ticks));
+    printf("%5u  none       serial    %11.1f\n", steps,
+           TimeTicks(processes, steps, false, false, ticks));
+    printf("%5u  none       parallel  %11.1f\n", steps,
+           TimeTicks(processes, steps, false, true, ticks));
+  }
+
+  if (bOwnJobSystem) {
+    g_pJobSystem->Uninit();
+    delete g_pJobSystem;
+    g_pJobSystem = nullptr;
+  }
+  return 0;
+}
+
+}  // namespace Mana
@@ -0,0 +1,141 @@
+#include "Bench.h"
+
+#include <stdio.h>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "datastructures/MpmcQueue.h"
+#include "datastructures/SynchronizedQueue.h"
+#include "events/EventManager.h"
+#include "utils/Timer.h"
+
+namespace Mana {
+
+namespace {
+
+typedef MpmcQueue<SynchronizedEvent, SYNC_EVENT_QUEUE_CAPACITY> EventMpmc;
+
+// producers push batches of this many, like a device's burst of input
+const size_t PUSH_BATCH = 8;
+
+SynchronizedEvent MakeEvent(U64 producer, U64 i) {
+  SynchronizedEvent event = {};
+  event.syncEventType = (U8)SynchronizedEventType::Input;
+  event.inputAction.deviceId = producer;
+  event.inputAction.wParam = i;
+  return event;
+}
+
+// ns per event, or 0 if an event got lost
+double RunMpmc(U64 producers, U64 perProducer) {
+  std::unique_ptr<EventMpmc> pQueue = std::make_unique<EventMpmc>();
+  std::vector<std::thread> threads;
+  Timer timer;
+  for (U64 p = 0; p < producers; ++p) {
+    threads.emplace_back([&pQueue, p, perProducer]() {
+      SynchronizedEvent batch[PUSH_BATCH];
+      for (U64 i = 0; i < perProducer;) {
+        size_t count = 0;
+        for (; count < PUSH_BATCH && i + count < perProducer; ++count) {
+          batch[count] = MakeEvent(p, i + count);
+        }
+        for (size_t pushed = 0; pushed < count;) {
+          size_t n = pQueue->TryPushBatch(batch + pushed, count - pushed);
+          if (n == 0) {
+            std::this_thread::yield();
+          }
+          pushed += n;
+        }
+        i += count;
+      }
+    });
+  }
+
+  // the game loop: one consumer, draining everything it can
+  U64 total = producers * perProducer;
+  U64 popped = 0;
+  U64 checksum = 0;
+  std::vector<SynchronizedEvent> events(SYNC_EVENT_QUEUE_CAPACITY);
+  while (popped < total) {
+    size_t n = pQueue->TryPopBatch(events.data(), events.size());
+    if (n == 0) {
+      std::this_thread::yield();
+    }
+    for (size_t i = 0; i < n; ++i) {
+      checksum += events[i].inputAction.wParam;
+    }
+    popped += n;
+  }
+  U64 micros = timer.GetMicroseconds();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  U64 expected = producers * (perProducer * (perProducer - 1) / 2);
+  return checksum == expected ? micros * 1000.0 / (double)total : 0.0;
+}
+
+double RunSynchronized(U64 producers, U64 perProducer) {
+  SynchronizedQueue<SynchronizedEvent> queue;
+  std::vector<std::thread> threads;
+  Timer timer;
+  for (U64 p = 0; p < producers; ++p) {
+    threads.emplace_back([&queue, p, perProducer]() {
+      for (U64 i = 0; i < perProducer; ++i) {
+        queue.Push(MakeEvent(p, i));
+      }
+    });
+  }
+
+  U64 total = producers * perProducer;
+  U64 popped = 0;
+  U64 checksum = 0;
+  std::vector<SynchronizedEvent> events;
+  while (popped < total) {
+    queue.PopAll(events);
+    if (events.empty()) {
+      std::this_thread::yield();
+    }
+    for (const SynchronizedEvent& event : events) {
+      checksum += event.inputAction.wParam;
+    }
+    popped += events.size();
+  }
+  U64 micros = timer.GetMicroseconds();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  U64 expected = producers * (perProducer * (perProducer - 1) / 2);
+  return checksum == expected ? micros * 1000.0 / (double)total : 0.0;
+}
+
+}  // namespace
+
+// Producer threads posting SynchronizedEvents to one consumer, the way
+// input, audio and loader threads post to the game loop: MpmcQueue (in
+// batches of PUSH_BATCH) against SynchronizedQueue's mutex, at 1, 2, 4
+// and 8 producers of --events each.
+int BenchEventQueues(CommandLine& commandLine) {
+  U64 perProducer = GetBenchOption(commandLine, "events", 200000);
+  if (perProducer == 0) {
+    return 1;
+  }
+
+  printf("hardware threads: %u\n", std::thread::hardware_concurrency());
+  printf("producers  MpmcQueue  SynchronizedQueue  (ns/event)\n");
+  int returnCode = 0;
+  for (U64 producers = 1; producers <= 8; producers *= 2) {
+    double mpmc = RunMpmc(producers, perProducer);
+    double synchronized = RunSynchronized(producers, perProducer);
+    printf("%9llu  %9.1f  %17.1f\n", producers, mpmc, synchronized);
+    if (mpmc == 0.0 || synchronized == 0.0) {
+      printf("events were lost\n");
+      returnCode = 1;
+    }
+  }
+  return returnCode;
+}
+
+}  // namespace Mana
@@ -0,0 +1,81 @@
+#include "Bench.h"
+
+#include <stdio.h>
+#include <atomic>
+#include <memory>
+#include "concurrency/IThread.h"
+#include "utils/Timer.h"
+
+namespace Mana {
+
+namespace {
+
+std::atomic<U64> g_itemsDone = 0;
+
+// about the least work an item can do, so the time is the queue's
+class TinyWorkItem : public IWorkItem {
+ public:
+  TinyWorkItem() = default;
+
+  WorkItemType GetType() override { return WorkItemType::LoadAudio; }
+  void Process() override {
+    bDone_.store(true, std::memory_order_release);
+    g_itemsDone.fetch_add(1, std::memory_order_release);
+  }
+  size_t GetHandleIfDoneProcessing() override {
+    return bDone_.load(std::memory_order_acquire) ? 1 : 0;
+  }
+
+ private:
+  std::atomic<bool> bDone_ = false;
+};
+
+}  // namespace
+
+// How long an IThread takes to hand out work items: the caller enqueues
+// --items of them as fast as it can, and the thread processes them.
+// Also times single items, the wake up from an empty queue.
+int BenchThreadQueue(CommandLine& commandLine) {
+  U64 items = GetBenchOption(commandLine, "items", 2000000);
+  const U64 ROUND_TRIPS = 1000;
+
+  g_itemsDone = 0;
+  std::unique_ptr<TinyWorkItem[]> pItems(new TinyWorkItem[items + ROUND_TRIPS]);
+  IThread* pThread = ThreadFactory::Create();
+  if (!pThread) {
+    printf("can't create a thread\n");
+    return 1;
+  }
+  pThread->Start();
+
+  Timer timer;
+  for (U64 i = 0; i < items; ++i) {
+    pThread->EnqueueWorkItem(&pItems[i]);
+  }
+  U64 enqueuedMicros = timer.GetMicroseconds();
+  while (g_itemsDone.load(std::memory_order_acquire) < items) {
+  }
+  U64 totalMicros = timer.GetMicroseconds();
+
+  printf("%llu items: enqueued in %llu us, processed in %llu us "
+         "(%.1f ns/item)\n",
+         items, enqueuedMicros, totalMicros,
+         totalMicros * 1000.0 / (double)items);
+
+  // one at a time, so the thread goes back to sleep in between
+  timer.Reset();
+  for (U64 i = 0; i < ROUND_TRIPS; ++i) {
+    pThread->EnqueueWorkItem(&pItems[items + i]);
+    while (g_itemsDone.load(std::memory_order_acquire) < items + i + 1) {
+    }
+  }
+  printf("%llu round trips: %.2f us each\n", ROUND_TRIPS,
+         timer.GetMicroseconds() / (double)ROUND_TRIPS);
+
+  pThread->Stop();
+  pThread->Join();
+  delete pThread;
+  return 0;
+}
+
+}  // namespace Mana
@@ -0,0 +1,101 @@
+#include "Bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils/Log.h"
+
+// Runs the engine benchmarks, one by name or all of them:
+//   ManaBench --run thread-queue --items 1000000
+//   ManaBench --run all
+// Without --run, lists them. Each benchmark's options are described
+// next to it.
+
+namespace Mana {
+
+namespace {
+
+struct Bench {
+  const char* pName;
+  const char* pDescription;
+  int (*pRun)(CommandLine& commandLine);
+};
+
+const Bench BENCHES[] = {
+    {"thread-queue",
+     "tiny work items through an IThread (--items)",
+     BenchThreadQueue},
+    {"event-queues",
+     "MpmcQueue vs SynchronizedQueue, 1-8 producers (--events)",
+     BenchEventQueues},
+    {"audio-mixer",
+     "AudioMixer voices per ms, per kernel level (--voices)",
+     BenchAudioMixer},
+    {"read-vs-map",
+     "File::ReadAllBytes vs MappedFile, 1-500 MB (--max-mb)",
+     BenchReadVsMap},
+    {"async-io",
+     "1000 small files, sequential ReadAllBytes vs AsyncIO (--files)",
+     BenchAsyncIO},
+    {"frame-arena",
+     "per-frame allocations, heap vs LinearArena (--frames)",
+     BenchFrameArena},
+    {"log-latency",
+     "per-call latency of the old logger, LogInfo and LogDeferred (--calls)",
+     BenchLogLatency},
+    {"process-update",
+     "10k trivial processes, serial vs parallel (--processes)",
+     BenchProcessUpdate},
+};
+
+void PrintBenches() {
+  printf("usage: ManaBench --run {name|all} [options]\n");
+  for (const Bench& bench : BENCHES) {
+    printf("  %-16s %s\n", bench.pName, bench.pDescription);
+  }
+}
+
+}  // namespace
+
+U64 GetBenchOption(CommandLine& commandLine,
+                   const char* pKey,
+                   U64 defaultValue) {
+  if (!commandLine.HasKey(pKey)) {
+    return defaultValue;
+  }
+  return (U64)strtoull(commandLine.Get(pKey).c_str(), nullptr, 10);
+}
+
+}  // namespace Mana
+
+int main(int argc, char** argv) {
+  Mana::CommandLine commandLine;
+  commandLine.Parse(argc, argv);
+  if (!commandLine.HasKey("run")) {
+    Mana::PrintBenches();
+    return 1;
+  }
+
+  ManaLogInit("ManaBench.log");
+
+  std::string name = commandLine.Get("run");
+  bool bFound = false;
+  int returnCode = 0;
+  for (const Mana::Bench& bench : Mana::BENCHES) {
+    if (name == "all" || name == bench.pName) {
+      printf("== %s\n", bench.pName);
+      fflush(stdout);
+      returnCode |= bench.pRun(commandLine);
+      bFound = true;
+    }
+  }
+
+  ManaLogShutdown();
+
+  if (!bFound) {
+    printf("no benchmark named %s\n", name.c_str());
+    Mana::PrintBenches();
+    return 1;
+  }
+  return returnCode;
+}
@@ -9,8 +9,6 @@
 
 #include "target/OSDefines.h"
 
-#ifdef OS_WIN
-
 // SSE intrisics (__m128 etc)
 // http://felix.abecassis.me/2011/09/cpp-getting-started-with-sse/
 #include <xmmintrin.h>
@@ -32,13 +30,15 @@ namespace Mana {
 
 }  // namespace Mana
 
-#endif
-
 #include "utils/StringTypes.h"
 
 #if defined(_DEBUG)
 #define MANA_LOGGING_ENABLED 1
 #endif
+// Define MANA_PROFILE in a release configuration for a profile build.
+#if defined(_DEBUG) || defined(MANA_PROFILE)
+#define MANA_PROFILING_ENABLED 1
+#endif
 #include "utils/Log.h"
 
 #include "utils/Timer.h"
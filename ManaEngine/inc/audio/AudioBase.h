@@ -3,13 +3,15 @@
 #pragma once
 
 #include <fstream>
-#include <map>
 #include <string>
 #include <vector>
 #include "ManaGlobals.h"
 #include "audio/AudioFileBase.h"
+#include "audio/PcmCache.h"
 #include "concurrency/IThread.h"
+#include "concurrency/Mutex.h"
 #include "utils/File.h"
+#include "utils/ObjectPool.h"
 
 namespace Mana {
 
@@ -21,7 +23,7 @@ class AudioBase {
   static const unsigned MAX_LOOP_COUNT = 254;
   static const unsigned LOOP_INFINITE = 255;
 
-  AudioBase() = default;
+  AudioBase() : fileMap_(MAX_SOUNDS_LOADED, nullptr) {}
   // TODO: maybe in debug build, assert if there are still files loaded?
   virtual ~AudioBase() = default;
 
@@ -32,13 +34,29 @@ class AudioBase {
   virtual void Uninit() = 0;
 
   // Returns non-zero for success.
-  virtual AudioFileHandle Load(const xstring& filePath,
-                               AudioCategory category,
-                               AudioFormat format,
-                               int64_t loopBackPcmSamplePos = 0,
-                               int simultaneousSounds = 1) = 0;
+  AudioFileHandle Load(const xstring& filePath,
+                       AudioCategory category,
+                       AudioFormat format,
+                       int64_t loopBackPcmSamplePos = 0,
+                       int simultaneousSounds = 1) {
+    return LoadFile(filePath, nullptr, category, format, loopBackPcmSamplePos,
+                    simultaneousSounds);
+  }
+  // Same, from the file's bytes when they're already in memory
+  // (e.g. read by AsyncIO, see MappedFile::Adopt). |filePath| only names
+  // the file. Takes ownership of |pFile|, even if it fails.
+  AudioFileHandle LoadFromMemory(const xstring& filePath,
+                                 MappedFile* pFile,
+                                 AudioCategory category,
+                                 AudioFormat format,
+                                 int64_t loopBackPcmSamplePos = 0,
+                                 int simultaneousSounds = 1) {
+    return LoadFile(filePath, pFile, category, format, loopBackPcmSamplePos,
+                    simultaneousSounds);
+  }
   // stops and destroys all voices and the buffer
-  // and removes from fileMap_
+  // and removes from fileMap_.
+  // The handle is stale afterwards, even if another file reuses its slot.
   virtual void Unload(AudioFileHandle audioFileHandle) = 0;
 
   // fills/queues streaming buffers, if needed
@@ -82,20 +100,49 @@ class AudioBase {
   virtual bool IsPlaying(AudioFileHandle audioFileHandle) = 0;
   virtual bool IsPaused(AudioFileHandle audioFileHandle) = 0;
 
+  // decoded pcm shared by static sounds, e.g. to set its budget
+  // or check hit rates across a level transition
+  PcmCache& GetPcmCache() { return pcmCache_; }
+
  protected:
   // this does not include simultaneous
   // versions of the same sound
-  const AudioFileHandle MAX_SOUNDS_LOADED = 500;
-
-  std::map<AudioFileHandle, AudioFileBase*> fileMap_;
-
-  AudioFileHandle lastAudioFileHandle_ = 0;
-  AudioFileHandle GetNextFreeAudioFileHandle();
+  static const U32 MAX_SOUNDS_LOADED = 500;
+
+  // Load and LoadFromMemory. |pMemory| is null to read |filePath|,
+  // else the file owns it (see AudioFileBase::LoadFromMemory).
+  virtual AudioFileHandle LoadFile(const xstring& filePath,
+                                   MappedFile* pMemory,
+                                   AudioCategory category,
+                                   AudioFormat format,
+                                   int64_t loopBackPcmSamplePos,
+                                   int simultaneousSounds) = 0;
+
+  // Engines allocate their files from an ObjectPool of at most
+  // MAX_SOUNDS_LOADED objects, and a file's handle is its PoolHandle.
+  // fileMap_ is indexed by the handle's slot (GetPoolHandleIndex),
+  // with null for empty slots. Lookups compare the whole handle, so a
+  // stale handle never finds a newer file loaded into the same slot.
+  std::vector<AudioFileBase*> fileMap_;
+  // Load can be called from several job system workers at once,
+  // so fileMap_ lookups/inserts/erases go through this lock.
+  Mutex fileMapLock_;
+
+  // Sets |pAudioFile|'s handle to |audioFileHandle| and adds it to fileMap_.
+  void AddAudioFile(AudioFileBase* pAudioFile,
+                    AudioFileHandle audioFileHandle);
+  void RemoveAudioFile(AudioFileHandle audioFileHandle);
 
   std::vector<AudioFileBase*> streamingFiles_;
   void GetStreamingFiles();
 
+  // Loaded files hold references into it,
+  // so engines must unload every file in Uninit.
+  PcmCache pcmCache_;
+
   AudioFileBase* GetAudioFile(AudioFileHandle audioFileHandle);
+  // same, for callers already holding fileMapLock_
+  AudioFileBase* GetAudioFile_NoLock(AudioFileHandle audioFileHandle);
   virtual void ClampVolume(float& volume) = 0;
 };
 
@@ -2,10 +2,16 @@
 
 #pragma once
 
+#include <atomic>
 #include "ManaGlobals.h"
 
 namespace Mana {
 
+class MappedFile;
+class PcmCache;
+struct PcmBuffer;
+struct PcmFormat;
+
 // Assumes streaming files' uncompressed pcm data
 // is larger than (AudioStreamBufSize * AudioStreamBufCount),
 // else just load it as an uncompressed pcm wav file.
@@ -36,8 +42,9 @@ class AudioFileBase {
   AudioLoadType loadType_;
   AudioFormat format_;
   float pan_;
-  bool isPaused_;
-  bool isStopped_;
+  // atomic, since engines may update these on their own audio thread
+  std::atomic<bool> isPaused_;
+  std::atomic<bool> isStopped_;
   size_t fileSize_;               // raw file size
   uint8_t* pDataBuffer_;          // pcm buffer
   size_t dataBufferSize_;         // pcm buffer size
@@ -54,7 +61,23 @@ class AudioFileBase {
   int64_t loopBackPcmSamplePos_; // pcm pos to loop back to, in samples.
                                  // Must be on a pcm frame boundary.
 
-  virtual bool Load(const xstring& strFilePath) = 0;
+  // Set by the Audio engine before Load. Static files share decoded pcm
+  // through it. Null disables caching.
+  PcmCache* pPcmCache_;
+  // non-null if pDataBuffer_ belongs to pPcmCache_ rather than this file
+  PcmBuffer* pCachedPcm_;
+
+  // Points pDataBuffer_ at |pCachedPcm| (a reference from the cache).
+  void UseCachedPcm(PcmBuffer* pCachedPcm);
+  // Hands the freshly decoded pDataBuffer_ over to pPcmCache_,
+  // so later loads of the same file can share it.
+  void CachePcm(U64 contentHash, const PcmFormat& format);
+
+  // Reads the file (see MappedFile), then LoadFromMemory.
+  bool Load(const xstring& strFilePath);
+  // Loads from the file's bytes, already in memory.
+  // Takes ownership of |pFile|, which may be kept open while streaming.
+  virtual bool LoadFromMemory(MappedFile* pFile) = 0;
   virtual void Unload() = 0;
 
   // streaming-only functions
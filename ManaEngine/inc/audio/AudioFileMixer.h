@@ -0,0 +1,54 @@
+// Audio file that AudioMixer decodes up front into 16 bit pcm
+
+#pragma once
+
+#include <vector>
+#include "ManaGlobals.h"
+#include "audio/AudioFileBase.h"
+
+namespace Mana {
+
+class AudioFileMixer : public AudioFileBase {
+ public:
+  // One playing instance of the file.
+  // A file has one voice per simultaneous sound (see AudioBase::Load).
+  struct Voice {
+    bool isPlaying = false;
+    size_t frameCursor = 0;  // next pcm frame to mix
+    uint32_t loopCount = 0;  // same meaning as AudioFileBase::loopCount_
+  };
+
+  AudioFileMixer();
+  ~AudioFileMixer() override;
+
+  AudioFileMixer(const AudioFileMixer&) = delete;
+  AudioFileMixer& operator=(const AudioFileMixer&) = delete;
+
+  // Decodes the whole file (format_ must be set first) into pDataBuffer_
+  // as interleaved 16 bit pcm. Supports mono and stereo.
+  bool LoadFromMemory(MappedFile* pFile) override;
+  void Unload() override;
+
+  // moves the first voice to |pcmSamples| (in frames)
+  bool StreamSeek(int64_t pcmSamples) override;
+
+  const I16* GetPcm() const { return (const I16*)pDataBuffer_; }
+
+  U32 channels_;
+  U32 sampleRate_;
+  size_t totalFrames_;
+
+  float volume_;
+  // false until SetPan is called, so unpanned sounds play at full volume
+  // in both speakers, like XAudio2's default output matrix.
+  bool isPanned_;
+
+  std::vector<Voice> voices_;
+  size_t voicePos_;  // next voice Play uses
+
+ private:
+  bool LoadWav(const U8* pData, size_t size);
+  bool LoadOgg(const U8* pData, size_t size);
+};
+
+}  // namespace Mana
@@ -5,7 +5,7 @@
 #include "ManaGlobals.h"
 #include "audio/AudioFileWin.h"
 #include "target/TargetOS.h"
-#include "utils/File.h"
+#include "utils/MappedFile.h"
 
 #include <vorbis/codec.h>
 #include <vorbis/vorbisfile.h>
@@ -22,12 +22,14 @@ class AudioFileOggWin : public AudioFileWin {
   AudioFileOggWin(const AudioFileOggWin&) = delete;
   AudioFileOggWin& operator=(const AudioFileOggWin&) = delete;
 
-  bool Load(const xstring& strFilePath) override;
+  bool LoadFromMemory(MappedFile* pFile) override;
   void Unload() override;
 
   bool StreamSeek(int64_t pcmBytePos) override;
 
-  File* pCompressedOggFile_;
+  // Mapped rather than read, so streamed music only keeps
+  // the pages that are being decoded resident.
+  MappedFile* pCompressedOggFile_;
   size_t dataReadSoFar_;     // compressed data pos
 
   // The struct that's initialized in ov_open_callbacks,
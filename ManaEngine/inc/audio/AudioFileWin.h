@@ -25,7 +25,7 @@ class AudioFileWin : public AudioFileBase {
 
   //XAUDIO2_BUFFER buffer_;
 
-  virtual bool Load(const xstring& strFilePath) override = 0;
+  virtual bool LoadFromMemory(MappedFile* pFile) override = 0;
   virtual void Unload() override = 0;
 
   virtual bool StreamSeek(int64_t pcmBytePos) override = 0;
@@ -0,0 +1,119 @@
+// Software Audio Engine that doesn't depend on any platform audio API
+
+#pragma once
+
+#include <vector>
+#include "ManaGlobals.h"
+#include "audio/AudioBase.h"
+#include "audio/AudioFileMixer.h"
+#include "audio/AudioSink.h"
+#include "utils/MemoryTracker.h"
+#include "utils/ObjectPool.h"
+
+namespace Mana {
+
+// Mixes every playing voice into an interleaved stereo float bus using the
+// SIMD kernels in AudioMixerKernels.h, applies the master volume, then hands
+// the bus to an AudioSinkBase (null, .wav file, or callback).
+//
+// Each Update mixes exactly one fixed-timestep update's worth of frames, so
+// the output only depends on the calls made, not on wall-clock time.
+// That makes it usable headless, in tests, and on platforms without AudioWin.
+//
+// Volumes and panning work like AudioWin:
+// final gain = file volume * category volume * linear pan * master volume.
+// Files are fully decoded on Load (nothing is streamed),
+// and must have the mixer's sample rate (there's no resampling).
+//
+// Mix can run on another thread than the game loop (e.g. from a sink's
+// device callback). It holds fileMapLock_ while it reads and advances the
+// voices, so Play, Stop, volume and the other calls take it too.
+class AudioMixer : public AudioBase {
+ public:
+  // Doesn't take ownership of |pSink|, which must outlive the mixer.
+  // |microsecPerUpdate| should match the game-loop's fixed timestep.
+  AudioMixer(AudioSinkBase* pSink,
+             U32 sampleRate = 44100,
+             U32 microsecPerUpdate = 16000);
+  virtual ~AudioMixer() = default;
+
+  AudioMixer(const AudioMixer&) = delete;
+  AudioMixer& operator=(const AudioMixer&) = delete;
+
+  bool Init() override;
+  void Uninit() override;
+  void Unload(AudioFileHandle audioFileHandle) override;
+
+  // mixes one update's worth of frames into the sink
+  void Update() override;
+
+  bool Play(AudioFileHandle audioFileHandle, uint32_t loopCount = 0) override;
+
+  void Stop(AudioFileHandle audioFileHandle) override;
+  void Pause(AudioFileHandle audioFileHandle) override;
+  void Resume(AudioFileHandle audioFileHandle) override;
+
+  float GetVolume(AudioFileHandle audioFileHandle) override;
+  float GetVolume(AudioCategory category) override;
+  float GetMasterVolume() override;
+
+  void SetVolume(AudioFileHandle audioFileHandle, float volume) override;
+  void SetVolume(AudioCategory category, float volume) override;
+  void SetMasterVolume(float& volume) override;
+
+  void SetPan(AudioFileHandle audioFileHandle, float pan) override;
+  float GetPan(AudioFileHandle audioFileHandle) override;
+
+  bool IsPlaying(AudioFileHandle audioFileHandle) override;
+  bool IsPaused(AudioFileHandle audioFileHandle) override;
+
+  // Mixes |frames| frames and writes them to the sink.
+  void Mix(size_t frames);
+
+  U32 GetSampleRate() const { return sampleRate_; }
+  static const U32 OUTPUT_CHANNELS = 2;
+
+ private:
+  AudioFileHandle LoadFile(const xstring& filePath,
+                           MappedFile* pMemory,
+                           AudioCategory category,
+                           AudioFormat format,
+                           int64_t loopBackPcmSamplePos,
+                           int simultaneousSounds) override;
+
+  const float AUDIO_MIN_VOLUME = 0.0f;
+  const float AUDIO_MAX_VOLUME = 1.0f;
+  static const size_t NUM_CATEGORIES = 3;  // see AudioCategory
+
+  AudioSinkBase* pSink_;
+  U32 sampleRate_;
+  U32 microsecPerUpdate_;
+  // Leftover (sampleRate_ * microseconds) that didn't make a whole frame,
+  // carried to the next Update so no frames are lost to rounding.
+  U64 frameRemainder_;
+
+  float masterVolume_;
+  float categoryVolumes_[NUM_CATEGORIES];
+
+  std::vector<F32, TaggedAllocator<F32, MemoryTag::Audio>> bus_;
+  bool bInitialized_;
+
+  // loaded files live here, and their handles are PoolHandles from it
+  ObjectPool<AudioFileMixer> filePool_;
+
+  // Returns the file if it's loaded by this mixer.
+  AudioFileMixer* GetMixerFile(AudioFileHandle audioFileHandle);
+  // same, for callers already holding fileMapLock_
+  AudioFileMixer* GetMixerFile_NoLock(AudioFileHandle audioFileHandle);
+  static bool IsAnyVoicePlaying(const AudioFileMixer* pFile);
+  void MixVoice(AudioFileMixer* pFile,
+                AudioFileMixer::Voice& voice,
+                F32* pBus,
+                size_t frames,
+                F32 gainLeft,
+                F32 gainRight);
+
+  void ClampVolume(float& volume) override;
+};
+
+}  // namespace Mana
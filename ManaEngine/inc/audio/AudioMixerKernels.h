@@ -0,0 +1,41 @@
+// SIMD kernels used by AudioMixer
+
+#pragma once
+
+#include "ManaGlobals.h"
+
+namespace Mana {
+
+// Every level produces bit-identical output (each kernel does a separate
+// multiply and add, never a fused multiply-add), so mixes are deterministic
+// no matter which CPU they run on.
+enum class MixKernelLevel { Scalar, SSE2, AVX2 };
+
+// Returns the fastest level the CPU supports.
+MixKernelLevel DetectMixKernelLevel();
+// Picks which kernels the functions below use.
+// Levels the CPU doesn't support fall back to the next best one.
+// Not thread-safe, so call this before any mixing starts.
+void SetMixKernelLevel(MixKernelLevel level);
+MixKernelLevel GetMixKernelLevel();
+
+// Adds |frames| frames of 16 bit pcm into the interleaved stereo float bus:
+//   pBus[2i] += left sample * gainLeft
+//   pBus[2i+1] += right sample * gainRight
+// |srcChannels| is 1 (the sample goes to both sides) or 2 (interleaved).
+// Gains should include the 1/32768 scale from 16 bit to [-1, 1].
+void MixI16ToStereo(F32* pBus,
+                    const I16* pSrc,
+                    U32 srcChannels,
+                    size_t frames,
+                    F32 gainLeft,
+                    F32 gainRight);
+
+// pSamples[i] *= gain
+void ApplyGain(F32* pSamples, size_t numSamples, F32 gain);
+
+// Converts [-1, 1] float samples to 16 bit pcm,
+// rounding to nearest and saturating anything out of range.
+void ConvertF32ToI16(const F32* pSrc, I16* pDest, size_t numSamples);
+
+}  // namespace Mana
@@ -0,0 +1,88 @@
+// Output sinks that AudioMixer writes its mixed bus to
+
+#pragma once
+
+#include <stdio.h>
+#include <vector>
+#include "ManaGlobals.h"
+#include "utils/MemoryTracker.h"
+
+namespace Mana {
+
+class AudioSinkBase {
+ public:
+  AudioSinkBase() = default;
+  virtual ~AudioSinkBase() = default;
+
+  AudioSinkBase(const AudioSinkBase&) = delete;
+  AudioSinkBase& operator=(const AudioSinkBase&) = delete;
+
+  virtual bool Open(U32 sampleRate, U32 channels) = 0;
+  // |pSamples| holds |frames| frames of interleaved float samples,
+  // normally in [-1, 1]. It's only valid during the call.
+  virtual void Write(const F32* pSamples, size_t frames) = 0;
+  virtual void Close() = 0;
+};
+
+// Throws the mix away. Useful for headless runs and benchmarks.
+class NullAudioSink : public AudioSinkBase {
+ public:
+  NullAudioSink() = default;
+  ~NullAudioSink() override = default;
+
+  bool Open(U32 sampleRate, U32 channels) override;
+  void Write(const F32* pSamples, size_t frames) override;
+  void Close() override {}
+
+  U64 GetFramesWritten() const { return framesWritten_; }
+
+ private:
+  U64 framesWritten_ = 0;
+};
+
+// Writes the mix to a 16 bit pcm .wav file.
+class WavFileAudioSink : public AudioSinkBase {
+ public:
+  explicit WavFileAudioSink(const xstring& filePath) : filePath_(filePath) {}
+  ~WavFileAudioSink() override;
+
+  bool Open(U32 sampleRate, U32 channels) override;
+  void Write(const F32* pSamples, size_t frames) override;
+  // fills in the header's sizes and closes the file
+  void Close() override;
+
+ private:
+  xstring filePath_;
+  FILE* pFile_ = nullptr;
+  U32 channels_ = 0;
+  U64 dataBytes_ = 0;
+  // conversion buffer, reused between writes
+  std::vector<I16, TaggedAllocator<I16, MemoryTag::Audio>> pcm_;
+
+  void WriteHeader(U32 sampleRate);
+};
+
+// Calls |callback| with each mixed block, e.g. to feed a platform audio API
+// or to inspect the output.
+typedef void (*AudioSinkCallback)(const F32* pSamples,
+                                  size_t frames,
+                                  U32 channels,
+                                  void* pUserData);
+
+class CallbackAudioSink : public AudioSinkBase {
+ public:
+  CallbackAudioSink(AudioSinkCallback callback, void* pUserData)
+      : callback_(callback), pUserData_(pUserData) {}
+  ~CallbackAudioSink() override = default;
+
+  bool Open(U32 sampleRate, U32 channels) override;
+  void Write(const F32* pSamples, size_t frames) override;
+  void Close() override {}
+
+ private:
+  AudioSinkCallback callback_;
+  void* pUserData_;
+  U32 channels_ = 0;
+};
+
+}  // namespace Mana
@@ -3,27 +3,71 @@
 #pragma once
 
 #include <xaudio2.h>
+#include <atomic>
 #include "ManaGlobals.h"
 #include "audio/AudioBase.h"
+#include "audio/AudioFileOggWin.h"
 #include "audio/AudioFileWin.h"
+#include "concurrency/IThread.h"
+#include "concurrency/Mutex.h"
+#include "datastructures/MpmcQueue.h"
+#include "datastructures/SpscRingBuffer.h"
 #include "target/TargetOS.h"
+#include "utils/ObjectPool.h"
 #include "utils/ScopedComInitializer.h"
 
 //#pragma comment(lib, "xaudio2_9redist.lib")
 
 namespace Mana {
 
+enum class AudioCommandType : U8 {
+  Play,
+  Stop,
+  Pause,
+  Resume,
+  SetFileVolume,
+  SetCategoryVolume,
+  SetMasterVolume,
+  SetPan,
+};
+
+// A call from the main or game-loop thread,
+// queued up for the audio thread to apply.
+struct AudioCommand {
+  AudioCommandType type;
+  AudioFileHandle audioFileHandle;
+  AudioCategory category;
+  float value;  // volume or pan
+  uint32_t loopCount;
+};
+
 // XAudio2.9 wrapper with focus on simple indie games.
 // Can load ogg files. If oggs are large, they will be streamed,
 // else their pcm data is fully loaded into memory,
 // and statically loaded files can play multiple buffers at once
 // (for sound FX)
+//
+// All decoding and voice control happens on a dedicated audio thread,
+// so a 64 KB ov_read never stalls the game-loop:
+// - Play, Stop, Pause, Resume, SetVolume and SetPan don't touch XAudio2.
+//   They push an AudioCommand onto a lock-free queue and return right away.
+//   The audio thread applies commands in the order they were made.
+// - Streaming voices report each finished buffer through
+//   IXAudio2VoiceCallback::OnBufferEnd, which wakes the audio thread
+//   to decode and queue the next buffer for just that file.
+// Getters read XAudio2 directly, so they may not reflect commands
+// that the audio thread hasn't applied yet.
 class AudioWin : public AudioBase {
  public:
   static const unsigned MAX_LOOP_COUNT = XAUDIO2_MAX_LOOP_COUNT;
   static const unsigned LOOP_INFINITE = XAUDIO2_LOOP_INFINITE;
 
-  AudioWin() = default;
+  // max commands that can be waiting for the audio thread
+  static const size_t AUDIO_COMMAND_QUEUE_CAPACITY = 256;
+  // max buffer-end notifications that can be waiting for the audio thread
+  static const size_t BUFFER_END_QUEUE_CAPACITY = 256;
+
+  AudioWin();
   virtual ~AudioWin() = default;
 
   AudioWin(const AudioWin&) = delete;
@@ -31,14 +75,10 @@ class AudioWin : public AudioBase {
 
   bool Init() override;
   void Uninit() override;
-  AudioFileHandle Load(const xstring& filePath,
-                       AudioCategory category,
-                       AudioFormat format,
-                       int64_t loopBackPcmSamplePos = 0,
-                       int simultaneousSounds = 1) override;
   void Unload(AudioFileHandle audioFileHandle) override;
 
-  void Update() override;
+  // Does nothing, since streaming happens on the audio thread.
+  void Update() override {}
 
   bool Play(AudioFileHandle audioFileHandle, uint32_t loopCount = 0) override;
 
@@ -61,6 +101,13 @@ class AudioWin : public AudioBase {
   bool IsPaused(AudioFileHandle audioFileHandle) override;
 
  private:
+  AudioFileHandle LoadFile(const xstring& filePath,
+                           MappedFile* pMemory,
+                           AudioCategory category,
+                           AudioFormat format,
+                           int64_t loopBackPcmSamplePos,
+                           int simultaneousSounds) override;
+
   // 0 is silent
   const float AUDIO_MIN_VOLUME = 0.0f;
   // 1.0 is no attenuation or gain.
@@ -74,7 +121,66 @@ class AudioWin : public AudioBase {
   IXAudio2* pXAudio2_ = nullptr;
   IXAudio2MasteringVoice* pMasterVoice_ = nullptr;
 
+  // Shared by all streaming voices. XAudio2 calls it on its own processing
+  // thread, so it must never block.
+  class StreamingVoiceCallback : public IXAudio2VoiceCallback {
+   public:
+    explicit StreamingVoiceCallback(AudioWin* pAudio) : pAudio_(pAudio) {}
+
+    // pBufferContext is the AudioFileHandle of the file that owns the buffer
+    void STDMETHODCALLTYPE OnBufferEnd(void* pBufferContext) override;
+
+    void STDMETHODCALLTYPE OnStreamEnd() override {}
+    void STDMETHODCALLTYPE OnVoiceProcessingPassEnd() override {}
+    void STDMETHODCALLTYPE OnVoiceProcessingPassStart(UINT32) override {}
+    void STDMETHODCALLTYPE OnBufferStart(void*) override {}
+    void STDMETHODCALLTYPE OnLoopEnd(void*) override {}
+    void STDMETHODCALLTYPE OnVoiceError(void*, HRESULT) override {}
+
+   private:
+    AudioWin* pAudio_;
+  };
+  StreamingVoiceCallback voiceCallback_;
+
+  // loaded files live here, and their handles are PoolHandles from it
+  ObjectPool<AudioFileOggWin> oggFilePool_;
+  // returns |pFile| to its pool
+  void DeleteAudioFile(AudioFileWin* pFile);
+
+  IThread* pAudioThread_ = nullptr;
+  // auto-reset event that wakes the audio thread
+  HANDLE hAudioThreadEvent_ = nullptr;
+  // Held by the audio thread while it works on files,
+  // and by Unload, so a file is never deleted out from under it.
+  Mutex audioThreadLock_;
+
+  // main/game-loop threads push, the audio thread pops
+  MpmcQueue<AudioCommand, AUDIO_COMMAND_QUEUE_CAPACITY> commandQueue_;
+  // only XAudio2's processing thread pushes, the audio thread pops
+  SpscRingBuffer<AudioFileHandle, BUFFER_END_QUEUE_CAPACITY> bufferEndQueue_;
+  // set if a notification was dropped, so the audio thread tops up
+  // every streaming file instead of just the notified ones
+  std::atomic<bool> bBufferEndDropped_;
+
+  void PostCommand(const AudioCommand& command);
+  void OnStreamBufferEnd(AudioFileHandle audioFileHandle);
+
+  // audio thread only
+  void ProcessAudioThreadWork();
+  void ExecuteCommand(const AudioCommand& command);
+  void FillStreamingBuffers(AudioFileWin* pFile);
+  void PlayNow(AudioFileHandle audioFileHandle, uint32_t loopCount);
+  void StopNow(AudioFileHandle audioFileHandle);
+  void PauseNow(AudioFileHandle audioFileHandle);
+  void ResumeNow(AudioFileHandle audioFileHandle);
+  void SetVolumeNow(AudioFileHandle audioFileHandle, float volume);
+  void SetVolumeNow(AudioCategory category, float volume);
+  void SetMasterVolumeNow(float volume);
+  void SetPanNow(AudioFileHandle audioFileHandle, float pan);
+
   void ClampVolume(float& volume) override;
+
+  friend unsigned long AudioThreadFunction(IThread* pThread);
 };
 
 }  // namespace Mana
@@ -0,0 +1,110 @@
+// Cache of decoded pcm shared by static sounds
+
+#pragma once
+
+#include <list>
+#include <unordered_map>
+#include "ManaGlobals.h"
+#include "concurrency/Mutex.h"
+
+namespace Mana {
+
+struct PcmFormat {
+  U32 channels;
+  U32 sampleRate;
+  U32 bitsPerSample;
+};
+
+// Decoded pcm for one compressed file.
+// Owned by PcmCache. Files hold a reference while they're loaded.
+struct PcmBuffer {
+  U64 contentHash;   // hash of the compressed file bytes
+  xstring filePath;  // first path it was loaded from, for debugging
+  PcmFormat format;
+  uint8_t* pData;
+  size_t size;
+
+ private:
+  U32 refCount_;
+  // position in PcmCache::lru_, valid while refCount_ == 0
+  std::list<PcmBuffer*>::iterator lruPos_;
+
+  friend class PcmCache;
+};
+
+struct PcmCacheStats {
+  U64 hits;
+  U64 misses;
+  U64 evictions;
+  size_t entries;
+  size_t bytesCached;  // all entries, referenced or not
+  size_t bytesUnused;  // entries no file references (evictable)
+};
+
+// Decoding a static ogg every time it's loaded wastes time and memory
+// when the same sound is used by several levels, so the audio engines
+// keep decoded pcm here, keyed by a hash of the compressed file's bytes.
+// Identical files share one buffer even if their paths differ.
+//
+// Entries stay cached after their last file is unloaded, so reloading
+// on a level transition is a hit. Once the cache is over budget,
+// the least recently used unreferenced entries are evicted.
+// Referenced entries are never evicted, so a budget that's too small
+// only costs hits, never loads.
+//
+// Thread-safe, since loads run on job system workers.
+class PcmCache {
+ public:
+  static const size_t DEFAULT_BUDGET_BYTES = 64 * 1024 * 1024;
+
+  explicit PcmCache(size_t budgetBytes = DEFAULT_BUDGET_BYTES);
+  // asserts that no file still references an entry
+  virtual ~PcmCache();
+
+  PcmCache(const PcmCache&) = delete;
+  PcmCache& operator=(const PcmCache&) = delete;
+
+  // Returns the pcm for |contentHash| with a new reference,
+  // or nullptr on a miss.
+  PcmBuffer* Acquire(U64 contentHash);
+
+  // Adds freshly decoded pcm and returns it with one reference.
+  // Takes ownership of |pData|, which must come from
+  // TaggedNewArray<uint8_t>(MemoryTag::Audio, ...).
+  // If another thread added the same hash first, |pData| is freed
+  // and the existing entry is returned instead.
+  PcmBuffer* Insert(U64 contentHash,
+                    const xstring& filePath,
+                    const PcmFormat& format,
+                    uint8_t* pData,
+                    size_t size);
+
+  // Drops a reference from Acquire or Insert.
+  void Release(PcmBuffer* pBuffer);
+
+  void SetBudget(size_t budgetBytes);
+  size_t GetBudget() const { return budgetBytes_; }
+
+  // evicts every unreferenced entry
+  void Trim();
+
+  PcmCacheStats GetStats();
+  void LogStats();
+
+ private:
+  // requires lock_
+  void EvictToBudget(size_t budgetBytes);
+
+  Mutex lock_;
+  size_t budgetBytes_;
+  std::unordered_map<U64, PcmBuffer*> entries_;
+  // unreferenced entries, least recently used at the front
+  std::list<PcmBuffer*> lru_;
+  size_t bytesCached_;
+  size_t bytesUnused_;
+  U64 hits_;
+  U64 misses_;
+  U64 evictions_;
+};
+
+}  // namespace Mana
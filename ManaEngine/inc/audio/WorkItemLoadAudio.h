@@ -2,11 +2,16 @@
 
 #include "audio/AudioBase.h"
 #include "concurrency/IWorkItem.h"
+#include "concurrency/JobSystem.h"
 #include "concurrency/Mutex.h"
+#include "utils/MappedFile.h"
+#include "utils/Profiler.h"
 #include "utils/StringTypes.h"
 
 namespace Mana {
 
+struct AsyncReadResult;
+
 class WorkItemLoadAudio : public IWorkItem {
  public:
   WorkItemLoadAudio(AudioBase* audioEngine,
@@ -23,27 +28,34 @@ class WorkItemLoadAudio : public IWorkItem {
     simultaneousSounds_ = simultaneousSounds;
     handle_ = 0u;
     doneProcessing_ = false;
+    pMemory_ = nullptr;
   }
 
-  virtual ~WorkItemLoadAudio() = default;
+  // frees a read that was never decoded (e.g. the JobSystem was
+  // uninitialized first)
+  virtual ~WorkItemLoadAudio() { delete pMemory_; }
 
   WorkItemLoadAudio(const WorkItemLoadAudio&) = delete;
   WorkItemLoadAudio& operator=(const WorkItemLoadAudio&) = delete;
 
   WorkItemType GetType() override { return WorkItemType::LoadAudio; }
 
+  // Reads and decodes the file on the calling thread.
   void Process() override {
+    MANA_PROFILE_SCOPE("WorkItemLoadAudio::Process");
     size_t handle =
         pAudioEngine_->Load(file_, audioCategory_, audioFormat_,
                             loopBackPcmSamplePos_, simultaneousSounds_);
-
-    {
-      ScopedMutex lock(lock_);
-      handle_ = handle;
-      doneProcessing_ = true;
-    }
+    SetDone(handle);
   }
 
+  // Reads the file with g_pAsyncIO, whose completion callback then submits
+  // a job that decodes it, so the read doesn't hold up a worker.
+  // Returns that job (under |parent|), which is done once the file is
+  // loaded. Needs g_pJobSystem.
+  // Without g_pAsyncIO, it's g_pJobSystem->Run(this, parent).
+  JobHandle LoadAsync(JobHandle parent = JobHandle());
+
   size_t GetHandleIfDoneProcessing() override {
     ScopedMutex lock(lock_);
     if (doneProcessing_) {
@@ -54,6 +66,14 @@ class WorkItemLoadAudio : public IWorkItem {
   }
 
  private:
+  static void OnRead(const AsyncReadResult& result);
+  static void DecodeJob(void* pData);
+  void SetDone(size_t handle) {
+    ScopedMutex lock(lock_);
+    handle_ = handle;
+    doneProcessing_ = true;
+  }
+
   Mutex lock_;
   AudioBase* pAudioEngine_;
   xstring file_;
@@ -63,6 +83,10 @@ class WorkItemLoadAudio : public IWorkItem {
   int simultaneousSounds_;
   size_t handle_;
   bool doneProcessing_;
+  // LoadAsync's decode job, submitted once the read completes
+  JobHandle decodeJob_;
+  // the bytes read by LoadAsync, or null if the read failed
+  MappedFile* pMemory_;
 };
 
 }  // namespace Mana
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "ManaGlobals.h"
+#include "concurrency/Mutex.h"
+#include "target/TargetOS.h"
+#ifndef OS_WIN
+#include <condition_variable>
+#endif
+
+namespace Mana {
+
+// A cross-thread condition variable that is paired with a Mutex.
+// The Mutex must be locked by the calling thread before calling Wait,
+// and is locked again when Wait returns.
+// Wait can return spuriously, so always call it in a loop
+// that re-checks the condition you're waiting on.
+class ConditionVariable {
+ public:
+  ConditionVariable();
+  ~ConditionVariable();
+
+  void Wait(Mutex& mutex);
+  // returns false if |milliseconds| elapsed without being notified
+  bool WaitFor(Mutex& mutex, U32 milliseconds);
+
+  void NotifyOne();
+  void NotifyAll();
+
+  ConditionVariable(const ConditionVariable&) = delete;
+  ConditionVariable& operator=(const ConditionVariable&) = delete;
+
+ protected:
+#ifdef OS_WIN
+  // CONDITION_VARIABLE works directly with our CRITICAL_SECTION based Mutex.
+  CONDITION_VARIABLE conditionVariable_;
+#else
+  std::condition_variable conditionVariable_;
+#endif
+};
+
+}  // namespace Mana
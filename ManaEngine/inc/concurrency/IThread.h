@@ -1,6 +1,15 @@
 #pragma once
 
 #include "concurrency/IWorkItem.h"
+#include "target/OSDefines.h"
+
+// ThreadFactory has two backends:
+//   ThreadWin.cpp - CreateThread / event based (default on Windows)
+//   ThreadStd.cpp - std::thread / ConditionVariable based (portable)
+// Define MANA_THREAD_STD to use the portable backend on Windows too.
+#if !defined(OS_WIN) && !defined(MANA_THREAD_STD)
+#define MANA_THREAD_STD
+#endif
 
 namespace Mana {
 
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "ManaGlobals.h"
+#include "concurrency/ConditionVariable.h"
+#include "concurrency/IThread.h"
+#include "concurrency/IWorkItem.h"
+#include "concurrency/Mutex.h"
+#include "datastructures/SynchronizedQueue.h"
+#include "datastructures/WorkStealingDeque.h"
+
+namespace Mana {
+
+class JobSystem;
+extern JobSystem* g_pJobSystem;
+
+typedef void (*JobFunc)(void* pData);
+
+// Identifies a job created by the JobSystem.
+// It's always safe to call IsDone/Wait on a handle, even long after the job
+// finished and its slot was reused. Invalid handles are always "done".
+struct JobHandle {
+  U32 index = 0;
+  U32 generation = 0;  // 0 is never a valid generation
+
+  bool IsValid() const { return generation != 0; }
+};
+
+// A work-stealing job system with one worker thread per hardware thread.
+// Each worker owns a Chase-Lev deque. Jobs submitted from a worker go to
+// its own deque, jobs submitted from other threads (main, game-loop) go to
+// a shared queue, and idle workers steal from each other.
+//
+// Jobs can have a parent. A job isn't done until it and all of its children
+// have finished, so waiting on a parent waits on the whole group.
+// Children must be created before their parent finishes, so either create
+// them before submitting the parent, or from within the parent's job.
+// A child created after its parent finished runs on its own, without one.
+//
+// Usage:
+//   JobHandle group = g_pJobSystem->CreateJob(nullptr, nullptr);
+//   g_pJobSystem->Run(pLoadMusic, group);  // IWorkItem*
+//   g_pJobSystem->Run(pLoadSFX, group);
+//   g_pJobSystem->Submit(group);
+//   g_pJobSystem->Wait(group);  // or poll IsDone(group)
+class JobSystem {
+ public:
+  // Max jobs that can be in flight at once.
+  static const U32 MAX_JOBS = 4096;
+  // Per-worker deque size. When full, jobs go to the shared queue.
+  static const size_t DEQUE_CAPACITY = 1024;
+
+  JobSystem();
+  virtual ~JobSystem();
+
+  JobSystem(const JobSystem&) = delete;
+  JobSystem& operator=(const JobSystem&) = delete;
+
+  // |numWorkers| of 0 creates one worker per hardware thread.
+  bool Init(U32 numWorkers = 0);
+  // Stops and joins all workers. Jobs that haven't started are dropped.
+  void Uninit();
+
+  // Creates a job without running it. Call Submit to queue it.
+  // |func| may be nullptr, which is useful for a parent that only groups
+  // children together.
+  // Returns an invalid handle if MAX_JOBS are already in flight.
+  JobHandle CreateJob(JobFunc func,
+                      void* pData,
+                      JobHandle parent = JobHandle());
+  // IWorkItem::Process is called on a worker thread.
+  // The JobSystem doesn't take ownership of |pWorkItem|.
+  JobHandle CreateJob(IWorkItem* pWorkItem, JobHandle parent = JobHandle());
+  void Submit(JobHandle job);
+
+  // CreateJob + Submit.
+  // If no job slots are free, runs the job on the calling thread
+  // before returning (and returns an invalid handle).
+  JobHandle Run(JobFunc func, void* pData, JobHandle parent = JobHandle());
+  JobHandle Run(IWorkItem* pWorkItem, JobHandle parent = JobHandle());
+
+  // true once the job and all of its children have finished.
+  bool IsDone(JobHandle job);
+  // Blocks until the job is done.
+  // The calling thread runs queued jobs while it waits.
+  void Wait(JobHandle job);
+
+  U32 GetWorkerCount() const { return (U32)workers_.size(); }
+
+ private:
+  struct Job {
+    JobFunc func;
+    void* pData;
+    IWorkItem* pWorkItem;
+    U32 parent;  // index + 1 of the parent job, or 0 if none
+    // 1 for the job itself, plus 1 for each unfinished child
+    std::atomic<I32> unfinished;
+    // incremented each time the slot is freed, so stale handles are "done"
+    std::atomic<U32> generation;
+  };
+
+  typedef WorkStealingDeque<U32, DEQUE_CAPACITY> JobDeque;
+
+  std::unique_ptr<Job[]> jobs_;
+  Mutex freeJobsLock_;
+  std::vector<U32> freeJobs_;
+
+  std::vector<IThread*> workers_;
+  std::vector<std::unique_ptr<JobDeque>> deques_;
+  // jobs submitted from non-worker threads, or when a deque is full
+  SynchronizedQueue<U32> sharedQueue_;
+
+  // number of submitted jobs that no thread has taken yet
+  std::atomic<I32> pendingJobs_;
+  std::atomic<I32> sleepingWorkers_;
+  Mutex sleepLock_;
+  ConditionVariable sleepCondition_;
+
+  bool bInitialized_ = false;
+
+  JobHandle AllocJob(JobFunc func,
+                     void* pData,
+                     IWorkItem* pWorkItem,
+                     JobHandle parent);
+  void FreeJob(U32 index);
+  void Execute(U32 index);
+  void Finish(U32 index);
+
+  // Runs a single job if one is available.
+  // |workerIndex| is -1 on non-worker threads.
+  bool RunOneJob(I32 workerIndex);
+  // Sleeps until a job is submitted or the worker is stopped.
+  void WaitForJobs(IThread* pWorker);
+  I32 GetCurrentWorkerIndex();
+
+  friend unsigned long JobWorkerThreadFunction(IThread* pThread);
+};
+
+}  // namespace Mana
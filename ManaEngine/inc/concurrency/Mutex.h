@@ -2,6 +2,9 @@
 
 #include "ManaGlobals.h"
 #include "target/TargetOS.h"
+#ifndef OS_WIN
+#include <mutex>
+#endif
 
 namespace Mana {
 
@@ -26,6 +29,8 @@ class Mutex {
 #else
   std::mutex mutex_;
 #endif
+
+  friend class ConditionVariable;
 };
 
 class ScopedMutex {
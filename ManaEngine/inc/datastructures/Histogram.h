@@ -0,0 +1,115 @@
+#pragma once
+
+#include <string.h>
+#include "ManaGlobals.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace Mana {
+
+// A fixed-size histogram of U32 values (e.g. microseconds) with buckets that
+// widen with the value, like HdrHistogram: values below 64 get a bucket
+// each, and every power of 2 above that is split into 32 buckets. So any
+// percentile is within about 3% of the value recorded, from 1 us to over
+// an hour, in 3.5 KB and with no allocation.
+// Not thread safe.
+class Histogram {
+ public:
+  // exact below 2^SUB_BUCKET_BITS, then 2^(SUB_BUCKET_BITS-1) per octave
+  static const U32 SUB_BUCKET_BITS = 6;
+  static const U32 SUB_BUCKETS = 1u << SUB_BUCKET_BITS;
+  static const U32 HALF_SUB_BUCKETS = SUB_BUCKETS / 2;
+  static const U32 BUCKETS =
+      SUB_BUCKETS + (32 - SUB_BUCKET_BITS) * HALF_SUB_BUCKETS;
+
+  Histogram() { Reset(); }
+  virtual ~Histogram() = default;
+
+  Histogram(const Histogram&) = delete;
+  Histogram& operator=(const Histogram&) = delete;
+
+  void Reset() {
+    memset(counts_, 0, sizeof(counts_));
+    count_ = 0;
+    sum_ = 0;
+    min_ = 0;
+    max_ = 0;
+  }
+
+  void Record(U32 value) {
+    ++counts_[GetBucket(value)];
+    min_ = count_ == 0 || value < min_ ? value : min_;
+    max_ = value > max_ ? value : max_;
+    ++count_;
+    sum_ += value;
+  }
+
+  U64 GetCount() const { return count_; }
+  U32 GetMin() const { return min_; }
+  U32 GetMax() const { return max_; }
+  U64 GetMean() const { return count_ ? sum_ / count_ : 0; }
+
+  // The value |percentile| (0 to 100) percent of the values are at or
+  // below, rounded up to the end of its bucket. 0 if nothing's recorded.
+  U32 GetPercentile(double percentile) const {
+    if (count_ == 0) {
+      return 0;
+    }
+
+    U64 target = (U64)(percentile / 100.0 * count_ + 0.5);
+    target = target < 1 ? 1 : target > count_ ? count_ : target;
+
+    U64 seen = 0;
+    for (U32 bucket = 0; bucket < BUCKETS; ++bucket) {
+      seen += counts_[bucket];
+      if (seen >= target) {
+        U32 high = GetBucketHighest(bucket);
+        return high < max_ ? high : max_;
+      }
+    }
+    return max_;
+  }
+
+  static U32 GetBucket(U32 value) {
+    if (value < SUB_BUCKETS) {
+      return value;
+    }
+    // value is in [2^octave, 2^(octave+1)), octave >= SUB_BUCKET_BITS
+    U32 octave = HighestBit(value);
+    U32 shift = octave - SUB_BUCKET_BITS + 1;
+    return SUB_BUCKETS + (octave - SUB_BUCKET_BITS) * HALF_SUB_BUCKETS +
+           ((value >> shift) - HALF_SUB_BUCKETS);
+  }
+
+  // the largest value that lands in |bucket|
+  static U32 GetBucketHighest(U32 bucket) {
+    if (bucket < SUB_BUCKETS) {
+      return bucket;
+    }
+    U32 index = bucket - SUB_BUCKETS;
+    U32 shift = index / HALF_SUB_BUCKETS + 1;
+    U64 top = HALF_SUB_BUCKETS + index % HALF_SUB_BUCKETS + 1;
+    return (U32)((top << shift) - 1);
+  }
+
+ private:
+  static U32 HighestBit(U32 value) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse(&index, value);
+    return (U32)index;
+#else
+    return 31 - (U32)__builtin_clz(value);
+#endif
+  }
+
+  U32 counts_[BUCKETS];
+  U64 count_;
+  U64 sum_;
+  U32 min_;
+  U32 max_;
+};
+
+}  // namespace Mana
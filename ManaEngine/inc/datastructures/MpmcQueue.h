@@ -0,0 +1,221 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <thread>
+#include "ManaGlobals.h"
+#include "datastructures/RingOverflowPolicy.h"
+
+namespace Mana {
+
+// A fixed-capacity, lock-free, multi-producer / multi-consumer queue.
+// Any number of threads may push and pop concurrently.
+// This is Dmitry Vyukov's bounded MPMC queue: each slot has a sequence
+// number that says whether it's free for the next producer or holds a value
+// for the next consumer, so producers and consumers only contend on their
+// own position counter and never on a lock.
+// The batch functions claim a run of slots with a single CAS.
+// No heap allocation: all |Capacity| elements live inside the object.
+// T must be default constructible and copy assignable.
+// |Capacity| must be a power of 2.
+template <typename T, size_t Capacity>
+class MpmcQueue {
+ public:
+  explicit MpmcQueue(
+      RingOverflowPolicy policy = RingOverflowPolicy::DropNewest);
+  virtual ~MpmcQueue() = default;
+
+  MpmcQueue(const MpmcQueue&) = delete;
+  MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+  // Returns false if the queue is full.
+  bool TryPush(const T& value) { return TryPushBatch(&value, 1) == 1; }
+  // Pushes up to |count| values from |pValues| in order,
+  // and returns how many were pushed (fewer if the queue filled up).
+  size_t TryPushBatch(const T* pValues, size_t count);
+
+  // Returns nullopt if empty, else returns front and pops it off.
+  std::optional<T> TryPop();
+  // Pops up to |destCapacity| values into |pDest| in FIFO order
+  // and returns how many were popped.
+  size_t TryPopBatch(T* pDest, size_t destCapacity);
+
+  // Same interface as SpscRingBuffer, so either can back a queue
+  // chosen at compile time.
+  // Push applies the overflow policy when the queue is full.
+  bool Push(const T& value);
+  std::optional<T> Pop() { return TryPop(); }
+  size_t PopAll(T* pDest, size_t destCapacity) {
+    return TryPopBatch(pDest, destCapacity);
+  }
+
+  // Approximate while other threads are pushing/popping.
+  bool Empty_NoLock() const;
+  size_t Size() const;
+  static constexpr size_t GetCapacity() { return Capacity; }
+
+  // Only call while no thread is pushing.
+  void SetOverflowPolicy(RingOverflowPolicy policy) { policy_ = policy; }
+  RingOverflowPolicy GetOverflowPolicy() const { return policy_; }
+  // total values dropped by Push because the queue was full
+  U64 GetDroppedCount() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  static_assert((Capacity & (Capacity - 1)) == 0,
+                "Capacity must be a power of 2");
+  static const size_t MASK = Capacity - 1;
+
+  struct Cell {
+    // == position: free for the producer at |position|.
+    // == position + 1: holds the value for the consumer at |position|.
+    std::atomic<size_t> sequence;
+    T data;
+  };
+
+  // producers and consumers each hammer their own position,
+  // so keep them on separate cache lines.
+  alignas(64) std::atomic<size_t> enqueuePos_;
+  alignas(64) std::atomic<size_t> dequeuePos_;
+  alignas(64) RingOverflowPolicy policy_;
+  std::atomic<U64> dropped_;
+
+  alignas(64) Cell cells_[Capacity];
+};
+
+template <typename T, size_t Capacity>
+MpmcQueue<T, Capacity>::MpmcQueue(RingOverflowPolicy policy)
+    : enqueuePos_(0), dequeuePos_(0), policy_(policy), dropped_(0) {
+  for (size_t i = 0; i < Capacity; ++i) {
+    cells_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+template <typename T, size_t Capacity>
+size_t MpmcQueue<T, Capacity>::TryPushBatch(const T* pValues, size_t count) {
+  if (count == 0) {
+    return 0;
+  }
+
+  size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+  while (true) {
+    // count how many slots from |pos| on are free for us
+    size_t ready = 0;
+    bool bStale = false;
+    for (; ready < count && ready < Capacity; ++ready) {
+      size_t seq =
+          cells_[(pos + ready) & MASK].sequence.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)seq - (intptr_t)(pos + ready);
+      if (diff != 0) {
+        // diff < 0: a consumer hasn't freed the slot yet (full).
+        // diff > 0: another producer already moved past |pos|.
+        bStale = diff > 0 && ready == 0;
+        break;
+      }
+    }
+
+    if (ready == 0) {
+      if (!bStale) {
+        return 0;
+      }
+      pos = enqueuePos_.load(std::memory_order_relaxed);
+      continue;
+    }
+
+    // Claim all the free slots at once. Only the producer that claims a slot
+    // can change its sequence, so they're still free if the CAS succeeds.
+    if (enqueuePos_.compare_exchange_weak(pos, pos + ready,
+                                          std::memory_order_relaxed)) {
+      for (size_t i = 0; i < ready; ++i) {
+        Cell& cell = cells_[(pos + i) & MASK];
+        cell.data = pValues[i];
+        cell.sequence.store(pos + i + 1, std::memory_order_release);
+      }
+      return ready;
+    }
+    // CAS failed and reloaded |pos|, so try again
+  }
+}
+
+template <typename T, size_t Capacity>
+std::optional<T> MpmcQueue<T, Capacity>::TryPop() {
+  T value;
+  if (TryPopBatch(&value, 1) == 0) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+template <typename T, size_t Capacity>
+size_t MpmcQueue<T, Capacity>::TryPopBatch(T* pDest, size_t destCapacity) {
+  if (destCapacity == 0) {
+    return 0;
+  }
+
+  size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+  while (true) {
+    // count how many slots from |pos| on hold values for us
+    size_t ready = 0;
+    bool bStale = false;
+    for (; ready < destCapacity && ready < Capacity; ++ready) {
+      size_t seq =
+          cells_[(pos + ready) & MASK].sequence.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)seq - (intptr_t)(pos + ready + 1);
+      if (diff != 0) {
+        // diff < 0: a producer hasn't filled the slot yet (empty).
+        // diff > 0: another consumer already moved past |pos|.
+        bStale = diff > 0 && ready == 0;
+        break;
+      }
+    }
+
+    if (ready == 0) {
+      if (!bStale) {
+        return 0;
+      }
+      pos = dequeuePos_.load(std::memory_order_relaxed);
+      continue;
+    }
+
+    if (dequeuePos_.compare_exchange_weak(pos, pos + ready,
+                                          std::memory_order_relaxed)) {
+      for (size_t i = 0; i < ready; ++i) {
+        Cell& cell = cells_[(pos + i) & MASK];
+        pDest[i] = cell.data;
+        // free the slot for the producer one lap ahead
+        cell.sequence.store(pos + i + Capacity, std::memory_order_release);
+      }
+      return ready;
+    }
+  }
+}
+
+template <typename T, size_t Capacity>
+bool MpmcQueue<T, Capacity>::Push(const T& value) {
+  while (!TryPush(value)) {
+    if (policy_ == RingOverflowPolicy::DropNewest) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    std::this_thread::yield();
+  }
+  return true;
+}
+
+template <typename T, size_t Capacity>
+bool MpmcQueue<T, Capacity>::Empty_NoLock() const {
+  size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+  size_t seq = cells_[pos & MASK].sequence.load(std::memory_order_acquire);
+  return (intptr_t)seq - (intptr_t)(pos + 1) < 0;
+}
+
+template <typename T, size_t Capacity>
+size_t MpmcQueue<T, Capacity>::Size() const {
+  size_t head = dequeuePos_.load(std::memory_order_acquire);
+  size_t tail = enqueuePos_.load(std::memory_order_acquire);
+  return tail > head ? tail - head : 0;
+}
+
+}  // namespace Mana
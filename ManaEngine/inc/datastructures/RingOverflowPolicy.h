@@ -0,0 +1,14 @@
+#pragma once
+
+namespace Mana {
+
+// What a bounded ring queue's Push does when the ring is full.
+enum class RingOverflowPolicy {
+  // Push fails and the value is dropped (counted in GetDroppedCount).
+  DropNewest,
+  // Push spins (yielding) until a consumer frees a slot.
+  // Only use this if the consumer is guaranteed to keep draining.
+  Block,
+};
+
+}  // namespace Mana
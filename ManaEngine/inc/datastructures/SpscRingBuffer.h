@@ -0,0 +1,194 @@
+#pragma once
+
+#include <atomic>
+#include <optional>
+#include <thread>
+#include "ManaGlobals.h"
+#include "datastructures/RingOverflowPolicy.h"
+
+namespace Mana {
+
+// A fixed-capacity, lock-free, single-producer / single-consumer ring buffer.
+// Exactly one thread may push and exactly one (other) thread may pop.
+// No heap allocation: all |Capacity| elements live inside the object.
+// Intended for the main thread -> game-loop thread event path,
+// where SynchronizedQueue's lock and per-node allocations are too costly.
+// T must be default constructible and copy assignable.
+// |Capacity| must be a power of 2.
+template <typename T, size_t Capacity>
+class SpscRingBuffer {
+ public:
+  explicit SpscRingBuffer(
+      RingOverflowPolicy policy = RingOverflowPolicy::DropNewest)
+      : head_(0), cachedTail_(0), tail_(0), cachedHead_(0),
+        policy_(policy), dropped_(0) {}
+  virtual ~SpscRingBuffer() = default;
+
+  SpscRingBuffer(const SpscRingBuffer&) = delete;
+  SpscRingBuffer& operator=(const SpscRingBuffer&) = delete;
+
+  // Producer thread only.
+  // Returns false if the value was dropped.
+  bool Push(const T& value);
+  // Producer thread only. Push without a copy: fill in the slot BeginPush
+  // returns, then publish it with EndPush. Returns nullptr if the value
+  // has to be dropped.
+  T* BeginPush();
+  void EndPush();
+  // Producer thread only. Whether |count| more values fit right now.
+  // Only reads the consumer's position when its cached copy says no.
+  bool HasSpaceFor(size_t count);
+  // Producer thread only. Like Size(), but from the producer's cached view
+  // of the consumer, so it may be an overestimate.
+  size_t ProducerSize() const {
+    return tail_.load(std::memory_order_relaxed) - cachedHead_;
+  }
+
+  // Consumer thread only.
+  // Returns nullopt if empty, else returns front and pops it off.
+  std::optional<T> Pop();
+  // Consumer thread only.
+  // Pops up to |destCapacity| values into |pDest| in FIFO order
+  // and returns how many were popped.
+  size_t PopAll(T* pDest, size_t destCapacity);
+
+  // Consumer thread only (from the producer it's only a hint).
+  bool Empty_NoLock() const;
+  // Approximate when called while the other thread is active.
+  size_t Size() const;
+  static constexpr size_t GetCapacity() { return Capacity; }
+
+  // Only call while no thread is pushing.
+  void SetOverflowPolicy(RingOverflowPolicy policy) { policy_ = policy; }
+  RingOverflowPolicy GetOverflowPolicy() const { return policy_; }
+  // total values dropped by Push because the ring was full
+  U64 GetDroppedCount() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  static_assert((Capacity & (Capacity - 1)) == 0,
+                "Capacity must be a power of 2");
+  static const size_t MASK = Capacity - 1;
+
+  // Consumer-owned cache line.
+  // head_ and tail_ only ever increase, and are masked on access.
+  alignas(64) std::atomic<size_t> head_;
+  size_t cachedTail_;  // consumer's last seen tail_
+
+  // Producer-owned cache line.
+  alignas(64) std::atomic<size_t> tail_;
+  size_t cachedHead_;  // producer's last seen head_
+  RingOverflowPolicy policy_;
+  std::atomic<U64> dropped_;
+
+  alignas(64) T buffer_[Capacity];
+};
+
+template <typename T, size_t Capacity>
+bool SpscRingBuffer<T, Capacity>::Push(const T& value) {
+  T* pSlot = BeginPush();
+  if (!pSlot) {
+    return false;
+  }
+  *pSlot = value;
+  EndPush();
+  return true;
+}
+
+template <typename T, size_t Capacity>
+T* SpscRingBuffer<T, Capacity>::BeginPush() {
+  size_t tail = tail_.load(std::memory_order_relaxed);
+
+  if (tail - cachedHead_ >= Capacity) {
+    // looks full, so refresh our view of the consumer
+    cachedHead_ = head_.load(std::memory_order_acquire);
+
+    while (tail - cachedHead_ >= Capacity) {
+      if (policy_ == RingOverflowPolicy::DropNewest) {
+        dropped_.store(dropped_.load(std::memory_order_relaxed) + 1,
+                       std::memory_order_relaxed);
+        return nullptr;
+      }
+
+      std::this_thread::yield();
+      cachedHead_ = head_.load(std::memory_order_acquire);
+    }
+  }
+
+  return &buffer_[tail & MASK];
+}
+
+template <typename T, size_t Capacity>
+void SpscRingBuffer<T, Capacity>::EndPush() {
+  tail_.store(tail_.load(std::memory_order_relaxed) + 1,
+              std::memory_order_release);
+}
+
+template <typename T, size_t Capacity>
+bool SpscRingBuffer<T, Capacity>::HasSpaceFor(size_t count) {
+  size_t tail = tail_.load(std::memory_order_relaxed);
+  if (Capacity - (tail - cachedHead_) >= count) {
+    return true;
+  }
+  cachedHead_ = head_.load(std::memory_order_acquire);
+  return Capacity - (tail - cachedHead_) >= count;
+}
+
+template <typename T, size_t Capacity>
+std::optional<T> SpscRingBuffer<T, Capacity>::Pop() {
+  size_t head = head_.load(std::memory_order_relaxed);
+
+  if (head == cachedTail_) {
+    cachedTail_ = tail_.load(std::memory_order_acquire);
+    if (head == cachedTail_) {
+      return std::nullopt;
+    }
+  }
+
+  T front = buffer_[head & MASK];
+  head_.store(head + 1, std::memory_order_release);
+  return front;
+}
+
+template <typename T, size_t Capacity>
+size_t SpscRingBuffer<T, Capacity>::PopAll(T* pDest, size_t destCapacity) {
+  size_t head = head_.load(std::memory_order_relaxed);
+  cachedTail_ = tail_.load(std::memory_order_acquire);
+
+  size_t count = cachedTail_ - head;
+  if (count > destCapacity) {
+    count = destCapacity;
+  }
+  if (count == 0) {
+    return 0;
+  }
+
+  // copy in up to two runs, since the values may wrap around the end
+  size_t start = head & MASK;
+  size_t firstRun = Capacity - start < count ? Capacity - start : count;
+  for (size_t i = 0; i < firstRun; ++i) {
+    pDest[i] = buffer_[start + i];
+  }
+  for (size_t i = firstRun; i < count; ++i) {
+    pDest[i] = buffer_[i - firstRun];
+  }
+
+  head_.store(head + count, std::memory_order_release);
+  return count;
+}
+
+template <typename T, size_t Capacity>
+bool SpscRingBuffer<T, Capacity>::Empty_NoLock() const {
+  return head_.load(std::memory_order_relaxed) ==
+         tail_.load(std::memory_order_acquire);
+}
+
+template <typename T, size_t Capacity>
+size_t SpscRingBuffer<T, Capacity>::Size() const {
+  size_t tail = tail_.load(std::memory_order_acquire);
+  size_t head = head_.load(std::memory_order_acquire);
+  return tail - head;
+}
+
+}  // namespace Mana
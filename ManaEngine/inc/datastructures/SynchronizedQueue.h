@@ -20,7 +20,7 @@ class SynchronizedQueue {
   SynchronizedQueue& operator=(const SynchronizedQueue&) = delete;
 
   bool Empty_NoLock();
-  const size_t Size();
+  size_t Size();
 
   void Push(const T& value);
   void Push(T&& value);
@@ -49,7 +49,7 @@ bool SynchronizedQueue<T>::Empty_NoLock() {
 }
 
 template <typename T>
-const size_t SynchronizedQueue<T>::Size() {
+size_t SynchronizedQueue<T>::Size() {
   ScopedMutex lock(lock_);
   return (size_t)queue_.size();
 }
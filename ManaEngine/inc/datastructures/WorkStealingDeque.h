@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <optional>
+#include "ManaGlobals.h"
+
+namespace Mana {
+
+// A fixed-capacity Chase-Lev work-stealing deque.
+// The owning thread pushes and pops at the bottom (LIFO),
+// while any other thread may steal from the top (FIFO).
+// Memory ordering follows "Correct and Efficient Work-Stealing for Weak
+// Memory Models" (Le, Pop, Cohen, Zappa Nardelli - PPoPP 2013),
+// minus the resizing, since we'd rather have the caller fall back
+// to another queue than allocate.
+// T must be trivially copyable (we store pointers or indices).
+// |Capacity| must be a power of 2.
+template <typename T, size_t Capacity>
+class WorkStealingDeque {
+ public:
+  WorkStealingDeque() : top_(0), bottom_(0) {}
+  virtual ~WorkStealingDeque() = default;
+
+  WorkStealingDeque(const WorkStealingDeque&) = delete;
+  WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+  // Owner thread only.
+  // Returns false if the deque is full.
+  bool Push(T value);
+  // Owner thread only.
+  // Returns nullopt if empty, else returns the most recently pushed value.
+  std::optional<T> Pop();
+  // Any thread.
+  // Returns nullopt if empty or if another thread won the race
+  // for the oldest value.
+  std::optional<T> Steal();
+
+  // Approximate, since other threads may be pushing/stealing.
+  size_t Size_NoLock() const;
+
+ private:
+  static_assert((Capacity & (Capacity - 1)) == 0,
+                "Capacity must be a power of 2");
+  static const size_t MASK = Capacity - 1;
+
+  // top_ and bottom_ are written by different threads,
+  // so keep them on separate cache lines.
+  alignas(64) std::atomic<I64> top_;
+  alignas(64) std::atomic<I64> bottom_;
+  alignas(64) std::atomic<T> buffer_[Capacity];
+};
+
+template <typename T, size_t Capacity>
+bool WorkStealingDeque<T, Capacity>::Push(T value) {
+  I64 b = bottom_.load(std::memory_order_relaxed);
+  I64 t = top_.load(std::memory_order_acquire);
+  if (b - t >= (I64)Capacity) {
+    return false;
+  }
+
+  buffer_[b & MASK].store(value, std::memory_order_relaxed);
+  // release, so thieves that see the new bottom also see the value
+  bottom_.store(b + 1, std::memory_order_release);
+  return true;
+}
+
+template <typename T, size_t Capacity>
+std::optional<T> WorkStealingDeque<T, Capacity>::Pop() {
+  I64 b = bottom_.load(std::memory_order_relaxed) - 1;
+  bottom_.store(b, std::memory_order_relaxed);
+  // the store to bottom_ must be visible before we read top_,
+  // else we could both pop and have stolen the last value.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  I64 t = top_.load(std::memory_order_relaxed);
+
+  if (t > b) {
+    // empty
+    bottom_.store(b + 1, std::memory_order_relaxed);
+    return std::nullopt;
+  }
+
+  T value = buffer_[b & MASK].load(std::memory_order_relaxed);
+  if (t == b) {
+    // last value, so race any thieves for it
+    bool won = top_.compare_exchange_strong(
+        t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+    if (!won) {
+      return std::nullopt;
+    }
+  }
+
+  return value;
+}
+
+template <typename T, size_t Capacity>
+std::optional<T> WorkStealingDeque<T, Capacity>::Steal() {
+  I64 t = top_.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  I64 b = bottom_.load(std::memory_order_acquire);
+
+  if (t >= b) {
+    return std::nullopt;
+  }
+
+  T value = buffer_[t & MASK].load(std::memory_order_relaxed);
+  if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                    std::memory_order_relaxed)) {
+    // lost the race to the owner or another thief
+    return std::nullopt;
+  }
+
+  return value;
+}
+
+template <typename T, size_t Capacity>
+size_t WorkStealingDeque<T, Capacity>::Size_NoLock() const {
+  I64 b = bottom_.load(std::memory_order_relaxed);
+  I64 t = top_.load(std::memory_order_relaxed);
+  return b > t ? (size_t)(b - t) : 0;
+}
+
+}  // namespace Mana
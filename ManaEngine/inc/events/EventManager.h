@@ -1,7 +1,8 @@
 #pragma once
 
 #include "ManaGlobals.h"
-#include "datastructures/SynchronizedQueue.h"
+#include "datastructures/MpmcQueue.h"
+#include "datastructures/SpscRingBuffer.h"
 #include "input/InputBase.h"
 
 namespace Mana {
@@ -26,6 +27,22 @@ struct SynchronizedEvent {
 class EventManager;
 extern EventManager* g_pEventMan;
 
+// Max events the main thread can queue up before the game-loop drains them.
+// The game-loop drains every frame, so this only fills if it stalls.
+constexpr size_t SYNC_EVENT_QUEUE_CAPACITY = 1024;
+
+// By default only the main thread pushes and only the game-loop thread pops,
+// so the queue is a single-producer ring that doesn't need a lock.
+// Define MANA_SYNC_EVENTS_MPMC (in the project's preprocessor definitions)
+// to let other threads (audio callbacks, loader jobs, etc) post to the
+// game-loop too, which switches to a lock-free multi-producer queue.
+#ifdef MANA_SYNC_EVENTS_MPMC
+typedef MpmcQueue<SynchronizedEvent, SYNC_EVENT_QUEUE_CAPACITY> SyncEventQueue;
+#else
+typedef SpscRingBuffer<SynchronizedEvent, SYNC_EVENT_QUEUE_CAPACITY>
+    SyncEventQueue;
+#endif
+
 class EventManager {
  public:
   EventManager() = default;
@@ -34,15 +51,34 @@ class EventManager {
   EventManager(const EventManager&) = delete;
   EventManager& operator=(const EventManager&) = delete;
 
-  bool Init() { return true; }
+  // |overflowPolicy| decides what happens to events if the game-loop
+  // falls SYNC_EVENT_QUEUE_CAPACITY events behind.
+  bool Init(
+      RingOverflowPolicy overflowPolicy = RingOverflowPolicy::DropNewest) {
+    syncQueue_.SetOverflowPolicy(overflowPolicy);
+    return true;
+  }
   void Uninit() {}
 
-  // queues up events going from main thread to the game-loop thread
+  // queues up events going from main thread to the game-loop thread.
+  // Must only be called from the main thread,
+  // unless MANA_SYNC_EVENTS_MPMC is defined.
   void EnqueueForGameLoop(SynchronizedEvent& event);
 
-  SynchronizedQueue<SynchronizedEvent>& GetSyncQueue() { return syncQueue_; }
+  // While replaying a recording (InputReplayer), EnqueueForGameLoop drops
+  // live input, and the game-loop thread queues the recorded events with
+  // EnqueueReplayed instead. Set it before the game-loop starts.
+  void SetReplaying(bool bReplaying) { bReplaying_ = bReplaying; }
+  bool IsReplaying() const { return bReplaying_; }
+  // Game-loop thread only, while replaying. false if the queue is full.
+  bool EnqueueReplayed(const SynchronizedEvent& event) {
+    return syncQueue_.Push(event);
+  }
+
+  SyncEventQueue& GetSyncQueue() { return syncQueue_; }
  private:
-  SynchronizedQueue<SynchronizedEvent> syncQueue_;
+  SyncEventQueue syncQueue_;
+  bool bReplaying_ = false;
 };
 
 }  // namespace Mana
@@ -0,0 +1,102 @@
+// Records the input the game loop consumes, and replays it, for
+// repeatable benchmark and regression runs
+
+#pragma once
+
+#include <stdio.h>
+#include <vector>
+#include "ManaGlobals.h"
+#include "events/EventManager.h"
+#include "utils/File.h"
+
+namespace Mana {
+
+// Input recording file layout (little endian, same as x86):
+//   header: "MINP", U16 version, U16 reserved, U32 micros per tick
+//   then one record per event:
+//     varint ticks since the previous record
+//     U8 syncEventType, U8 deviceType, U8 deviceChangeType
+//     varint device index, into the devices seen so far. The first time
+//       a device shows up, it's the next index, followed by the U64 id.
+//     varint virtualKey, flags, scanCode, wParam
+//     zigzag varint mouseX, mouseY
+// A key press or mouse move is 11-13 bytes, about a quarter of a
+// SynchronizedEvent.
+const U16 INPUT_RECORDING_VERSION = 1;
+
+// Writes the events the game loop pops from the sync queue, stamped with
+// the fixed update tick they were popped at.
+class InputRecorder {
+ public:
+  InputRecorder() = default;
+  virtual ~InputRecorder();
+
+  InputRecorder(const InputRecorder&) = delete;
+  InputRecorder& operator=(const InputRecorder&) = delete;
+
+  // |tickMicros| is the game loop's fixed update step
+  bool Open(const xstring& filePath, U32 tickMicros);
+  // |tick| is how many fixed updates ran before the events were popped.
+  // If a write fails, logs it and closes the file, keeping what was
+  // written so far. Game loop thread only.
+  void Record(U64 tick, const SynchronizedEvent* pEvents, size_t count);
+  void Close();
+
+  bool IsOpen() const { return pFile_ != nullptr; }
+  U64 GetEventCount() const { return eventCount_; }
+
+ private:
+  FILE* pFile_ = nullptr;
+  U64 lastTick_ = 0;
+  U64 eventCount_ = 0;
+  // device ids, by the index records refer to them with
+  std::vector<U64> devices_;
+};
+
+// Reads a recording and queues its events back on the EventManager, each
+// at the tick it was recorded at. Replaying turns live input off (see
+// EventManager::SetReplaying), so the run only sees the recording.
+//
+// The game loop pops the events on the first frame at or after their
+// tick. That's the same frame as when recording if frames run the same
+// updates, like a headless run stepping one update per frame. With real
+// time pacing an event can come a frame late.
+class InputReplayer {
+ public:
+  InputReplayer() = default;
+  virtual ~InputReplayer() = default;
+
+  InputReplayer(const InputReplayer&) = delete;
+  InputReplayer& operator=(const InputReplayer&) = delete;
+
+  // reads the whole recording up front, so replaying doesn't touch disk
+  bool Open(const xstring& filePath);
+  // Queues the events recorded at or before |tick|, returning how many.
+  // If the queue fills, the rest wait for the next call.
+  // Game loop thread only.
+  size_t EnqueueDue(U64 tick, EventManager& eventMan);
+
+  bool IsOpen() const { return pCursor_ != nullptr; }
+  // every event was queued (or the rest of the file is unreadable)
+  bool IsDone() const { return !bHasNext_; }
+  U32 GetTickMicros() const { return tickMicros_; }
+  U64 GetEventCount() const { return eventCount_; }
+
+ private:
+  File file_;
+  const U8* pCursor_ = nullptr;
+  const U8* pEnd_ = nullptr;
+  U32 tickMicros_ = 0;
+  U64 eventCount_ = 0;
+  std::vector<U64> devices_;
+
+  // the next event, decoded ahead to know its tick
+  bool bHasNext_ = false;
+  U64 nextTick_ = 0;
+  SynchronizedEvent next_ = {};
+
+  // false at the end of the file, or if the record is cut off
+  bool DecodeNext();
+};
+
+}  // namespace Mana
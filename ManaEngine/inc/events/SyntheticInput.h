@@ -0,0 +1,49 @@
+// Generated input for headless runs, in place of a keyboard and mouse
+
+#pragma once
+
+#include "ManaGlobals.h"
+#include "events/EventManager.h"
+
+namespace Mana {
+
+// A seeded stream of key presses, key releases and mouse moves, queued
+// on the EventManager like the raw input the main thread would send.
+// The same seed gives the same events at the same ticks, so headless
+// soak and throughput runs exercise the input path repeatably without
+// anyone at the keyboard.
+//
+// The first call also announces its keyboard and mouse, as
+// InputDeviceChange events.
+class SyntheticInput {
+ public:
+  static const U64 KEYBOARD_ID = 1;
+  static const U64 MOUSE_ID = 2;
+
+  SyntheticInput() = default;
+  virtual ~SyntheticInput() = default;
+
+  SyntheticInput(const SyntheticInput&) = delete;
+  SyntheticInput& operator=(const SyntheticInput&) = delete;
+
+  // |eventsPerUpdate| events are queued per tick, 0 turns it off
+  void Init(U32 seed, U32 eventsPerUpdate);
+
+  // Queues the events for |tick| on |eventMan| and returns how many.
+  // The calling thread becomes the sync queue's producer, so only use
+  // this when nothing else feeds it (no InputWin).
+  size_t EnqueueDue(U64 tick, EventManager& eventMan);
+
+ private:
+  U32 state_ = 1;  // xorshift32, never 0
+  U32 eventsPerUpdate_ = 0;
+  U64 nextTick_ = 0;
+  bool bDevicesAdded_ = false;
+  U16 heldKey_ = 0;  // the key that's down, 0 if none
+  int mouseX_ = 0;
+  int mouseY_ = 0;
+
+  U32 NextRandom();
+};
+
+}  // namespace Mana
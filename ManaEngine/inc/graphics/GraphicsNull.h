@@ -0,0 +1,53 @@
+// Graphics Engine that draws nothing, for headless runs
+
+#pragma once
+
+#include <vector>
+#include "graphics/GraphicsBase.h"
+#include "graphics/GraphicsDeviceBase.h"
+
+namespace Mana {
+
+// The one GPU GraphicsNull reports: it supports no multisampling.
+class GraphicsDeviceNull : public GraphicsDeviceBase {
+ public:
+  GraphicsDeviceNull() { name_ = _X("Null"); }
+  virtual ~GraphicsDeviceNull() = default;
+
+  GraphicsDeviceNull(const GraphicsDeviceNull&) = delete;
+  GraphicsDeviceNull& operator=(const GraphicsDeviceNull&) = delete;
+
+  bool Init() override { return true; }
+  void Uninit() override {}
+
+  bool GetSupportedMultisampleLevels(
+      std::vector<MultisampleLevel>& levels) override;
+};
+
+// No adapters, outputs or device underneath, so it works without a
+// display or GPU driver (--headless, CI, Linux perf machines). It
+// reports a single GraphicsDeviceNull, so the usual init path (get the
+// GPUs, select the first) runs unchanged.
+class GraphicsNull : public GraphicsBase {
+ public:
+  GraphicsNull() = default;
+  virtual ~GraphicsNull() = default;
+
+  GraphicsNull(const GraphicsNull&) = delete;
+  GraphicsNull& operator=(const GraphicsNull&) = delete;
+
+  bool Init() override { return true; }
+  void Uninit() override {}
+
+  bool EnumerateAdaptersAndFullScreenModes() override { return true; }
+  xstring GetNoSupportedGPUFoundMessage() override;
+
+  bool GetSupportedGPUs(std::vector<GraphicsDeviceBase*>& gpus) override;
+
+  bool SelectGPU(GraphicsDeviceBase* gpu) override;
+
+ private:
+  GraphicsDeviceNull device_;
+};
+
+}  // namespace Mana
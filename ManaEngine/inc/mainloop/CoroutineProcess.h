@@ -0,0 +1,182 @@
+// Process that runs a C++20 coroutine, for scripts that span frames
+
+#pragma once
+
+#include <coroutine>
+#include "audio/WorkItemLoadAudio.h"
+#include "concurrency/JobSystem.h"
+#include "mainloop/ProcessBase.h"
+
+namespace Mana {
+
+// Coroutine frames come from pools of a few size classes (see
+// CoroutineProcess.cpp), bigger ones from the heap.
+void* AllocateCoroutineFrame(size_t size);
+void FreeCoroutineFrame(void* pFrame, size_t size);
+
+// The return type of a script run by a CoroutineProcess:
+//
+//   ProcessScript FadeInMusic(Sprite* pSprite) {
+//     AudioFileHandle music = co_await LoadAudio(
+//         g_pAudioEngine, _X("music/town.ogg"), AudioCategory::Music,
+//         AudioFormat::Ogg);
+//     co_await WaitMs(500);
+//     g_pAudioEngine->Play(music, ...);
+//     while (pSprite->Fade(0.05f)) {
+//       co_await NextFrame();
+//     }
+//   }
+//
+//   pManager->AddProcess<CoroutineProcess>(FadeInMusic(pSprite));
+//
+// The script starts on the process's first update, and the process
+// succeeds when it returns. co_await FailProcess(), or an exception
+// escaping the script, fails it instead.
+// Each step is a suspension in one frame, instead of a process per step
+// chained with AttachChild.
+class ProcessScript {
+ public:
+  struct promise_type {
+    // what the script waits on before it's resumed
+    unsigned long waitMs = 0;
+    JobHandle waitJob;
+    bool bFailed = false;
+
+    ProcessScript get_return_object() {
+      return ProcessScript(
+          std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    // started by the first update, not by the call
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    // kept until the process is destroyed, which destroys the frame
+    std::suspend_always final_suspend() noexcept { return {}; }
+    void return_void() {}
+    // fails the process instead of unwinding into UpdateProcesses
+    void unhandled_exception();
+
+    static void* operator new(size_t size) {
+      return AllocateCoroutineFrame(size);
+    }
+    static void operator delete(void* pFrame, size_t size) {
+      FreeCoroutineFrame(pFrame, size);
+    }
+  };
+
+  typedef std::coroutine_handle<promise_type> Handle;
+
+  ProcessScript() = default;
+  explicit ProcessScript(Handle handle) : handle_(handle) {}
+  ProcessScript(ProcessScript&& other) noexcept : handle_(other.handle_) {
+    other.handle_ = nullptr;
+  }
+  ProcessScript& operator=(ProcessScript&& other) noexcept;
+  ~ProcessScript();
+
+  ProcessScript(const ProcessScript&) = delete;
+  ProcessScript& operator=(const ProcessScript&) = delete;
+
+  Handle GetHandle() const { return handle_; }
+
+ private:
+  Handle handle_ = nullptr;
+};
+
+// Resumes its script every update, unless the script is waiting.
+// Final, so it can live in the ProcessManager's typed storage.
+// Like any process, it updates on the thread calling UpdateProcesses.
+class CoroutineProcess final : public ProcessBase {
+ public:
+  explicit CoroutineProcess(ProcessScript script);
+  // Destroys the script where it's suspended, running its destructors.
+  // If it's waiting on a job, waits for the job first.
+  ~CoroutineProcess() override;
+
+  void VOnUpdate(unsigned long deltaMs) override;
+
+ private:
+  ProcessScript script_;
+};
+
+// co_await NextFrame(): resumes on the next update
+struct NextFrame {
+  bool await_ready() const noexcept { return false; }
+  void await_suspend(ProcessScript::Handle) noexcept {}
+  void await_resume() const noexcept {}
+};
+
+// co_await WaitMs(500): resumes |ms| from now, the process sleeping
+// meanwhile (see ProcessBase::SleepFor)
+class WaitMs {
+ public:
+  explicit WaitMs(unsigned long ms) : ms_(ms) {}
+
+  bool await_ready() const noexcept { return ms_ == 0; }
+  void await_suspend(ProcessScript::Handle handle) noexcept {
+    handle.promise().waitMs = ms_;
+  }
+  void await_resume() const noexcept {}
+
+ private:
+  unsigned long ms_;
+};
+
+// co_await WaitForJob(job): resumes on the first update after the job
+// (and its children) finished
+class WaitForJob {
+ public:
+  explicit WaitForJob(JobHandle job) : job_(job) {}
+
+  bool await_ready() const {
+    return !g_pJobSystem || g_pJobSystem->IsDone(job_);
+  }
+  void await_suspend(ProcessScript::Handle handle) noexcept {
+    handle.promise().waitJob = job_;
+  }
+  void await_resume() const noexcept {}
+
+ private:
+  JobHandle job_;
+};
+
+// co_await LoadAudio(...): reads with g_pAsyncIO and decodes on a job
+// worker (see WorkItemLoadAudio::LoadAsync), then resumes with the
+// AudioFileHandle (0 if it failed). Takes WorkItemLoadAudio's arguments.
+// Without a JobSystem it loads right away.
+class LoadAudio {
+ public:
+  template <typename... Args>
+  explicit LoadAudio(Args&&... args)
+      : workItem_(std::forward<Args>(args)...) {}
+
+  LoadAudio(const LoadAudio&) = delete;
+  LoadAudio& operator=(const LoadAudio&) = delete;
+
+  bool await_ready() const { return false; }
+  bool await_suspend(ProcessScript::Handle handle) {
+    if (!g_pJobSystem) {
+      workItem_.Process();
+      return false;
+    }
+    // if no job slots are free, LoadAsync loads before returning
+    handle.promise().waitJob = workItem_.LoadAsync();
+    return true;
+  }
+  AudioFileHandle await_resume() {
+    return workItem_.GetHandleIfDoneProcessing();
+  }
+
+ private:
+  // in the coroutine frame while the script waits for it
+  WorkItemLoadAudio workItem_;
+};
+
+// co_await FailProcess(): ends the script, and the process fails
+struct FailProcess {
+  bool await_ready() const noexcept { return false; }
+  void await_suspend(ProcessScript::Handle handle) noexcept {
+    handle.promise().bFailed = true;
+  }
+  void await_resume() const noexcept {}
+};
+
+}  // namespace Mana
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "ManaGlobals.h"
+#include "datastructures/Histogram.h"
+
+namespace Mana {
+
+enum class FramePacerMode : U32 {
+  Uncapped,   // never waits
+  TargetFps,  // sleeps, then spins, until the next frame is due
+  VSync,      // waits for the display's vertical blank
+};
+
+struct FramePacerStats {
+  U64 frames;
+  U64 sleeps;
+  U64 sleepMicros;  // time given back to the OS
+  U64 spinMicros;   // time spent spinning after waking up early
+  U64 lateFrames;   // more than a frame late, so the schedule was reset
+  U32 slackMicros;  // how early it currently wakes up to spin
+};
+
+// Paces the game loop, so it doesn't burn a core running frames
+// nobody sees. Only decides when the next iteration starts: the loop's
+// fixed timestep accumulator works as before, catching up on update
+// steps for however long the frame took.
+//
+// TargetFps sleeps on a high resolution timer (waitable timer on
+// Windows, clock_nanosleep elsewhere) until shortly before the frame is
+// due, then spins the rest, for low jitter without spinning the whole
+// frame. How early to wake (the slack) is calibrated from how late the
+// timer's sleeps actually end. Deadlines advance by exactly one period,
+// so there's no drift, unless the loop falls a whole frame behind.
+//
+// VSync waits for the compositor's next vertical blank (DwmFlush), which
+// works in a window without a swap chain. Where that isn't available,
+// it paces to the display's refresh rate like TargetFps. Once the
+// renderer presents with a sync interval, Present does the waiting and
+// the loop should run Uncapped.
+//
+// The pacing error (how far each frame's start was from when it was
+// due) goes in a histogram, logged by LogStats.
+// Game loop thread only.
+class FramePacer {
+ public:
+  // the timer's sleeps are assumed to end this late until measured
+  static const U64 INITIAL_SLACK_NS = 1000000;
+  static const U64 MIN_SLACK_NS = 50000;
+  static const U64 MAX_SLACK_NS = 20000000;
+  // used for VSync when the refresh rate is unknown
+  static const U32 DEFAULT_REFRESH_HZ = 60;
+
+  FramePacer() = default;
+  virtual ~FramePacer();
+
+  FramePacer(const FramePacer&) = delete;
+  FramePacer& operator=(const FramePacer&) = delete;
+
+  // |targetFps| is only used by TargetFps
+  bool Init(FramePacerMode mode, U32 targetFps);
+  void Uninit();
+
+  // Blocks until the next frame is due. Call once per game loop
+  // iteration, before reading the clock for the accumulator.
+  void WaitForNextFrame();
+
+  FramePacerMode GetMode() const { return mode_; }
+  U64 GetPeriodNs() const { return periodNs_; }
+  // pacing error of each frame, in nanoseconds
+  const Histogram& GetErrors() const { return errorsNs_; }
+  FramePacerStats GetStats() const;
+  void LogStats() const;
+
+ private:
+  static U64 Now();
+  // sleeps until about |deadline| (Now() time), then spins until it
+  void WaitUntil(U64 deadline);
+  void RecordError(U64 errorNs);
+
+  // platform specific (FramePacerWin.cpp, FramePacerStd.cpp)
+  bool InitTimer();
+  void UninitTimer();
+  // sleeps until |deadline| (Now() time), or a bit later
+  void SleepUntil(U64 deadline);
+  // blocks until the next vertical blank, false if we can't
+  static bool WaitForVBlank();
+  // the main display's refresh rate, 0 if unknown
+  static U32 GetRefreshRate();
+
+  bool bInitialized_ = false;
+  FramePacerMode mode_ = FramePacerMode::Uncapped;
+  U64 periodNs_ = 0;
+  U64 nextFrame_ = 0;  // when the next frame is due, 0 before the first
+  U64 lastFrame_ = 0;  // when the last frame started
+  U64 slackNs_ = INITIAL_SLACK_NS;
+  bool bVBlankWorks_ = false;
+
+  void* pTimer_ = nullptr;  // platform timer, if it needs one
+  bool bTimerPeriodSet_ = false;
+
+  Histogram errorsNs_;
+  FramePacerStats stats_ = {};
+};
+
+}  // namespace Mana
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "ManaGlobals.h"
+#include "datastructures/Histogram.h"
+
+namespace Mana {
+
+// One game loop iteration's timings, in microseconds.
+struct FrameRecord {
+  U64 frame;  // filled in by FrameStats::AddFrame
+  U64 startMicros;
+  U32 frameMicros;   // the whole iteration
+  U32 updateMicros;  // all of the frame's fixed update steps
+  U32 renderMicros;
+  U16 updates;  // fixed update steps run
+  // Steps the loop gave up on because MAX_UPDATES ran out.
+  // These are the stutter: game time fell behind real time.
+  U16 droppedUpdates;
+};
+
+// Frame time statistics for the game loop thread: histograms of frame,
+// update and render times (so we can see the 99th percentile, not just
+// FPS), counts of dropped update steps, and the last HISTORY_FRAMES
+// frames, which are logged on Channel::Perf when a frame takes longer
+// than the spike threshold.
+// Game loop thread only.
+class FrameStats {
+ public:
+  // a dump is HISTORY_FRAMES + 1 lines, which has to fit in the game
+  // loop thread's log ring (Logger::RING_RECORDS)
+  static const size_t HISTORY_FRAMES = 128;
+  static const U32 DEFAULT_SPIKE_MICROS = 50000;
+
+  FrameStats() = default;
+  virtual ~FrameStats() = default;
+
+  FrameStats(const FrameStats&) = delete;
+  FrameStats& operator=(const FrameStats&) = delete;
+
+  // 0 turns off the spike dumps
+  void SetSpikeThreshold(U32 micros) { spikeMicros_ = micros; }
+  U32 GetSpikeThreshold() const { return spikeMicros_; }
+
+  void AddFrame(const FrameRecord& record);
+  void Reset();
+
+  const Histogram& GetFrameTimes() const { return frameTimes_; }
+  const Histogram& GetUpdateTimes() const { return updateTimes_; }
+  const Histogram& GetRenderTimes() const { return renderTimes_; }
+  U64 GetFrames() const { return frames_; }
+  U64 GetUpdates() const { return updates_; }
+  U64 GetDroppedUpdates() const { return droppedUpdates_; }
+  // frames that hit MAX_UPDATES
+  U64 GetClampedFrames() const { return clampedFrames_; }
+  U64 GetSpikes() const { return spikes_; }
+
+  // percentiles of each histogram and the counters
+  void LogSummary() const;
+  // the last HISTORY_FRAMES frames, oldest first
+  void LogHistory() const;
+
+ private:
+  Histogram frameTimes_;
+  Histogram updateTimes_;  // per frame that ran any updates
+  Histogram renderTimes_;
+  U64 frames_ = 0;
+  U64 updates_ = 0;
+  U64 droppedUpdates_ = 0;
+  U64 clampedFrames_ = 0;
+  U64 spikes_ = 0;
+
+  U32 spikeMicros_ = DEFAULT_SPIKE_MICROS;
+  // No dump until the history has been replaced since the last one,
+  // so a burst of spikes logs each frame once.
+  U64 nextDumpFrame_ = 0;
+
+  FrameRecord history_[HISTORY_FRAMES] = {};
+};
+
+}  // namespace Mana
@@ -0,0 +1,67 @@
+// Runs the engine without a window, GPU or sound device
+
+#pragma once
+
+#include "ManaGlobals.h"
+#include "audio/AudioSink.h"
+#include "events/InputRecording.h"
+#include "events/SyntheticInput.h"
+#include "mainloop/FrameStats.h"
+#include "mainloop/ManaGameBase.h"
+
+namespace Mana {
+
+// The engine with null backends, for throughput and soak tests in CI and
+// on Linux perf machines (--headless): WindowNull, GraphicsNull, and an
+// AudioMixer writing to a NullAudioSink (so mixing still costs what it
+// would). Input comes from a recording (--replay FILE) or SyntheticInput.
+//
+// The fixed-timestep loop runs on the calling thread, one update per
+// frame, as fast as it can. Game time advances MICROSEC_PER_UPDATE per
+// update however long the update took, so a run with the same input does
+// the same work every time, and replays line up with their recording.
+//
+// Options:
+//   --updates N     updates to run, default DEFAULT_UPDATES (a minute).
+//                   With --replay, the default is until it ends.
+//   --replay FILE   input from a recording (see InputReplayer)
+//   --record FILE   save the input the loop consumed
+//   --input-rate N  synthetic events per update (default 2, 0 for none)
+//   --seed N        the synthetic input's seed
+//
+// Games can subclass it and fill in OnSyncEvents and OnUpdate.
+class HeadlessGame : public ManaGameBase {
+ public:
+  static const U32 MICROSEC_PER_UPDATE = 16000;
+  static const U64 DEFAULT_UPDATES = 3750;
+  static const U32 DEFAULT_INPUT_RATE = 2;
+
+  HeadlessGame() = default;
+  virtual ~HeadlessGame() = default;
+
+  HeadlessGame(const HeadlessGame&) = delete;
+  HeadlessGame& operator=(const HeadlessGame&) = delete;
+
+ protected:
+  bool OnInit() override;
+  bool OnStartGameLoop() override;
+  bool OnShutdown() override;
+
+  // On the calling thread, every frame: the events popped off the sync
+  // queue, then the frame's update.
+  // |pEvents| is in g_pFrameArena, so it's only valid for the frame.
+  virtual void OnSyncEvents(const SynchronizedEvent* /*pEvents*/,
+                            size_t /*count*/) {}
+  virtual void OnUpdate() {}
+
+ private:
+  U64 updates_ = DEFAULT_UPDATES;
+  bool bUntilReplayEnds_ = false;
+  NullAudioSink audioSink_;
+  SyntheticInput syntheticInput_;
+  InputRecorder recorder_;
+  InputReplayer replayer_;
+  FrameStats frameStats_;
+};
+
+}  // namespace Mana
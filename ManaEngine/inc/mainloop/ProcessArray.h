@@ -0,0 +1,218 @@
+// contiguous storage for processes of one concrete type
+
+#pragma once
+
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "mainloop/ProcessBase.h"
+#include "utils/ObjectPool.h"
+
+namespace Mana {
+
+// The ProcessManager's typed storage, one array per process type.
+// See ProcessManager::AddProcess.
+class ProcessArrayBase {
+ public:
+  ProcessArrayBase() = default;
+  virtual ~ProcessArrayBase() {}
+
+  ProcessArrayBase(const ProcessArrayBase&) = delete;
+  ProcessArrayBase& operator=(const ProcessArrayBase&) = delete;
+
+  size_t GetCount() const { return count_; }
+  size_t GetCount(ProcessPhase phase) const {
+    return phaseCounts_[(size_t)phase];
+  }
+
+  // nullptr once the process ended
+  virtual ProcessBase* Get(PoolHandle handle) const = 0;
+  // Initializes and updates the processes in |phase|, then ends and
+  // destroys the dead ones. Children of the ones that succeeded are
+  // added to |children|, for the manager to attach.
+  virtual void Update(ProcessPhase phase,
+                      unsigned long deltaMs,
+                      std::vector<StrongProcessPtr>& children,
+                      unsigned short int& successCount,
+                      unsigned short int& failCount) = 0;
+  virtual void AbortAll(bool immediate) = 0;
+  // destroys every process (and DOESN'T run any exit code)
+  virtual void Clear() = 0;
+
+  // wakes sleeping processes, see ProcessManager::SetTimerWheel
+  void SetTimerWheel(TimerWheel* pTimers) {
+    pTimers_ = pTimers;
+    bOrderDirty_ = true;
+  }
+
+  // Called by the manager before each tick's updates. Collects the
+  // processes to update this tick, if they changed, so processes created
+  // later are first updated next tick.
+  virtual void BeginTick() = 0;
+
+ protected:
+  TimerWheel* pTimers_ = nullptr;
+  size_t count_ = 0;
+  size_t phaseCounts_[PROCESS_PHASE_COUNT] = {};
+  // Set when processes are created or destroyed, fall asleep or wake up.
+  // Wake timers set it too, so they capture its address.
+  bool bOrderDirty_ = true;
+};
+
+// Processes of type T, in an ObjectPool: chunks of PROCESSES_PER_CHUNK
+// objects. Since every object is exactly a T, and T is final, VOnUpdate
+// isn't a virtual call and can be inlined. Rarer calls (VOnInit, the
+// exit functions) stay virtual.
+//
+// Each phase updates from a list of its processes in slot order, rebuilt
+// by BeginTick when processes come and go. With a TimerWheel, sleeping
+// processes are left out of it until their timer wakes them, so they
+// cost nothing while they sleep.
+template <typename T>
+class ProcessArray : public ProcessArrayBase {
+  static_assert(std::is_base_of<ProcessBase, T>::value,
+                "ProcessArray is for processes");
+  static_assert(std::is_final<T>::value,
+                "typed processes must be final, so updates aren't virtual");
+
+ public:
+  static const U32 PROCESSES_PER_CHUNK = 256;
+
+  ProcessArray() : pool_(_X("ProcessArray"), PROCESSES_PER_CHUNK) {}
+  ~ProcessArray() override { Clear(); }
+
+  // nullptr if the pool is full
+  template <typename... Args>
+  T* New(Args&&... args) {
+    T* pProcess = pool_.New(std::forward<Args>(args)...);
+    if (pProcess) {
+      ++count_;
+      ++phaseCounts_[(size_t)pProcess->GetPhase()];
+      bOrderDirty_ = true;
+    }
+    return pProcess;
+  }
+
+  PoolHandle GetHandle(const T* pProcess) const {
+    return pool_.GetHandle(pProcess);
+  }
+  T* GetTyped(PoolHandle handle) const { return pool_.Get(handle); }
+  ProcessBase* Get(PoolHandle handle) const override {
+    return pool_.Get(handle);
+  }
+
+  void BeginTick() override {
+    if (!bOrderDirty_) {
+      return;
+    }
+    bOrderDirty_ = false;
+
+    for (std::vector<T*>& order : updateOrder_) {
+      order.clear();
+    }
+    pool_.ForEach([&](T& process) {
+      if (!process.IsWaitingForWake()) {
+        updateOrder_[(size_t)process.GetPhase()].push_back(&process);
+      }
+    });
+  }
+
+  void Update(ProcessPhase phase,
+              unsigned long deltaMs,
+              std::vector<StrongProcessPtr>& children,
+              unsigned short int& successCount,
+              unsigned short int& failCount) override {
+    const std::vector<T*>& order = updateOrder_[(size_t)phase];
+    size_t dead = 0;
+    for (T* pProcess : order) {
+      T& process = *pProcess;
+      if (!pTimers_ && process.IsSleeping()) {
+        process.CountDownSleep(deltaMs);
+      }
+      if (process.GetState() == ProcessBase::State::UNINITIALIZED) {
+        ((ProcessBase&)process).VOnInit();
+      }
+      if (process.GetState() == ProcessBase::State::RUNNING) {
+        process.VOnUpdate(deltaMs);
+      }
+      if (process.IsDead()) {
+        ++dead;
+      } else if (pTimers_ && process.NeedsWakeTimer()) {
+        process.ScheduleWake(*pTimers_, &bOrderDirty_);
+        bOrderDirty_ = true;
+      }
+    }
+
+    if (dead == 0) {
+      return;
+    }
+
+    // the same exit functions as ProcessManager::UpdateProcesses
+    for (T* pProcess : order) {
+      ProcessBase& base = *pProcess;
+      if (!base.IsDead()) {
+        continue;
+      }
+
+      switch (base.GetState()) {
+        case ProcessBase::State::SUCCEEDED: {
+          base.VOnSuccess();
+          StrongProcessPtr pChild = base.RemoveChild();
+          if (pChild)
+            children.push_back(pChild);
+          else
+            ++successCount;  // only counts if the whole chain completed
+          break;
+        }
+
+        case ProcessBase::State::FAILED:
+          base.VOnFail();
+          ++failCount;
+          break;
+
+        case ProcessBase::State::ABORTED:
+          base.VOnAbort();
+          ++failCount;
+          break;
+
+        default:
+          break;
+      }
+
+      Delete(pProcess);
+    }
+  }
+
+  void AbortAll(bool immediate) override {
+    pool_.ForEach([&](T& process) {
+      if (process.IsAlive()) {
+        process.CancelWake(pTimers_);
+        process.SetState(ProcessBase::State::ABORTED);
+        if (immediate) {
+          ((ProcessBase&)process).VOnAbort();
+          Delete(&process);
+        }
+      }
+    });
+    // the aborted sleepers end next tick
+    bOrderDirty_ = true;
+  }
+
+  void Clear() override {
+    pool_.ForEach([&](T& process) { Delete(&process); });
+  }
+
+ private:
+  ObjectPool<T> pool_;
+  std::vector<T*> updateOrder_[PROCESS_PHASE_COUNT];  // see BeginTick
+
+  void Delete(T* pProcess) {
+    --count_;
+    --phaseCounts_[(size_t)pProcess->GetPhase()];
+    pProcess->CancelWake(pTimers_);
+    pool_.Delete(pProcess);
+    bOrderDirty_ = true;
+  }
+};
+
+}  // namespace Mana
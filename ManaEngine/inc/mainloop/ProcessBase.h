@@ -4,6 +4,7 @@
 
 #include <memory>
 #include "ManaGlobals.h"
+#include "mainloop/TimerWheel.h"
 
 namespace Mana {
 
@@ -11,6 +12,21 @@ class ProcessBase;
 typedef std::shared_ptr<ProcessBase> StrongProcessPtr;
 typedef std::weak_ptr<ProcessBase> WeakProcessPtr;
 
+// Processes update phase by phase, in this order.
+enum class ProcessPhase : U32 {
+  PreUpdate,
+  Update,
+  PostUpdate,
+  Count,
+};
+const size_t PROCESS_PHASE_COUNT = (size_t)ProcessPhase::Count;
+
+// Shared data a process reads or writes during VOnInit/VOnUpdate, as bits
+// the game assigns (transforms, the nav grid, ...), see SetAccess.
+typedef U32 ProcessAccess;
+const ProcessAccess PROCESS_ACCESS_NONE = 0;
+const ProcessAccess PROCESS_ACCESS_ALL = 0xffffffff;
+
 class ProcessBase {
  public:
   enum class State {
@@ -19,9 +35,10 @@ class ProcessBase {
     REMOVED,            // removed from the process list but not destroyed;
                         // this can happen when a process that is already
                         // running is parented to another process.
-              // Living processes
-    RUNNING,  // initialized and running
-    PAUSED,   // initialized but paused
+               // Living processes
+    RUNNING,   // initialized and running
+    PAUSED,    // initialized but paused
+    SLEEPING,  // waiting out SleepFor, not updated
 
     // Dead processes
     SUCCEEDED,  // completed successfully
@@ -46,7 +63,8 @@ class ProcessBase {
   // accessors
   State GetState(void) const { return state_; }
   bool IsAlive(void) const {
-    return (state_ == State::RUNNING || state_ == State::PAUSED);
+    return (state_ == State::RUNNING || state_ == State::PAUSED ||
+            state_ == State::SLEEPING);
   }
   bool IsDead(void) const {
     return (state_ == State::SUCCEEDED || state_ == State::FAILED ||
@@ -54,6 +72,32 @@ class ProcessBase {
   }
   bool IsRemoved(void) const { return (state_ == State::REMOVED); }
   bool IsPaused(void) const { return state_ == State::PAUSED; }
+  bool IsSleeping(void) const { return state_ == State::SLEEPING; }
+
+  // Skips updates until |ms| from now, then runs again. Call it from
+  // VOnUpdate. With the ProcessManager's TimerWheel, the process is
+  // woken by a timer instead of counting down every update, and isn't
+  // looked at until then (ending it meanwhile may wait for that).
+  void SleepFor(unsigned long ms);
+
+  // Scheduling, read when the process is attached to the ProcessManager,
+  // so set it before that.
+  void SetPhase(ProcessPhase phase) { phase_ = phase; }
+  ProcessPhase GetPhase(void) const { return phase_; }
+  // Processes in the same phase whose accesses don't conflict (one writes
+  // what the other reads or writes) may update at the same time, on job
+  // workers. Conflicting ones update in the order they were attached.
+  // Touching only the process itself is PROCESS_ACCESS_NONE for both.
+  // By default a process is exclusive: it writes everything, so it's
+  // updated on the thread calling UpdateProcesses, after everything
+  // before it and before everything after it.
+  void SetAccess(ProcessAccess reads, ProcessAccess writes) {
+    reads_ = reads;
+    writes_ = writes;
+  }
+  ProcessAccess GetReads(void) const { return reads_; }
+  ProcessAccess GetWrites(void) const { return writes_; }
+  bool IsExclusive(void) const { return writes_ == PROCESS_ACCESS_ALL; }
 
   // child functions
   inline void AttachChild(StrongProcessPtr pChild);
@@ -74,10 +118,32 @@ class ProcessBase {
  private:
   State state_;
   StrongProcessPtr pChild_;  // child process is optional
+  ProcessPhase phase_ = ProcessPhase::Update;
+  ProcessAccess reads_ = PROCESS_ACCESS_ALL;
+  ProcessAccess writes_ = PROCESS_ACCESS_ALL;
+  unsigned long sleepMs_ = 0;  // how long SleepFor asked for
+  TimerHandle wakeTimer_ = 0;
 
   void SetState(State newState) { state_ = newState; }
 
+  // sleeping, for the ProcessManager and ProcessArray
+  bool NeedsWakeTimer(void) const {
+    return state_ == State::SLEEPING && wakeTimer_ == 0;
+  }
+  // the timer also sets |*pWoken|, for the update order to take it back
+  void ScheduleWake(TimerWheel& timers, bool* pWoken);
+  bool IsWaitingForWake(void) const {
+    return state_ == State::SLEEPING && wakeTimer_ != 0;
+  }
+  // must be called before a sleeping process is destroyed
+  void CancelWake(TimerWheel* pTimers);
+  // without a TimerWheel
+  void CountDownSleep(unsigned long deltaMs);
+  void WakeUp(void);
+
   friend class ProcessManager;
+  template <typename T>
+  friend class ProcessArray;
 };
 
 // inline function definitions --------------------------------------------
@@ -3,12 +3,52 @@
 #pragma once
 
 #include <list>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "mainloop/ProcessArray.h"
 #include "mainloop/ProcessBase.h"
+#include "utils/PoolAllocator.h"
 
 namespace Mana {
 
+// Refers to a process in the ProcessManager's typed storage, instead of
+// a WeakProcessPtr. Finds nothing once the process ended.
+struct ProcessHandle {
+  U32 type = 0;            // index of the process's type, see AddProcess
+  PoolHandle process = 0;  // 0 is never valid
+
+  bool IsValid() const { return process != 0; }
+};
+
+// Updates processes phase by phase (see ProcessPhase). Within a phase,
+// processes are grouped into waves by their declared accesses: a process
+// goes in the wave after the last earlier process it conflicts with, so
+// the processes in a wave never conflict and conflicting ones keep their
+// list order. In parallel mode, big waves are split into batches that
+// run as jobs on g_pJobSystem, and the calling thread waits for a wave
+// before starting the next. Exclusive processes (the default) always
+// update on the calling thread.
+//
+// Ending processes (VOnSuccess/VOnFail/VOnAbort, attaching children) is
+// done after all the updates, on the calling thread, in list order, so
+// it's the same in either mode. Processes attached or added meanwhile,
+// including children and processes of types never added before, are
+// first updated next tick.
+//
+// Processes added with AddProcess live in typed storage instead of the
+// list: a ProcessArray per concrete type. Each phase updates its list
+// processes first, then each type's processes in one pass, on the
+// calling thread.
+//
+// Sleeping processes (ProcessBase::SleepFor) are woken by timers on the
+// TimerWheel given to SetTimerWheel, scheduled on the calling thread.
+// Until then they're left out of the update order, list and typed ones
+// alike. Without a TimerWheel, each update counts their sleep down.
 class ProcessManager {
-  typedef std::list<StrongProcessPtr> ProcessList;
+  // list nodes come from a pool, since processes come and go all the time
+  typedef std::list<StrongProcessPtr, PoolAllocator<StrongProcessPtr>>
+      ProcessList;
 
  public:
   ProcessManager() = default;
@@ -17,18 +57,148 @@ class ProcessManager {
   ProcessManager(const ProcessManager&) = delete;
   ProcessManager& operator=(const ProcessManager&) = delete;
 
+  // Creates a process whose object and reference counts share one
+  // pooled allocation, instead of two trips to the heap:
+  //   pManager->AttachProcess(ProcessManager::CreateProcess<Delay>(500));
+  template <typename T, typename... Args>
+  static std::shared_ptr<T> CreateProcess(Args&&... args) {
+    return std::allocate_shared<T>(PoolAllocator<T>(),
+                                   std::forward<Args>(args)...);
+  }
+
+  // Waves smaller than this are updated on the calling thread, since
+  // a job costs a few microseconds to hand out and wait for.
+  static const size_t MIN_PARALLEL_PROCESSES = 256;
+  // the smallest batch of processes given to one job
+  static const size_t MIN_BATCH_PROCESSES = 64;
+
   // interface
   unsigned int UpdateProcesses(unsigned long deltaMs);
   WeakProcessPtr AttachProcess(StrongProcessPtr pProcess);
+
+  // Constructs a process in its type's ProcessArray, for processes that
+  // come by the thousand (AI, tweens). They sit together in pooled
+  // chunks and update without reference counts or virtual calls.
+  //   ProcessHandle fade = pManager->AddProcess<Tween>(pSprite, 0.0f);
+  // T must be final, with a public VOnUpdate. Set the phase in its
+  // constructor. Accesses are ignored: typed processes always update on
+  // the calling thread. Children (AttachChild) work as usual, and go on
+  // the list when their parent succeeds.
+  // Returns an invalid handle if the type's pool is full.
+  template <typename T, typename... Args>
+  ProcessHandle AddProcess(Args&&... args);
+  // nullptr once the process ended
+  ProcessBase* GetProcess(ProcessHandle handle) const;
+  template <typename T>
+  T* GetProcess(ProcessHandle handle) const;
+
+  // |immediate| ends and destroys them right away, so not from an update
   void AbortAllProcesses(bool immediate);
 
+  // Off by default. Needs g_pJobSystem, serial without it.
+  void SetParallel(bool bParallel) { bParallel_ = bParallel; }
+  bool IsParallel() const { return bParallel_; }
+
+  // Wakes sleeping processes. Set it before attaching processes, and
+  // keep it alive (and advancing) until after the manager is destroyed.
+  void SetTimerWheel(TimerWheel* pTimers);
+  TimerWheel* GetTimerWheel() const { return pTimers_; }
+
   // accessors
-  unsigned int GetProcessCount() const { return (int)processList_.size(); }
+  unsigned int GetProcessCount() const;
 
  private:
+  struct UpdateEntry {
+    ProcessBase* pProcess;
+    U32 phase;
+    U32 wave;
+  };
+
+  struct UpdateBatch {
+    const UpdateEntry* pBegin;
+    const UpdateEntry* pEnd;
+    unsigned long deltaMs;
+    bool bHasTimers;
+    size_t dead;   // processes that ended, counted by the job
+    size_t slept;  // processes that fell asleep, waiting for a timer
+  };
+
+  // what UpdateProcess saw
+  static const U32 PROCESS_DIED = 1;
+  static const U32 PROCESS_SLEPT = 2;  // fell asleep, needs a wake timer
+
   ProcessList processList_;
+  bool bParallel_ = false;
+  TimerWheel* pTimers_ = nullptr;
+
+  // typed storage, by type index (nullptr for types never added)
+  std::vector<std::unique_ptr<ProcessArrayBase>> processArrays_;
+  std::vector<StrongProcessPtr> arrayChildren_;
+
+  // processList_ sorted by phase, then wave, then list order, without
+  // the processes waiting for a wake timer. Rebuilt when processes are
+  // attached or removed, fall asleep or wake up.
+  std::vector<UpdateEntry> updateOrder_;
+  std::vector<UpdateEntry> sortScratch_;
+  std::vector<U32> waveCounts_;
+  bool bUpdateOrderDirty_ = true;
+  std::vector<UpdateBatch> batches_;
+
+  void BuildUpdateOrder();
+  // these return how many processes are dead after the update
+  size_t UpdateWave(const UpdateEntry* pBegin,
+                    const UpdateEntry* pEnd,
+                    unsigned long deltaMs);
+  // and schedules its wake timer, if it fell asleep
+  size_t UpdateOnCaller(ProcessBase* pProcess, unsigned long deltaMs);
+  static U32 UpdateProcess(ProcessBase* pProcess,
+                           unsigned long deltaMs,
+                           bool bHasTimers);
+  static void UpdateBatchJob(void* pData);
+  void UpdateProcessArrays(ProcessPhase phase,
+                           unsigned long deltaMs,
+                           unsigned short int& successCount,
+                           unsigned short int& failCount);
+
+  // a small index per process type, handed out on first use
+  template <typename T>
+  static U32 GetProcessTypeIndex() {
+    static const U32 index = NextProcessTypeIndex();
+    return index;
+  }
+  static U32 NextProcessTypeIndex();
 
   void ClearAllProcesses();  // should only be called by destructor
 };
 
+template <typename T, typename... Args>
+ProcessHandle ProcessManager::AddProcess(Args&&... args) {
+  U32 type = GetProcessTypeIndex<T>();
+  if (type >= processArrays_.size()) {
+    processArrays_.resize(type + 1);
+  }
+  if (!processArrays_[type]) {
+    processArrays_[type] = std::make_unique<ProcessArray<T>>();
+    processArrays_[type]->SetTimerWheel(pTimers_);
+  }
+
+  ProcessArray<T>* pArray = (ProcessArray<T>*)processArrays_[type].get();
+  ProcessHandle handle;
+  if (T* pProcess = pArray->New(std::forward<Args>(args)...)) {
+    handle.type = type;
+    handle.process = pArray->GetHandle(pProcess);
+  }
+  return handle;
+}
+
+template <typename T>
+T* ProcessManager::GetProcess(ProcessHandle handle) const {
+  if (!handle.IsValid() || handle.type != GetProcessTypeIndex<T>() ||
+      handle.type >= processArrays_.size() || !processArrays_[handle.type]) {
+    return nullptr;
+  }
+  return ((ProcessArray<T>*)processArrays_[handle.type].get())
+      ->GetTyped(handle.process);
+}
+
 }  // namespace Mana
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "ManaGlobals.h"
+#include "utils/InlineFunction.h"
+#include "utils/ObjectPool.h"
+
+namespace Mana {
+
+class TimerWheel;
+extern TimerWheel* g_pTimerWheel;
+
+// Refers to a scheduled timer. Stale once the timer ran (unless it
+// repeats) or was cancelled, so Cancel on it does nothing.
+// 0 is never a valid handle.
+typedef PoolHandle TimerHandle;
+
+// Runs callbacks a number of ticks from now, for cooldowns, timeouts and
+// sleeping processes, without polling each of them every tick.
+// The game loop advances it once per fixed update step.
+//
+// A hierarchical timing wheel: LEVELS wheels of SLOTS slots each, where
+// level n's slots are SLOTS^n ticks wide. A timer goes in the slot of
+// the coarsest level it fits in, and moves down a level each time the
+// finer wheels wrap around to its slot. So Schedule and Cancel are O(1),
+// and each tick only looks at one slot (plus, every SLOTS ticks, moving
+// down one coarser slot).
+//
+// Timers live in an ObjectPool, with their callbacks inline (up to
+// CALLBACK_BYTES of captures), so scheduling doesn't allocate once the
+// pool has grown to the number of timers in flight.
+//
+//   TimerHandle cooldown = g_pTimerWheel->Schedule(
+//       g_pTimerWheel->MsToTicks(1500), [pSkill]() { pSkill->Ready(); });
+//   g_pTimerWheel->Cancel(cooldown);
+//
+// Game loop thread only.
+class TimerWheel {
+ public:
+  static const U32 SLOT_BITS = 8;
+  static const U32 SLOTS = 1u << SLOT_BITS;
+  static const U32 LEVELS = 4;
+  // Longer delays are clamped to this (about 2 years of 16 ms ticks).
+  static const U64 MAX_DELAY_TICKS = (1ull << (SLOT_BITS * LEVELS)) - 1;
+  static const size_t CALLBACK_BYTES = 32;
+
+  typedef InlineFunction<void(), CALLBACK_BYTES> Callback;
+
+  // |tickMicros| is only used by MsToTicks
+  explicit TimerWheel(U32 tickMicros);
+  // drops timers that are still scheduled, without running them
+  virtual ~TimerWheel();
+
+  TimerWheel(const TimerWheel&) = delete;
+  TimerWheel& operator=(const TimerWheel&) = delete;
+
+  // Runs |callback| in the Advance that reaches |delayTicks| ticks from
+  // now. At least 1, so a callback scheduling another for 0 ticks
+  // doesn't run it in the same Advance.
+  // Returns 0 if the timer pool is full.
+  TimerHandle Schedule(U64 delayTicks, Callback callback);
+  // Same, then again every |periodTicks| until it's cancelled.
+  TimerHandle ScheduleRepeating(U64 delayTicks,
+                                U64 periodTicks,
+                                Callback callback);
+  // false if the timer already ran or was cancelled. A callback may
+  // cancel itself, or any other timer.
+  bool Cancel(TimerHandle handle);
+  bool IsScheduled(TimerHandle handle) const;
+
+  // Moves time forward, running the callbacks that come due, tick by
+  // tick. Within a tick the order isn't specified, but it's the same
+  // every run for the same timers.
+  void Advance(U64 ticks = 1);
+
+  U64 GetTick() const { return tick_; }
+  size_t GetCount() const { return count_; }
+  // rounded up, so a timer never ends early
+  U64 MsToTicks(U64 ms) const {
+    return (ms * 1000 + tickMicros_ - 1) / tickMicros_;
+  }
+
+ private:
+  // not in a slot: running its callback, or about to be
+  static const U32 DUE_SLOT = LEVELS * SLOTS;
+  static const U32 NO_SLOT = DUE_SLOT + 1;
+
+  struct Timer {
+    Timer* pPrev;
+    Timer* pNext;
+    U64 deadline;
+    U64 period;  // 0 if it doesn't repeat
+    U32 slot;    // index in slots_, DUE_SLOT or NO_SLOT
+    bool bCancelled;
+    Callback callback;
+  };
+
+  TimerHandle Add(U64 delayTicks, U64 periodTicks, Callback& callback);
+  // puts |pTimer| in the slot for its deadline
+  void Insert(Timer* pTimer);
+  void Unlink(Timer* pTimer);
+  Timer** GetList(U32 slot) {
+    return slot == DUE_SLOT ? &pDue_ : &slots_[slot];
+  }
+  // moves a coarse slot's timers down to finer levels
+  void Cascade(U32 level);
+  void RunDue();
+  void Free(Timer* pTimer);
+
+  U32 tickMicros_;
+  U64 tick_ = 0;
+  size_t count_ = 0;
+  // heads of doubly linked lists, level by level
+  Timer* slots_[LEVELS * SLOTS] = {};
+  // timers due this tick, while their callbacks run
+  Timer* pDue_ = nullptr;
+  ObjectPool<Timer> timers_;
+};
+
+}  // namespace Mana
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "ManaGlobals.h"
+#include "os/WindowBase.h"
+
+namespace Mana {
+
+// A window that's never shown, for headless runs (--headless): there's
+// no display, so nothing is created, and showing or going fullscreen
+// just succeeds.
+class WindowNull : public WindowBase {
+ public:
+  WindowNull() = default;
+  ~WindowNull() final = default;
+
+  WindowNull(const WindowNull&) = delete;
+  WindowNull& operator=(const WindowNull&) = delete;
+
+  bool CreateMainWindow(CommandLine& commandLine, const xstring& title) final;
+  bool ShowWindow(int nCmdShow) final;
+  bool ToggleFullscreenWindowed() final;
+
+  const xstring& GetTitle() const { return title_; }
+  bool IsFullscreen() const { return bFullscreen_; }
+
+ private:
+  xstring title_;
+  bool bFullscreen_ = false;
+};
+
+}  // namespace Mana
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "ManaGlobals.h"
+#include "utils/MappedFile.h"
+#include "utils/StringTypes.h"
+
+namespace Mana {
+
+// On-disk layout of a .mpak archive, built by ManaGame/scripts/mpak.py
+// (which documents the format). All integers are little endian.
+struct ArchiveHeader {
+  char magic[4];  // "MPAK"
+  U32 version;
+  U32 entryCount;
+  U32 bucketBits;
+  U64 tocOffset;
+  U64 namesOffset;
+};
+
+struct ArchiveEntry {
+  U64 pathHash;
+  U64 offset;  // from the start of the archive, 4K aligned
+  U32 storedSize;
+  U32 size;  // uncompressed size
+  U32 flags;
+  U32 nameOffset;  // into the names table, only used by tools
+};
+
+static_assert(sizeof(ArchiveHeader) == 32, "must match mpak.py");
+static_assert(sizeof(ArchiveEntry) == 32, "must match mpak.py");
+
+// Read-only access to a .mpak archive, so assets can be found without
+// a per-file open and stat.
+// The archive is mapped, and lookups hash the path and go straight to a
+// bucket of the table of contents, so Find is O(1) on average.
+// Stored entries can be used in place (GetView); compressed ones are
+// decompressed by Read.
+class Archive {
+ public:
+  static const U32 VERSION = 1;
+  static const U32 ALIGNMENT = 4096;
+  static const U32 FLAG_LZ4 = 1;
+
+  Archive() = default;
+  virtual ~Archive() = default;
+
+  Archive(const Archive&) = delete;
+  Archive& operator=(const Archive&) = delete;
+
+  // Returns false if the file is missing or isn't a valid archive.
+  bool Open(const xchar* fileName);
+  void Close();
+  bool IsOpen() const { return pHeader_ != nullptr; }
+
+  // Hashes |path| the same way mpak.py does:
+  // '\' becomes '/', ASCII letters are lowercased, a leading "./" is
+  // skipped, and the utf-8 bytes are hashed with 64 bit FNV-1a.
+  static U64 HashPath(const xchar* path);
+
+  // Returns nullptr if the archive doesn't contain the path.
+  const ArchiveEntry* Find(const xchar* path) const;
+  const ArchiveEntry* Find(U64 pathHash) const;
+
+  // The entry's bytes inside the mapping,
+  // or nullptr if the entry is compressed.
+  const unsigned char* GetView(const ArchiveEntry* pEntry) const;
+  // Copies or decompresses the entry into |pDest|,
+  // which must hold pEntry->size bytes.
+  bool Read(const ArchiveEntry* pEntry, unsigned char* pDest) const;
+
+  U32 GetEntryCount() const { return pHeader_ ? pHeader_->entryCount : 0; }
+
+ private:
+  MappedFile file_;
+  const ArchiveHeader* pHeader_ = nullptr;
+  const U32* pBuckets_ = nullptr;
+  const ArchiveEntry* pEntries_ = nullptr;
+};
+
+// The archive File::ReadAllBytes and MappedFile::Open look in
+// before going to disk. Null if the game runs from loose files.
+extern Archive* g_pAssetArchive;
+
+}  // namespace Mana
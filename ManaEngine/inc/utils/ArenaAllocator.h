@@ -0,0 +1,65 @@
+#pragma once
+
+#include <new>
+#include "ManaGlobals.h"
+#include "utils/LinearArena.h"
+
+namespace Mana {
+
+// STL allocator that draws from a LinearArena (or StackAllocator),
+// so containers used for one frame don't hit the heap:
+//
+//   std::vector<Entity*, ArenaAllocator<Entity*>> visible(
+//       ArenaAllocator<Entity*>(g_pFrameArena));
+//
+// deallocate is a no-op for arena memory, so a growing vector leaves its
+// old buffers in the arena until it's reset; reserve up front if you can.
+// If the arena is full, allocations fall back to the heap (and are freed
+// normally), so running out costs speed, not correctness.
+// The container must not outlive the arena's next Reset.
+template <typename T, typename TArena = LinearArena>
+class ArenaAllocator {
+ public:
+  typedef T value_type;
+
+  explicit ArenaAllocator(TArena* pArena) noexcept : pArena_(pArena) {}
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U, TArena>& other) noexcept
+      : pArena_(other.GetArena()) {}
+
+  T* allocate(size_t count) {
+    if (count > (size_t)-1 / sizeof(T)) {
+      throw std::bad_array_new_length();
+    }
+    void* p = pArena_->Allocate(count * sizeof(T), alignof(T));
+    if (!p) {
+      p = ::operator new(count * sizeof(T));
+    }
+    return (T*)p;
+  }
+
+  void deallocate(T* p, size_t /*count*/) noexcept {
+    if (!pArena_->Owns(p)) {
+      ::operator delete(p);
+    }
+  }
+
+  TArena* GetArena() const { return pArena_; }
+
+ private:
+  TArena* pArena_;
+};
+
+template <typename T, typename U, typename TArena>
+bool operator==(const ArenaAllocator<T, TArena>& a,
+                const ArenaAllocator<U, TArena>& b) {
+  return a.GetArena() == b.GetArena();
+}
+
+template <typename T, typename U, typename TArena>
+bool operator!=(const ArenaAllocator<T, TArena>& a,
+                const ArenaAllocator<U, TArena>& b) {
+  return a.GetArena() != b.GetArena();
+}
+
+}  // namespace Mana
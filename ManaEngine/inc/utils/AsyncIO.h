@@ -0,0 +1,159 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <vector>
+#include "ManaGlobals.h"
+#include "concurrency/ConditionVariable.h"
+#include "concurrency/IThread.h"
+#include "concurrency/Mutex.h"
+#include "target/TargetOS.h"
+#include "utils/StringTypes.h"
+
+// AsyncIO has three backends:
+//   AsyncIOWin.cpp   - overlapped reads on an I/O completion port (Windows)
+//   AsyncIOUring.cpp - io_uring (Linux)
+//   AsyncIO.cpp      - a pool of threads doing blocking reads (portable)
+// The thread pool is used when the native backend can't be initialized
+// (e.g. io_uring is disabled), or when MANA_ASYNCIO_THREADPOOL is defined.
+#if defined(__linux__) && !defined(MANA_ASYNCIO_THREADPOOL)
+#define MANA_ASYNCIO_URING
+#endif
+
+namespace Mana {
+
+struct AsyncReadResult {
+  const xchar* pPath;
+  // The bytes that were read. If the request's pDest was null, this was
+  // allocated with new[] and the callback owns it. Null on failure.
+  unsigned char* pBuffer;
+  size_t bytesRead;
+  bool bSuccess;
+  void* pUserData;
+};
+
+// Called once per request, on an AsyncIO thread (or on the calling thread
+// if the read is served from g_pAssetArchive), so keep it short:
+// e.g. queue a job that decodes the buffer.
+typedef void (*AsyncReadCallback)(const AsyncReadResult& result);
+
+struct AsyncReadRequest {
+  xstring path;
+  U64 offset = 0;
+  // 0 reads from |offset| to the end of the file
+  size_t size = 0;
+  // If null, a buffer is allocated and handed to the callback.
+  // Else it must hold |size| bytes (so |size| can't be 0)
+  // and stay valid until the callback is called.
+  unsigned char* pDest = nullptr;
+  AsyncReadCallback callback = nullptr;
+  void* pUserData = nullptr;
+};
+
+enum class AsyncIOBackend { None, ThreadPool, IoUring, CompletionPort };
+
+#ifdef MANA_ASYNCIO_URING
+// io_uring state, see AsyncIOUring.cpp
+struct AsyncIOUring;
+#endif
+
+// Keeps many file reads in flight at once, so loading lots of small
+// assets overlaps their I/O instead of waiting on each one in turn.
+// Reads complete in any order.
+// Files in the mounted asset archive (g_pAssetArchive) are copied out of it
+// right away instead.
+class AsyncIO {
+ public:
+  // threads used by the thread pool backend
+  static const U32 DEFAULT_POOL_THREADS = 4;
+  // max reads the native backends keep in flight
+  static const U32 MAX_IN_FLIGHT = 256;
+
+  AsyncIO();
+  virtual ~AsyncIO();
+
+  AsyncIO(const AsyncIO&) = delete;
+  AsyncIO& operator=(const AsyncIO&) = delete;
+
+  // Only one AsyncIO can be initialized at a time.
+  bool Init(U32 poolThreads = DEFAULT_POOL_THREADS);
+  // waits for reads in flight, then stops the threads
+  void Uninit();
+
+  AsyncIOBackend GetBackend() const { return backend_; }
+
+  // Returns false if the request is invalid (its callback isn't called).
+  // A read that fails later still calls the callback, with bSuccess false.
+  bool ReadAsync(const AsyncReadRequest& request);
+  // Submits all |count| requests at once (one system call with io_uring).
+  // Returns how many were accepted.
+  size_t ReadAsyncBatch(const AsyncReadRequest* pRequests, size_t count);
+
+  // Blocks until every accepted read has called its callback.
+  void WaitIdle();
+  size_t GetPendingCount() const {
+    return pending_.load(std::memory_order_acquire);
+  }
+
+ private:
+  // one accepted read
+  struct AsyncRead {
+    AsyncReadRequest request;
+    unsigned char* pBuffer;
+    size_t size;       // bytes to read
+    size_t bytesRead;  // so far, since a read can complete in pieces
+#ifdef OS_WIN
+    OVERLAPPED overlapped;
+    HANDLE hFile;
+#else
+    int fd;
+#endif
+  };
+
+  // Works out how much to read now that the file size is known,
+  // and allocates the buffer if needed.
+  // Returns false if the read would go past the end of the file.
+  bool PrepareBuffer(AsyncRead* pRead, U64 fileSize);
+  bool ReadFromArchive(const AsyncReadRequest& request);
+  // calls the callback and frees |pRead|
+  void Complete(AsyncRead* pRead, bool bSuccess);
+
+  // thread pool backend
+  bool InitThreadPool(U32 numThreads);
+  void UninitThreadPool();
+  void SubmitToThreadPool(AsyncRead** ppReads, size_t count);
+  void ReadBlocking(AsyncRead* pRead);
+
+  // native backend, implemented per platform.
+  // InitNative sets backend_, or returns false if the platform has none.
+  bool InitNative();
+  void UninitNative();
+  void SubmitNative(AsyncRead** ppReads, size_t count);
+  // Runs on the completion thread until it's stopped and woken.
+  void ProcessNativeCompletions(IThread* pThread);
+  void WakeNativeCompletionThread();
+
+  AsyncIOBackend backend_;
+  std::atomic<size_t> pending_;
+  Mutex idleLock_;
+  ConditionVariable idleCondition_;
+
+  std::vector<IThread*> poolThreads_;
+  std::deque<AsyncRead*> poolQueue_;
+  Mutex poolLock_;
+  ConditionVariable poolCondition_;
+
+  IThread* pCompletionThread_ = nullptr;
+#ifdef OS_WIN
+  HANDLE hCompletionPort_ = nullptr;
+#elif defined(MANA_ASYNCIO_URING)
+  AsyncIOUring* pUring_ = nullptr;
+#endif
+
+  friend unsigned long AsyncIOPoolThreadFunction(IThread* pThread);
+  friend unsigned long AsyncIOCompletionThreadFunction(IThread* pThread);
+};
+
+extern AsyncIO* g_pAsyncIO;
+
+}  // namespace Mana
@@ -26,6 +26,8 @@ class File {
   // calls Open/Close for you in rb mode
   // and synchronously calls Read until all bytes
   // are read into an internal buffer.
+  // Files in the mounted asset archive (g_pAssetArchive)
+  // are read from it instead.
   size_t ReadAllBytes(const xchar* fileName);
   unsigned char* GetBuffer() { return pBuf_; }
   size_t GetFileSize() const { return fileSize_; };
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "ManaGlobals.h"
+
+namespace Mana {
+
+// 64 bit FNV-1a.
+// Fast and good enough to tell files apart, but not cryptographic.
+// http://www.isthe.com/chongo/tech/comp/fnv/
+constexpr U64 FNV1A_64_OFFSET_BASIS = 0xcbf29ce484222325ULL;
+constexpr U64 FNV1A_64_PRIME = 0x100000001b3ULL;
+
+// Pass the previous result as |hash| to continue hashing across buffers.
+inline U64 HashBytes64(const void* pData,
+                       size_t size,
+                       U64 hash = FNV1A_64_OFFSET_BASIS) {
+  const U8* pBytes = (const U8*)pData;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= pBytes[i];
+    hash *= FNV1A_64_PRIME;
+  }
+  return hash;
+}
+
+}  // namespace Mana
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "ManaGlobals.h"
+
+namespace Mana {
+
+template <typename Signature, size_t CAPACITY>
+class InlineFunction;
+
+// A callable stored inside the object, instead of on the heap like
+// std::function. Anything that fits in CAPACITY bytes can be stored
+// (lambdas capturing a few pointers, function pointers); bigger ones
+// don't compile. Move only.
+//
+//   InlineFunction<void(), 32> onDone = [pSprite]() { pSprite->Hide(); };
+//   onDone();
+template <typename R, typename... Args, size_t CAPACITY>
+class InlineFunction<R(Args...), CAPACITY> {
+ public:
+  InlineFunction() = default;
+  InlineFunction(std::nullptr_t) {}
+
+  template <typename F,
+            typename = std::enable_if_t<
+                !std::is_same<std::decay_t<F>, InlineFunction>::value>>
+  InlineFunction(F&& func) {
+    typedef std::decay_t<F> Func;
+    static_assert(sizeof(Func) <= CAPACITY,
+                  "callable too big for this InlineFunction");
+    static_assert(alignof(Func) <= alignof(std::max_align_t),
+                  "callable over-aligned for InlineFunction");
+    static_assert(std::is_nothrow_move_constructible<Func>::value,
+                  "InlineFunction callables must move without throwing");
+    new (storage_) Func(std::forward<F>(func));
+    pOps_ = &OpsFor<Func>::ops;
+  }
+
+  InlineFunction(InlineFunction&& other) noexcept { MoveFrom(other); }
+  InlineFunction& operator=(InlineFunction&& other) noexcept {
+    if (this != &other) {
+      Reset();
+      MoveFrom(other);
+    }
+    return *this;
+  }
+  ~InlineFunction() { Reset(); }
+
+  InlineFunction(const InlineFunction&) = delete;
+  InlineFunction& operator=(const InlineFunction&) = delete;
+
+  explicit operator bool() const { return pOps_ != nullptr; }
+
+  R operator()(Args... args) {
+    assert(pOps_ && "calling an empty InlineFunction");
+    return pOps_->invoke(storage_, std::forward<Args>(args)...);
+  }
+
+  void Reset() {
+    if (pOps_) {
+      pOps_->destroy(storage_);
+      pOps_ = nullptr;
+    }
+  }
+
+ private:
+  struct Ops {
+    R (*invoke)(void* pFunc, Args&&... args);
+    // move constructs into |pTo| and destroys |pFrom|
+    void (*move)(void* pTo, void* pFrom);
+    void (*destroy)(void* pFunc);
+  };
+
+  template <typename Func>
+  struct OpsFor {
+    static R Invoke(void* pFunc, Args&&... args) {
+      return (*(Func*)pFunc)(std::forward<Args>(args)...);
+    }
+    static void Move(void* pTo, void* pFrom) {
+      new (pTo) Func(std::move(*(Func*)pFrom));
+      ((Func*)pFrom)->~Func();
+    }
+    static void Destroy(void* pFunc) { ((Func*)pFunc)->~Func(); }
+
+    static constexpr Ops ops = {Invoke, Move, Destroy};
+  };
+
+  void MoveFrom(InlineFunction& other) {
+    if (other.pOps_) {
+      other.pOps_->move(storage_, other.storage_);
+      pOps_ = other.pOps_;
+      other.pOps_ = nullptr;
+    }
+  }
+
+  alignas(std::max_align_t) unsigned char storage_[CAPACITY];
+  const Ops* pOps_ = nullptr;
+};
+
+}  // namespace Mana
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <assert.h>
+#include <cstddef>
+#include "ManaGlobals.h"
+
+namespace Mana {
+
+// Bump allocator over one block from AlignedMalloc.
+// Allocate just moves an offset, and there's no per-allocation free:
+// Reset frees everything at once. Meant for temporaries that all die
+// together, like the game loop's per-frame scratch data (g_pFrameArena),
+// instead of a new/delete per object.
+//
+// Not thread-safe. Use one arena per thread.
+class LinearArena {
+ public:
+  static const size_t DEFAULT_ALIGNMENT = alignof(std::max_align_t);
+
+  LinearArena() = default;
+  virtual ~LinearArena();
+
+  LinearArena(const LinearArena&) = delete;
+  LinearArena& operator=(const LinearArena&) = delete;
+
+  bool Init(size_t capacity);
+  void Uninit();
+
+  // Returns nullptr if the arena doesn't have |size| bytes left.
+  // |align| must be a power of 2.
+  void* Allocate(size_t size, size_t align = DEFAULT_ALIGNMENT) {
+    assert((align & (align - 1)) == 0);
+    uintptr_t base = (uintptr_t)pBase_;
+    uintptr_t aligned = (base + offset_ + align - 1) & ~(uintptr_t)(align - 1);
+    size_t start = (size_t)(aligned - base);
+    if (start > capacity_ || size > capacity_ - start) {
+      return nullptr;
+    }
+
+    offset_ = start + size;
+    if (offset_ > highWater_) {
+      highWater_ = offset_;
+    }
+    return pBase_ + start;
+  }
+
+  // Uninitialized storage for |count| T's. Their destructors won't run.
+  template <typename T>
+  T* AllocateArray(size_t count) {
+    if (count > (size_t)-1 / sizeof(T)) {
+      return nullptr;
+    }
+    return (T*)Allocate(count * sizeof(T), alignof(T));
+  }
+
+  // Frees every allocation. Pointers into the arena are invalid after this.
+  void Reset() { Rewind(0); }
+
+  bool Owns(const void* p) const {
+    return p >= pBase_ && p < pBase_ + capacity_;
+  }
+
+  size_t GetUsed() const { return offset_; }
+  size_t GetCapacity() const { return capacity_; }
+  // most ever used at once, for sizing the arena
+  size_t GetHighWater() const { return highWater_; }
+
+ protected:
+  // frees everything allocated after |offset|
+  void Rewind(size_t offset);
+
+  unsigned char* pBase_ = nullptr;
+  size_t capacity_ = 0;
+  size_t offset_ = 0;
+  size_t highWater_ = 0;
+
+ private:
+  void* pRaw_ = nullptr;
+};
+
+// Scratch memory for the game loop thread, reset at the start of every
+// frame. Only use it from the game loop thread, and never keep a pointer
+// into it past the frame it was allocated in.
+extern LinearArena* g_pFrameArena;
+
+}  // namespace Mana
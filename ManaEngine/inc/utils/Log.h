@@ -2,8 +2,12 @@
 
 #include <cstdarg>
 #include <cstdio>
+#include <atomic>
 #include <cstring>
+#include <string>
+#include <type_traits>
 #include "ManaGlobals.h"
+#include "datastructures/RingOverflowPolicy.h"
 
 namespace Mana {
 
@@ -14,35 +18,293 @@ enum class Channel : U32 {
   Init = 1,
   Shutdown = 2,
   Graphics = 3,
-  Sound = 4
+  Sound = 4,
+  Input = 5,
+  Perf = 6,  // frame timings
+  Count
+};
+
+const size_t LOG_CHANNEL_COUNT = (size_t)Channel::Count;
+
+enum class LogFileFormat : U32 {
+  Text,    // formatted by the writer thread
+  Binary,  // .mlog, formatted later by ManaGame/scripts/mlog.py
+};
+
+// A ManaLog macro call site. The macros define one as a constant-initialized
+// static, so its address identifies the call site and the format string is
+// never copied.
+struct LogSite {
+  Verbosity verbosity;
+  Channel channel;
+  bool newline;
+  const xchar* format;
+  const char* file;
+  U32 line;
+};
+
+// Type tags for the arguments captured by the ManaLog macros.
+// Don't renumber, .mlog files depend on them.
+enum class LogArgType : U8 {
+  I32 = 1,
+  U32 = 2,
+  I64 = 3,
+  U64 = 4,
+  F64 = 5,
+  Pointer = 6,
+  String = 7,        // xchar units
+  NarrowString = 8,  // char units, for %S or %hs where xchar is wchar_t
+};
+
+// The arguments of one log call, captured instead of formatted: each is a
+// LogArgType followed by the value. Strings are a U16 length in characters
+// followed by the characters, or NULL_STRING.
+class LogArgs {
+ public:
+  static const size_t MAX_BYTES = 1024;
+  static const U16 NULL_STRING = 0xffff;
+
+  LogArgs() = default;
+  virtual ~LogArgs() = default;
+
+  LogArgs(const LogArgs&) = delete;
+  LogArgs& operator=(const LogArgs&) = delete;
+
+  template <typename T>
+  void Add(const T& value);
+
+  const U8* GetData() const { return data_; }
+  size_t GetSize() const { return size_; }
+  // an argument didn't fit in MAX_BYTES
+  bool IsTruncated() const { return bTruncated_; }
+
+ private:
+  void AddValue(LogArgType type, const void* pValue, size_t bytes);
+  template <typename C>
+  void AddString(LogArgType type, const C* pString);
+
+  U8 data_[MAX_BYTES];
+  size_t size_ = 0;
+  bool bTruncated_ = false;
+};
+
+struct LogStats {
+  U64 messagesLogged;
+  U64 messagesDropped;    // the logging thread's ring was full
+  U64 messagesTruncated;  // longer than Logger::MAX_MESSAGE_CHARS,
+                          // or arguments longer than LogArgs::MAX_BYTES
+  U64 bytesWritten;
+  U64 fileWrites;  // batched writes, each covering many messages
+  U32 threadRings;
 };
 
 // use the macros below instead of these functions
-bool LogInit(const char* logFile);
+// Messages are written by a background thread (see Logger.h).
+bool LogInit(const char* logFile,
+             RingOverflowPolicy policy = RingOverflowPolicy::DropNewest,
+             LogFileFormat format = LogFileFormat::Text);
+// Writes everything still queued and stops the writer thread.
+// Frees every thread's log ring, so call it once the other threads that
+// log have stopped (or stopped logging).
+void LogShutdown();
+// blocks until everything logged so far is in the file
+void LogFlush();
+LogStats GetLogStats();
+bool IsLogInitialized();
+// queues a call site's arguments, formatted by the writer thread if at all
+void LogWrite(const LogSite& site, const LogArgs& args);
+// These format on the calling thread. The macros use LogDeferred instead.
 void LogError(Channel channel, bool newline, const xchar* format, ...);
 void LogWarning(Channel channel, bool newline, const xchar* format, ...);
 void LogInfo(Channel channel, bool newline, const xchar* format, ...);
 void LogVerbose(Channel channel, bool newline, const xchar* format, ...);
 
+// Runtime channel filter, one bit per Channel. Errors, and messages on
+// Channel::All, are always logged.
+extern std::atomic<U32> g_logChannelMask;
+// Enables only the channels in a comma separated list of names, as in
+// `--log-channels sound,graphics`. "all" enables every channel.
+// Returns false (and changes nothing) if a name isn't a channel.
+bool LogSetChannels(const char* channels);
+
+inline bool IsLogEnabled(Verbosity verbosity, Channel channel) {
+  return verbosity == Verbosity::Error || channel == Channel::All ||
+         (g_logChannelMask.load(std::memory_order_relaxed) &
+          (1u << (U32)channel)) != 0;
+}
+
+template <typename... Args>
+void LogDeferred(const LogSite& site, const Args&... args) {
+  if (!IsLogInitialized())
+    return;
+
+  LogArgs logArgs;
+  (logArgs.Add(args), ...);
+  LogWrite(site, logArgs);
+}
+
+template <typename T>
+void LogArgs::Add(const T& value) {
+  using Type = std::decay_t<T>;
+
+  if constexpr (std::is_same_v<Type, xchar*> ||
+                std::is_same_v<Type, const xchar*>) {
+    AddString(LogArgType::String, (const xchar*)value);
+  } else if constexpr (std::is_same_v<Type, char*> ||
+                       std::is_same_v<Type, const char*>) {
+    AddString(LogArgType::NarrowString, (const char*)value);
+  } else if constexpr (std::is_floating_point_v<Type>) {
+    double v = (double)value;
+    AddValue(LogArgType::F64, &v, sizeof(v));
+  } else if constexpr (std::is_pointer_v<Type> ||
+                       std::is_null_pointer_v<Type>) {
+    U64 v = (U64)(uintptr_t)value;
+    AddValue(LogArgType::Pointer, &v, sizeof(v));
+  } else if constexpr (std::is_enum_v<Type>) {
+    Add((std::underlying_type_t<Type>)value);
+  } else if constexpr (std::is_integral_v<Type>) {
+    // as printf would see it after promotion
+    if constexpr (sizeof(Type) <= 4 && std::is_signed_v<Type>) {
+      I32 v = (I32)value;
+      AddValue(LogArgType::I32, &v, sizeof(v));
+    } else if constexpr (sizeof(Type) <= 4) {
+      U32 v = (U32)value;
+      AddValue(LogArgType::U32, &v, sizeof(v));
+    } else if constexpr (std::is_signed_v<Type>) {
+      I64 v = (I64)value;
+      AddValue(LogArgType::I64, &v, sizeof(v));
+    } else {
+      U64 v = (U64)value;
+      AddValue(LogArgType::U64, &v, sizeof(v));
+    }
+  } else {
+    static_assert(sizeof(Type) == 0, "ManaLog can't capture this type");
+  }
+}
+
+inline void LogArgs::AddValue(LogArgType type,
+                              const void* pValue,
+                              size_t bytes) {
+  if (bTruncated_ || size_ + 1 + bytes > MAX_BYTES) {
+    bTruncated_ = true;
+    return;
+  }
+  data_[size_] = (U8)type;
+  memcpy(data_ + size_ + 1, pValue, bytes);
+  size_ += 1 + bytes;
+}
+
+template <typename C>
+void LogArgs::AddString(LogArgType type, const C* pString) {
+  const size_t HEADER = 1 + sizeof(U16);
+  if (bTruncated_ || size_ + HEADER > MAX_BYTES) {
+    bTruncated_ = true;
+    return;
+  }
+
+  U16 length = NULL_STRING;
+  if (pString) {
+    size_t fullLength = std::char_traits<C>::length(pString);
+    size_t maxLength = (MAX_BYTES - size_ - HEADER) / sizeof(C);
+    bTruncated_ = fullLength > maxLength;
+    length = (U16)(bTruncated_ ? maxLength : fullLength);
+  }
+
+  data_[size_] = (U8)type;
+  memcpy(data_ + size_ + 1, &length, sizeof(length));
+  size_ += HEADER;
+  if (length != NULL_STRING) {
+    memcpy(data_ + size_, pString, length * sizeof(C));
+    size_ += length * sizeof(C);
+  }
+}
+
 }  // namespace Mana
 
 #ifdef MANA_LOGGING_ENABLED
 
-#define ManaLogInit(file) ::Mana::LogInit(file)
+// The most verbose level compiled in: 0 Error, 1 Warning, 2 Info, 3 Verbose.
+// Messages above it compile to nothing, arguments included. Set per channel
+// in the project's preprocessor definitions, e.g. MANA_LOG_VERBOSITY=1 and
+// MANA_LOG_VERBOSITY_SOUND=3 keep only warnings, except for audio tracing.
+#ifndef MANA_LOG_VERBOSITY
+#define MANA_LOG_VERBOSITY 3
+#endif
+#ifndef MANA_LOG_VERBOSITY_ALL
+#define MANA_LOG_VERBOSITY_ALL MANA_LOG_VERBOSITY
+#endif
+#ifndef MANA_LOG_VERBOSITY_INIT
+#define MANA_LOG_VERBOSITY_INIT MANA_LOG_VERBOSITY
+#endif
+#ifndef MANA_LOG_VERBOSITY_SHUTDOWN
+#define MANA_LOG_VERBOSITY_SHUTDOWN MANA_LOG_VERBOSITY
+#endif
+#ifndef MANA_LOG_VERBOSITY_GRAPHICS
+#define MANA_LOG_VERBOSITY_GRAPHICS MANA_LOG_VERBOSITY
+#endif
+#ifndef MANA_LOG_VERBOSITY_SOUND
+#define MANA_LOG_VERBOSITY_SOUND MANA_LOG_VERBOSITY
+#endif
+#ifndef MANA_LOG_VERBOSITY_INPUT
+#define MANA_LOG_VERBOSITY_INPUT MANA_LOG_VERBOSITY
+#endif
+#ifndef MANA_LOG_VERBOSITY_PERF
+#define MANA_LOG_VERBOSITY_PERF MANA_LOG_VERBOSITY
+#endif
+
+namespace Mana {
+
+// indexed by Channel
+constexpr U32 LOG_COMPILED_VERBOSITY[] = {
+    MANA_LOG_VERBOSITY_ALL,      MANA_LOG_VERBOSITY_INIT,
+    MANA_LOG_VERBOSITY_SHUTDOWN, MANA_LOG_VERBOSITY_GRAPHICS,
+    MANA_LOG_VERBOSITY_SOUND,    MANA_LOG_VERBOSITY_INPUT,
+    MANA_LOG_VERBOSITY_PERF};
+static_assert(sizeof(LOG_COMPILED_VERBOSITY) / sizeof(U32) ==
+                  LOG_CHANNEL_COUNT,
+              "add a MANA_LOG_VERBOSITY_ define for the new Channel");
+
+constexpr bool IsLogCompiledIn(Verbosity verbosity, Channel channel) {
+  return (U32)verbosity <= LOG_COMPILED_VERBOSITY[(U32)channel];
+}
+
+}  // namespace Mana
+
+// Captures the call site and the arguments, leaving the formatting to the
+// writer thread (or to mlog.py). Both filters run before the arguments are
+// evaluated.
+#define MANA_LOG_AT_SITE(verbosity, channel, newline, format, ...)      \
+  do {                                                                  \
+    if constexpr (::Mana::IsLogCompiledIn(verbosity, channel)) {        \
+      if (::Mana::IsLogEnabled(verbosity, channel)) {                   \
+        static const ::Mana::LogSite manaLogSite = {                    \
+            verbosity, channel, newline, format, __FILE__, __LINE__};   \
+        ::Mana::LogDeferred(manaLogSite, ##__VA_ARGS__);                \
+      }                                                                 \
+    }                                                                   \
+  } while (0)
+
+#define ManaLogInit(file, ...) ::Mana::LogInit(file, ##__VA_ARGS__)
+#define ManaLogShutdown() ::Mana::LogShutdown()
+#define ManaLogFlush() ::Mana::LogFlush()
+#define ManaLogSetChannels(channels) ::Mana::LogSetChannels(channels)
 
-#define ManaLogError(channel, format, ...)      ::Mana::LogError(channel, false, format, __VA_ARGS__)
-#define ManaLogWarning(channel, format, ...)    ::Mana::LogWarning(channel, false, format, __VA_ARGS__)
-#define ManaLogInfo(channel, format, ...)       ::Mana::LogInfo(channel, false, format, __VA_ARGS__)
-#define ManaLogVerbose(channel, format, ...)    ::Mana::LogVerbose(channel, false, format, __VA_ARGS__)
+#define ManaLogError(channel, format, ...)      MANA_LOG_AT_SITE(::Mana::Verbosity::Error, channel, false, format, ##__VA_ARGS__)
+#define ManaLogWarning(channel, format, ...)    MANA_LOG_AT_SITE(::Mana::Verbosity::Warning, channel, false, format, ##__VA_ARGS__)
+#define ManaLogInfo(channel, format, ...)       MANA_LOG_AT_SITE(::Mana::Verbosity::Info, channel, false, format, ##__VA_ARGS__)
+#define ManaLogVerbose(channel, format, ...)    MANA_LOG_AT_SITE(::Mana::Verbosity::Verbose, channel, false, format, ##__VA_ARGS__)
 
-#define ManaLogLnError(channel, format, ...)    ::Mana::LogError(channel, true, format, __VA_ARGS__)
-#define ManaLogLnWarning(channel, format, ...)  ::Mana::LogWarning(channel, true, format, __VA_ARGS__)
-#define ManaLogLnInfo(channel, format, ...)     ::Mana::LogInfo(channel, true, format, __VA_ARGS__)
-#define ManaLogLnVerbose(channel, format, ...)  ::Mana::LogVerbose(channel, true, format, __VA_ARGS__)
+#define ManaLogLnError(channel, format, ...)    MANA_LOG_AT_SITE(::Mana::Verbosity::Error, channel, true, format, ##__VA_ARGS__)
+#define ManaLogLnWarning(channel, format, ...)  MANA_LOG_AT_SITE(::Mana::Verbosity::Warning, channel, true, format, ##__VA_ARGS__)
+#define ManaLogLnInfo(channel, format, ...)     MANA_LOG_AT_SITE(::Mana::Verbosity::Info, channel, true, format, ##__VA_ARGS__)
+#define ManaLogLnVerbose(channel, format, ...)  MANA_LOG_AT_SITE(::Mana::Verbosity::Verbose, channel, true, format, ##__VA_ARGS__)
 
 #else
 
-#define ManaLogInit(file)
+#define ManaLogInit(file, ...)
+#define ManaLogShutdown()
+#define ManaLogFlush()
+#define ManaLogSetChannels(channels) true
 
 #define ManaLogError(channel, format, ...)
 #define ManaLogWarning(channel, format, ...)
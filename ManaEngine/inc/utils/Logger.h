@@ -0,0 +1,236 @@
+#pragma once
+
+#include <stdio.h>
+#include <atomic>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ManaGlobals.h"
+#include "concurrency/ConditionVariable.h"
+#include "concurrency/IThread.h"
+#include "concurrency/Mutex.h"
+#include "datastructures/RingOverflowPolicy.h"
+#include "datastructures/SpscRingBuffer.h"
+#include "utils/Log.h"
+#include "utils/MemoryTracker.h"
+#include "utils/Timer.h"
+
+namespace Mana {
+
+// The asynchronous logger behind the ManaLog macros (see Log.h).
+//
+// Logging used to format, allocate, and open/append/close the log file on
+// the calling thread under one global mutex, so a log line from the game
+// loop or audio thread could stall on disk. Now the calling thread only
+// copies the call site's LogSite pointer and the raw arguments (see LogArgs)
+// into its own lock-free ring (no lock, no allocation once the thread's ring
+// exists), and a background writer thread drains every ring, merges them in
+// time order, formats them, and writes each batch with one fwrite.
+//
+// With LogFileFormat::Binary, the writer doesn't format either. It writes
+// each call site's format string to the .mlog file the first time it's used,
+// then just the site's ID and the argument bytes per message, for
+// ManaGame/scripts/mlog.py to format later. Nothing goes to the debugger
+// output in that mode.
+//
+// .mlog format (fixed size integers are little endian, "var" is LEB128,
+// "svar" is a zigzag LEB128, "str" is a var length + utf-8):
+//   header   "MLOG", U16 version, U16 0,
+//            U64 local time of day at LogInit in microseconds
+//   chunks   each starts with a U8 CHUNK_ kind:
+//   SITE     var id, U8 verbosity, U8 channel, U8 newline, var line,
+//            str file, str format
+//   MESSAGE  var site id, svar microseconds since the previous chunk,
+//            var length + arguments
+//   TEXT     U8 verbosity, U8 channel, U8 newline,
+//            svar microseconds since the previous chunk, str text
+// Each argument is a U8 LogArgType, then a svar for signed integers, a var
+// for unsigned ones and pointers, 8 bytes for doubles, or a var length + 1
+// (0 for null) and utf-8 for strings.
+//
+// When a thread's ring is full, the message is dropped and counted
+// (RingOverflowPolicy::DropNewest), or the thread waits for the writer
+// (RingOverflowPolicy::Block). Errors, and rings getting half full,
+// wake the writer right away. Everything else is written within
+// WRITE_INTERVAL_MS.
+class Logger {
+ public:
+  // per thread: RING_RECORDS * RECORD_BYTES bytes
+  static const size_t RING_RECORDS = 256;
+  static const size_t RECORD_BYTES = 256;
+  // longer messages are truncated
+  static const size_t MAX_MESSAGE_CHARS = 1024;
+  static const U32 WRITE_INTERVAL_MS = 10;
+
+  Logger() = default;
+  virtual ~Logger();
+
+  Logger(const Logger&) = delete;
+  Logger& operator=(const Logger&) = delete;
+
+  static const U16 BINARY_VERSION = 1;
+  static const U8 CHUNK_SITE = 1;
+  static const U8 CHUNK_MESSAGE = 2;
+  static const U8 CHUNK_TEXT = 3;
+
+  // Truncates |fileName| and starts the writer thread.
+  bool Init(const char* fileName,
+            RingOverflowPolicy policy,
+            LogFileFormat format);
+  // Writes everything still queued, stops the writer and frees the rings.
+  // Threads that log must have stopped logging by then.
+  void Uninit();
+  bool IsInitialized() const {
+    return bInitialized_.load(std::memory_order_acquire);
+  }
+
+  // Any thread. Formats the message and queues it for the writer.
+  void Write(Verbosity verbosity,
+             Channel channel,
+             bool newline,
+             const xchar* format,
+             va_list args);
+  // Any thread. Queues the arguments as they are.
+  void WriteArgs(const LogSite& site, const LogArgs& args);
+
+  // Blocks until everything logged before the call is in the file.
+  void Flush();
+
+  LogStats GetStats();
+
+ private:
+  static const U8 FLAG_NEWLINE = 1;
+  // the message goes on in the next record of the same ring
+  static const U8 FLAG_CONTINUED = 2;
+  static const size_t RECORD_DATA_BYTES = RECORD_BYTES - 24;
+
+  // A piece of one message. Long messages span several records,
+  // which are always pushed into the ring back to back.
+  struct Record {
+    U64 timestamp;         // clock_ microseconds
+    const LogSite* pSite;  // nullptr when data is preformatted text
+    U16 length;            // bytes used in data
+    U8 verbosity;
+    U8 channel;
+    U8 flags;
+    U8 data[RECORD_DATA_BYTES];  // LogArgs bytes, or xchar text
+  };
+
+  // One producer thread's records.
+  // A thread's ring goes back to the list when it exits, for the next new
+  // thread, and Uninit frees them all.
+  struct ThreadRing {
+    explicit ThreadRing(RingOverflowPolicy policy) : ring(policy) {}
+
+    SpscRingBuffer<Record, RING_RECORDS> ring;
+    std::atomic<bool> bInUse{true};
+    // set by the producer when it wakes the writer early,
+    // cleared by the writer once it has drained the ring
+    std::atomic<bool> bWakePending{false};
+    ThreadRing* pNext = nullptr;
+    // written by the owning thread only
+    std::atomic<U64> logged{0};
+    std::atomic<U64> dropped{0};
+    std::atomic<U64> truncated{0};
+  };
+
+  // a message in the writer's batch
+  struct Message {
+    U64 timestamp;
+    size_t firstRecord;
+    size_t numRecords;
+  };
+
+  // the calling thread's ring, nullptr if it couldn't be allocated
+  ThreadRing* GetThreadRing();
+  // |generation| is set to the ring list's generation it came from
+  ThreadRing* AcquireRing(U32& generation);
+  // from an exiting thread, if the ring wasn't freed since
+  void ReleaseRing(ThreadRing* pRing, U32 generation);
+  void FreeRings();
+  // splits the message into records and pushes them
+  void PushMessage(ThreadRing* pRing,
+                   U64 timestamp,
+                   const LogSite* pSite,
+                   Verbosity verbosity,
+                   Channel channel,
+                   const void* pData,
+                   size_t bytes,
+                   bool newline,
+                   bool bTruncated);
+
+  friend unsigned long LoggerThreadFunction(IThread* pThread);
+  void RunWriter(IThread* pThread);
+  void WakeWriter();
+  // writer thread: write everything queued so far
+  void Drain();
+  void WriteMessage(const Message& message);
+  void WriteBinaryMessage(const Message& message);
+  // the site's ID in this file, writing its SITE chunk the first time
+  U32 GetSiteId(const LogSite& site);
+  // formats |format| with captured LogArgs bytes, appending to |out|
+  void FormatArgs(const xchar* format,
+                  const U8* pArgs,
+                  size_t size,
+                  xstring& out);
+  static int FormatOne(xchar* pDest,
+                       size_t destChars,
+                       const xchar* format,
+                       ...);
+
+  // platform specific (LogWin.cpp, LogStd.cpp)
+  static FILE* OpenLogFile(const char* fileName);
+  // local time of day, in microseconds since midnight
+  static U64 GetLocalTimeOfDay();
+  // like vsnprintf: returns the untruncated length, or -1 on error
+  // (on some platforms, -1 on truncation too)
+  static int FormatText(xchar* pDest,
+                        size_t destChars,
+                        const xchar* format,
+                        va_list args);
+  static void AppendUtf8(const xchar* pText, size_t length, std::string& out);
+  // a varint byte count, then the utf-8
+  void AppendString(const xchar* pText, size_t length, std::string& out);
+  static void OutputToDebugger(const xchar* pText);
+
+  std::atomic<bool> bInitialized_{false};
+  RingOverflowPolicy policy_ = RingOverflowPolicy::DropNewest;
+  LogFileFormat format_ = LogFileFormat::Text;
+  FILE* pFile_ = nullptr;
+  Timer clock_;
+  U64 timeOfDayAtInit_ = 0;
+
+  Mutex ringsLock_;  // for AcquireRing, ReleaseRing and FreeRings
+  // Only prepended to while logging, so the writer can walk it without the
+  // lock. Emptied by FreeRings once the writer has stopped.
+  std::atomic<ThreadRing*> pFirstRing_{nullptr};
+  std::atomic<U32> numRings_{0};
+  // bumped by FreeRings, so threads holding a freed ring get a new one
+  std::atomic<U32> ringGeneration_{0};
+
+  IThread* pWriterThread_ = nullptr;
+  Mutex wakeLock_;
+  ConditionVariable wake_;
+  ConditionVariable flushed_;
+  bool bWakeRequested_ = false;
+  U64 flushRequests_ = 0;
+  U64 flushesDone_ = 0;
+
+  // writer thread only, reused between batches
+  std::vector<Record, TaggedAllocator<Record, MemoryTag::Log>> records_;
+  std::vector<Message, TaggedAllocator<Message, MemoryTag::Log>> messages_;
+  // the message being written, reassembled from its records
+  std::vector<U8, TaggedAllocator<U8, MemoryTag::Log>> payload_;
+  std::unordered_map<const LogSite*, U32> siteIds_;
+  U64 lastTimestamp_ = 0;
+  xstring line_;
+  xstring stringArg_;
+  std::string narrowArg_;
+  std::string utf8_;
+  std::string args_;
+  std::string out_;
+  std::atomic<U64> bytesWritten_{0};
+  std::atomic<U64> fileWrites_{0};
+};
+
+}  // namespace Mana
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "ManaGlobals.h"
+#include "target/TargetOS.h"
+#include "utils/File.h"
+#include "utils/MemoryTracker.h"
+#include "utils/StringTypes.h"
+
+namespace Mana {
+
+// Read-only view of a whole file, mapped into memory
+// (file mapping on Windows, mmap elsewhere).
+// Unlike File::ReadAllBytes, nothing is copied up front: pages are read
+// in by the OS as they're touched, and they don't count against the heap,
+// so large music files can be decoded straight out of the mapping.
+// Files in the mounted asset archive (g_pAssetArchive) are served
+// from the archive's own mapping.
+// If the file can't be mapped, Open falls back to File::ReadAllBytes,
+// so callers always get a buffer.
+class MappedFile {
+ public:
+  MappedFile() = default;
+  virtual ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  // Returns false if the file is missing, empty, or can't be read.
+  // A mapping counts against |tag| while it's open. (Archive views are
+  // already counted by the archive, and the fallback's buffer as IO.)
+  bool Open(const xchar* fileName, MemoryTag tag = MemoryTag::IO);
+  // Takes over a buffer that was already read into memory and allocated
+  // with new[] (e.g. by AsyncIO), so code that decodes a MappedFile can
+  // decode it too. It counts against |tag| until Close deletes it.
+  // Returns false (and deletes it) if |size| is 0.
+  bool Adopt(unsigned char* pBuffer, size_t size, MemoryTag tag);
+  void Close();
+
+  // Same names as File, so the two are easy to swap.
+  const unsigned char* GetBuffer() const { return pData_; }
+  size_t GetFileSize() const { return size_; }
+
+  // false if Open fell back to reading into a heap buffer, or for Adopt
+  bool IsMapped() const { return bMapped_ || bArchiveView_; }
+
+ private:
+  // platform specific, returns false if the file can't be mapped
+  bool Map(const xchar* fileName);
+  void Unmap();
+
+  const unsigned char* pData_ = nullptr;
+  size_t size_ = 0;
+  bool bMapped_ = false;
+  MemoryTag tag_ = MemoryTag::IO;
+  // pData_ points into g_pAssetArchive, which owns the mapping
+  bool bArchiveView_ = false;
+
+  // only used by the fallback path
+  File* pFile_ = nullptr;
+  // set by Adopt
+  unsigned char* pAdopted_ = nullptr;
+
+#ifdef OS_WIN
+  HANDLE hFile_ = INVALID_HANDLE_VALUE;
+  HANDLE hMapping_ = nullptr;
+#else
+  int fd_ = -1;
+#endif
+};
+
+}  // namespace Mana
@@ -9,6 +9,7 @@ namespace Mana {
 // Note that we could probably use C11's "aligned_alloc" function instead,
 // but this was a nice learning exersize.
 // |align| must be a power of 2.
+// Free the memory by passing |*ppRaw| (not |*ppAligned|) to free().
 bool AlignedMalloc(size_t align, size_t size,
     void** ppAligned, void** ppRaw);
 
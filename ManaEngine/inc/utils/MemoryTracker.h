@@ -0,0 +1,123 @@
+#pragma once
+
+#include <new>
+#include <type_traits>
+#include "ManaGlobals.h"
+
+namespace Mana {
+
+// Which engine subsystem a piece of memory belongs to.
+enum class MemoryTag : U32 {
+  Audio,     // pcm buffers, compressed audio files, mixer buses
+  Input,     // raw input buffers
+  Graphics,  // cpu side graphics data
+  IO,        // file buffers and mapped files
+  Log,       // formatted log strings
+  Profiler,  // profiler zone buffers
+  Count
+};
+
+const size_t MEMORY_TAG_COUNT = (size_t)MemoryTag::Count;
+
+const xchar* GetMemoryTagName(MemoryTag tag);
+
+struct MemoryTagStats {
+  const xchar* pName;
+  size_t liveBytes;
+  size_t peakBytes;
+  size_t budgetBytes;  // 0 if there's no budget
+  U64 allocations;
+  U64 frees;
+};
+
+struct MemorySnapshot {
+  MemoryTagStats tags[MEMORY_TAG_COUNT];
+};
+
+// Counts |size| bytes against |tag|. For memory the tagged functions below
+// don't allocate themselves, like file mappings. Every TrackAllocation
+// needs a TrackFree with the same tag and size.
+// Warns (once until it's back under) when a tag goes over its budget.
+void TrackAllocation(MemoryTag tag, size_t size);
+void TrackFree(MemoryTag tag, size_t size);
+
+// malloc/realloc/free that count against |tag|.
+// The size and tag are kept in front of the block, so TaggedFree and
+// TaggedRealloc don't need them. Never mix these with plain malloc/free.
+void* TaggedMalloc(MemoryTag tag, size_t size);
+void* TaggedRealloc(MemoryTag tag, void* p, size_t size);
+void TaggedFree(void* p);
+
+// Replacements for new T[count] / delete[] for plain data, like pcm.
+// Like new[], the elements are left uninitialized, and running out of
+// memory throws instead of returning null, same as TaggedAllocator.
+template <typename T>
+T* TaggedNewArray(MemoryTag tag, size_t count) {
+  static_assert(std::is_trivially_destructible<T>::value,
+                "TaggedNewArray doesn't run destructors");
+  if (count > (size_t)-1 / sizeof(T)) {
+    throw std::bad_array_new_length();
+  }
+  void* p = TaggedMalloc(tag, count * sizeof(T));
+  if (!p) {
+    throw std::bad_alloc();
+  }
+  return (T*)p;
+}
+
+template <typename T>
+void TaggedDeleteArray(T* p) {
+  TaggedFree(p);
+}
+
+// Live and peak bytes, and allocation counts, of every tag.
+// Cheap enough to take every frame.
+MemorySnapshot GetMemorySnapshot();
+// one line per tag that has ever allocated
+void LogMemorySnapshot();
+
+// 0 removes the budget
+void SetMemoryBudget(MemoryTag tag, size_t budgetBytes);
+
+// STL allocator counting against |TAG|, e.g.
+//   std::vector<F32, TaggedAllocator<F32, MemoryTag::Audio>> bus;
+template <typename T, MemoryTag TAG>
+class TaggedAllocator {
+ public:
+  typedef T value_type;
+  template <typename U>
+  struct rebind {
+    typedef TaggedAllocator<U, TAG> other;
+  };
+
+  TaggedAllocator() noexcept = default;
+  template <typename U>
+  TaggedAllocator(const TaggedAllocator<U, TAG>&) noexcept {}
+
+  T* allocate(size_t count) {
+    if (count > (size_t)-1 / sizeof(T)) {
+      throw std::bad_array_new_length();
+    }
+    void* p = TaggedMalloc(TAG, count * sizeof(T));
+    if (!p) {
+      throw std::bad_alloc();
+    }
+    return (T*)p;
+  }
+
+  void deallocate(T* p, size_t) noexcept { TaggedFree(p); }
+};
+
+template <typename T, typename U, MemoryTag TAG>
+bool operator==(const TaggedAllocator<T, TAG>&,
+                const TaggedAllocator<U, TAG>&) {
+  return true;
+}
+
+template <typename T, typename U, MemoryTag TAG>
+bool operator!=(const TaggedAllocator<T, TAG>&,
+                const TaggedAllocator<U, TAG>&) {
+  return false;
+}
+
+}  // namespace Mana
@@ -0,0 +1,276 @@
+#pragma once
+
+#include <assert.h>
+#include <atomic>
+#include <new>
+#include <utility>
+#include <vector>
+#include "ManaGlobals.h"
+#include "concurrency/Mutex.h"
+#include "utils/StringTypes.h"
+
+namespace Mana {
+
+// Refers to an object in an ObjectPool: the low 20 bits are its slot index,
+// the high 12 bits the slot's generation, which changes every time the slot
+// is reused. So a handle to a deleted object finds nothing, instead of
+// whatever was created in its slot afterwards. 0 is never a valid handle.
+typedef U32 PoolHandle;
+
+const U32 POOL_HANDLE_INDEX_BITS = 20;
+const U32 POOL_HANDLE_INDEX_MASK = (1u << POOL_HANDLE_INDEX_BITS) - 1;
+
+inline U32 GetPoolHandleIndex(PoolHandle handle) {
+  return handle & POOL_HANDLE_INDEX_MASK;
+}
+
+// ObjectPoolCaches report their allocations and frees once per batch,
+// so while caches are in use the counts can lag a little.
+struct ObjectPoolStats {
+  const xchar* pName;
+  size_t objectSize;
+  size_t liveObjects;
+  size_t peakObjects;  // most slots out at once, cached ones included
+  size_t cachedSlots;  // free, but held by an ObjectPoolCache
+  size_t capacity;     // slots in all chunks
+  size_t chunks;
+  size_t emptyChunks;  // chunks with no live or cached objects
+  U64 allocations;
+  U64 frees;
+  U64 failedAllocations;  // the pool was at maxObjects
+};
+
+class ObjectPoolCache;
+
+// Untyped part of ObjectPool<T>, see below.
+class ObjectPoolBase {
+ public:
+  static const U32 MAX_OBJECTS = 1u << POOL_HANDLE_INDEX_BITS;
+  static const U32 DEFAULT_OBJECTS_PER_CHUNK = 64;
+
+  ObjectPoolBase(const xchar* name,
+                 size_t objectSize,
+                 size_t objectAlign,
+                 U32 objectsPerChunk,
+                 U32 maxObjects);
+  virtual ~ObjectPoolBase();
+
+  ObjectPoolBase(const ObjectPoolBase&) = delete;
+  ObjectPoolBase& operator=(const ObjectPoolBase&) = delete;
+
+  // Uninitialized storage for one object; nullptr if the pool is full.
+  // Release it with FreeStorage. Prefer ObjectPool<T>::New.
+  void* AllocateStorage();
+  void FreeStorage(void* pObject);
+
+  ObjectPoolStats GetStats() const;
+  void LogStats() const;
+
+  // debug reports over every pool that exists
+  static void GetAllStats(std::vector<ObjectPoolStats>& stats);
+  static void LogAllStats();
+
+ protected:
+  // nullptr if |handle| is stale or invalid
+  void* GetObject(PoolHandle handle) const;
+  // |pObject| must be live
+  PoolHandle GetObjectHandle(const void* pObject) const;
+  // Calls |pDestroy| on every live object (and frees it).
+  void DestroyLiveObjects(void (*pDestroy)(void* pObject));
+  // Calls |visit|(pObject) on every live object, chunk by chunk in slot
+  // order. Not locked, so no other thread may use the pool meanwhile.
+  // |visit| may delete the object; objects it creates may be visited.
+  template <typename Visit>
+  void ForEachLiveObject(Visit&& visit);
+
+ private:
+  static const U32 INVALID_INDEX = 0xFFFFFFFF;
+  static const U32 LIVE_BIT = 0x80000000;
+  static const U32 GENERATION_MASK = (1u << (32 - POOL_HANDLE_INDEX_BITS)) - 1;
+
+  // in front of each object
+  struct SlotHeader {
+    U32 index;
+    U32 nextFree;  // while on the free list
+    // generation, and LIVE_BIT while the object is live.
+    // Atomic, since Get may read a stale handle's slot
+    // while a cache reuses it without the lock.
+    std::atomic<U32> state;
+  };
+
+  // allocations and frees an ObjectPoolCache hasn't reported yet
+  struct PendingCounts {
+    U32 allocations = 0;
+    U32 frees = 0;
+  };
+
+  SlotHeader* GetHeader(U32 index) const;
+  SlotHeader* GetHeaderOf(const void* pObject) const {
+    return (SlotHeader*)((unsigned char*)pObject - headerSize_);
+  }
+  void* GetObjectOf(SlotHeader* pHeader) const {
+    return (unsigned char*)pHeader + headerSize_;
+  }
+
+  // Move slots between the free list and an ObjectPoolCache,
+  // adding its |pending| counts to the pool's.
+  size_t TakeFreeSlots(void** ppObjects, size_t count, PendingCounts& pending);
+  void ReturnFreeSlots(void* const* ppObjects,
+                       size_t count,
+                       PendingCounts& pending);
+  // lock_ must be held
+  size_t TakeFreeSlotsLocked(void** ppObjects, size_t count);
+  void ReturnFreeSlotsLocked(void* const* ppObjects, size_t count);
+  void AddPendingCountsLocked(PendingCounts& pending);
+  // bump the generation and mark live, or mark dead
+  void MarkLive(void* pObject);
+  void MarkFree(void* pObject);
+
+  xstring name_;
+  size_t objectSize_;
+  size_t align_;
+  size_t headerSize_;
+  size_t stride_;
+  U32 objectsPerChunk_;
+  U32 maxObjects_;
+
+  mutable Mutex lock_;
+  // chunks never move or shrink, so objects keep their address
+  std::vector<unsigned char*> chunks_;
+  std::vector<void*> rawChunks_;
+  std::vector<U32> chunkSlotsOut_;  // slots not on the free list
+  U32 numSlots_ = 0;                // slots carved out of chunks_ so far
+  U32 freeHead_ = INVALID_INDEX;
+  size_t slotsOut_ = 0;
+  size_t peakSlotsOut_ = 0;
+
+  U64 allocations_ = 0;
+  U64 frees_ = 0;
+  U64 failedAllocations_ = 0;
+
+  // every pool, for GetAllStats
+  ObjectPoolBase* pPrevPool_ = nullptr;
+  ObjectPoolBase* pNextPool_ = nullptr;
+
+  friend class ObjectPoolCache;
+};
+
+template <typename Visit>
+void ObjectPoolBase::ForEachLiveObject(Visit&& visit) {
+  for (U32 chunk = 0; chunk * objectsPerChunk_ < numSlots_; ++chunk) {
+    U32 slots = numSlots_ - chunk * objectsPerChunk_;
+    if (slots > objectsPerChunk_) {
+      slots = objectsPerChunk_;
+    }
+    unsigned char* pSlot = chunks_[chunk];
+    for (U32 i = 0; i < slots; ++i, pSlot += stride_) {
+      SlotHeader* pHeader = (SlotHeader*)pSlot;
+      if (pHeader->state.load(std::memory_order_relaxed) & LIVE_BIT) {
+        visit(GetObjectOf(pHeader));
+      }
+    }
+  }
+}
+
+// Fixed-size slots for objects of type T, carved out of chunks of
+// |objectsPerChunk| objects, so creating and deleting lots of them
+// reuses the same memory instead of fragmenting the heap.
+// Deleted slots go on a free list and are reused first.
+//
+// Objects can be referred to by pointer, or by PoolHandle when whoever
+// holds the reference may outlive the object (Get checks the generation).
+//
+// Thread-safe. Threads that create and delete a lot can use an
+// ObjectPoolCache to take the pool's lock once per batch instead.
+template <typename T>
+class ObjectPool : public ObjectPoolBase {
+ public:
+  explicit ObjectPool(const xchar* name,
+                      U32 objectsPerChunk = DEFAULT_OBJECTS_PER_CHUNK,
+                      U32 maxObjects = MAX_OBJECTS)
+      : ObjectPoolBase(name, sizeof(T), alignof(T), objectsPerChunk,
+                       maxObjects) {}
+  // deletes objects that are still live
+  ~ObjectPool() override {
+    DestroyLiveObjects([](void* pObject) { ((T*)pObject)->~T(); });
+  }
+
+  ObjectPool(const ObjectPool&) = delete;
+  ObjectPool& operator=(const ObjectPool&) = delete;
+
+  // Returns nullptr if the pool is full.
+  template <typename... Args>
+  T* New(Args&&... args) {
+    void* pStorage = AllocateStorage();
+    return pStorage ? new (pStorage) T(std::forward<Args>(args)...) : nullptr;
+  }
+  template <typename... Args>
+  T* New(ObjectPoolCache& cache, Args&&... args);
+
+  void Delete(T* pObject) {
+    if (pObject) {
+      pObject->~T();
+      FreeStorage(pObject);
+    }
+  }
+  void Delete(ObjectPoolCache& cache, T* pObject);
+
+  // nullptr if the object was deleted
+  T* Get(PoolHandle handle) const { return (T*)GetObject(handle); }
+  PoolHandle GetHandle(const T* pObject) const {
+    return GetObjectHandle(pObject);
+  }
+
+  // Calls |func|(T&) on every live object, see ForEachLiveObject.
+  template <typename Func>
+  void ForEach(Func&& func) {
+    ForEachLiveObject([&func](void* pObject) { func(*(T*)pObject); });
+  }
+};
+
+// A few free slots of one pool, owned by one thread,
+// so that thread only takes the pool's lock once per BATCH allocations.
+// Must not outlive the pool. Gives its slots back when destroyed.
+class ObjectPoolCache {
+ public:
+  static const U32 CAPACITY = 32;
+  static const U32 BATCH = CAPACITY / 2;
+
+  explicit ObjectPoolCache(ObjectPoolBase& pool) : pool_(pool) {}
+  virtual ~ObjectPoolCache() { Flush(); }
+
+  ObjectPoolCache(const ObjectPoolCache&) = delete;
+  ObjectPoolCache& operator=(const ObjectPoolCache&) = delete;
+
+  void* AllocateStorage();
+  void FreeStorage(void* pObject);
+  // gives every cached slot back to the pool
+  void Flush();
+
+  ObjectPoolBase& GetPool() { return pool_; }
+
+ private:
+  ObjectPoolBase& pool_;
+  void* slots_[CAPACITY];
+  U32 count_ = 0;
+  ObjectPoolBase::PendingCounts pending_;
+};
+
+template <typename T>
+template <typename... Args>
+T* ObjectPool<T>::New(ObjectPoolCache& cache, Args&&... args) {
+  assert(&cache.GetPool() == this && "cache is for another pool");
+  void* pStorage = cache.AllocateStorage();
+  return pStorage ? new (pStorage) T(std::forward<Args>(args)...) : nullptr;
+}
+
+template <typename T>
+void ObjectPool<T>::Delete(ObjectPoolCache& cache, T* pObject) {
+  assert(&cache.GetPool() == this && "cache is for another pool");
+  if (pObject) {
+    pObject->~T();
+    cache.FreeStorage(pObject);
+  }
+}
+
+}  // namespace Mana
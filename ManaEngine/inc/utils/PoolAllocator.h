@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdio>
+#include <new>
+#include "ManaGlobals.h"
+#include "utils/ObjectPool.h"
+#include "utils/Strings.h"
+
+namespace Mana {
+
+// STL allocator that takes single objects from a pool shared by every
+// PoolAllocator of the same type, through a per-thread ObjectPoolCache.
+// Good for node based containers and std::allocate_shared, which allocate
+// one node / control block at a time:
+//
+//   std::list<Foo, PoolAllocator<Foo>> foos;
+//   auto pBar = std::allocate_shared<Bar>(PoolAllocator<Bar>());
+//
+// Arrays (count > 1) go to the heap.
+template <typename T>
+class PoolAllocator {
+ public:
+  typedef T value_type;
+
+  PoolAllocator() noexcept = default;
+  template <typename U>
+  PoolAllocator(const PoolAllocator<U>&) noexcept {}
+
+  T* allocate(size_t count) {
+    if (count != 1) {
+      if (count > (size_t)-1 / sizeof(T)) {
+        throw std::bad_array_new_length();
+      }
+      return (T*)::operator new(count * sizeof(T));
+    }
+
+    ObjectPoolCache* pCache = GetCache();
+    void* p = pCache ? pCache->AllocateStorage() : GetPool().AllocateStorage();
+    if (!p) {
+      throw std::bad_alloc();
+    }
+    return (T*)p;
+  }
+
+  void deallocate(T* p, size_t count) noexcept {
+    if (count != 1) {
+      ::operator delete(p);
+    } else if (ObjectPoolCache* pCache = GetCache()) {
+      pCache->FreeStorage(p);
+    } else {
+      GetPool().FreeStorage(p);
+    }
+  }
+
+ private:
+  struct alignas(T) Storage {
+    unsigned char bytes[sizeof(T)];
+  };
+
+  static ObjectPool<Storage>& GetPool() {
+    // never deleted, since containers in other globals
+    // may still free into it while globals are destroyed
+    static ObjectPool<Storage>* pPool =
+        new ObjectPool<Storage>(GetPoolName().c_str());
+    return *pPool;
+  }
+
+  // e.g. "PoolAllocator<48 bytes>", so each type's pool shows up on its
+  // own in the pool stats and leak reports
+  static xstring GetPoolName() {
+    char name[48];
+    snprintf(name, sizeof(name), "PoolAllocator<%zu bytes>", sizeof(T));
+    return Utf8ToXString(name);
+  }
+
+  class ThreadCache : public ObjectPoolCache {
+   public:
+    // qualified, since ObjectPoolCache::GetPool would hide it here
+    ThreadCache() : ObjectPoolCache(PoolAllocator::GetPool()) {}
+    ~ThreadCache() override { bCacheDestroyed_ = true; }
+  };
+
+  // Containers in globals can free after the main thread's thread_locals
+  // are destroyed, so they go straight to the pool then.
+  static inline thread_local bool bCacheDestroyed_ = false;
+
+  // nullptr once the thread is exiting
+  static ObjectPoolCache* GetCache() {
+    if (bCacheDestroyed_) {
+      return nullptr;
+    }
+    thread_local ThreadCache cache;
+    return &cache;
+  }
+};
+
+template <typename T, typename U>
+bool operator==(const PoolAllocator<T>&, const PoolAllocator<U>&) {
+  return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const PoolAllocator<T>&, const PoolAllocator<U>&) {
+  return false;
+}
+
+}  // namespace Mana
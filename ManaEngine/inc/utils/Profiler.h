@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include "ManaGlobals.h"
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define MANA_PROFILER_RDTSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define MANA_PROFILER_RDTSC 1
+#endif
+
+namespace Mana {
+
+// A CPU profiler for the MANA_PROFILE_ macros below.
+//
+// Zones are only recorded during a capture (ProfilerBeginCapture to
+// ProfilerEndCapture). Each thread records into its own buffer, with no
+// lock, so outside a capture a zone costs one relaxed atomic load, and
+// during one, two clock reads and a store. Zones are scopes, so they nest
+// by construction: the trace viewer rebuilds the hierarchy from the begin
+// and end times. ProfilerEndCapture writes a Chrome trace, which
+// chrome://tracing and https://ui.perfetto.dev open.
+//
+// Zone names must be string literals (or otherwise outlive the capture),
+// since only the pointer is kept.
+
+// clock ticks: the TSC where there is one, otherwise steady_clock
+// (rdtsc assumes an invariant TSC, which every x64 CPU we support has)
+inline U64 ProfilerNow() {
+#ifdef MANA_PROFILER_RDTSC
+  return __rdtsc();
+#else
+  return (U64)std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+// odd while capturing, bumped by every ProfilerBeginCapture/EndCapture
+extern std::atomic<U32> g_profilerGeneration;
+
+// Starts recording zones on every thread.
+// Returns false if a capture is already running.
+bool ProfilerBeginCapture();
+// Stops recording and writes what was captured to |traceFile| as Chrome
+// trace JSON. Returns false if there was no capture or the file couldn't
+// be written.
+bool ProfilerEndCapture(const xchar* traceFile);
+bool IsProfilerCapturing();
+
+// Names the calling thread in the trace (copied, so it can be temporary).
+void ProfilerSetThreadName(const char* name);
+// Marks the start of a frame on the calling thread.
+void ProfilerFrameMark();
+
+struct ProfilerStats {
+  U64 zones;         // recorded in the last capture
+  U64 zonesDropped;  // a thread's buffer was full
+  U64 frames;
+  U32 threads;
+};
+
+// the last capture's stats, valid after ProfilerEndCapture
+ProfilerStats GetProfilerStats();
+
+// records a finished zone, if the capture it started in is still running
+void ProfilerEndZone(const char* name, U64 begin, U32 generation);
+
+// Use MANA_PROFILE_SCOPE instead.
+class ScopedProfileZone {
+ public:
+  explicit ScopedProfileZone(const char* name)
+      : name_(name),
+        generation_(g_profilerGeneration.load(std::memory_order_relaxed)) {
+    if (generation_ & 1) {
+      begin_ = ProfilerNow();
+    }
+  }
+
+  ~ScopedProfileZone() {
+    if (generation_ & 1) {
+      ProfilerEndZone(name_, begin_, generation_);
+    }
+  }
+
+  ScopedProfileZone(const ScopedProfileZone&) = delete;
+  ScopedProfileZone& operator=(const ScopedProfileZone&) = delete;
+
+ private:
+  const char* name_;
+  U32 generation_;
+  U64 begin_ = 0;
+};
+
+}  // namespace Mana
+
+#ifdef MANA_PROFILING_ENABLED
+
+#define MANA_PROFILE_CONCAT_INNER(a, b) a##b
+#define MANA_PROFILE_CONCAT(a, b) MANA_PROFILE_CONCAT_INNER(a, b)
+
+// Times the rest of the enclosing scope, e.g.
+//   MANA_PROFILE_SCOPE("AudioWin::ProcessAudioThreadWork");
+#define MANA_PROFILE_SCOPE(name)                                    \
+  ::Mana::ScopedProfileZone MANA_PROFILE_CONCAT(manaProfileZone,    \
+                                                __LINE__)(name)
+#define MANA_PROFILE_FRAME() ::Mana::ProfilerFrameMark()
+#define MANA_PROFILE_THREAD_NAME(name) ::Mana::ProfilerSetThreadName(name)
+
+#else
+
+#define MANA_PROFILE_SCOPE(name)
+#define MANA_PROFILE_FRAME()
+#define MANA_PROFILE_THREAD_NAME(name)
+
+#endif
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "ManaGlobals.h"
+#include "utils/LinearArena.h"
+
+namespace Mana {
+
+// A LinearArena that can also free back to a marker,
+// for nested scratch allocations. Allocations must be freed in the
+// reverse order they were made, so it's usually used through
+// ScopedStackMarker:
+//
+//   ScopedStackMarker scope(stack);
+//   float* pWeights = stack.AllocateArray<float>(count);
+//   ...  // freed when |scope| goes out of scope
+class StackAllocator : public LinearArena {
+ public:
+  typedef size_t Marker;
+
+  StackAllocator() = default;
+  ~StackAllocator() override = default;
+
+  StackAllocator(const StackAllocator&) = delete;
+  StackAllocator& operator=(const StackAllocator&) = delete;
+
+  Marker GetMarker() const { return offset_; }
+  // Frees everything allocated since |marker| was taken.
+  void FreeToMarker(Marker marker) { Rewind(marker); }
+};
+
+// Frees everything allocated from |stack| during its lifetime.
+class ScopedStackMarker {
+ public:
+  explicit ScopedStackMarker(StackAllocator& stack)
+      : stack_(stack), marker_(stack.GetMarker()) {}
+  ~ScopedStackMarker() { stack_.FreeToMarker(marker_); }
+
+  ScopedStackMarker(const ScopedStackMarker&) = delete;
+  ScopedStackMarker& operator=(const ScopedStackMarker&) = delete;
+
+ private:
+  StackAllocator& stack_;
+  StackAllocator::Marker marker_;
+};
+
+}  // namespace Mana
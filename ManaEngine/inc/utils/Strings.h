@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include "utils/StringTypes.h"
 
 namespace Mana {
 
@@ -11,4 +12,13 @@ namespace Mana {
 std::string Utf16ToUtf8(std::wstring wide);
 std::wstring Utf8ToUtf16(std::string utf8);
 
+// e.g. a command line value, to open a file with
+inline xstring Utf8ToXString(const std::string& utf8) {
+#ifdef OS_WIN
+  return Utf8ToUtf16(utf8);
+#else
+  return utf8;
+#endif
+}
+
 }  // namespace Mana
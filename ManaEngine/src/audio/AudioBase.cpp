@@ -1,68 +1,86 @@
 #include "pch.h"
 #include "audio/AudioBase.h"
 
+#include <assert.h>
+
 namespace Mana {
 
+AudioBase* g_pAudioEngine = nullptr;
+
 void AudioBase::StopAll() {
-  for (const auto& pair : fileMap_) {
-    Stop(pair.first);
+  for (AudioFileBase* pFile : fileMap_) {
+    if (pFile) {
+      Stop(pFile->audioFileHandle_);
+    }
   }
 }
 
 void AudioBase::PauseAll() {
-  for (const auto& pair : fileMap_) {
-    Pause(pair.first);
+  for (AudioFileBase* pFile : fileMap_) {
+    if (pFile) {
+      Pause(pFile->audioFileHandle_);
+    }
   }
 }
 
 void AudioBase::ResumeAll() {
-  for (const auto& pair : fileMap_) {
-    Resume(pair.first);
+  for (AudioFileBase* pFile : fileMap_) {
+    if (pFile) {
+      Resume(pFile->audioFileHandle_);
+    }
   }
 }
 
-AudioFileHandle AudioBase::GetNextFreeAudioFileHandle() {
-  AudioFileHandle next = lastAudioFileHandle_ + 1;
-  if (next > MAX_SOUNDS_LOADED)
-    next = 1;  // wrap around
-
-  // make sure next value isn't in use
-  bool firstPass = true;
-  while (true) {
-    if (fileMap_.find(next) == fileMap_.end())
-      break;
-
-    next++;
-    if (next > MAX_SOUNDS_LOADED) {
-      if (!firstPass) {
-        return 0;  // too many sounds loaded.
-      }
-
-      firstPass = false;
-      next = 1;
-    }
-  }
+void AudioBase::AddAudioFile(AudioFileBase* pAudioFile,
+                             AudioFileHandle audioFileHandle) {
+  U32 index = GetPoolHandleIndex((PoolHandle)audioFileHandle);
+  assert(index < fileMap_.size() && "file pool is bigger than fileMap_");
+
+  ScopedMutex lock(fileMapLock_);
+  assert(!fileMap_[index] && "file pool reused a loaded file's slot");
+  pAudioFile->audioFileHandle_ = audioFileHandle;
+  fileMap_[index] = pAudioFile;
+}
+
+void AudioBase::RemoveAudioFile(AudioFileHandle audioFileHandle) {
+  U32 index = GetPoolHandleIndex((PoolHandle)audioFileHandle);
 
-  lastAudioFileHandle_ = next;
-  return next;
+  ScopedMutex lock(fileMapLock_);
+  if (index < fileMap_.size() && fileMap_[index] &&
+      fileMap_[index]->audioFileHandle_ == audioFileHandle) {
+    fileMap_[index] = nullptr;
+  }
 }
 
 void AudioBase::GetStreamingFiles() {
+  ScopedMutex lock(fileMapLock_);
   streamingFiles_.clear();
-  for (auto const& item : fileMap_) {
-    if (item.second->loadType_ == AudioLoadType::Streaming) {
-      streamingFiles_.push_back(item.second);
+  for (AudioFileBase* pFile : fileMap_) {
+    if (pFile && pFile->loadType_ == AudioLoadType::Streaming) {
+      streamingFiles_.push_back(pFile);
     }
   }
 }
 
 AudioFileBase* AudioBase::GetAudioFile(AudioFileHandle audioFileHandle) {
-  auto search = fileMap_.find(audioFileHandle);
-  if (search == fileMap_.end()) {
+  ScopedMutex lock(fileMapLock_);
+  return GetAudioFile_NoLock(audioFileHandle);
+}
+
+AudioFileBase* AudioBase::GetAudioFile_NoLock(
+    AudioFileHandle audioFileHandle) {
+  U32 index = GetPoolHandleIndex((PoolHandle)audioFileHandle);
+  if (index >= fileMap_.size()) {
+    return nullptr;
+  }
+
+  // null if unloaded, or if the slot now holds a newer file
+  AudioFileBase* pFile = fileMap_[index];
+  if (!pFile || pFile->audioFileHandle_ != audioFileHandle) {
     return nullptr;
   }
 
-  return search->second;
+  return pFile;
 }
 
 }  // namespace Mana
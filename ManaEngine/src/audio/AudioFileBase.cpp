@@ -1,5 +1,9 @@
 #include "pch.h"
 #include "audio/AudioFileBase.h"
+#include <assert.h>
+#include "audio/PcmCache.h"
+#include "utils/MappedFile.h"
+#include "utils/MemoryTracker.h"
 
 namespace Mana {
 
@@ -19,14 +23,54 @@ AudioFileBase::AudioFileBase()
       currentTotalPcmPos_(0),
       lastBufferPlaying_(false),
       loopCount_(0),
-      loopBackPcmSamplePos_(0) {
+      loopBackPcmSamplePos_(0),
+      pPcmCache_(nullptr),
+      pCachedPcm_(nullptr) {
 }
 
 AudioFileBase::~AudioFileBase() {
+  if (pCachedPcm_) {
+    // other files may share it, so give it back instead of deleting it
+    pPcmCache_->Release(pCachedPcm_);
+    pCachedPcm_ = nullptr;
+    pDataBuffer_ = nullptr;
+  }
+
   if (pDataBuffer_) {
-    delete[] pDataBuffer_;
+    TaggedDeleteArray(pDataBuffer_);
     pDataBuffer_ = nullptr;
   }
 }
 
+bool AudioFileBase::Load(const xstring& strFilePath) {
+  MappedFile* pFile = new MappedFile();
+  if (!pFile->Open(strFilePath.c_str(), MemoryTag::Audio)) {
+    ManaLogLnError(Channel::Sound, _X("AudioFileBase: can't read %s"),
+                   strFilePath.c_str());
+    delete pFile;
+    return false;
+  }
+  return LoadFromMemory(pFile);
+}
+
+void AudioFileBase::UseCachedPcm(PcmBuffer* pCachedPcm) {
+  assert(!pDataBuffer_ && "UseCachedPcm would leak pDataBuffer_");
+  pCachedPcm_ = pCachedPcm;
+  pDataBuffer_ = pCachedPcm->pData;
+  dataBufferSize_ = pCachedPcm->size;
+}
+
+void AudioFileBase::CachePcm(U64 contentHash, const PcmFormat& format) {
+  if (!pPcmCache_ || !pDataBuffer_ || pCachedPcm_) {
+    return;
+  }
+
+  // the cache owns the buffer from here on, and may hand back
+  // another loader's copy of the same file
+  PcmBuffer* pCachedPcm = pPcmCache_->Insert(contentHash, filePath_, format,
+                                             pDataBuffer_, dataBufferSize_);
+  pDataBuffer_ = nullptr;
+  UseCachedPcm(pCachedPcm);
+}
+
 }  // namespace Mana
@@ -0,0 +1,271 @@
+#include "pch.h"
+#include "audio/AudioFileMixer.h"
+
+#include <memory>
+#include <string.h>
+#include "audio/PcmCache.h"
+#include "utils/Hash.h"
+#include "utils/MappedFile.h"
+#include "utils/MemoryTracker.h"
+
+// libvorbisfile is always available on Windows (see AudioFileOggWin.cpp).
+// Elsewhere, define MANA_HAS_VORBIS when building against it.
+#if defined(OS_WIN) || defined(MANA_HAS_VORBIS)
+#define MANA_MIXER_OGG
+#include <vorbis/codec.h>
+#include <vorbis/vorbisfile.h>
+#endif
+
+namespace Mana {
+
+AudioFileMixer::AudioFileMixer()
+    : channels_(0),
+      sampleRate_(0),
+      totalFrames_(0),
+      volume_(1.0f),
+      isPanned_(false),
+      voicePos_(0) {}
+
+AudioFileMixer::~AudioFileMixer() {
+  Unload();
+}
+
+bool AudioFileMixer::LoadFromMemory(MappedFile* pFile) {
+  // decoded right away, so the bytes are freed on return
+  std::unique_ptr<MappedFile> file(pFile);
+  fileSize_ = file->GetFileSize();
+
+  // the mixer decodes everything up front, so every file is worth caching
+  U64 contentHash = 0;
+  if (pPcmCache_) {
+    contentHash = HashBytes64(file->GetBuffer(), fileSize_);
+    PcmBuffer* pCachedPcm = pPcmCache_->Acquire(contentHash);
+    if (pCachedPcm) {
+      UseCachedPcm(pCachedPcm);
+      channels_ = pCachedPcm->format.channels;
+      sampleRate_ = pCachedPcm->format.sampleRate;
+      totalFrames_ = dataBufferSize_ / (channels_ * sizeof(I16));
+      loadType_ = AudioLoadType::Static;
+      totalPcmBytes_ = dataBufferSize_;
+      return true;
+    }
+  }
+
+  bool loaded = false;
+  if (format_ == AudioFormat::Wav) {
+    loaded = LoadWav(file->GetBuffer(), fileSize_);
+  } else if (format_ == AudioFormat::Ogg) {
+    loaded = LoadOgg(file->GetBuffer(), fileSize_);
+  }
+
+  if (!loaded) {
+    ManaLogLnError(Channel::Sound, _X("AudioFileMixer: can't decode %s"),
+                   filePath_.c_str());
+    return false;
+  }
+
+  PcmFormat format = {channels_, sampleRate_, 16};
+  CachePcm(contentHash, format);
+
+  // the mixer never streams
+  loadType_ = AudioLoadType::Static;
+  totalPcmBytes_ = dataBufferSize_;
+  return true;
+}
+
+void AudioFileMixer::Unload() {
+  // nothing beyond the pcm buffer, which AudioFileBase frees
+}
+
+bool AudioFileMixer::StreamSeek(int64_t pcmSamples) {
+  if (voices_.empty() || pcmSamples < 0 ||
+      (size_t)pcmSamples >= totalFrames_) {
+    return false;
+  }
+
+  voices_[0].frameCursor = (size_t)pcmSamples;
+  currentTotalPcmPos_ = (size_t)pcmSamples * channels_ * sizeof(I16);
+  return true;
+}
+
+static U32 ReadU32(const U8* p) {
+  return (U32)p[0] | ((U32)p[1] << 8) | ((U32)p[2] << 16) | ((U32)p[3] << 24);
+}
+
+static U16 ReadU16(const U8* p) {
+  return (U16)(p[0] | (p[1] << 8));
+}
+
+bool AudioFileMixer::LoadWav(const U8* pData, size_t size) {
+  if (size < 12 || memcmp(pData, "RIFF", 4) != 0 ||
+      memcmp(pData + 8, "WAVE", 4) != 0) {
+    return false;
+  }
+
+  const U8* pPcm = nullptr;
+  size_t pcmBytes = 0;
+  U16 bitsPerSample = 0;
+
+  // walk the chunks, looking for "fmt " and "data"
+  size_t pos = 12;
+  while (pos + 8 <= size) {
+    const U8* pChunk = pData + pos;
+    size_t chunkBytes = ReadU32(pChunk + 4);
+    const U8* pChunkData = pChunk + 8;
+    size_t available = size - pos - 8;
+    if (chunkBytes > available) {
+      chunkBytes = available;
+    }
+
+    if (memcmp(pChunk, "fmt ", 4) == 0 && chunkBytes >= 16) {
+      U16 formatTag = ReadU16(pChunkData);
+      if (formatTag != 1) {  // WAVE_FORMAT_PCM
+        return false;
+      }
+      channels_ = ReadU16(pChunkData + 2);
+      sampleRate_ = ReadU32(pChunkData + 4);
+      bitsPerSample = ReadU16(pChunkData + 14);
+    } else if (memcmp(pChunk, "data", 4) == 0) {
+      pPcm = pChunkData;
+      pcmBytes = chunkBytes;
+    }
+
+    // chunks are padded to an even size
+    pos += 8 + chunkBytes + (chunkBytes & 1);
+  }
+
+  if (!pPcm || bitsPerSample != 16 || channels_ < 1 || channels_ > 2) {
+    return false;
+  }
+
+  size_t frameBytes = channels_ * sizeof(I16);
+  totalFrames_ = pcmBytes / frameBytes;
+  if (totalFrames_ == 0) {
+    return false;
+  }
+
+  dataBufferSize_ = totalFrames_ * frameBytes;
+  // loads run on job workers, so running out fails the load, not the game
+  pDataBuffer_ = (uint8_t*)TaggedMalloc(MemoryTag::Audio, dataBufferSize_);
+  if (!pDataBuffer_) {
+    return false;
+  }
+  memcpy(pDataBuffer_, pPcm, dataBufferSize_);
+  return true;
+}
+
+#ifdef MANA_MIXER_OGG
+
+// in-memory stream for ov_open_callbacks
+struct OggMemoryReader {
+  const U8* pData;
+  size_t size;
+  size_t pos;
+};
+
+static size_t OggMemoryRead(void* pDest,
+                            size_t byteSize,
+                            size_t count,
+                            void* dataSource) {
+  OggMemoryReader* pReader = static_cast<OggMemoryReader*>(dataSource);
+  size_t bytes = byteSize * count;
+  size_t bytesToEOF = pReader->size - pReader->pos;
+  if (bytes > bytesToEOF) {
+    bytes = bytesToEOF;
+  }
+
+  memcpy(pDest, pReader->pData + pReader->pos, bytes);
+  pReader->pos += bytes;
+  return bytes;
+}
+
+static int OggMemorySeek(void* dataSource, ogg_int64_t offset, int origin) {
+  OggMemoryReader* pReader = static_cast<OggMemoryReader*>(dataSource);
+  ogg_int64_t pos;
+  switch (origin) {
+    case SEEK_SET:
+      pos = offset;
+      break;
+    case SEEK_CUR:
+      pos = (ogg_int64_t)pReader->pos + offset;
+      break;
+    case SEEK_END:
+      pos = (ogg_int64_t)pReader->size + offset;
+      break;
+    default:
+      return -1;
+  }
+
+  if (pos < 0 || pos > (ogg_int64_t)pReader->size) {
+    return -1;
+  }
+
+  pReader->pos = (size_t)pos;
+  return 0;
+}
+
+static long OggMemoryTell(void* dataSource) {
+  return (long)static_cast<OggMemoryReader*>(dataSource)->pos;
+}
+
+bool AudioFileMixer::LoadOgg(const U8* pData, size_t size) {
+  OggMemoryReader reader = {pData, size, 0};
+
+  ov_callbacks callbacks;
+  callbacks.read_func = OggMemoryRead;
+  callbacks.seek_func = OggMemorySeek;
+  callbacks.close_func = nullptr;
+  callbacks.tell_func = OggMemoryTell;
+
+  OggVorbis_File vorbisFile;
+  if (::ov_open_callbacks(&reader, &vorbisFile, nullptr, 0, callbacks) < 0) {
+    return false;
+  }
+
+  vorbis_info* vi = ::ov_info(&vorbisFile, -1);
+  ogg_int64_t pcmFrames = ::ov_pcm_total(&vorbisFile, -1);
+  if (!vi || vi->channels < 1 || vi->channels > 2 || pcmFrames <= 0) {
+    ::ov_clear(&vorbisFile);
+    return false;
+  }
+
+  channels_ = (U32)vi->channels;
+  sampleRate_ = (U32)vi->rate;
+
+  size_t capacity = (size_t)pcmFrames * channels_ * sizeof(I16);
+  pDataBuffer_ = (uint8_t*)TaggedMalloc(MemoryTag::Audio, capacity);
+  if (!pDataBuffer_) {
+    ::ov_clear(&vorbisFile);
+    return false;
+  }
+
+  size_t bytesRead = 0;
+  int bitstream = 0;
+  while (bytesRead < capacity) {
+    // little endian, 16 bit, signed
+    long read = ::ov_read(&vorbisFile, (char*)&pDataBuffer_[bytesRead],
+                          (int)(capacity - bytesRead), 0, 2, 1, &bitstream);
+    if (read <= 0) {
+      break;
+    }
+    bytesRead += (size_t)read;
+  }
+
+  ::ov_clear(&vorbisFile);
+
+  totalFrames_ = bytesRead / (channels_ * sizeof(I16));
+  dataBufferSize_ = totalFrames_ * channels_ * sizeof(I16);
+  return totalFrames_ > 0;
+}
+
+#else
+
+bool AudioFileMixer::LoadOgg(const U8* /*pData*/, size_t /*size*/) {
+  ManaLogLnError(Channel::Sound,
+                 _X("AudioFileMixer: built without ogg vorbis support"));
+  return false;
+}
+
+#endif  // #ifdef MANA_MIXER_OGG
+
+}  // namespace Mana
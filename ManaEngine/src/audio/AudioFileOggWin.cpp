@@ -3,6 +3,9 @@
 #include <cerrno>
 #include "audio/AudioBase.h"
 #include "audio/AudioFileOggWin.h"
+#include "audio/PcmCache.h"
+#include "utils/Hash.h"
+#include "utils/MemoryTracker.h"
 
 // These are dynamic (not static) libs,
 // so dlls are required at runtime.
@@ -24,19 +27,11 @@ AudioFileOggWin::~AudioFileOggWin() {
   Unload();
 }
 
-bool AudioFileOggWin::Load(const xstring& strFilePath) {
-  // Load entire ogg file into memory.
-  // At runtime, we'll decode from memory.
-  pCompressedOggFile_ = new File();
-  if (!pCompressedOggFile_) {
-    return false;
-  }
-  fileSize_ = pCompressedOggFile_->ReadAllBytes(strFilePath.c_str());
-  if (fileSize_ == 0) {
-    delete pCompressedOggFile_;
-    pCompressedOggFile_ = nullptr;
-    return false;
-  }
+bool AudioFileOggWin::LoadFromMemory(MappedFile* pFile) {
+  // Keep the entire ogg file in memory (usually mapped, see Load).
+  // At runtime, we'll decode straight from it.
+  pCompressedOggFile_ = pFile;
+  fileSize_ = pCompressedOggFile_->GetFileSize();
 
   ov_callbacks oggCallbacks;
   oggCallbacks.read_func = OggVorbisRead;
@@ -116,9 +111,23 @@ bool AudioFileOggWin::Load(const xstring& strFilePath) {
   if (totalPcmBytes_ <= AudioStreamBufCount * AudioStreamBufSize) {
     loadType_ = AudioLoadType::Static;
 
+    // Skip decoding if this file's pcm is already cached.
+    // Only static files are hashed, since streaming files are large
+    // and never cached.
+    U64 contentHash = 0;
+    if (pPcmCache_) {
+      contentHash = HashBytes64(pCompressedOggFile_->GetBuffer(), fileSize_);
+      PcmBuffer* pCachedPcm = pPcmCache_->Acquire(contentHash);
+      if (pCachedPcm) {
+        UseCachedPcm(pCachedPcm);
+        Unload();
+        return true;
+      }
+    }
+
     // decode all pcm data into memory
 
-    pDataBuffer_ = new uint8_t[totalPcmBytes_];
+    pDataBuffer_ = TaggedNewArray<uint8_t>(MemoryTag::Audio, totalPcmBytes_);
     dataBufferSize_ = totalPcmBytes_;
 
     int bytesPerSample = wfx_.Format.wBitsPerSample / 8;
@@ -143,6 +152,10 @@ bool AudioFileOggWin::Load(const xstring& strFilePath) {
       currentBytesRead += actualBytesRead;
     }
 
+    PcmFormat format = {wfx_.Format.nChannels, wfx_.Format.nSamplesPerSec,
+                        wfx_.Format.wBitsPerSample};
+    CachePcm(contentHash, format);
+
     // don't need OggVorbis lib or compressed file data anymore
     Unload();
 
@@ -156,7 +169,8 @@ bool AudioFileOggWin::Load(const xstring& strFilePath) {
                          (AudioStreamBufCount * AudioStreamBufSize)) &&
            "loopBackPcmSamplePos_ cannot be so close to the end of the file");
 
-    pDataBuffer_ = new uint8_t[AudioStreamBufSize * AudioStreamBufCount];
+    pDataBuffer_ = TaggedNewArray<uint8_t>(
+        MemoryTag::Audio, AudioStreamBufSize * AudioStreamBufCount);
 
     //OutputDebugStringW(
     //    (std::wstring(L"Ogg Loaded for streaming: ") + strFilePath + L"\n")
@@ -216,8 +230,9 @@ size_t OggVorbisRead(void* pDestData,
   }
 
   if (actualSizeToRead) {
+    // the only copy: ov_callbacks reads into vorbisfile's own buffer
     ::memcpy(pDestData,
-             (char*)pOggFile->pCompressedOggFile_->GetBuffer() +
+             (const char*)pOggFile->pCompressedOggFile_->GetBuffer() +
                  pOggFile->dataReadSoFar_,
              actualSizeToRead);
 
@@ -0,0 +1,454 @@
+#include "pch.h"
+#include "audio/AudioMixer.h"
+
+#include <assert.h>
+#include <algorithm>
+#include <memory>
+#include "audio/AudioMixerKernels.h"
+#include "utils/MappedFile.h"
+#include "utils/Profiler.h"
+
+namespace Mana {
+
+[[maybe_unused]] static const xchar* GetMixKernelLevelString(MixKernelLevel level) {
+  switch (level) {
+    case MixKernelLevel::AVX2:
+      return _X("AVX2");
+    case MixKernelLevel::SSE2:
+      return _X("SSE2");
+    default:
+      return _X("scalar");
+  }
+}
+
+AudioMixer::AudioMixer(AudioSinkBase* pSink,
+                       U32 sampleRate,
+                       U32 microsecPerUpdate)
+    : pSink_(pSink),
+      sampleRate_(sampleRate),
+      microsecPerUpdate_(microsecPerUpdate),
+      frameRemainder_(0),
+      masterVolume_(1.0f),
+      bInitialized_(false),
+      filePool_(_X("AudioFileMixer"), 16, MAX_SOUNDS_LOADED) {
+  for (size_t i = 0; i < NUM_CATEGORIES; ++i) {
+    categoryVolumes_[i] = 1.0f;
+  }
+}
+
+bool AudioMixer::Init() {
+  if (bInitialized_ || !pSink_ || sampleRate_ == 0) {
+    return false;
+  }
+
+  if (!pSink_->Open(sampleRate_, OUTPUT_CHANNELS)) {
+    return false;
+  }
+
+  frameRemainder_ = 0;
+
+  // size the bus for a normal update up front, so Update doesn't allocate
+  size_t framesPerUpdate =
+      (size_t)(((U64)sampleRate_ * microsecPerUpdate_) / 1000000) + 1;
+  bus_.resize(framesPerUpdate * OUTPUT_CHANNELS);
+
+  bInitialized_ = true;
+
+  ManaLogLnInfo(Channel::Sound, _X("AudioMixer: %u Hz, %s kernels"),
+                sampleRate_, GetMixKernelLevelString(GetMixKernelLevel()));
+  return true;
+}
+
+void AudioMixer::Uninit() {
+  if (!bInitialized_) {
+    return;
+  }
+
+  // Unload removes from fileMap_, so collect the handles first
+  std::vector<AudioFileHandle> fileHandleList;
+  {
+    ScopedMutex lock(fileMapLock_);
+    for (AudioFileBase* pFile : fileMap_) {
+      if (pFile) {
+        fileHandleList.push_back(pFile->audioFileHandle_);
+      }
+    }
+  }
+
+  for (AudioFileHandle audioFileHandle : fileHandleList) {
+    Unload(audioFileHandle);
+  }
+
+  pSink_->Close();
+  bInitialized_ = false;
+}
+
+AudioFileHandle AudioMixer::LoadFile(const xstring& filePath,
+                                     MappedFile* pMemory,
+                                     AudioCategory category,
+                                     AudioFormat format,
+                                     int64_t loopBackPcmSamplePos,
+                                     int simultaneousSounds) {
+  std::unique_ptr<MappedFile> memory(pMemory);
+  if (simultaneousSounds < 1)
+    return 0;
+
+  AudioFileMixer* pFile = filePool_.New();
+  if (!pFile) {
+    ManaLogLnError(Channel::Sound, _X("AudioMixer: too many sounds loaded"));
+    return 0;
+  }
+
+  pFile->filePath_ = filePath;
+  pFile->category_ = category;
+  pFile->format_ = format;
+  pFile->loopBackPcmSamplePos_ = loopBackPcmSamplePos;
+  pFile->pPcmCache_ = &pcmCache_;
+
+  bool loaded = memory ? pFile->LoadFromMemory(memory.release())
+                       : pFile->Load(filePath);
+  if (!loaded) {
+    filePool_.Delete(pFile);
+    return 0;
+  }
+
+  if (pFile->sampleRate_ != sampleRate_) {
+    ManaLogLnError(Channel::Sound,
+                   _X("AudioMixer: %s is %u Hz, but the mixer is %u Hz"),
+                   filePath.c_str(), pFile->sampleRate_, sampleRate_);
+    filePool_.Delete(pFile);
+    return 0;
+  }
+
+  if (loopBackPcmSamplePos < 0 ||
+      (size_t)loopBackPcmSamplePos >= pFile->totalFrames_) {
+    ManaLogLnError(Channel::Sound,
+                   _X("AudioMixer: loopBackPcmSamplePos is past the end of %s"),
+                   filePath.c_str());
+    filePool_.Delete(pFile);
+    return 0;
+  }
+
+  // must be fully set up before it's added, since Update may be mixing
+  pFile->voices_.resize(simultaneousSounds);
+
+  AudioFileHandle audioFileHandle = filePool_.GetHandle(pFile);
+  AddAudioFile(pFile, audioFileHandle);
+
+  return audioFileHandle;
+}
+
+void AudioMixer::Unload(AudioFileHandle audioFileHandle) {
+  AudioFileMixer* pFile = GetMixerFile(audioFileHandle);
+  if (!pFile) {
+    return;
+  }
+
+  // Mix holds fileMapLock_ while it uses files,
+  // so once this returns, the file is safe to delete.
+  RemoveAudioFile(audioFileHandle);
+
+  pFile->Unload();
+  filePool_.Delete(pFile);
+}
+
+void AudioMixer::Update() {
+  if (!bInitialized_) {
+    return;
+  }
+
+  U64 units = (U64)sampleRate_ * microsecPerUpdate_ + frameRemainder_;
+  frameRemainder_ = units % 1000000;
+  Mix((size_t)(units / 1000000));
+}
+
+void AudioMixer::Mix(size_t frames) {
+  MANA_PROFILE_SCOPE("AudioMixer::Mix");
+  if (!bInitialized_ || frames == 0) {
+    return;
+  }
+
+  size_t numSamples = frames * OUTPUT_CHANNELS;
+  if (bus_.size() < numSamples) {
+    bus_.resize(numSamples);
+  }
+  std::fill(bus_.begin(), bus_.begin() + numSamples, 0.0f);
+
+  F32 masterVolume;
+  {
+    ScopedMutex lock(fileMapLock_);
+    masterVolume = masterVolume_;
+    for (AudioFileBase* pAudioFile : fileMap_) {
+      AudioFileMixer* pFile = static_cast<AudioFileMixer*>(pAudioFile);
+      if (!pFile || pFile->isStopped_ || pFile->isPaused_) {
+        continue;
+      }
+
+      // fold 16 bit -> float scaling into the gain
+      F32 gain = pFile->volume_ * categoryVolumes_[(size_t)pFile->category_] /
+                 32768.0f;
+      F32 gainLeft = gain;
+      F32 gainRight = gain;
+      if (pFile->isPanned_) {
+        // same linear panning as AudioWin::SetPan
+        gainLeft *= 0.5f - pFile->pan_ / 2;
+        gainRight *= 0.5f + pFile->pan_ / 2;
+      }
+
+      bool anyPlaying = false;
+      for (AudioFileMixer::Voice& voice : pFile->voices_) {
+        if (voice.isPlaying) {
+          MixVoice(pFile, voice, bus_.data(), frames, gainLeft, gainRight);
+          anyPlaying = anyPlaying || voice.isPlaying;
+        }
+      }
+
+      if (!anyPlaying) {
+        pFile->isStopped_ = true;
+      }
+    }
+  }
+
+  ApplyGain(bus_.data(), numSamples, masterVolume);
+  pSink_->Write(bus_.data(), frames);
+}
+
+void AudioMixer::MixVoice(AudioFileMixer* pFile,
+                          AudioFileMixer::Voice& voice,
+                          F32* pBus,
+                          size_t frames,
+                          F32 gainLeft,
+                          F32 gainRight) {
+  const I16* pPcm = pFile->GetPcm();
+  U32 channels = pFile->channels_;
+  size_t mixed = 0;
+
+  while (mixed < frames && voice.isPlaying) {
+    size_t count = pFile->totalFrames_ - voice.frameCursor;
+    if (count > frames - mixed) {
+      count = frames - mixed;
+    }
+
+    MixI16ToStereo(&pBus[mixed * OUTPUT_CHANNELS],
+                   &pPcm[voice.frameCursor * channels], channels, count,
+                   gainLeft, gainRight);
+    mixed += count;
+    voice.frameCursor += count;
+
+    if (voice.frameCursor >= pFile->totalFrames_) {
+      if (voice.loopCount > 0) {
+        if (voice.loopCount != AudioBase::LOOP_INFINITE) {
+          voice.loopCount--;
+        }
+        voice.frameCursor = (size_t)pFile->loopBackPcmSamplePos_;
+      } else {
+        voice.isPlaying = false;
+        voice.frameCursor = 0;
+      }
+    }
+  }
+}
+
+bool AudioMixer::Play(AudioFileHandle audioFileHandle, uint32_t loopCount) {
+  assert(loopCount <= AudioBase::LOOP_INFINITE && "invalid loopCount");
+
+  ScopedMutex lock(fileMapLock_);
+  AudioFileMixer* pFile = GetMixerFile_NoLock(audioFileHandle);
+  if (!pFile) {
+    return false;
+  }
+
+  // if paused, resume (only single voice files can be paused)
+  if (pFile->isPaused_) {
+    pFile->isPaused_ = false;
+    pFile->isStopped_ = false;
+    return true;
+  }
+
+  // round-robin through the voices, restarting whichever is next
+  AudioFileMixer::Voice& voice = pFile->voices_[pFile->voicePos_];
+  pFile->voicePos_ = (pFile->voicePos_ + 1) % pFile->voices_.size();
+
+  voice.frameCursor = 0;
+  voice.loopCount = loopCount;
+  voice.isPlaying = true;
+
+  pFile->loopCount_ = loopCount;
+  pFile->isPaused_ = false;
+  pFile->isStopped_ = false;
+  return true;
+}
+
+void AudioMixer::Stop(AudioFileHandle audioFileHandle) {
+  ScopedMutex lock(fileMapLock_);
+  AudioFileMixer* pFile = GetMixerFile_NoLock(audioFileHandle);
+  if (!pFile || pFile->isStopped_) {
+    return;
+  }
+
+  for (AudioFileMixer::Voice& voice : pFile->voices_) {
+    voice.isPlaying = false;
+    voice.frameCursor = 0;
+  }
+
+  pFile->isPaused_ = false;
+  pFile->isStopped_ = true;
+}
+
+void AudioMixer::Pause(AudioFileHandle audioFileHandle) {
+  ScopedMutex lock(fileMapLock_);
+  AudioFileMixer* pFile = GetMixerFile_NoLock(audioFileHandle);
+  if (!pFile || pFile->isPaused_) {
+    return;
+  }
+
+  // same restriction as AudioWin::Pause
+  if (pFile->voices_.size() > 1) {
+    return;
+  }
+
+  if (!IsAnyVoicePlaying(pFile)) {
+    return;
+  }
+
+  pFile->isPaused_ = true;
+}
+
+void AudioMixer::Resume(AudioFileHandle audioFileHandle) {
+  ScopedMutex lock(fileMapLock_);
+  AudioFileMixer* pFile = GetMixerFile_NoLock(audioFileHandle);
+  if (!pFile || !pFile->isPaused_) {
+    return;
+  }
+
+  if (pFile->voices_.size() > 1) {
+    return;
+  }
+
+  pFile->isPaused_ = false;
+  pFile->isStopped_ = false;
+}
+
+float AudioMixer::GetVolume(AudioFileHandle audioFileHandle) {
+  ScopedMutex lock(fileMapLock_);
+  AudioFileMixer* pFile = GetMixerFile_NoLock(audioFileHandle);
+  if (!pFile) {
+    return 1.0f;
+  }
+
+  return pFile->volume_;
+}
+
+float AudioMixer::GetVolume(AudioCategory category) {
+  ScopedMutex lock(fileMapLock_);
+  return categoryVolumes_[(size_t)category];
+}
+
+float AudioMixer::GetMasterVolume() {
+  ScopedMutex lock(fileMapLock_);
+  return masterVolume_;
+}
+
+void AudioMixer::SetVolume(AudioFileHandle audioFileHandle, float volume) {
+  ClampVolume(volume);
+
+  ScopedMutex lock(fileMapLock_);
+  AudioFileMixer* pFile = GetMixerFile_NoLock(audioFileHandle);
+  if (!pFile) {
+    return;
+  }
+
+  pFile->volume_ = volume;
+}
+
+void AudioMixer::SetVolume(AudioCategory category, float volume) {
+  ClampVolume(volume);
+
+  ScopedMutex lock(fileMapLock_);
+  categoryVolumes_[(size_t)category] = volume;
+}
+
+void AudioMixer::SetMasterVolume(float& volume) {
+  ClampVolume(volume);
+
+  ScopedMutex lock(fileMapLock_);
+  masterVolume_ = volume;
+}
+
+void AudioMixer::SetPan(AudioFileHandle audioFileHandle, float pan) {
+  // clamp
+  if (pan < -1.0f)
+    pan = -1.0f;
+  else if (pan > 1.0f)
+    pan = 1.0f;
+
+  ScopedMutex lock(fileMapLock_);
+  AudioFileMixer* pFile = GetMixerFile_NoLock(audioFileHandle);
+  if (!pFile) {
+    ManaLogLnError(Channel::Sound,
+                   _X("AudioMixer: SetPan GetAudioFile failed"));
+    return;
+  }
+
+  pFile->pan_ = pan;
+  pFile->isPanned_ = true;
+}
+
+float AudioMixer::GetPan(AudioFileHandle audioFileHandle) {
+  ScopedMutex lock(fileMapLock_);
+  AudioFileMixer* pFile = GetMixerFile_NoLock(audioFileHandle);
+  if (!pFile) {
+    return 0.0f;
+  }
+
+  return pFile->pan_;
+}
+
+bool AudioMixer::IsPlaying(AudioFileHandle audioFileHandle) {
+  ScopedMutex lock(fileMapLock_);
+  AudioFileMixer* pFile = GetMixerFile_NoLock(audioFileHandle);
+  if (!pFile || pFile->isPaused_) {
+    return false;
+  }
+
+  return IsAnyVoicePlaying(pFile);
+}
+
+bool AudioMixer::IsPaused(AudioFileHandle audioFileHandle) {
+  ScopedMutex lock(fileMapLock_);
+  AudioFileMixer* pFile = GetMixerFile_NoLock(audioFileHandle);
+  if (!pFile) {
+    return false;
+  }
+
+  return pFile->isPaused_;
+}
+
+AudioFileMixer* AudioMixer::GetMixerFile(AudioFileHandle audioFileHandle) {
+  return static_cast<AudioFileMixer*>(GetAudioFile(audioFileHandle));
+}
+
+AudioFileMixer* AudioMixer::GetMixerFile_NoLock(
+    AudioFileHandle audioFileHandle) {
+  return static_cast<AudioFileMixer*>(GetAudioFile_NoLock(audioFileHandle));
+}
+
+// static
+bool AudioMixer::IsAnyVoicePlaying(const AudioFileMixer* pFile) {
+  for (const AudioFileMixer::Voice& voice : pFile->voices_) {
+    if (voice.isPlaying) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void AudioMixer::ClampVolume(float& volume) {
+  if (volume < AUDIO_MIN_VOLUME)
+    volume = AUDIO_MIN_VOLUME;
+  else if (volume > AUDIO_MAX_VOLUME)
+    volume = AUDIO_MAX_VOLUME;
+}
+
+}  // namespace Mana
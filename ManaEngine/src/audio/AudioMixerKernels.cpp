@@ -0,0 +1,355 @@
+#include "pch.h"
+#include "audio/AudioMixerKernels.h"
+
+#include <cmath>
+#include <emmintrin.h>
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+// MSVC lets any function use AVX2 intrinsics
+#define MANA_TARGET_AVX2
+#else
+#define MANA_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace Mana {
+
+typedef void (*MixI16ToStereoFunc)(F32*, const I16*, U32, size_t, F32, F32);
+typedef void (*ApplyGainFunc)(F32*, size_t, F32);
+typedef void (*ConvertF32ToI16Func)(const F32*, I16*, size_t);
+
+struct MixKernels {
+  MixKernelLevel level;
+  MixI16ToStereoFunc mixI16ToStereo;
+  ApplyGainFunc applyGain;
+  ConvertF32ToI16Func convertF32ToI16;
+};
+
+static const F32 I16_SCALE = 32768.0f;
+static const F32 I16_MIN = -32768.0f;
+static const F32 I16_MAX = 32767.0f;
+
+//
+// Scalar kernels.
+// These also handle the leftover samples of the SIMD kernels.
+//
+
+static void MixI16ToStereoScalar(F32* pBus,
+                                 const I16* pSrc,
+                                 U32 srcChannels,
+                                 size_t frames,
+                                 F32 gainLeft,
+                                 F32 gainRight) {
+  if (srcChannels == 1) {
+    for (size_t i = 0; i < frames; ++i) {
+      F32 sample = (F32)pSrc[i];
+      pBus[i * 2] += sample * gainLeft;
+      pBus[i * 2 + 1] += sample * gainRight;
+    }
+  } else {
+    for (size_t i = 0; i < frames; ++i) {
+      pBus[i * 2] += (F32)pSrc[i * 2] * gainLeft;
+      pBus[i * 2 + 1] += (F32)pSrc[i * 2 + 1] * gainRight;
+    }
+  }
+}
+
+static void ApplyGainScalar(F32* pSamples, size_t numSamples, F32 gain) {
+  for (size_t i = 0; i < numSamples; ++i) {
+    pSamples[i] *= gain;
+  }
+}
+
+static void ConvertF32ToI16Scalar(const F32* pSrc,
+                                  I16* pDest,
+                                  size_t numSamples) {
+  for (size_t i = 0; i < numSamples; ++i) {
+    F32 sample = pSrc[i] * I16_SCALE;
+    if (sample < I16_MIN) {
+      sample = I16_MIN;
+    } else if (sample > I16_MAX) {
+      sample = I16_MAX;
+    }
+    // rounds to nearest even, same as _mm_cvtps_epi32
+    pDest[i] = (I16)std::lrintf(sample);
+  }
+}
+
+//
+// SSE2 kernels
+//
+
+// sign extends the low/high 4 16 bit ints and converts them to floats
+static inline __m128 LowI16ToF32(__m128i pcm) {
+  return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(pcm, pcm), 16));
+}
+
+static inline __m128 HighI16ToF32(__m128i pcm) {
+  return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(pcm, pcm), 16));
+}
+
+static void MixI16ToStereoSSE2(F32* pBus,
+                               const I16* pSrc,
+                               U32 srcChannels,
+                               size_t frames,
+                               F32 gainLeft,
+                               F32 gainRight) {
+  const __m128 gains = _mm_setr_ps(gainLeft, gainRight, gainLeft, gainRight);
+  size_t i = 0;
+
+  if (srcChannels == 1) {
+    // 8 mono samples -> 16 bus floats per pass
+    for (; i + 8 <= frames; i += 8) {
+      __m128i pcm = _mm_loadu_si128((const __m128i*)&pSrc[i]);
+      __m128 lo = LowI16ToF32(pcm);
+      __m128 hi = HighI16ToF32(pcm);
+
+      F32* pOut = &pBus[i * 2];
+      // duplicate each sample into left and right
+      _mm_storeu_ps(pOut,
+                    _mm_add_ps(_mm_loadu_ps(pOut),
+                               _mm_mul_ps(_mm_unpacklo_ps(lo, lo), gains)));
+      _mm_storeu_ps(pOut + 4,
+                    _mm_add_ps(_mm_loadu_ps(pOut + 4),
+                               _mm_mul_ps(_mm_unpackhi_ps(lo, lo), gains)));
+      _mm_storeu_ps(pOut + 8,
+                    _mm_add_ps(_mm_loadu_ps(pOut + 8),
+                               _mm_mul_ps(_mm_unpacklo_ps(hi, hi), gains)));
+      _mm_storeu_ps(pOut + 12,
+                    _mm_add_ps(_mm_loadu_ps(pOut + 12),
+                               _mm_mul_ps(_mm_unpackhi_ps(hi, hi), gains)));
+    }
+  } else {
+    // 4 stereo frames (8 samples) -> 8 bus floats per pass,
+    // which are already interleaved the same as the bus.
+    for (; i + 4 <= frames; i += 4) {
+      __m128i pcm = _mm_loadu_si128((const __m128i*)&pSrc[i * 2]);
+      __m128 lo = LowI16ToF32(pcm);
+      __m128 hi = HighI16ToF32(pcm);
+
+      F32* pOut = &pBus[i * 2];
+      _mm_storeu_ps(pOut,
+                    _mm_add_ps(_mm_loadu_ps(pOut), _mm_mul_ps(lo, gains)));
+      _mm_storeu_ps(pOut + 4,
+                    _mm_add_ps(_mm_loadu_ps(pOut + 4), _mm_mul_ps(hi, gains)));
+    }
+  }
+
+  if (i < frames) {
+    MixI16ToStereoScalar(&pBus[i * 2], &pSrc[i * srcChannels], srcChannels,
+                         frames - i, gainLeft, gainRight);
+  }
+}
+
+static void ApplyGainSSE2(F32* pSamples, size_t numSamples, F32 gain) {
+  const __m128 gains = _mm_set1_ps(gain);
+  size_t i = 0;
+  for (; i + 4 <= numSamples; i += 4) {
+    _mm_storeu_ps(&pSamples[i], _mm_mul_ps(_mm_loadu_ps(&pSamples[i]), gains));
+  }
+
+  ApplyGainScalar(&pSamples[i], numSamples - i, gain);
+}
+
+static void ConvertF32ToI16SSE2(const F32* pSrc,
+                                I16* pDest,
+                                size_t numSamples) {
+  const __m128 scale = _mm_set1_ps(I16_SCALE);
+  const __m128 minimum = _mm_set1_ps(I16_MIN);
+  const __m128 maximum = _mm_set1_ps(I16_MAX);
+  size_t i = 0;
+  for (; i + 8 <= numSamples; i += 8) {
+    __m128 a = _mm_mul_ps(_mm_loadu_ps(&pSrc[i]), scale);
+    __m128 b = _mm_mul_ps(_mm_loadu_ps(&pSrc[i + 4]), scale);
+    a = _mm_min_ps(_mm_max_ps(a, minimum), maximum);
+    b = _mm_min_ps(_mm_max_ps(b, minimum), maximum);
+    __m128i packed =
+        _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+    _mm_storeu_si128((__m128i*)&pDest[i], packed);
+  }
+
+  ConvertF32ToI16Scalar(&pSrc[i], &pDest[i], numSamples - i);
+}
+
+//
+// AVX2 kernels
+//
+
+MANA_TARGET_AVX2
+static void MixI16ToStereoAVX2(F32* pBus,
+                               const I16* pSrc,
+                               U32 srcChannels,
+                               size_t frames,
+                               F32 gainLeft,
+                               F32 gainRight) {
+  const __m256 gains = _mm256_setr_ps(gainLeft, gainRight, gainLeft, gainRight,
+                                      gainLeft, gainRight, gainLeft, gainRight);
+  size_t i = 0;
+
+  if (srcChannels == 1) {
+    // 8 mono samples -> 16 bus floats per pass
+    for (; i + 8 <= frames; i += 8) {
+      __m256 pcm = _mm256_cvtepi32_ps(
+          _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)&pSrc[i])));
+      // unpack works within 128 bit lanes:
+      // lo = s0 s0 s1 s1 | s4 s4 s5 s5, hi = s2 s2 s3 s3 | s6 s6 s7 s7
+      __m256 lo = _mm256_unpacklo_ps(pcm, pcm);
+      __m256 hi = _mm256_unpackhi_ps(pcm, pcm);
+      __m256 first = _mm256_permute2f128_ps(lo, hi, 0x20);
+      __m256 second = _mm256_permute2f128_ps(lo, hi, 0x31);
+
+      F32* pOut = &pBus[i * 2];
+      _mm256_storeu_ps(pOut, _mm256_add_ps(_mm256_loadu_ps(pOut),
+                                           _mm256_mul_ps(first, gains)));
+      _mm256_storeu_ps(pOut + 8, _mm256_add_ps(_mm256_loadu_ps(pOut + 8),
+                                               _mm256_mul_ps(second, gains)));
+    }
+  } else {
+    // 8 stereo frames (16 samples) -> 16 bus floats per pass
+    for (; i + 8 <= frames; i += 8) {
+      __m256 lo = _mm256_cvtepi32_ps(
+          _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)&pSrc[i * 2])));
+      __m256 hi = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(
+          _mm_loadu_si128((const __m128i*)&pSrc[i * 2 + 8])));
+
+      F32* pOut = &pBus[i * 2];
+      _mm256_storeu_ps(pOut, _mm256_add_ps(_mm256_loadu_ps(pOut),
+                                           _mm256_mul_ps(lo, gains)));
+      _mm256_storeu_ps(pOut + 8, _mm256_add_ps(_mm256_loadu_ps(pOut + 8),
+                                               _mm256_mul_ps(hi, gains)));
+    }
+  }
+
+  if (i < frames) {
+    MixI16ToStereoScalar(&pBus[i * 2], &pSrc[i * srcChannels], srcChannels,
+                         frames - i, gainLeft, gainRight);
+  }
+}
+
+MANA_TARGET_AVX2
+static void ApplyGainAVX2(F32* pSamples, size_t numSamples, F32 gain) {
+  const __m256 gains = _mm256_set1_ps(gain);
+  size_t i = 0;
+  for (; i + 8 <= numSamples; i += 8) {
+    _mm256_storeu_ps(&pSamples[i],
+                     _mm256_mul_ps(_mm256_loadu_ps(&pSamples[i]), gains));
+  }
+
+  ApplyGainScalar(&pSamples[i], numSamples - i, gain);
+}
+
+MANA_TARGET_AVX2
+static void ConvertF32ToI16AVX2(const F32* pSrc,
+                                I16* pDest,
+                                size_t numSamples) {
+  const __m256 scale = _mm256_set1_ps(I16_SCALE);
+  const __m256 minimum = _mm256_set1_ps(I16_MIN);
+  const __m256 maximum = _mm256_set1_ps(I16_MAX);
+  size_t i = 0;
+  for (; i + 16 <= numSamples; i += 16) {
+    __m256 a = _mm256_mul_ps(_mm256_loadu_ps(&pSrc[i]), scale);
+    __m256 b = _mm256_mul_ps(_mm256_loadu_ps(&pSrc[i + 8]), scale);
+    a = _mm256_min_ps(_mm256_max_ps(a, minimum), maximum);
+    b = _mm256_min_ps(_mm256_max_ps(b, minimum), maximum);
+    // packs works within 128 bit lanes, so put the 64 bit chunks back
+    // in order afterwards.
+    __m256i packed =
+        _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+    packed = _mm256_permute4x64_epi64(packed, 0xD8);
+    _mm256_storeu_si256((__m256i*)&pDest[i], packed);
+  }
+
+  ConvertF32ToI16Scalar(&pSrc[i], &pDest[i], numSamples - i);
+}
+
+//
+// Dispatch
+//
+
+static const MixKernels scalarKernels = {
+    MixKernelLevel::Scalar, MixI16ToStereoScalar, ApplyGainScalar,
+    ConvertF32ToI16Scalar};
+static const MixKernels sse2Kernels = {
+    MixKernelLevel::SSE2, MixI16ToStereoSSE2, ApplyGainSSE2,
+    ConvertF32ToI16SSE2};
+static const MixKernels avx2Kernels = {
+    MixKernelLevel::AVX2, MixI16ToStereoAVX2, ApplyGainAVX2,
+    ConvertF32ToI16AVX2};
+
+static const MixKernels* GetKernels(MixKernelLevel level) {
+  switch (level) {
+    case MixKernelLevel::AVX2:
+      return &avx2Kernels;
+    case MixKernelLevel::SSE2:
+      return &sse2Kernels;
+    default:
+      return &scalarKernels;
+  }
+}
+
+static const MixKernels* pKernels = GetKernels(DetectMixKernelLevel());
+
+MixKernelLevel DetectMixKernelLevel() {
+  // SSE2 is part of x64, and we already require SSE (see ManaGlobals.h)
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7) {
+    return MixKernelLevel::SSE2;
+  }
+
+  // the OS must also save the AVX registers on context switches
+  __cpuid(info, 1);
+  bool bOSXSave = (info[2] & (1 << 27)) != 0;
+  bool bAVX = (info[2] & (1 << 28)) != 0;
+  if (!bOSXSave || !bAVX || (_xgetbv(0) & 0x6) != 0x6) {
+    return MixKernelLevel::SSE2;
+  }
+
+  __cpuidex(info, 7, 0);
+  if (info[1] & (1 << 5)) {
+    return MixKernelLevel::AVX2;
+  }
+  return MixKernelLevel::SSE2;
+#else
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return MixKernelLevel::AVX2;
+  }
+  return MixKernelLevel::SSE2;
+#endif
+}
+
+void SetMixKernelLevel(MixKernelLevel level) {
+  MixKernelLevel supported = DetectMixKernelLevel();
+  if ((int)level > (int)supported) {
+    level = supported;
+  }
+
+  pKernels = GetKernels(level);
+}
+
+MixKernelLevel GetMixKernelLevel() {
+  return pKernels->level;
+}
+
+void MixI16ToStereo(F32* pBus,
+                    const I16* pSrc,
+                    U32 srcChannels,
+                    size_t frames,
+                    F32 gainLeft,
+                    F32 gainRight) {
+  pKernels->mixI16ToStereo(pBus, pSrc, srcChannels, frames, gainLeft,
+                           gainRight);
+}
+
+void ApplyGain(F32* pSamples, size_t numSamples, F32 gain) {
+  pKernels->applyGain(pSamples, numSamples, gain);
+}
+
+void ConvertF32ToI16(const F32* pSrc, I16* pDest, size_t numSamples) {
+  pKernels->convertF32ToI16(pSrc, pDest, numSamples);
+}
+
+}  // namespace Mana
@@ -0,0 +1,111 @@
+#include "pch.h"
+#include "audio/AudioSink.h"
+
+#include "audio/AudioMixerKernels.h"
+
+namespace Mana {
+
+bool NullAudioSink::Open(U32 /*sampleRate*/, U32 /*channels*/) {
+  framesWritten_ = 0;
+  return true;
+}
+
+void NullAudioSink::Write(const F32* /*pSamples*/, size_t frames) {
+  framesWritten_ += frames;
+}
+
+WavFileAudioSink::~WavFileAudioSink() {
+  Close();
+}
+
+bool WavFileAudioSink::Open(U32 sampleRate, U32 channels) {
+  if (pFile_) {
+    return false;
+  }
+
+#ifdef OS_WIN
+  _wfopen_s(&pFile_, filePath_.c_str(), _X("wb"));
+#else
+  pFile_ = fopen(filePath_.c_str(), "wb");
+#endif
+  if (!pFile_) {
+    ManaLogLnError(Channel::Sound, _X("WavFileAudioSink: can't open %s"),
+                   filePath_.c_str());
+    return false;
+  }
+
+  channels_ = channels;
+  dataBytes_ = 0;
+  // sizes are filled in by Close
+  WriteHeader(sampleRate);
+  return true;
+}
+
+void WavFileAudioSink::Write(const F32* pSamples, size_t frames) {
+  if (!pFile_) {
+    return;
+  }
+
+  size_t numSamples = frames * channels_;
+  if (pcm_.size() < numSamples) {
+    pcm_.resize(numSamples);
+  }
+
+  ConvertF32ToI16(pSamples, pcm_.data(), numSamples);
+  dataBytes_ += fwrite(pcm_.data(), sizeof(I16), numSamples, pFile_) *
+                sizeof(I16);
+}
+
+void WavFileAudioSink::Close() {
+  if (!pFile_) {
+    return;
+  }
+
+  // .wav sizes are 32 bit
+  U32 dataBytes = dataBytes_ > 0xFFFFFFFF - 36 ? 0xFFFFFFFF - 36
+                                                : (U32)dataBytes_;
+  U32 riffBytes = 36 + dataBytes;
+  fseek(pFile_, 4, SEEK_SET);
+  fwrite(&riffBytes, sizeof(riffBytes), 1, pFile_);
+  fseek(pFile_, 40, SEEK_SET);
+  fwrite(&dataBytes, sizeof(dataBytes), 1, pFile_);
+
+  fclose(pFile_);
+  pFile_ = nullptr;
+}
+
+void WavFileAudioSink::WriteHeader(U32 sampleRate) {
+  // canonical 44 byte RIFF/WAVE header (little endian, same as x86)
+  U16 formatTag = 1;  // WAVE_FORMAT_PCM
+  U16 channels = (U16)channels_;
+  U16 bitsPerSample = 16;
+  U16 blockAlign = channels * (bitsPerSample / 8);
+  U32 bytesPerSec = sampleRate * blockAlign;
+  U32 fmtBytes = 16;
+  U32 zero = 0;
+
+  fwrite("RIFF", 1, 4, pFile_);
+  fwrite(&zero, sizeof(zero), 1, pFile_);
+  fwrite("WAVE", 1, 4, pFile_);
+  fwrite("fmt ", 1, 4, pFile_);
+  fwrite(&fmtBytes, sizeof(fmtBytes), 1, pFile_);
+  fwrite(&formatTag, sizeof(formatTag), 1, pFile_);
+  fwrite(&channels, sizeof(channels), 1, pFile_);
+  fwrite(&sampleRate, sizeof(sampleRate), 1, pFile_);
+  fwrite(&bytesPerSec, sizeof(bytesPerSec), 1, pFile_);
+  fwrite(&blockAlign, sizeof(blockAlign), 1, pFile_);
+  fwrite(&bitsPerSample, sizeof(bitsPerSample), 1, pFile_);
+  fwrite("data", 1, 4, pFile_);
+  fwrite(&zero, sizeof(zero), 1, pFile_);
+}
+
+bool CallbackAudioSink::Open(U32 /*sampleRate*/, U32 channels) {
+  channels_ = channels;
+  return callback_ != nullptr;
+}
+
+void CallbackAudioSink::Write(const F32* pSamples, size_t frames) {
+  callback_(pSamples, frames, channels_, pUserData_);
+}
+
+}  // namespace Mana
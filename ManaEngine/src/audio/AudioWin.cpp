@@ -1,13 +1,25 @@
 #include "pch.h"
 #include <assert.h>
+#include <memory>
 #include "audio/AudioWin.h"
 #include "audio/AudioFileBase.h"
 #include "audio/AudioFileOggWin.h"
 #include "concurrency/IThread.h"
+#include "utils/Profiler.h"
 
 namespace Mana {
 
-AudioBase* g_pAudioEngine = nullptr;
+// ThreadFunc doesn't take a user param,
+// so the audio thread finds its AudioWin through here.
+static AudioWin* pAudioThreadOwner = nullptr;
+
+unsigned long AudioThreadFunction(IThread* pThread);
+
+AudioWin::AudioWin()
+    : voiceCallback_(this),
+      oggFilePool_(_X("AudioFileOggWin"), 16, MAX_SOUNDS_LOADED),
+      commandQueue_(RingOverflowPolicy::Block),
+      bBufferEndDropped_(false) {}
 
 bool AudioWin::Init() {
   if (!com_.IsInitialized()) {
@@ -24,7 +36,15 @@ bool AudioWin::Init() {
   if (FAILED(hr = pXAudio2_->CreateMasteringVoice(&pMasterVoice_)))
     return false;
 
-  lastAudioFileHandle_ = 0;
+  hAudioThreadEvent_ = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+  if (!hAudioThreadEvent_)
+    return false;
+
+  pAudioThreadOwner = this;
+  pAudioThread_ = ThreadFactory::Create(AudioThreadFunction);
+  if (!pAudioThread_)
+    return false;
+  pAudioThread_->Start();
 
   return true;
 }
@@ -32,24 +52,45 @@ bool AudioWin::Init() {
 void AudioWin::Uninit() {
   // stop and destroy all voices and buffers by calling Unload on all AudioFiles
 
+  // stop the audio thread first. Commands it hasn't applied are dropped.
+  if (pAudioThread_) {
+    pAudioThread_->Stop();
+    SetEvent(hAudioThreadEvent_);
+    pAudioThread_->Join();
+    delete pAudioThread_;
+    pAudioThread_ = nullptr;
+  }
+  pAudioThreadOwner = nullptr;
+
   if (pXAudio2_) {
     pXAudio2_->StopEngine();
   }
 
-  // since Unload calls "fileMap_.erase",
-  // and therefore alters the foreach iterator,
+  // since Unload removes files from fileMap_,
   // first form a list of audio handles,
   // then use those to call Unload.
   std::vector<AudioFileHandle> fileHandleList;
-  for (auto it = fileMap_.begin(); it != fileMap_.end(); ++it) {
-    AudioFileBase* pAudioFile = it->second;
-    fileHandleList.push_back(pAudioFile->audioFileHandle_);
+  {
+    ScopedMutex lock(fileMapLock_);
+    for (AudioFileBase* pAudioFile : fileMap_) {
+      if (pAudioFile) {
+        fileHandleList.push_back(pAudioFile->audioFileHandle_);
+      }
+    }
   }
 
   for (size_t i = 0; i < fileHandleList.size(); ++i) {
     Unload(fileHandleList[i]);
   }
 
+  // Streaming voices' callbacks (OnBufferEnd) set the event from XAudio2's
+  // thread, so it's only closed once the engine is stopped and every
+  // source voice is destroyed.
+  if (hAudioThreadEvent_) {
+    CloseHandle(hAudioThreadEvent_);
+    hAudioThreadEvent_ = nullptr;
+  }
+
   if (pMasterVoice_) {
     pMasterVoice_->DestroyVoice();
     pMasterVoice_ = nullptr;
@@ -61,11 +102,13 @@ void AudioWin::Uninit() {
   }
 }
 
-AudioFileHandle AudioWin::Load(const xstring& filePath,
-                               AudioCategory category,
-                               AudioFormat format,
-                               int64_t loopBackPcmSamplePos,
-                               int simultaneousSounds) {
+AudioFileHandle AudioWin::LoadFile(const xstring& filePath,
+                                   MappedFile* pMemory,
+                                   AudioCategory category,
+                                   AudioFormat format,
+                                   int64_t loopBackPcmSamplePos,
+                                   int simultaneousSounds) {
+  std::unique_ptr<MappedFile> memory(pMemory);
   AudioFileHandle audioFileHandle = 0;
 
   if (simultaneousSounds < 1)
@@ -73,7 +116,11 @@ AudioFileHandle AudioWin::Load(const xstring& filePath,
 
   AudioFileWin* pFile = nullptr;
   if (format == AudioFormat::Ogg) {
-    pFile = new AudioFileOggWin;
+    pFile = oggFilePool_.New();
+    if (!pFile) {
+      ManaLogLnError(Channel::Sound, _X("AudioWin: too many sounds loaded"));
+      return 0;
+    }
   }
 
   if (!pFile)
@@ -83,64 +130,71 @@ AudioFileHandle AudioWin::Load(const xstring& filePath,
   pFile->category_ = category;
   pFile->format_ = format;
   pFile->loopBackPcmSamplePos_ = loopBackPcmSamplePos;
+  pFile->pPcmCache_ = &pcmCache_;
 
-  if (!pFile->Load(filePath)) {
-    delete pFile;
+  bool loaded = memory ? pFile->LoadFromMemory(memory.release())
+                       : pFile->Load(filePath);
+  if (!loaded) {
+    DeleteAudioFile(pFile);
     return 0;
   }
 
   if (simultaneousSounds > 1 && pFile->loadType_ == AudioLoadType::Streaming) {
     assert(false &&
            "Audio file is too big to support multiple simultaneous sounds");
-    delete pFile;
-    return 0;
-  }
-
-  audioFileHandle = GetNextFreeAudioFileHandle();
-  if (!audioFileHandle) {
-    delete pFile;
+    DeleteAudioFile(pFile);
     return 0;
   }
 
-  pFile->audioFileHandle_ = audioFileHandle;
-
-  fileMap_.insert(std::map<AudioFileHandle, AudioFileBase*>::value_type(
-      audioFileHandle, pFile));
-
   int numSounds = simultaneousSounds;
   while (numSounds > 0) {
     IXAudio2SourceVoice* pSourceVoice = nullptr;
 
-    //if (pFile->loadType == AudioLoadType::Streaming) {
-    //  if (FAILED(pXAudio2_->CreateSourceVoice(
-    //          &pSourceVoice, (WAVEFORMATEX*)&pFile->wfx_, 0u, 2.0f,
-    //          (IXAudio2VoiceCallback*)&voiceCallback))) {
-    //    OutputDebugStringW(L"ERROR: CreateSourceVoice streaming failed\n");
-    //    delete pFile;
-    //    return 0;
-    //  }
-    //} else {
+    if (pFile->loadType_ == AudioLoadType::Streaming) {
+      // streaming voices tell the audio thread when they need more data
+      if (FAILED(pXAudio2_->CreateSourceVoice(
+              &pSourceVoice, (WAVEFORMATEX*)&pFile->wfx_, 0u,
+              XAUDIO2_DEFAULT_FREQ_RATIO, &voiceCallback_))) {
+        OutputDebugStringW(L"ERROR: CreateSourceVoice streaming failed\n");
+        break;
+      }
+    } else {
       if (FAILED(pXAudio2_->CreateSourceVoice(&pSourceVoice,
                                                (WAVEFORMATEX*)&pFile->wfx_))) {
         OutputDebugStringW(L"ERROR: CreateSourceVoice failed\n");
-        delete pFile;
-        return 0;
+        break;
       }
-    //}
+    }
 
     pFile->sourceVoices_.push_back(pSourceVoice);
     numSounds--;
   }
 
+  if (numSounds > 0) {
+    for (IXAudio2SourceVoice* pSourceVoice : pFile->sourceVoices_) {
+      pSourceVoice->DestroyVoice();
+    }
+    pFile->sourceVoices_.clear();
+    DeleteAudioFile(pFile);
+    return 0;
+  }
+
   // set defaults
   pFile->sourceVoicePos_ = 0;
   pFile->isPaused_ = false;
   pFile->pan_ = 0.0f;
 
+  // only added once it's fully set up, since the audio thread may use it.
+  // The handle is the file's slot in its pool.
+  audioFileHandle = oggFilePool_.GetHandle((AudioFileOggWin*)pFile);
+  AddAudioFile(pFile, audioFileHandle);
   return audioFileHandle;
 }
 
 void AudioWin::Unload(AudioFileHandle audioFileHandle) {
+  // wait for the audio thread to finish with the file
+  ScopedMutex lock(audioThreadLock_);
+
   AudioFileWin* pAudioFile = (AudioFileWin*)GetAudioFile(audioFileHandle);
   if (!pAudioFile) {
     return;
@@ -159,191 +213,369 @@ void AudioWin::Unload(AudioFileHandle audioFileHandle) {
     pSourceVoice = nullptr;
   }
 
-  fileMap_.erase(pAudioFile->audioFileHandle_);
+  RemoveAudioFile(pAudioFile->audioFileHandle_);
 
   pAudioFile->sourceVoices_.clear();
 
   pAudioFile->Unload();
 
-  delete pAudioFile;
+  DeleteAudioFile(pAudioFile);
   pAudioFile = nullptr;
 }
 
-void AudioWin::Update() {
+void AudioWin::DeleteAudioFile(AudioFileWin* pFile) {
+  // Load only creates oggs for now
+  assert(pFile->format_ == AudioFormat::Ogg);
+  oggFilePool_.Delete((AudioFileOggWin*)pFile);
+}
+
+void AudioWin::FillStreamingBuffers(AudioFileWin* pFile) {
+  MANA_PROFILE_SCOPE("AudioWin::FillStreamingBuffers");
   XAUDIO2_VOICE_STATE voiceState;
   XAUDIO2_BUFFER buffer;
 
-  GetStreamingFiles();
-  for (AudioFileBase* pFileBase : streamingFiles_) {
-    AudioFileWin* pFile = static_cast<AudioFileWin*>(pFileBase);
-
-    if (pFile->isStopped_)
-      continue;
+  if (pFile->isStopped_)
+    return;
 
-    if (pFile->lastBufferPlaying_) {
+  if (pFile->lastBufferPlaying_) {
+    pFile->sourceVoices_[0]->GetState(&voiceState,
+                                     XAUDIO2_VOICE_NOSAMPLESPLAYED);
+    if (voiceState.BuffersQueued == 0) {
       // last buffer just finished playing.
       //OutputDebugStringW(L"file done playing\n");
       pFile->currentStreamBufIndex_ = 0;
       pFile->StreamSeek(0);
       pFile->isStopped_ = true;
-      continue;
     }
+    return;
+  }
 
-    // NOTE: even if this streaming sound is paused,
-    // we still want to fill it's buffers and queue them on it's
-    // XAudio2-voice. They just won't play until the sound is resumed.
+  // NOTE: even if this streaming sound is paused,
+  // we still want to fill it's buffers and queue them on it's
+  // XAudio2-voice. They just won't play until the sound is resumed.
+
+  int bytesPerSample = pFile->wfx_.Format.wBitsPerSample / 8;
+
+  // get number of buffers currently in the XAudio2-Voice queue
+  pFile->sourceVoices_[0]->GetState(&voiceState,
+                                   XAUDIO2_VOICE_NOSAMPLESPLAYED);
+
+  while (voiceState.BuffersQueued < AudioStreamBufCount) {
+    //OutputDebugStringW((std::wstring(L"BuffersQueued: ") +
+    //                    std::to_wstring(voiceState.BuffersQueued) + L"\n")
+    //                       .c_str());
+    //assert(voiceState.BuffersQueued > 0 && "BuffersQueued == 0!");
+
+    // init next buffer with silence
+    memset(&pFile->pDataBuffer_[pFile->currentStreamBufIndex_ *
+                                AudioStreamBufSize],
+           0, AudioStreamBufSize);
+
+    buffer = {0};
+
+    int readBufLen = AudioStreamBufSize;  // multiple of 4
+
+    size_t destBufPos = pFile->currentStreamBufIndex_ * AudioStreamBufSize;
+    unsigned currentBytesRead = 0;
+    long actualBytesRead = 1;
+    int ovBitstream = 0;
+
+    int bytesToPcmEOF =
+        (int)(pFile->totalPcmBytes_ - pFile->currentTotalPcmPos_);
+    //OutputDebugStringW((std::wstring(L"Audio Update: bytesToPcmEOF: ") +
+    //                    std::to_wstring(bytesToPcmEOF) + L"\n")
+    //                       .c_str());
+    bool reachedEOF = false;
+    if (bytesToPcmEOF < readBufLen) {
+      readBufLen = bytesToPcmEOF;
+      reachedEOF = true;
+      //OutputDebugStringW(L"Audio Update: reachedEOF true\n");
+    }
 
-    int bytesPerSample = pFile->wfx_.Format.wBitsPerSample / 8;
+    size_t maxBytesToRead = reachedEOF ? bytesToPcmEOF : AudioStreamBufSize;
+
+    AudioFileOggWin* pOggFile = static_cast<AudioFileOggWin*>(pFile);
+
+    while (actualBytesRead && currentBytesRead < maxBytesToRead) {
+      actualBytesRead = ::ov_read(
+          &pOggFile->oggVorbisFile_, (char*)&pFile->pDataBuffer_[destBufPos],
+          readBufLen, 0, bytesPerSample, 1, &ovBitstream);
+      //OutputDebugStringW(
+      //    (std::wstring(L"Audio Update: ov_read actualBytesRead: ") +
+      //     std::to_wstring(actualBytesRead) + L"\n")
+      //        .c_str());
+      assert(actualBytesRead >= 0 && "ov_read failed");
+      destBufPos += actualBytesRead;
+      currentBytesRead += actualBytesRead;
+      pFile->currentTotalPcmPos_ += actualBytesRead;
+      //OutputDebugStringW((std::wstring(L"Audio Update: ov_read pcmPos: ") +
+      //                    std::to_wstring(pFile->currentTotalPcmPos_) + L"\n")
+      //                       .c_str());
+      if (maxBytesToRead - currentBytesRead < (unsigned)readBufLen) {
+        readBufLen = (int)maxBytesToRead - currentBytesRead;
+      }
+    }
+
+    //bool onLastLoop = false;
+    if (reachedEOF && pFile->loopCount_ > 0 &&
+        pFile->loopCount_ != AudioBase::LOOP_INFINITE) {
+      pFile->loopCount_--;
+      //if (pFile->loopCount_ == 0) {
+      //  onLastLoop = true;
+      //}
+    }
+
+    // if reached the end of file and still looping,
+    // reset position to start of the file,
+    // and fill the rest of the destination buffer.
+    if (reachedEOF && pFile->loopCount_ > 0) {
+      pFile->StreamSeek(pFile->loopBackPcmSamplePos_);
+
+      if (currentBytesRead < AudioStreamBufSize) {
+        // fill the rest of the destination buffer
+        readBufLen = AudioStreamBufSize - currentBytesRead;
+        actualBytesRead = 1;
+        while (actualBytesRead && currentBytesRead < AudioStreamBufSize) {
+          actualBytesRead =
+              ::ov_read(&pOggFile->oggVorbisFile_,
+                        (char*)&pFile->pDataBuffer_[destBufPos], readBufLen,
+                        0, bytesPerSample, 1, &ovBitstream);
+          //OutputDebugStringW(
+          //    (std::wstring(L"Audio Update: ov_read actualBytesRead: ") +
+          //     std::to_wstring(actualBytesRead) + L"\n")
+          //        .c_str());
+          assert(actualBytesRead >= 0 && "ov_read failed");
+          destBufPos += actualBytesRead;
+          currentBytesRead += actualBytesRead;
+          pFile->currentTotalPcmPos_ += actualBytesRead;
+          if (AudioStreamBufSize - currentBytesRead < readBufLen) {
+            readBufLen = AudioStreamBufSize - currentBytesRead;
+          }
+        }
+      }
+    } else {  // not looping (or on last loop)
+      if (reachedEOF) {
+        pFile->lastBufferPlaying_ = true;
+        //OutputDebugStringW(L"Audio Update: set lastBufferPlaying_ true\n");
+      }
+    }
+
+    buffer.AudioBytes = currentBytesRead;
+    buffer.pAudioData = &pFile->pDataBuffer_[pFile->currentStreamBufIndex_ *
+                                             AudioStreamBufSize];
+    // tells OnBufferEnd which file needs more data
+    buffer.pContext = (void*)pFile->audioFileHandle_;
+    if (pFile->lastBufferPlaying_) {
+      buffer.Flags = XAUDIO2_END_OF_STREAM;
+    }
+
+    pFile->currentStreamBufIndex_++;
+    if (pFile->currentStreamBufIndex_ == AudioStreamBufCount) {
+      pFile->currentStreamBufIndex_ = 0;
+    }
+
+    HRESULT hr;
+    if (FAILED(hr = pFile->sourceVoices_[0]->SubmitSourceBuffer(&buffer))) {
+      OutputDebugStringW(L"Audio Update: SubmitSourceBuffer failed\n");
+      assert(false && "Audio Update: SubmitSourceBuffer failed");
+      return;
+    }
+
+    if (pFile->lastBufferPlaying_) {
+      break;
+    }
 
-    // get number of buffers currently in the XAudio2-Voice queue
     pFile->sourceVoices_[0]->GetState(&voiceState,
                                      XAUDIO2_VOICE_NOSAMPLESPLAYED);
+  }
+}
 
-    while (voiceState.BuffersQueued < AudioStreamBufCount) {
-      //OutputDebugStringW((std::wstring(L"BuffersQueued: ") +
-      //                    std::to_wstring(voiceState.BuffersQueued) + L"\n")
-      //                       .c_str());
-      //assert(voiceState.BuffersQueued > 0 && "BuffersQueued == 0!");
+bool AudioWin::Play(AudioFileHandle audioFileHandle, uint32_t loopCount) {
+  if (!GetAudioFile(audioFileHandle)) {
+    return false;
+  }
 
-      // init next buffer with silence
-      memset(&pFile->pDataBuffer_[pFile->currentStreamBufIndex_ *
-                                  AudioStreamBufSize],
-             0, AudioStreamBufSize);
+  assert(loopCount <= AudioBase::LOOP_INFINITE && "invalid loopCount");
 
-      buffer = {0};
+  AudioCommand command = {AudioCommandType::Play, audioFileHandle,
+                          AudioCategory::Sound, 0.0f, loopCount};
+  PostCommand(command);
+  return true;
+}
 
-      int readBufLen = AudioStreamBufSize;  // multiple of 4
+void AudioWin::Stop(AudioFileHandle audioFileHandle) {
+  AudioCommand command = {AudioCommandType::Stop, audioFileHandle,
+                          AudioCategory::Sound, 0.0f, 0};
+  PostCommand(command);
+}
 
-      size_t destBufPos = pFile->currentStreamBufIndex_ * AudioStreamBufSize;
-      unsigned currentBytesRead = 0;
-      long actualBytesRead = 1;
-      int ovBitstream = 0;
+void AudioWin::Pause(AudioFileHandle audioFileHandle) {
+  AudioCommand command = {AudioCommandType::Pause, audioFileHandle,
+                          AudioCategory::Sound, 0.0f, 0};
+  PostCommand(command);
+}
 
-      int bytesToPcmEOF =
-          (int)(pFile->totalPcmBytes_ - pFile->currentTotalPcmPos_);
-      //OutputDebugStringW((std::wstring(L"Audio Update: bytesToPcmEOF: ") +
-      //                    std::to_wstring(bytesToPcmEOF) + L"\n")
-      //                       .c_str());
-      bool reachedEOF = false;
-      if (bytesToPcmEOF < readBufLen) {
-        readBufLen = bytesToPcmEOF;
-        reachedEOF = true;
-        //OutputDebugStringW(L"Audio Update: reachedEOF true\n");
-      }
+void AudioWin::Resume(AudioFileHandle audioFileHandle) {
+  AudioCommand command = {AudioCommandType::Resume, audioFileHandle,
+                          AudioCategory::Sound, 0.0f, 0};
+  PostCommand(command);
+}
 
-      size_t maxBytesToRead = reachedEOF ? bytesToPcmEOF : AudioStreamBufSize;
+void AudioWin::SetVolume(AudioFileHandle audioFileHandle, float volume) {
+  ClampVolume(volume);
+  AudioCommand command = {AudioCommandType::SetFileVolume, audioFileHandle,
+                          AudioCategory::Sound, volume, 0};
+  PostCommand(command);
+}
 
-      AudioFileOggWin* pOggFile = static_cast<AudioFileOggWin*>(pFile);
+void AudioWin::SetVolume(AudioCategory category, float volume) {
+  ClampVolume(volume);
+  AudioCommand command = {AudioCommandType::SetCategoryVolume, 0, category,
+                          volume, 0};
+  PostCommand(command);
+}
 
-      while (actualBytesRead && currentBytesRead < maxBytesToRead) {
-        actualBytesRead = ::ov_read(
-            &pOggFile->oggVorbisFile_, (char*)&pFile->pDataBuffer_[destBufPos],
-            readBufLen, 0, bytesPerSample, 1, &ovBitstream);
-        //OutputDebugStringW(
-        //    (std::wstring(L"Audio Update: ov_read actualBytesRead: ") +
-        //     std::to_wstring(actualBytesRead) + L"\n")
-        //        .c_str());
-        assert(actualBytesRead >= 0 && "ov_read failed");
-        destBufPos += actualBytesRead;
-        currentBytesRead += actualBytesRead;
-        pFile->currentTotalPcmPos_ += actualBytesRead;
-        //OutputDebugStringW((std::wstring(L"Audio Update: ov_read pcmPos: ") +
-        //                    std::to_wstring(pFile->currentTotalPcmPos_) + L"\n")
-        //                       .c_str());
-        if (maxBytesToRead - currentBytesRead < (unsigned)readBufLen) {
-          readBufLen = (int)maxBytesToRead - currentBytesRead;
-        }
-      }
+void AudioWin::SetMasterVolume(float& volume) {
+  ClampVolume(volume);
+  AudioCommand command = {AudioCommandType::SetMasterVolume, 0,
+                          AudioCategory::Sound, volume, 0};
+  PostCommand(command);
+}
 
-      //bool onLastLoop = false;
-      if (reachedEOF && pFile->loopCount_ > 0 &&
-          pFile->loopCount_ != AudioBase::LOOP_INFINITE) {
-        pFile->loopCount_--;
-        //if (pFile->loopCount_ == 0) {
-        //  onLastLoop = true;
-        //}
-      }
+void AudioWin::SetPan(AudioFileHandle audioFileHandle, float pan) {
+  AudioFileBase* pAudioFile = GetAudioFile(audioFileHandle);
+  if (!pAudioFile) {
+    OutputDebugStringW(L"ERROR: SetPan GetAudioFile failed");
+    return;
+  }
 
-      // if reached the end of file and still looping,
-      // reset position to start of the file,
-      // and fill the rest of the destination buffer.
-      if (reachedEOF && pFile->loopCount_ > 0) {
-        pFile->StreamSeek(pFile->loopBackPcmSamplePos_);
+  // clamp
+  if (pan < -1.0f)
+    pan = -1.0f;
+  else if (pan > 1.0f)
+    pan = 1.0f;
 
-        if (currentBytesRead < AudioStreamBufSize) {
-          // fill the rest of the destination buffer
-          readBufLen = AudioStreamBufSize - currentBytesRead;
-          actualBytesRead = 1;
-          while (actualBytesRead && currentBytesRead < AudioStreamBufSize) {
-            actualBytesRead =
-                ::ov_read(&pOggFile->oggVorbisFile_,
-                          (char*)&pFile->pDataBuffer_[destBufPos], readBufLen,
-                          0, bytesPerSample, 1, &ovBitstream);
-            //OutputDebugStringW(
-            //    (std::wstring(L"Audio Update: ov_read actualBytesRead: ") +
-            //     std::to_wstring(actualBytesRead) + L"\n")
-            //        .c_str());
-            assert(actualBytesRead >= 0 && "ov_read failed");
-            destBufPos += actualBytesRead;
-            currentBytesRead += actualBytesRead;
-            pFile->currentTotalPcmPos_ += actualBytesRead;
-            if (AudioStreamBufSize - currentBytesRead < readBufLen) {
-              readBufLen = AudioStreamBufSize - currentBytesRead;
-            }
-          }
-        }
-      } else {  // not looping (or on last loop)
-        if (reachedEOF) {
-          pFile->lastBufferPlaying_ = true;
-          //OutputDebugStringW(L"Audio Update: set lastBufferPlaying_ true\n");
-        }
-      }
+  // set now, so GetPan reflects it right away
+  pAudioFile->pan_ = pan;
 
-      buffer.AudioBytes = currentBytesRead;
-      buffer.pAudioData = &pFile->pDataBuffer_[pFile->currentStreamBufIndex_ *
-                                               AudioStreamBufSize];
-      if (pFile->lastBufferPlaying_) {
-        buffer.Flags = XAUDIO2_END_OF_STREAM;
-      }
+  AudioCommand command = {AudioCommandType::SetPan, audioFileHandle,
+                          AudioCategory::Sound, pan, 0};
+  PostCommand(command);
+}
 
-      pFile->currentStreamBufIndex_++;
-      if (pFile->currentStreamBufIndex_ == AudioStreamBufCount) {
-        pFile->currentStreamBufIndex_ = 0;
-      }
+void AudioWin::PostCommand(const AudioCommand& command) {
+  commandQueue_.Push(command);
+  SetEvent(hAudioThreadEvent_);
+}
 
-      HRESULT hr;
-      if (FAILED(hr = pFile->sourceVoices_[0]->SubmitSourceBuffer(&buffer))) {
-        OutputDebugStringW(L"Audio Update: SubmitSourceBuffer failed\n");
-        assert(false && "Audio Update: SubmitSourceBuffer failed");
-        return;
-      }
+void AudioWin::StreamingVoiceCallback::OnBufferEnd(void* pBufferContext) {
+  pAudio_->OnStreamBufferEnd((AudioFileHandle)pBufferContext);
+}
 
-      if (pFile->lastBufferPlaying_) {
-        break;
+void AudioWin::OnStreamBufferEnd(AudioFileHandle audioFileHandle) {
+  if (!bufferEndQueue_.Push(audioFileHandle)) {
+    bBufferEndDropped_.store(true, std::memory_order_release);
+  }
+  SetEvent(hAudioThreadEvent_);
+}
+
+void AudioWin::ProcessAudioThreadWork() {
+  MANA_PROFILE_SCOPE("AudioWin::ProcessAudioThreadWork");
+  ScopedMutex lock(audioThreadLock_);
+
+  // apply commands first, in the order they were made
+  AudioCommand commands[32];
+  size_t numCommands;
+  while ((numCommands = commandQueue_.TryPopBatch(commands, 32)) > 0) {
+    for (size_t i = 0; i < numCommands; ++i) {
+      ExecuteCommand(commands[i]);
+    }
+  }
+
+  if (bBufferEndDropped_.exchange(false, std::memory_order_acq_rel)) {
+    // we don't know which files missed a notification, so top them all up
+    GetStreamingFiles();
+    for (AudioFileBase* pFileBase : streamingFiles_) {
+      FillStreamingBuffers(static_cast<AudioFileWin*>(pFileBase));
+    }
+  }
+
+  AudioFileHandle handles[32];
+  size_t numHandles;
+  while ((numHandles = bufferEndQueue_.PopAll(handles, 32)) > 0) {
+    for (size_t i = 0; i < numHandles; ++i) {
+      // the file may have been unloaded since the buffer ended
+      AudioFileWin* pFile = (AudioFileWin*)GetAudioFile(handles[i]);
+      if (pFile && pFile->loadType_ == AudioLoadType::Streaming) {
+        FillStreamingBuffers(pFile);
       }
+    }
+  }
+}
+
+void AudioWin::ExecuteCommand(const AudioCommand& command) {
+  switch (command.type) {
+    case AudioCommandType::Play:
+      PlayNow(command.audioFileHandle, command.loopCount);
+      break;
+    case AudioCommandType::Stop:
+      StopNow(command.audioFileHandle);
+      break;
+    case AudioCommandType::Pause:
+      PauseNow(command.audioFileHandle);
+      break;
+    case AudioCommandType::Resume:
+      ResumeNow(command.audioFileHandle);
+      break;
+    case AudioCommandType::SetFileVolume:
+      SetVolumeNow(command.audioFileHandle, command.value);
+      break;
+    case AudioCommandType::SetCategoryVolume:
+      SetVolumeNow(command.category, command.value);
+      break;
+    case AudioCommandType::SetMasterVolume:
+      SetMasterVolumeNow(command.value);
+      break;
+    case AudioCommandType::SetPan:
+      SetPanNow(command.audioFileHandle, command.value);
+      break;
+  }
+}
 
-      pFile->sourceVoices_[0]->GetState(&voiceState,
-                                       XAUDIO2_VOICE_NOSAMPLESPLAYED);
+unsigned long AudioThreadFunction(IThread* pThread) {
+  AudioWin* pAudio = pAudioThreadOwner;
+  assert(pAudio && "audio thread started without an AudioWin");
+  MANA_PROFILE_THREAD_NAME("Audio");
+
+  while (!pThread->IsStopping()) {
+    // woken by PostCommand, OnStreamBufferEnd, or Uninit
+    WaitForSingleObject(pAudio->hAudioThreadEvent_, INFINITE);
+    if (pThread->IsStopping()) {
+      break;
     }
+
+    pAudio->ProcessAudioThreadWork();
   }
+
+  return 0;
 }
 
-bool AudioWin::Play(AudioFileHandle audioFileHandle, uint32_t loopCount) {
+void AudioWin::PlayNow(AudioFileHandle audioFileHandle, uint32_t loopCount) {
   AudioFileWin* pFile = (AudioFileWin*)GetAudioFile(audioFileHandle);
   if (!pFile) {
-    return false;
+    return;
   }
 
   // if paused, resume
   if (pFile->isPaused_) {
-    Resume(audioFileHandle);
-    return true;
+    ResumeNow(audioFileHandle);
+    return;
   }
 
   // if streaming sound is already playing, do nothing.
   if (pFile->loadType_ == AudioLoadType::Streaming && !pFile->isPaused_ &&
       IsPlaying(audioFileHandle)) {
-    return true;
+    return;
   }
 
   IXAudio2SourceVoice* pSourceVoice =
@@ -377,7 +609,7 @@ bool AudioWin::Play(AudioFileHandle audioFileHandle, uint32_t loopCount) {
 
     if (FAILED(pSourceVoice->SubmitSourceBuffer(&buffer))) {
       OutputDebugStringW(L"ERROR: Play SubmitSourceBuffer failed!\n");
-      return false;
+      return;
     }
   } else  // streaming
   {
@@ -439,6 +671,7 @@ bool AudioWin::Play(AudioFileHandle audioFileHandle, uint32_t loopCount) {
       buffer.AudioBytes = (UINT32)currentBytesRead;
       buffer.pAudioData = &pFile->pDataBuffer_[bufIndex * AudioStreamBufSize];
       buffer.Flags = 0;
+      buffer.pContext = (void*)pFile->audioFileHandle_;
 
       pFile->currentStreamBufIndex_++;
       if (pFile->currentStreamBufIndex_ == AudioStreamBufCount) {
@@ -447,7 +680,7 @@ bool AudioWin::Play(AudioFileHandle audioFileHandle, uint32_t loopCount) {
 
       if (FAILED(pSourceVoice->SubmitSourceBuffer(&buffer))) {
         OutputDebugStringW(L"ERROR: SubmitSourceBuffer streaming failed\n");
-        return 0;
+        return;
       }
 
       ++bufIndex;
@@ -456,16 +689,14 @@ bool AudioWin::Play(AudioFileHandle audioFileHandle, uint32_t loopCount) {
 
   if (FAILED(pSourceVoice->Start())) {
     OutputDebugStringW(L"ERROR: Play Start failed!\n");
-    return false;
+    return;
   }
 
   pFile->isPaused_ = false;
   pFile->isStopped_ = false;
-
-  return true;
 }
 
-void AudioWin::Stop(AudioFileHandle audioFileHandle) {
+void AudioWin::StopNow(AudioFileHandle audioFileHandle) {
   AudioFileWin* pAudioFile = (AudioFileWin*)GetAudioFile(audioFileHandle);
   if (!pAudioFile || pAudioFile->isStopped_) {
     return;
@@ -493,7 +724,7 @@ void AudioWin::Stop(AudioFileHandle audioFileHandle) {
   }
 }
 
-void AudioWin::Pause(AudioFileHandle audioFileHandle) {
+void AudioWin::PauseNow(AudioFileHandle audioFileHandle) {
   AudioFileWin* pAudioFile = (AudioFileWin*)GetAudioFile(audioFileHandle);
   if (!pAudioFile) {
     return;
@@ -526,7 +757,7 @@ void AudioWin::Pause(AudioFileHandle audioFileHandle) {
   pAudioFile->isPaused_ = true;
 }
 
-void AudioWin::Resume(AudioFileHandle audioFileHandle) {
+void AudioWin::ResumeNow(AudioFileHandle audioFileHandle) {
   AudioFileWin* pAudioFile = (AudioFileWin*)GetAudioFile(audioFileHandle);
   if (!pAudioFile) {
     return;
@@ -587,9 +818,9 @@ float AudioWin::GetVolume(AudioCategory category) {
   float avg = 0.0f;
   int x = 1;
   float volume;
-  for (const auto& pair : fileMap_) {
-    if (pair.second->category_ == category) {
-      AudioFileWin* pFile = (AudioFileWin*)pair.second;
+  for (AudioFileBase* pAudioFile : fileMap_) {
+    if (pAudioFile && pAudioFile->category_ == category) {
+      AudioFileWin* pFile = (AudioFileWin*)pAudioFile;
 
       // we assume all voices of a sound have the same volume
       if (pFile->sourceVoices_.size() > 0) {
@@ -613,7 +844,7 @@ float AudioWin::GetMasterVolume() {
   return volume;
 }
 
-void AudioWin::SetVolume(AudioFileHandle audioFileHandle, float volume) {
+void AudioWin::SetVolumeNow(AudioFileHandle audioFileHandle, float volume) {
   AudioFileWin* pAudioFile = (AudioFileWin*)GetAudioFile(audioFileHandle);
   if (!pAudioFile) {
     return;
@@ -629,12 +860,12 @@ void AudioWin::SetVolume(AudioFileHandle audioFileHandle, float volume) {
   }
 }
 
-void AudioWin::SetVolume(AudioCategory category, float volume) {
+void AudioWin::SetVolumeNow(AudioCategory category, float volume) {
   ClampVolume(volume);
 
-  for (const auto& pair : fileMap_) {
-    if (pair.second->category_ == category) {
-      AudioFileWin* pFile = (AudioFileWin*)pair.second;
+  for (AudioFileBase* pAudioFile : fileMap_) {
+    if (pAudioFile && pAudioFile->category_ == category) {
+      AudioFileWin* pFile = (AudioFileWin*)pAudioFile;
 
       for (const auto& pSourceVoice : pFile->sourceVoices_) {
         if (FAILED(pSourceVoice->SetVolume(volume))) {
@@ -647,7 +878,7 @@ void AudioWin::SetVolume(AudioCategory category, float volume) {
   }
 }
 
-void AudioWin::SetMasterVolume(float& volume) {
+void AudioWin::SetMasterVolumeNow(float volume) {
   if (!pMasterVoice_)
     return;
 
@@ -659,7 +890,7 @@ void AudioWin::SetMasterVolume(float& volume) {
   }
 }
 
-void AudioWin::SetPan(AudioFileHandle audioFileHandle, float pan) {
+void AudioWin::SetPanNow(AudioFileHandle audioFileHandle, float pan) {
   AudioFileWin* pAudioFile = (AudioFileWin*)GetAudioFile(audioFileHandle);
   if (!pAudioFile) {
     OutputDebugStringW(L"ERROR: SetPan GetAudioFile failed");
@@ -0,0 +1,156 @@
+#include "pch.h"
+#include "audio/PcmCache.h"
+
+#include <assert.h>
+#include "utils/MemoryTracker.h"
+
+namespace Mana {
+
+PcmCache::PcmCache(size_t budgetBytes)
+    : budgetBytes_(budgetBytes),
+      bytesCached_(0),
+      bytesUnused_(0),
+      hits_(0),
+      misses_(0),
+      evictions_(0) {}
+
+PcmCache::~PcmCache() {
+  ScopedMutex lock(lock_);
+  for (auto& item : entries_) {
+    assert(item.second->refCount_ == 0 &&
+           "PcmCache destroyed while a file still uses it");
+    TaggedDeleteArray(item.second->pData);
+    delete item.second;
+  }
+  entries_.clear();
+  lru_.clear();
+}
+
+PcmBuffer* PcmCache::Acquire(U64 contentHash) {
+  ScopedMutex lock(lock_);
+
+  auto search = entries_.find(contentHash);
+  if (search == entries_.end()) {
+    ++misses_;
+    return nullptr;
+  }
+
+  PcmBuffer* pBuffer = search->second;
+  if (pBuffer->refCount_ == 0) {
+    lru_.erase(pBuffer->lruPos_);
+    bytesUnused_ -= pBuffer->size;
+  }
+  ++pBuffer->refCount_;
+  ++hits_;
+  return pBuffer;
+}
+
+PcmBuffer* PcmCache::Insert(U64 contentHash,
+                            const xstring& filePath,
+                            const PcmFormat& format,
+                            uint8_t* pData,
+                            size_t size) {
+  ScopedMutex lock(lock_);
+
+  auto search = entries_.find(contentHash);
+  if (search != entries_.end()) {
+    // lost a race with another loader decoding the same file
+    TaggedDeleteArray(pData);
+
+    PcmBuffer* pBuffer = search->second;
+    if (pBuffer->refCount_ == 0) {
+      lru_.erase(pBuffer->lruPos_);
+      bytesUnused_ -= pBuffer->size;
+    }
+    ++pBuffer->refCount_;
+    return pBuffer;
+  }
+
+  // make room first, so we don't evict what we're adding
+  if (bytesCached_ + size > budgetBytes_) {
+    EvictToBudget(budgetBytes_ > size ? budgetBytes_ - size : 0);
+  }
+
+  PcmBuffer* pBuffer = new PcmBuffer;
+  pBuffer->contentHash = contentHash;
+  pBuffer->filePath = filePath;
+  pBuffer->format = format;
+  pBuffer->pData = pData;
+  pBuffer->size = size;
+  pBuffer->refCount_ = 1;
+
+  entries_[contentHash] = pBuffer;
+  bytesCached_ += size;
+  return pBuffer;
+}
+
+void PcmCache::Release(PcmBuffer* pBuffer) {
+  if (!pBuffer) {
+    return;
+  }
+
+  ScopedMutex lock(lock_);
+
+  assert(pBuffer->refCount_ > 0 && "PcmCache::Release without a reference");
+  if (--pBuffer->refCount_ > 0) {
+    return;
+  }
+
+  // keep it around in case it's loaded again soon
+  pBuffer->lruPos_ = lru_.insert(lru_.end(), pBuffer);
+  bytesUnused_ += pBuffer->size;
+
+  if (bytesCached_ > budgetBytes_) {
+    EvictToBudget(budgetBytes_);
+  }
+}
+
+void PcmCache::SetBudget(size_t budgetBytes) {
+  ScopedMutex lock(lock_);
+  budgetBytes_ = budgetBytes;
+  EvictToBudget(budgetBytes_);
+}
+
+void PcmCache::Trim() {
+  ScopedMutex lock(lock_);
+  EvictToBudget(0);
+}
+
+PcmCacheStats PcmCache::GetStats() {
+  ScopedMutex lock(lock_);
+
+  PcmCacheStats stats;
+  stats.hits = hits_;
+  stats.misses = misses_;
+  stats.evictions = evictions_;
+  stats.entries = entries_.size();
+  stats.bytesCached = bytesCached_;
+  stats.bytesUnused = bytesUnused_;
+  return stats;
+}
+
+void PcmCache::LogStats() {
+  [[maybe_unused]] PcmCacheStats stats = GetStats();
+  ManaLogLnInfo(Channel::Sound,
+                _X("PcmCache: %llu hits, %llu misses, %llu evictions, ")
+                    _X("%llu entries, %llu KB cached (%llu KB unused)"),
+                stats.hits, stats.misses, stats.evictions, (U64)stats.entries,
+                (U64)stats.bytesCached / 1024, (U64)stats.bytesUnused / 1024);
+}
+
+void PcmCache::EvictToBudget(size_t budgetBytes) {
+  while (bytesCached_ > budgetBytes && !lru_.empty()) {
+    PcmBuffer* pBuffer = lru_.front();
+    lru_.pop_front();
+
+    bytesCached_ -= pBuffer->size;
+    bytesUnused_ -= pBuffer->size;
+    ++evictions_;
+
+    entries_.erase(pBuffer->contentHash);
+    TaggedDeleteArray(pBuffer->pData);
+    delete pBuffer;
+  }
+}
+
+}  // namespace Mana
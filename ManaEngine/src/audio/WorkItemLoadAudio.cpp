@@ -0,0 +1,62 @@
+#include "pch.h"
+#include "audio/WorkItemLoadAudio.h"
+#include "utils/AsyncIO.h"
+#include "utils/MappedFile.h"
+
+namespace Mana {
+
+JobHandle WorkItemLoadAudio::LoadAsync(JobHandle parent) {
+  if (!g_pAsyncIO) {
+    return g_pJobSystem->Run(this, parent);
+  }
+
+  // created now so it can be waited on, but only submitted by OnRead
+  decodeJob_ = g_pJobSystem->CreateJob(DecodeJob, this, parent);
+  if (!decodeJob_.IsValid()) {
+    // no job slots are free, so load before returning, like Run
+    Process();
+    return decodeJob_;
+  }
+
+  AsyncReadRequest request;
+  request.path = file_;
+  request.callback = OnRead;
+  request.pUserData = this;
+  if (!g_pAsyncIO->ReadAsync(request)) {
+    // DecodeJob falls back to Process
+    g_pJobSystem->Submit(decodeJob_);
+  }
+  return decodeJob_;
+}
+
+void WorkItemLoadAudio::OnRead(const AsyncReadResult& result) {
+  WorkItemLoadAudio* pThis = (WorkItemLoadAudio*)result.pUserData;
+  if (result.bSuccess) {
+    pThis->pMemory_ = new MappedFile();
+    if (!pThis->pMemory_->Adopt(result.pBuffer, result.bytesRead,
+                                MemoryTag::Audio)) {
+      delete pThis->pMemory_;
+      pThis->pMemory_ = nullptr;
+    }
+  }
+  g_pJobSystem->Submit(pThis->decodeJob_);
+}
+
+void WorkItemLoadAudio::DecodeJob(void* pData) {
+  WorkItemLoadAudio* pThis = (WorkItemLoadAudio*)pData;
+  if (!pThis->pMemory_) {
+    // the read failed, so try the blocking read, which logs why
+    pThis->Process();
+    return;
+  }
+
+  MANA_PROFILE_SCOPE("WorkItemLoadAudio::DecodeJob");
+  MappedFile* pMemory = pThis->pMemory_;
+  pThis->pMemory_ = nullptr;
+  size_t handle = pThis->pAudioEngine_->LoadFromMemory(
+      pThis->file_, pMemory, pThis->audioCategory_, pThis->audioFormat_,
+      pThis->loopBackPcmSamplePos_, pThis->simultaneousSounds_);
+  pThis->SetDone(handle);
+}
+
+}  // namespace Mana
@@ -0,0 +1,37 @@
+#include "pch.h"
+#include "concurrency/ConditionVariable.h"
+
+#include <chrono>
+#include <mutex>
+
+namespace Mana {
+
+ConditionVariable::ConditionVariable() {}
+
+ConditionVariable::~ConditionVariable() {}
+
+void ConditionVariable::Wait(Mutex& mutex) {
+  // The caller already owns the mutex, so adopt it for the wait,
+  // then release the unique_lock without unlocking it again.
+  std::unique_lock<std::mutex> lock(mutex.mutex_, std::adopt_lock);
+  conditionVariable_.wait(lock);
+  lock.release();
+}
+
+bool ConditionVariable::WaitFor(Mutex& mutex, U32 milliseconds) {
+  std::unique_lock<std::mutex> lock(mutex.mutex_, std::adopt_lock);
+  std::cv_status status = conditionVariable_.wait_for(
+      lock, std::chrono::milliseconds(milliseconds));
+  lock.release();
+  return status == std::cv_status::no_timeout;
+}
+
+void ConditionVariable::NotifyOne() {
+  conditionVariable_.notify_one();
+}
+
+void ConditionVariable::NotifyAll() {
+  conditionVariable_.notify_all();
+}
+
+}  // namespace Mana
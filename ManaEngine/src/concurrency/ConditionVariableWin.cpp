@@ -0,0 +1,35 @@
+#include "pch.h"
+#include "concurrency/ConditionVariable.h"
+
+namespace Mana {
+
+ConditionVariable::ConditionVariable() {
+  ::InitializeConditionVariable(&conditionVariable_);
+}
+
+// CONDITION_VARIABLEs don't need to be explicitly destroyed.
+ConditionVariable::~ConditionVariable() {}
+
+void ConditionVariable::Wait(Mutex& mutex) {
+  ::SleepConditionVariableCS(&conditionVariable_, &mutex.criticalSection_,
+                             INFINITE);
+}
+
+bool ConditionVariable::WaitFor(Mutex& mutex, U32 milliseconds) {
+  if (!::SleepConditionVariableCS(&conditionVariable_, &mutex.criticalSection_,
+                                  milliseconds)) {
+    // ERROR_TIMEOUT is the only expected failure
+    return false;
+  }
+  return true;
+}
+
+void ConditionVariable::NotifyOne() {
+  ::WakeConditionVariable(&conditionVariable_);
+}
+
+void ConditionVariable::NotifyAll() {
+  ::WakeAllConditionVariable(&conditionVariable_);
+}
+
+}  // namespace Mana
@@ -0,0 +1,369 @@
+#include "pch.h"
+#include "concurrency/JobSystem.h"
+
+#include <cassert>
+#include <cstdio>
+#include <thread>
+#include "utils/Log.h"
+#include "utils/Profiler.h"
+
+namespace Mana {
+
+JobSystem* g_pJobSystem = nullptr;
+
+// ThreadFunc doesn't take a user param,
+// so workers find their JobSystem through here.
+// Only one JobSystem can be initialized at a time.
+static JobSystem* pInitializedJobSystem = nullptr;
+
+static thread_local JobSystem* tlsJobSystem = nullptr;
+static thread_local I32 tlsWorkerIndex = -1;
+
+unsigned long JobWorkerThreadFunction(IThread* pThread);
+
+JobSystem::JobSystem() : pendingJobs_(0), sleepingWorkers_(0) {}
+
+JobSystem::~JobSystem() {
+  Uninit();
+}
+
+bool JobSystem::Init(U32 numWorkers) {
+  if (bInitialized_ || pInitializedJobSystem) {
+    return false;
+  }
+
+  if (numWorkers == 0) {
+    numWorkers = std::thread::hardware_concurrency();
+    if (numWorkers == 0) {
+      numWorkers = 1;
+    }
+  }
+
+  jobs_.reset(new Job[MAX_JOBS]);
+  freeJobs_.clear();
+  freeJobs_.reserve(MAX_JOBS);
+  for (U32 i = 0; i < MAX_JOBS; ++i) {
+    jobs_[i].func = nullptr;
+    jobs_[i].pData = nullptr;
+    jobs_[i].pWorkItem = nullptr;
+    jobs_[i].parent = 0;
+    jobs_[i].unfinished.store(0, std::memory_order_relaxed);
+    jobs_[i].generation.store(1, std::memory_order_relaxed);
+    // hand out low indices first
+    freeJobs_.push_back(MAX_JOBS - 1 - i);
+  }
+
+  pendingJobs_ = 0;
+  sleepingWorkers_ = 0;
+  pInitializedJobSystem = this;
+
+  // create all workers before starting any,
+  // since workers look themselves up in workers_.
+  for (U32 i = 0; i < numWorkers; ++i) {
+    deques_.push_back(std::make_unique<JobDeque>());
+
+    IThread* pWorker = ThreadFactory::Create(JobWorkerThreadFunction);
+    if (!pWorker) {
+      ManaLogLnError(Channel::Init, _X("JobSystem: failed to create worker"));
+      for (IThread* pCreated : workers_) {
+        delete pCreated;
+      }
+      workers_.clear();
+      deques_.clear();
+      pInitializedJobSystem = nullptr;
+      return false;
+    }
+    workers_.push_back(pWorker);
+  }
+
+  bInitialized_ = true;
+
+  for (IThread* pWorker : workers_) {
+    pWorker->Start();
+  }
+
+  ManaLogLnInfo(Channel::Init, _X("JobSystem: started %u workers"),
+                numWorkers);
+  return true;
+}
+
+void JobSystem::Uninit() {
+  if (!bInitialized_) {
+    return;
+  }
+
+  for (IThread* pWorker : workers_) {
+    pWorker->Stop();
+  }
+
+  {
+    ScopedMutex lock(sleepLock_);
+    sleepCondition_.NotifyAll();
+  }
+
+  for (IThread* pWorker : workers_) {
+    pWorker->Join();
+    delete pWorker;
+  }
+
+  workers_.clear();
+  deques_.clear();
+  jobs_.reset();
+  freeJobs_.clear();
+
+  pInitializedJobSystem = nullptr;
+  bInitialized_ = false;
+}
+
+JobHandle JobSystem::CreateJob(JobFunc func, void* pData, JobHandle parent) {
+  return AllocJob(func, pData, nullptr, parent);
+}
+
+JobHandle JobSystem::CreateJob(IWorkItem* pWorkItem, JobHandle parent) {
+  return AllocJob(nullptr, nullptr, pWorkItem, parent);
+}
+
+void JobSystem::Submit(JobHandle job) {
+  if (!job.IsValid()) {
+    return;
+  }
+
+  I32 workerIndex = GetCurrentWorkerIndex();
+  if (workerIndex < 0 || !deques_[workerIndex]->Push(job.index)) {
+    sharedQueue_.Push(job.index);
+  }
+
+  // Paired with WaitForJobs. Either the sleeping worker sees the new
+  // pending job, or we see the sleeping worker and wake it.
+  pendingJobs_.fetch_add(1, std::memory_order_seq_cst);
+  if (sleepingWorkers_.load(std::memory_order_seq_cst) > 0) {
+    ScopedMutex lock(sleepLock_);
+    sleepCondition_.NotifyOne();
+  }
+}
+
+JobHandle JobSystem::Run(JobFunc func, void* pData, JobHandle parent) {
+  JobHandle job = CreateJob(func, pData, parent);
+  if (!job.IsValid()) {
+    if (func) {
+      func(pData);
+    }
+    return job;
+  }
+
+  Submit(job);
+  return job;
+}
+
+JobHandle JobSystem::Run(IWorkItem* pWorkItem, JobHandle parent) {
+  JobHandle job = CreateJob(pWorkItem, parent);
+  if (!job.IsValid()) {
+    if (pWorkItem) {
+      pWorkItem->Process();
+    }
+    return job;
+  }
+
+  Submit(job);
+  return job;
+}
+
+bool JobSystem::IsDone(JobHandle job) {
+  if (!job.IsValid()) {
+    return true;
+  }
+
+  Job& slot = jobs_[job.index];
+  if (slot.generation.load(std::memory_order_acquire) != job.generation) {
+    // slot was freed (and maybe reused), so the job finished
+    return true;
+  }
+
+  return slot.unfinished.load(std::memory_order_acquire) == 0;
+}
+
+void JobSystem::Wait(JobHandle job) {
+  I32 workerIndex = GetCurrentWorkerIndex();
+  while (!IsDone(job)) {
+    if (!RunOneJob(workerIndex)) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+JobHandle JobSystem::AllocJob(JobFunc func,
+                              void* pData,
+                              IWorkItem* pWorkItem,
+                              JobHandle parent) {
+  JobHandle handle;
+  if (!bInitialized_) {
+    return handle;
+  }
+
+  U32 index;
+  {
+    ScopedMutex lock(freeJobsLock_);
+    if (freeJobs_.empty()) {
+      ManaLogLnWarning(Channel::All, _X("JobSystem: out of job slots"));
+      return handle;
+    }
+    index = freeJobs_.back();
+    freeJobs_.pop_back();
+  }
+
+  Job& job = jobs_[index];
+  job.func = func;
+  job.pData = pData;
+  job.pWorkItem = pWorkItem;
+  job.parent = 0;
+  job.unfinished.store(1, std::memory_order_relaxed);
+
+  if (parent.IsValid()) {
+    // Join the parent only while it's unfinished. Once its count reaches 0
+    // the slot is freed and may already belong to another job, so a plain
+    // IsDone check followed by an increment could land on that one.
+    Job& parentJob = jobs_[parent.index];
+    I32 unfinished = parentJob.unfinished.load(std::memory_order_acquire);
+    while (unfinished > 0 &&
+           !parentJob.unfinished.compare_exchange_weak(
+               unfinished, unfinished + 1, std::memory_order_acq_rel,
+               std::memory_order_acquire)) {
+    }
+    if (unfinished > 0) {
+      // holding a count, the parent can't be freed under us anymore
+      if (parentJob.generation.load(std::memory_order_acquire) ==
+          parent.generation) {
+        job.parent = parent.index + 1;
+      } else {
+        // the slot was reused, give the count back to its new job
+        Finish(parent.index);
+      }
+    }
+  }
+
+  handle.index = index;
+  handle.generation = job.generation.load(std::memory_order_relaxed);
+  return handle;
+}
+
+void JobSystem::FreeJob(U32 index) {
+  Job& job = jobs_[index];
+  U32 generation = job.generation.load(std::memory_order_relaxed) + 1;
+  if (generation == 0) {
+    generation = 1;
+  }
+  job.generation.store(generation, std::memory_order_release);
+
+  ScopedMutex lock(freeJobsLock_);
+  freeJobs_.push_back(index);
+}
+
+void JobSystem::Execute(U32 index) {
+  MANA_PROFILE_SCOPE("JobSystem::Execute");
+  Job& job = jobs_[index];
+  if (job.pWorkItem) {
+    job.pWorkItem->Process();
+  } else if (job.func) {
+    job.func(job.pData);
+  }
+
+  Finish(index);
+}
+
+void JobSystem::Finish(U32 index) {
+  Job& job = jobs_[index];
+  if (job.unfinished.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+    // still waiting on children
+    return;
+  }
+
+  U32 parent = job.parent;
+  FreeJob(index);
+
+  if (parent) {
+    Finish(parent - 1);
+  }
+}
+
+bool JobSystem::RunOneJob(I32 workerIndex) {
+  std::optional<U32> index;
+
+  if (workerIndex >= 0) {
+    index = deques_[workerIndex]->Pop();
+  }
+
+  if (!index.has_value() && !sharedQueue_.Empty_NoLock()) {
+    index = sharedQueue_.Pop();
+  }
+
+  if (!index.has_value()) {
+    // try to steal, starting with the next worker over
+    // so all workers don't hammer worker 0.
+    size_t numDeques = deques_.size();
+    size_t start = workerIndex >= 0 ? (size_t)workerIndex + 1 : 0;
+    for (size_t i = 0; i < numDeques && !index.has_value(); ++i) {
+      size_t victim = (start + i) % numDeques;
+      if ((I32)victim == workerIndex) {
+        continue;
+      }
+      index = deques_[victim]->Steal();
+    }
+  }
+
+  if (!index.has_value()) {
+    return false;
+  }
+
+  pendingJobs_.fetch_sub(1, std::memory_order_relaxed);
+  Execute(index.value());
+  return true;
+}
+
+void JobSystem::WaitForJobs(IThread* pWorker) {
+  ScopedMutex lock(sleepLock_);
+  sleepingWorkers_.fetch_add(1, std::memory_order_seq_cst);
+  while (pendingJobs_.load(std::memory_order_seq_cst) <= 0 &&
+         !pWorker->IsStopping()) {
+    sleepCondition_.Wait(sleepLock_);
+  }
+  sleepingWorkers_.fetch_sub(1, std::memory_order_seq_cst);
+}
+
+I32 JobSystem::GetCurrentWorkerIndex() {
+  return tlsJobSystem == this ? tlsWorkerIndex : -1;
+}
+
+unsigned long JobWorkerThreadFunction(IThread* pThread) {
+  JobSystem* pJobSystem = pInitializedJobSystem;
+  assert(pJobSystem && "JobSystem worker started without a JobSystem");
+
+  I32 workerIndex = -1;
+  for (size_t i = 0; i < pJobSystem->workers_.size(); ++i) {
+    if (pJobSystem->workers_[i] == pThread) {
+      workerIndex = (I32)i;
+      break;
+    }
+  }
+  assert(workerIndex >= 0 && "JobSystem worker not found");
+
+  tlsJobSystem = pJobSystem;
+  tlsWorkerIndex = workerIndex;
+
+#ifdef MANA_PROFILING_ENABLED
+  char threadName[32];
+  snprintf(threadName, sizeof(threadName), "Job Worker %d", workerIndex);
+  MANA_PROFILE_THREAD_NAME(threadName);
+#endif
+
+  while (!pThread->IsStopping()) {
+    if (!pJobSystem->RunOneJob(workerIndex)) {
+      pJobSystem->WaitForJobs(pThread);
+    }
+  }
+
+  tlsJobSystem = nullptr;
+  tlsWorkerIndex = -1;
+  return 0;
+}
+
+}  // namespace Mana
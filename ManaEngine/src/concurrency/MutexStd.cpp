@@ -0,0 +1,26 @@
+#include "pch.h"
+#include "concurrency/Mutex.h"
+
+namespace Mana {
+
+Mutex::Mutex() {}
+
+Mutex::~Mutex() {}
+
+void Mutex::Lock() {
+  mutex_.lock();
+}
+
+void Mutex::Unlock() {
+  mutex_.unlock();
+}
+
+ScopedMutex::ScopedMutex(Mutex& mutex) : mutex_(mutex) {
+  mutex_.Lock();
+}
+
+ScopedMutex::~ScopedMutex() {
+  mutex_.Unlock();
+}
+
+}  // namespace Mana
@@ -0,0 +1,198 @@
+#include "pch.h"
+#include "concurrency/IThread.h"
+
+#ifdef MANA_THREAD_STD
+
+#include "concurrency/ConditionVariable.h"
+#include "concurrency/Mutex.h"
+#include "utils/Log.h"
+#include "datastructures/SynchronizedQueue.h"
+#include <atomic>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace Mana {
+
+unsigned long ThreadFunction(IThread* pIThread);
+
+// A portable, cross-thread-safe Thread implementation
+// built on std::thread and ConditionVariable.
+// Behaves the same as the Windows implementation in ThreadWin.cpp:
+// the thread doesn't run until Start is called, and when using the
+// work item queue, it sleeps until an item is enqueued.
+class Thread : public IThread {
+ public:
+  ~Thread() override {
+    // std::thread terminates the process if it's destroyed while joinable
+    if (thread_.joinable()) {
+      Stop();
+      Join();
+    }
+  }
+
+  bool Init(ThreadFunc pThreadFunc) override;
+
+  void Start() override {
+    ScopedMutex lock(lock_);
+    if (!bInitialized_ || bStarted_) {
+      return;
+    }
+    bStarted_ = true;
+    thread_ = std::thread(ThreadFunction, this);
+  }
+
+  void Stop() override {
+    bStopping_ = true;
+    ScopedMutex lock(lock_);
+    wait_.NotifyAll();
+    // TODO: m_queue.Clear();
+  }
+
+  bool IsStopping() override {
+    return bStopping_ == true;
+  }
+
+  void Join() override {
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+  void EnqueueWorkItem(IWorkItem* pWorkItem) override {
+    ScopedMutex lock(lock_);
+    list_.push_back(pWorkItem);
+    queue_.Push(pWorkItem);
+    wait_.NotifyOne();
+  }
+
+  bool IsAllItemsProcessed() override {
+    ScopedMutex lock(lock_);
+
+    for (const auto& item : list_) {
+      if (item->GetHandleIfDoneProcessing() == 0)
+        return false;
+    }
+
+    return true;
+  }
+
+  void ClearProcessedItems() override {
+    ScopedMutex lock(lock_);
+    list_.clear();
+  }
+
+ private:
+  bool bInitialized_ = false;
+  bool bStarted_ = false;
+  Mutex lock_;
+  std::thread thread_;
+  // TODO: shared_ptr<IWorkItem>
+  std::vector<IWorkItem*> list_;
+  SynchronizedQueue<IWorkItem*> queue_;
+  // signaled (while holding lock_) when an item is enqueued or on Stop
+  ConditionVariable wait_;
+  std::atomic<bool> bStopping_ = false;
+  ThreadFunc pThreadFunc_ = nullptr;
+
+  // Sleeps until there's a work item to process or the thread is stopping.
+  // Returns false if stopping.
+  bool WaitForWork();
+
+  friend unsigned long ThreadFunction(IThread* pIThread);
+};
+
+bool Thread::Init(ThreadFunc pThreadFunc) {
+  ScopedMutex lock(lock_);
+
+  if (bInitialized_)
+    return false;
+
+  // the std::thread itself is created in Start,
+  // since std::thread has no equivalent of CREATE_SUSPENDED.
+  pThreadFunc_ = pThreadFunc;
+
+  bInitialized_ = true;
+  return true;
+}
+
+bool Thread::WaitForWork() {
+  ScopedMutex lock(lock_);
+  // The queue's empty flag is updated before EnqueueWorkItem
+  // notifies (under lock_), so we can't miss a wake-up here.
+  while (queue_.Empty_NoLock() && !IsStopping()) {
+    wait_.Wait(lock_);
+  }
+  return !IsStopping();
+}
+
+unsigned long ThreadFunction(IThread* pIThread) {
+  Thread* pThread = static_cast<Thread*>(pIThread);
+
+  ManaLogLnInfo(Channel::Init, _X("ThreadFunction"));
+
+  if (pThread->pThreadFunc_) {
+    return pThread->pThreadFunc_(pThread);
+  } else {
+    while (!pThread->IsStopping()) {
+      std::optional<IWorkItem*> workItem = pThread->queue_.Pop();
+
+      if (!workItem.has_value()) {
+        if (!pThread->WaitForWork()) {
+          break;
+        }
+      } else {
+        workItem.value()->Process();
+      }
+
+      while (1) {
+        workItem = pThread->queue_.Pop();
+        if (!workItem.has_value()) {
+          break;
+        }
+        workItem.value()->Process();
+      }
+    }
+
+    return 0;
+  }
+}
+
+namespace ThreadFactory {
+
+// TODO: do we really need this? leave it for now in case we want to add more
+// properties/management of the threads.
+class PrivateThreadFactory {
+ public:
+  static PrivateThreadFactory& Instance() {
+    static PrivateThreadFactory instance;
+    return instance;
+  }
+
+  IThread* CreateThread(ThreadFunc pThreadFunc);
+};
+
+IThread* PrivateThreadFactory::CreateThread(ThreadFunc pThreadFunc) {
+  Thread* pThread = new Thread();
+  if (!pThread) {
+    return nullptr;
+  }
+
+  if (!pThread->Init(pThreadFunc)) {
+    delete pThread;
+    return nullptr;
+  }
+
+  return pThread;
+}
+
+// public factory function
+IThread* Create(ThreadFunc pThreadFunc) {
+  return PrivateThreadFactory::Instance().CreateThread(pThreadFunc);
+}
+
+}  // namespace ThreadFactory
+
+}  // namespace Mana
+
+#endif  // #ifdef MANA_THREAD_STD
@@ -1,5 +1,8 @@
 #include "pch.h"
 #include "concurrency/IThread.h"
+
+#ifndef MANA_THREAD_STD
+
 #include "concurrency/Mutex.h"
 #include "utils/Log.h"
 #include "datastructures/SynchronizedQueue.h"
@@ -184,3 +187,5 @@ IThread* Create(ThreadFunc pThreadFunc) {
 }  // namespace ThreadFactory
 
 }  // namespace Mana
+
+#endif  // #ifndef MANA_THREAD_STD
@@ -3,7 +3,7 @@
 
 namespace Mana {
 
-bool ConfigManager::LoadDefaultConfig(File* pFile) {
+bool ConfigManager::LoadDefaultConfig(File* /*pFile*/) {
   // TODO: implement
   return false;
 }
@@ -1,12 +1,24 @@
 #include "pch.h"
 #include "events/EventManager.h"
+#include "utils/Log.h"
 
 namespace Mana {
 
 EventManager* g_pEventMan;
 
 void EventManager::EnqueueForGameLoop(SynchronizedEvent& event) {
-  syncQueue_.Push(event);
+  if (bReplaying_) {
+    return;
+  }
+
+  if (!syncQueue_.Push(event)) {
+    // only warn on the first drop, since this can fire per mouse move
+    if (syncQueue_.GetDroppedCount() == 1) {
+      ManaLogLnWarning(Channel::All,
+                       _X("EventManager: game-loop event queue full, "
+                          "dropping events"));
+    }
+  }
 }
 
 } // namespace Mana
@@ -0,0 +1,252 @@
+#include "pch.h"
+#include "events/InputRecording.h"
+
+#include <string.h>
+#include "utils/Log.h"
+
+namespace Mana {
+
+static const char INPUT_RECORDING_MAGIC[4] = {'M', 'I', 'N', 'P'};
+static const size_t INPUT_RECORDING_HEADER_BYTES = 12;
+// the longest record: 10 byte tick, 3 types, 5 byte device index and
+// the id, 3 + 3 + 3 + 10 byte key and wParam fields, 5 + 5 byte coords
+static const size_t MAX_RECORD_BYTES = 64;
+
+static U8* WriteVarint(U8* pOut, U64 value) {
+  while (value >= 0x80) {
+    *pOut++ = (U8)(value | 0x80);
+    value >>= 7;
+  }
+  *pOut++ = (U8)value;
+  return pOut;
+}
+
+// small negative numbers stay small
+static U64 ZigZag(int value) {
+  return ((U64)(U32)value << 1) ^ (U64)(I64)(value >> 31);
+}
+
+static int UnZigZag(U64 value) {
+  return (int)(U32)((value >> 1) ^ (~(value & 1) + 1));
+}
+
+// false if the varint runs past |pEnd|
+static bool ReadVarint(const U8*& pCursor, const U8* pEnd, U64& value) {
+  value = 0;
+  for (U32 shift = 0; shift < 64; shift += 7) {
+    if (pCursor >= pEnd) {
+      return false;
+    }
+    U8 byte = *pCursor++;
+    value |= (U64)(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+InputRecorder::~InputRecorder() {
+  Close();
+}
+
+bool InputRecorder::Open(const xstring& filePath, U32 tickMicros) {
+  if (pFile_) {
+    return false;
+  }
+
+#ifdef OS_WIN
+  _wfopen_s(&pFile_, filePath.c_str(), _X("wb"));
+#else
+  pFile_ = fopen(filePath.c_str(), "wb");
+#endif
+  if (!pFile_) {
+    ManaLogLnError(Channel::Input, _X("InputRecorder: can't open %s"),
+                   filePath.c_str());
+    return false;
+  }
+
+  U16 version = INPUT_RECORDING_VERSION;
+  U16 reserved = 0;
+  if (fwrite(INPUT_RECORDING_MAGIC, sizeof(INPUT_RECORDING_MAGIC), 1,
+             pFile_) != 1 ||
+      fwrite(&version, sizeof(version), 1, pFile_) != 1 ||
+      fwrite(&reserved, sizeof(reserved), 1, pFile_) != 1 ||
+      fwrite(&tickMicros, sizeof(tickMicros), 1, pFile_) != 1) {
+    ManaLogLnError(Channel::Input, _X("InputRecorder: can't write to %s"),
+                   filePath.c_str());
+    fclose(pFile_);
+    pFile_ = nullptr;
+    return false;
+  }
+
+  lastTick_ = 0;
+  eventCount_ = 0;
+  devices_.clear();
+  return true;
+}
+
+void InputRecorder::Record(U64 tick,
+                           const SynchronizedEvent* pEvents,
+                           size_t count) {
+  if (!pFile_) {
+    return;
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    const SynchronizedEvent& event = pEvents[i];
+    const InputAction& action = event.inputAction;
+    U8 record[MAX_RECORD_BYTES];
+    U8* pOut = WriteVarint(record, tick - lastTick_);
+    lastTick_ = tick;
+
+    *pOut++ = event.syncEventType;
+    *pOut++ = action.deviceType;
+    *pOut++ = action.deviceChangeType;
+
+    // a handful of devices, so a linear search is fine
+    size_t device = 0;
+    while (device < devices_.size() && devices_[device] != action.deviceId) {
+      ++device;
+    }
+    pOut = WriteVarint(pOut, device);
+    if (device == devices_.size()) {
+      devices_.push_back(action.deviceId);
+      memcpy(pOut, &action.deviceId, sizeof(action.deviceId));
+      pOut += sizeof(action.deviceId);
+    }
+
+    pOut = WriteVarint(pOut, action.virtualKey);
+    pOut = WriteVarint(pOut, action.flags);
+    pOut = WriteVarint(pOut, action.scanCode);
+    pOut = WriteVarint(pOut, action.wParam);
+    pOut = WriteVarint(pOut, ZigZag(action.mouseX));
+    pOut = WriteVarint(pOut, ZigZag(action.mouseY));
+
+    size_t bytes = (size_t)(pOut - record);
+    if (fwrite(record, 1, bytes, pFile_) != bytes) {
+      // the disk is full or gone, so stop instead of failing every event
+      ManaLogLnError(Channel::Input,
+                     _X("InputRecorder: write failed, stopped recording "
+                        "after %llu events"),
+                     eventCount_ + i);
+      fclose(pFile_);
+      pFile_ = nullptr;
+      return;
+    }
+  }
+  eventCount_ += count;
+}
+
+void InputRecorder::Close() {
+  if (!pFile_) {
+    return;
+  }
+
+  // the last buffered records are written here
+  bool bWritten = fclose(pFile_) == 0;
+  pFile_ = nullptr;
+  if (!bWritten) {
+    ManaLogLnError(Channel::Input, _X("InputRecorder: write failed"));
+    return;
+  }
+  ManaLogLnInfo(Channel::Input, _X("InputRecorder: recorded %llu events"),
+                eventCount_);
+}
+
+bool InputReplayer::Open(const xstring& filePath) {
+  if (IsOpen()) {
+    return false;
+  }
+
+  size_t size = file_.ReadAllBytes(filePath.c_str());
+  const U8* pData = file_.GetBuffer();
+  U16 version = 0;
+  if (size >= INPUT_RECORDING_HEADER_BYTES) {
+    memcpy(&version, pData + 4, sizeof(version));
+  }
+  if (size < INPUT_RECORDING_HEADER_BYTES ||
+      memcmp(pData, INPUT_RECORDING_MAGIC, sizeof(INPUT_RECORDING_MAGIC)) ||
+      version != INPUT_RECORDING_VERSION) {
+    ManaLogLnError(Channel::Input,
+                   _X("InputReplayer: %s isn't an input recording"),
+                   filePath.c_str());
+    return false;
+  }
+
+  memcpy(&tickMicros_, pData + 8, sizeof(tickMicros_));
+  pCursor_ = pData + INPUT_RECORDING_HEADER_BYTES;
+  pEnd_ = pData + size;
+  eventCount_ = 0;
+  nextTick_ = 0;
+  devices_.clear();
+  bHasNext_ = DecodeNext();
+  return true;
+}
+
+size_t InputReplayer::EnqueueDue(U64 tick, EventManager& eventMan) {
+  size_t count = 0;
+  while (bHasNext_ && nextTick_ <= tick) {
+    if (!eventMan.EnqueueReplayed(next_)) {
+      break;
+    }
+    ++count;
+    bHasNext_ = DecodeNext();
+  }
+  eventCount_ += count;
+  return count;
+}
+
+bool InputReplayer::DecodeNext() {
+  if (pCursor_ >= pEnd_) {
+    return false;
+  }
+
+  const U8* pCursor = pCursor_;
+  U64 tickDelta, device, virtualKey, flags, scanCode, wParam, mouseX, mouseY;
+  if (!ReadVarint(pCursor, pEnd_, tickDelta) || pEnd_ - pCursor < 3) {
+    ManaLogLnWarning(Channel::Input, _X("InputReplayer: recording cut off"));
+    return false;
+  }
+
+  SynchronizedEvent event = {};
+  event.syncEventType = *pCursor++;
+  event.inputAction.deviceType = *pCursor++;
+  event.inputAction.deviceChangeType = *pCursor++;
+
+  bool bOk = ReadVarint(pCursor, pEnd_, device) && device <= devices_.size();
+  if (bOk && device == devices_.size()) {
+    U64 deviceId = 0;
+    bOk = (size_t)(pEnd_ - pCursor) >= sizeof(deviceId);
+    if (bOk) {
+      memcpy(&deviceId, pCursor, sizeof(deviceId));
+      pCursor += sizeof(deviceId);
+      devices_.push_back(deviceId);
+    }
+  }
+  bOk = bOk && ReadVarint(pCursor, pEnd_, virtualKey) &&
+        ReadVarint(pCursor, pEnd_, flags) &&
+        ReadVarint(pCursor, pEnd_, scanCode) &&
+        ReadVarint(pCursor, pEnd_, wParam) &&
+        ReadVarint(pCursor, pEnd_, mouseX) &&
+        ReadVarint(pCursor, pEnd_, mouseY);
+  if (!bOk) {
+    ManaLogLnWarning(Channel::Input, _X("InputReplayer: recording cut off"));
+    return false;
+  }
+
+  event.inputAction.deviceId = devices_[(size_t)device];
+  event.inputAction.virtualKey = (U16)virtualKey;
+  event.inputAction.flags = (U16)flags;
+  event.inputAction.scanCode = (U16)scanCode;
+  event.inputAction.wParam = wParam;
+  event.inputAction.mouseX = UnZigZag(mouseX);
+  event.inputAction.mouseY = UnZigZag(mouseY);
+
+  pCursor_ = pCursor;
+  nextTick_ += tickDelta;
+  next_ = event;
+  return true;
+}
+
+}  // namespace Mana
@@ -0,0 +1,93 @@
+#include "pch.h"
+#include "events/SyntheticInput.h"
+
+namespace Mana {
+
+// keys a player might mash: WASD, space, and 1-4 (Windows virtual keys)
+static const U16 SYNTHETIC_KEYS[] = {'W', 'A', 'S', 'D', 0x20,
+                                     '1', '2', '3', '4'};
+static const size_t SYNTHETIC_KEY_COUNT =
+    sizeof(SYNTHETIC_KEYS) / sizeof(SYNTHETIC_KEYS[0]);
+// mouse moves wander around a 1920x1080 screen
+static const int SYNTHETIC_SCREEN_WIDTH = 1920;
+static const int SYNTHETIC_SCREEN_HEIGHT = 1080;
+
+static int ClampToScreen(int coord, int size) {
+  return coord < 0 ? 0 : (coord >= size ? size - 1 : coord);
+}
+
+void SyntheticInput::Init(U32 seed, U32 eventsPerUpdate) {
+  state_ = seed ? seed : 1;
+  eventsPerUpdate_ = eventsPerUpdate;
+  nextTick_ = 0;
+  bDevicesAdded_ = false;
+  heldKey_ = 0;
+  mouseX_ = SYNTHETIC_SCREEN_WIDTH / 2;
+  mouseY_ = SYNTHETIC_SCREEN_HEIGHT / 2;
+}
+
+size_t SyntheticInput::EnqueueDue(U64 tick, EventManager& eventMan) {
+  if (eventsPerUpdate_ == 0 || tick < nextTick_) {
+    return 0;
+  }
+  nextTick_ = tick + 1;
+
+  size_t count = 0;
+  SynchronizedEvent event = {};
+  if (!bDevicesAdded_) {
+    bDevicesAdded_ = true;
+    event.syncEventType = (U8)SynchronizedEventType::InputDeviceChange;
+    event.inputAction.deviceChangeType = (U8)InputDeviceChangeType::Added;
+    event.inputAction.deviceId = KEYBOARD_ID;
+    event.inputAction.deviceType = (U8)InputDeviceType::Keyboard;
+    eventMan.EnqueueForGameLoop(event);
+    event.inputAction.deviceId = MOUSE_ID;
+    event.inputAction.deviceType = (U8)InputDeviceType::Mouse;
+    eventMan.EnqueueForGameLoop(event);
+    count += 2;
+  }
+
+  for (U32 i = 0; i < eventsPerUpdate_; ++i) {
+    event = {};
+    event.syncEventType = (U8)SynchronizedEventType::Input;
+    InputAction& action = event.inputAction;
+    U32 random = NextRandom();
+
+    if (random % 4 == 0) {
+      // press a key, or let go of the one that's down
+      action.deviceId = KEYBOARD_ID;
+      action.deviceType = (U8)InputDeviceType::Keyboard;
+      if (heldKey_) {
+        action.virtualKey = heldKey_;
+        action.flags = INPUTACTION_FLAG_RELEASE;
+        heldKey_ = 0;
+      } else {
+        heldKey_ = SYNTHETIC_KEYS[(random >> 8) % SYNTHETIC_KEY_COUNT];
+        action.virtualKey = heldKey_;
+      }
+    } else {
+      // a few pixels in some direction, like a hand on the mouse
+      mouseX_ = ClampToScreen(mouseX_ + (int)((random >> 8) & 15) - 7,
+                              SYNTHETIC_SCREEN_WIDTH);
+      mouseY_ = ClampToScreen(mouseY_ + (int)((random >> 16) & 15) - 7,
+                              SYNTHETIC_SCREEN_HEIGHT);
+      action.deviceId = MOUSE_ID;
+      action.deviceType = (U8)InputDeviceType::Mouse;
+      action.mouseX = mouseX_;
+      action.mouseY = mouseY_;
+    }
+
+    eventMan.EnqueueForGameLoop(event);
+    ++count;
+  }
+  return count;
+}
+
+U32 SyntheticInput::NextRandom() {
+  state_ ^= state_ << 13;
+  state_ ^= state_ >> 17;
+  state_ ^= state_ << 5;
+  return state_;
+}
+
+}  // namespace Mana
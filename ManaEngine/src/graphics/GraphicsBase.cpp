@@ -0,0 +1,8 @@
+#include "pch.h"
+#include "graphics/GraphicsBase.h"
+
+namespace Mana {
+
+GraphicsBase* g_pGraphicsEngine = nullptr;
+
+}  // namespace Mana
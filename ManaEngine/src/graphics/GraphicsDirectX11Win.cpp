@@ -3,14 +3,13 @@
 
 #include <cassert>
 #include <vector>
+#include "utils/MemoryTracker.h"
 
 // TODO: Correctly handle lifetimes of all IDXGI interface pointers.
 //       Use ComPtr<T>
 
 namespace Mana {
 
-GraphicsBase* g_pGraphicsEngine = nullptr;
-
 GraphicsDirectX11Win::GraphicsDirectX11Win()
 #ifdef _DEBUG
     : debug_(nullptr)
@@ -156,9 +155,12 @@ bool GraphicsDirectX11Win::EnumerateAdaptersAndFullScreenModes() {
       }
 
       // Get modes.
-      DXGI_MODE_DESC* pModes = new DXGI_MODE_DESC[numModes];
-      if (FAILED(output->GetDisplayModeList(
+      DXGI_MODE_DESC* pModes = (DXGI_MODE_DESC*)TaggedMalloc(
+          MemoryTag::Graphics, numModes * sizeof(DXGI_MODE_DESC));
+      if (!pModes ||
+          FAILED(output->GetDisplayModeList(
               GraphicsDeviceDirectX11Win::dxgiFormat, 0, &numModes, pModes))) {
+        TaggedDeleteArray(pModes);
         continue;
       }
 
@@ -205,7 +207,7 @@ bool GraphicsDirectX11Win::EnumerateAdaptersAndFullScreenModes() {
 
       // TODO: store data into cross-platform objects? See GraphicsBase.h
 
-      delete[] pModes;
+      TaggedDeleteArray(pModes);
       pModes = nullptr;
     }
 
@@ -0,0 +1,28 @@
+#include "pch.h"
+#include "graphics/GraphicsNull.h"
+
+namespace Mana {
+
+bool GraphicsDeviceNull::GetSupportedMultisampleLevels(
+    std::vector<MultisampleLevel>& levels) {
+  levels.clear();
+  levels.push_back({1, 1});
+  return true;
+}
+
+xstring GraphicsNull::GetNoSupportedGPUFoundMessage() {
+  // never shown, there's always the null device
+  return xstring();
+}
+
+bool GraphicsNull::GetSupportedGPUs(std::vector<GraphicsDeviceBase*>& gpus) {
+  gpus.clear();
+  gpus.push_back(&device_);
+  return true;
+}
+
+bool GraphicsNull::SelectGPU(GraphicsDeviceBase* gpu) {
+  return gpu == &device_ && gpu->Init();
+}
+
+}  // namespace Mana
@@ -1,2 +1,8 @@
 #include "pch.h"
 #include "input/InputBase.h"
+
+namespace Mana {
+
+InputBase* g_pInputEngine = nullptr;
+
+}  // namespace Mana
@@ -5,8 +5,6 @@
 
 namespace Mana {
 
-InputBase* g_pInputEngine = nullptr;
-
 InputWin::InputWin(HWND hwnd) : hwnd_(hwnd), pRawInput_(nullptr) {}
 
 bool InputWin::Init() {
@@ -3,10 +3,12 @@
 #include "input/RawInputWin.h"
 
 #include <cassert>
-#include <strsafe.h>
 #include "events/EventManager.h"
 #include "input/InputBase.h"
 #include "input/InputWin.h"
+#include "utils/Log.h"
+#include "utils/MemoryTracker.h"
+#include "utils/Profiler.h"
 
 namespace Mana {
 
@@ -16,7 +18,8 @@ RawInputWin::RawInputWin(HWND hwndTarget)
 
 bool RawInputWin::Init() {
   // allocate dynamic memory for RAWINPUT type used at run-time.
-  pRawInput_ = (RAWINPUT*)malloc(rawInputSizeBytes_);
+  pRawInput_ =
+      (RAWINPUT*)TaggedMalloc(MemoryTag::Input, rawInputSizeBytes_);
 
   return RegisterDevices();
 }
@@ -25,7 +28,7 @@ bool RawInputWin::Uninit() {
   UnregisterDevices();
 
   if (pRawInput_) {
-    free(pRawInput_);
+    TaggedFree(pRawInput_);
     pRawInput_ = nullptr;
   }
 
@@ -75,6 +78,7 @@ bool RawInputWin::UnregisterDevices() {
 // TODO: make sure the above comment's logic is consistent with
 //       other forms of input devices, such as XInput.
 bool RawInputWin::OnRawInput(HRAWINPUT hRawInput) {
+  MANA_PROFILE_SCOPE("RawInputWin::OnRawInput");
   UINT dataSize;
   if (GetRawInputData(hRawInput, RID_INPUT, nullptr, &dataSize,
                       sizeof(RAWINPUTHEADER)) != 0) {
@@ -86,11 +90,8 @@ bool RawInputWin::OnRawInput(HRAWINPUT hRawInput) {
   if (dataSize > rawInputSizeBytes_) {
     // this is ok, just want to make sure it doesn't happen often.
     // if it does happen often, adjust initial value for rawInputSizeBytes_
-    wchar_t buffer[256];
-    StringCchPrintfW(buffer, ARRAYSIZE(buffer),
-                     L"!!!!!!!! RAW INPUT REALLOC !!!!!!!! dataSize=%04u\n",
+    ManaLogLnWarning(Channel::Input, L"RawInputWin: realloc, dataSize=%04u",
                      dataSize);
-    OutputDebugStringW(buffer);
     //assert(false && "RAW INPUT REALLOC !!");
     if (!ReallocRawInputPtr(dataSize)) {
       return false;
@@ -106,27 +107,16 @@ bool RawInputWin::OnRawInput(HRAWINPUT hRawInput) {
   // --- keyboard -------------------------------------------------
   if (input->header.dwType == RIM_TYPEKEYBOARD) {
 
-#ifndef NDEBUG
-    wchar_t prefix[80];
-    prefix[0] = L'\0';
-    if (input->data.keyboard.Flags & RI_KEY_E0) {
-      StringCchCatW(prefix, ARRAYSIZE(prefix), L"E0 ");
-    }
-    if (input->data.keyboard.Flags & RI_KEY_E1) {
-      StringCchCatW(prefix, ARRAYSIZE(prefix), L"E1 ");
-    }
-
-    wchar_t buffer[256];
-    StringCchPrintfW(
-        buffer, ARRAYSIZE(buffer),
-        L"%p, msg=%04x, vk=%04x, scanCode=%s%02x, %s\n",
+    // Every key event, so only the arguments are captured here
+    // and the formatting happens on the log thread.
+    ManaLogLnVerbose(
+        Channel::Input, L"%p, msg=%04x, vk=%04x, scanCode=%s%s%02x, %s",
         input->header.hDevice, input->data.keyboard.Message,
-        input->data.keyboard.VKey, prefix, input->data.keyboard.MakeCode,
-        (input->data.keyboard.Flags & RI_KEY_BREAK) ? L"release"
-                                                    : L"press");
-
-    OutputDebugStringW(buffer);
-#endif  // DEBUG
+        input->data.keyboard.VKey,
+        (input->data.keyboard.Flags & RI_KEY_E0) ? L"E0 " : L"",
+        (input->data.keyboard.Flags & RI_KEY_E1) ? L"E1 " : L"",
+        input->data.keyboard.MakeCode,
+        (input->data.keyboard.Flags & RI_KEY_BREAK) ? L"release" : L"press");
 
     // wrap InputAction into a SyncronizedEvent and pass
     // to the SynchronizedQueue used to send it to the game-loop thread.
@@ -208,25 +198,21 @@ bool RawInputWin::OnInputDeviceChange(InputDeviceChangeType deviceChangeType,
     }
     action.deviceType = (U8)deviceType;
 
-#ifndef NDEBUG
-    std::string sDeviceChangeType("None");
+#ifdef MANA_LOGGING_ENABLED
+    const wchar_t* sDeviceChangeType = L"None";
     if (deviceChangeType == InputDeviceChangeType::Added)
-      sDeviceChangeType = "Added";
+      sDeviceChangeType = L"Added";
     else if (deviceChangeType == InputDeviceChangeType::Removed)
-      sDeviceChangeType = "Removed";
+      sDeviceChangeType = L"Removed";
 
-    std::string sDeviceType("Unknown");
+    const wchar_t* sDeviceType = L"Unknown";
     if (deviceType == InputDeviceType::Keyboard)
-      sDeviceType = "Keyboard";
+      sDeviceType = L"Keyboard";
     //else if (deviceType == InputDeviceType::Mouse)
-    //  sDeviceType = "Mouse";
-
-    wchar_t buffer[256];
-    StringCchPrintfW(buffer, ARRAYSIZE(buffer),
-                     L"Device %S, type:%S, hDevice: %p, name=%s\n",
-                     sDeviceChangeType.c_str(), sDeviceType.c_str(), hDevice,
-                     deviceName);
-    OutputDebugStringW(buffer);
+    //  sDeviceType = L"Mouse";
+
+    ManaLogLnInfo(Channel::Input, L"Device %s, type:%s, hDevice: %p, name=%s",
+                  sDeviceChangeType, sDeviceType, hDevice, deviceName);
 #endif
 
     g_pEventMan->EnqueueForGameLoop(syncEvent);
@@ -236,7 +222,7 @@ bool RawInputWin::OnInputDeviceChange(InputDeviceChangeType deviceChangeType,
 }
 
 bool RawInputWin::ReallocRawInputPtr(size_t size) {
-  void* ptr = realloc(pRawInput_, size);
+  void* ptr = TaggedRealloc(MemoryTag::Input, pRawInput_, size);
   if (!ptr)
     return false;
   pRawInput_ = ptr;
@@ -0,0 +1,118 @@
+#include "pch.h"
+#include "mainloop/CoroutineProcess.h"
+
+#include "utils/PoolAllocator.h"
+
+namespace Mana {
+
+// Scripts' frames hold their locals and awaiters (a LoadAudio holds its
+// work item), so most fit in a few hundred bytes.
+template <size_t SIZE>
+struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) CoroutineFrameBlock {
+  unsigned char bytes[SIZE];
+};
+
+void* AllocateCoroutineFrame(size_t size) {
+  if (size <= 128) {
+    return PoolAllocator<CoroutineFrameBlock<128>>().allocate(1);
+  } else if (size <= 256) {
+    return PoolAllocator<CoroutineFrameBlock<256>>().allocate(1);
+  } else if (size <= 512) {
+    return PoolAllocator<CoroutineFrameBlock<512>>().allocate(1);
+  } else if (size <= 1024) {
+    return PoolAllocator<CoroutineFrameBlock<1024>>().allocate(1);
+  }
+  return ::operator new(size);
+}
+
+void FreeCoroutineFrame(void* pFrame, size_t size) {
+  if (size <= 128) {
+    PoolAllocator<CoroutineFrameBlock<128>>().deallocate(
+        (CoroutineFrameBlock<128>*)pFrame, 1);
+  } else if (size <= 256) {
+    PoolAllocator<CoroutineFrameBlock<256>>().deallocate(
+        (CoroutineFrameBlock<256>*)pFrame, 1);
+  } else if (size <= 512) {
+    PoolAllocator<CoroutineFrameBlock<512>>().deallocate(
+        (CoroutineFrameBlock<512>*)pFrame, 1);
+  } else if (size <= 1024) {
+    PoolAllocator<CoroutineFrameBlock<1024>>().deallocate(
+        (CoroutineFrameBlock<1024>*)pFrame, 1);
+  } else {
+    ::operator delete(pFrame);
+  }
+}
+
+void ProcessScript::promise_type::unhandled_exception() {
+  // the frame is at its final suspend point once this returns
+  ManaLogLnError(Channel::All, _X("Coroutine script threw an exception"));
+  bFailed = true;
+}
+
+ProcessScript& ProcessScript::operator=(ProcessScript&& other) noexcept {
+  if (this != &other) {
+    if (handle_) {
+      handle_.destroy();
+    }
+    handle_ = other.handle_;
+    other.handle_ = nullptr;
+  }
+  return *this;
+}
+
+ProcessScript::~ProcessScript() {
+  if (handle_) {
+    handle_.destroy();
+  }
+}
+
+CoroutineProcess::CoroutineProcess(ProcessScript script)
+    : script_(std::move(script)) {}
+
+CoroutineProcess::~CoroutineProcess() {
+  ProcessScript::Handle handle = script_.GetHandle();
+  if (handle && g_pJobSystem) {
+    // a job may still be using the frame (LoadAudio's work item)
+    g_pJobSystem->Wait(handle.promise().waitJob);
+  }
+}
+
+void CoroutineProcess::VOnUpdate(unsigned long /*deltaMs*/) {
+  ProcessScript::Handle handle = script_.GetHandle();
+  if (!handle) {
+    Fail();
+    return;
+  }
+
+  ProcessScript::promise_type& promise = handle.promise();
+  if (handle.done()) {
+    // resuming a finished script is undefined
+    if (promise.bFailed) {
+      Fail();
+    } else {
+      Succeed();
+    }
+    return;
+  }
+
+  if (promise.waitJob.IsValid()) {
+    if (!g_pJobSystem->IsDone(promise.waitJob)) {
+      return;
+    }
+    promise.waitJob = JobHandle();
+  }
+
+  handle.resume();
+
+  if (promise.bFailed) {
+    Fail();
+  } else if (handle.done()) {
+    Succeed();
+  } else if (promise.waitMs > 0) {
+    // not updated until then, woken by the manager's TimerWheel if any
+    SleepFor(promise.waitMs);
+    promise.waitMs = 0;
+  }
+}
+
+}  // namespace Mana
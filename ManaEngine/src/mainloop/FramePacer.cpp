@@ -0,0 +1,184 @@
+#include "pch.h"
+#include "mainloop/FramePacer.h"
+
+#include <immintrin.h>  // _mm_pause
+#include <chrono>
+#include "utils/Profiler.h"
+
+namespace Mana {
+
+[[maybe_unused]] static const xchar* GetModeString(FramePacerMode mode) {
+  switch (mode) {
+    case FramePacerMode::Uncapped:
+      return _X("uncapped");
+    case FramePacerMode::TargetFps:
+      return _X("target fps");
+    case FramePacerMode::VSync:
+      return _X("vsync");
+    default:
+      return _X("MISSING MODE");
+  }
+}
+
+FramePacer::~FramePacer() {
+  Uninit();
+}
+
+bool FramePacer::Init(FramePacerMode mode, U32 targetFps) {
+  if (bInitialized_) {
+    return false;
+  }
+
+  U32 hz = targetFps;
+  if (mode == FramePacerMode::VSync) {
+    hz = GetRefreshRate();
+    if (hz == 0) {
+      hz = DEFAULT_REFRESH_HZ;
+    }
+    bVBlankWorks_ = true;
+  }
+
+  if (mode != FramePacerMode::Uncapped) {
+    if (hz == 0) {
+      return false;
+    }
+    // without a timer, sleeps are Sleep(ms) or sleep_until,
+    // and the slack calibrates to however coarse they are
+    if (!InitTimer()) {
+      ManaLogLnWarning(Channel::Perf,
+                       _X("FramePacer: no high resolution timer"));
+    }
+  }
+
+  mode_ = mode;
+  periodNs_ = hz ? 1000000000ull / hz : 0;
+  nextFrame_ = 0;
+  lastFrame_ = 0;
+  slackNs_ = INITIAL_SLACK_NS;
+  errorsNs_.Reset();
+  stats_ = {};
+  bInitialized_ = true;
+
+  ManaLogLnInfo(Channel::Perf, _X("FramePacer: %s, %u Hz"),
+                GetModeString(mode), mode == FramePacerMode::Uncapped ? 0 : hz);
+  return true;
+}
+
+void FramePacer::Uninit() {
+  if (!bInitialized_) {
+    return;
+  }
+  UninitTimer();
+  bInitialized_ = false;
+}
+
+void FramePacer::WaitForNextFrame() {
+  MANA_PROFILE_SCOPE("FramePacer::WaitForNextFrame");
+  if (!bInitialized_ || mode_ == FramePacerMode::Uncapped) {
+    return;
+  }
+
+  ++stats_.frames;
+
+  if (mode_ == FramePacerMode::VSync && bVBlankWorks_) {
+    bVBlankWorks_ = WaitForVBlank();
+    U64 woke = Now();
+    // the error is how far the time between frames is from a refresh
+    if (lastFrame_ != 0) {
+      U64 interval = woke - lastFrame_;
+      RecordError(interval > periodNs_ ? interval - periodNs_
+                                       : periodNs_ - interval);
+    }
+    lastFrame_ = woke;
+    return;
+  }
+
+  U64 now = Now();
+  if (nextFrame_ == 0 || now > nextFrame_ + periodNs_) {
+    // The first frame, or a whole frame behind (a breakpoint, a long
+    // load). Start the schedule over instead of rushing out frames to
+    // catch up. The accumulator still catches the updates up.
+    if (nextFrame_ != 0) {
+      ++stats_.lateFrames;
+    }
+    nextFrame_ = now;
+  }
+
+  WaitUntil(nextFrame_);
+  U64 woke = Now();
+  RecordError(woke - nextFrame_);
+  lastFrame_ = woke;
+  nextFrame_ += periodNs_;
+}
+
+FramePacerStats FramePacer::GetStats() const {
+  FramePacerStats stats = stats_;
+  stats.slackMicros = (U32)(slackNs_ / 1000);
+  return stats;
+}
+
+void FramePacer::LogStats() const {
+  if (mode_ == FramePacerMode::Uncapped) {
+    return;
+  }
+
+  [[maybe_unused]] FramePacerStats stats = GetStats();
+  ManaLogLnInfo(Channel::Perf,
+                _X("FramePacer: %llu frames, error us p50=%.1f p99=%.1f ")
+                    _X("p99.9=%.1f max=%.1f, %llu late, slept %llu ms, ")
+                    _X("spun %llu ms, slack %u us"),
+                stats.frames, errorsNs_.GetPercentile(50.0) / 1000.0,
+                errorsNs_.GetPercentile(99.0) / 1000.0,
+                errorsNs_.GetPercentile(99.9) / 1000.0,
+                errorsNs_.GetMax() / 1000.0, stats.lateFrames,
+                stats.sleepMicros / 1000, stats.spinMicros / 1000,
+                stats.slackMicros);
+}
+
+U64 FramePacer::Now() {
+  return (U64)std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void FramePacer::WaitUntil(U64 deadline) {
+  U64 now = Now();
+
+  if (deadline > now + slackNs_) {
+    U64 wake = deadline - slackNs_;
+    SleepUntil(wake);
+    U64 woke = Now();
+    ++stats_.sleeps;
+    stats_.sleepMicros += (woke - now) / 1000;
+
+    // Wake up early by a bit more than the sleeps end late. Grow fast
+    // when a sleep ends later than that, shrink slowly otherwise. Never
+    // more than half a frame, so one stall (a page fault, a preempted
+    // VM) can't turn the rest of the frames into spinning.
+    U64 late = woke > wake ? woke - wake : 0;
+    U64 wanted = late + late / 4;
+    if (wanted > slackNs_) {
+      slackNs_ += (wanted - slackNs_) / 2;
+    } else {
+      slackNs_ -= (slackNs_ - wanted) / 64;
+    }
+    U64 maxSlack = periodNs_ / 2 < MAX_SLACK_NS ? periodNs_ / 2 : MAX_SLACK_NS;
+    slackNs_ = slackNs_ < MIN_SLACK_NS ? MIN_SLACK_NS
+               : slackNs_ > maxSlack   ? maxSlack
+                                       : slackNs_;
+    now = woke;
+  }
+
+  U64 spinStart = now;
+  while (now < deadline) {
+    _mm_pause();
+    now = Now();
+  }
+  stats_.spinMicros += (now - spinStart) / 1000;
+}
+
+void FramePacer::RecordError(U64 errorNs) {
+  errorsNs_.Record(errorNs < 0xffffffffull ? (U32)errorNs : 0xffffffffu);
+}
+
+}  // namespace Mana
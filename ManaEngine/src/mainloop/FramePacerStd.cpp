@@ -0,0 +1,49 @@
+#include "pch.h"
+#include "mainloop/FramePacer.h"
+
+#ifndef OS_WIN
+
+#include <errno.h>
+#include <time.h>
+#include <chrono>
+#include <thread>
+
+namespace Mana {
+
+// Portable parts of FramePacer, for platforms other than Windows.
+// Same behavior as FramePacerWin.cpp, except there's no vertical blank
+// to wait on, so VSync paces to DEFAULT_REFRESH_HZ.
+
+bool FramePacer::InitTimer() {
+  return true;
+}
+
+void FramePacer::UninitTimer() {}
+
+void FramePacer::SleepUntil(U64 deadline) {
+#ifdef __linux__
+  // steady_clock is CLOCK_MONOTONIC, so Now() times can be used as is
+  timespec wake;
+  wake.tv_sec = (time_t)(deadline / 1000000000);
+  wake.tv_nsec = (long)(deadline % 1000000000);
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, nullptr) ==
+         EINTR) {
+  }
+#else
+  std::this_thread::sleep_until(std::chrono::steady_clock::time_point(
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::nanoseconds(deadline))));
+#endif
+}
+
+bool FramePacer::WaitForVBlank() {
+  return false;
+}
+
+U32 FramePacer::GetRefreshRate() {
+  return 0;
+}
+
+}  // namespace Mana
+
+#endif  // #ifndef OS_WIN
@@ -0,0 +1,85 @@
+#include "pch.h"
+#include "mainloop/FramePacer.h"
+#include "target/TargetOS.h"
+#include <dwmapi.h>
+#include <timeapi.h>
+
+#pragma comment(lib, "dwmapi.lib")
+#pragma comment(lib, "winmm.lib")
+
+// Windows 10 1803+. Older SDKs don't define it.
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+namespace Mana {
+
+// Windows parts of FramePacer (see FramePacer.cpp).
+
+bool FramePacer::InitTimer() {
+  // wakes within about half a millisecond,
+  // without raising the system wide timer resolution
+  HANDLE hTimer = CreateWaitableTimerExW(
+      nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION,
+      TIMER_ALL_ACCESS);
+  if (!hTimer) {
+    // older Windows: a normal timer, with the system timer at 1 ms
+    hTimer = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+    bTimerPeriodSet_ = timeBeginPeriod(1) == TIMERR_NOERROR;
+  }
+
+  pTimer_ = hTimer;
+  return hTimer != nullptr;
+}
+
+void FramePacer::UninitTimer() {
+  if (pTimer_) {
+    CloseHandle((HANDLE)pTimer_);
+    pTimer_ = nullptr;
+  }
+  if (bTimerPeriodSet_) {
+    timeEndPeriod(1);
+    bTimerPeriodSet_ = false;
+  }
+}
+
+void FramePacer::SleepUntil(U64 deadline) {
+  U64 now = Now();
+  if (deadline <= now) {
+    return;
+  }
+
+  if (!pTimer_) {
+    Sleep((DWORD)((deadline - now) / 1000000));
+    return;
+  }
+
+  // negative is relative, in 100 ns units
+  LARGE_INTEGER dueTime;
+  dueTime.QuadPart = -(LONGLONG)((deadline - now) / 100);
+  if (dueTime.QuadPart == 0) {
+    return;
+  }
+  if (SetWaitableTimer((HANDLE)pTimer_, &dueTime, 0, nullptr, nullptr,
+                       FALSE)) {
+    WaitForSingleObject((HANDLE)pTimer_, INFINITE);
+  }
+}
+
+bool FramePacer::WaitForVBlank() {
+  // fails when desktop composition is off (Windows 7 basic themes)
+  return SUCCEEDED(DwmFlush());
+}
+
+U32 FramePacer::GetRefreshRate() {
+  DEVMODEW mode = {};
+  mode.dmSize = sizeof(mode);
+  // 0 and 1 mean the hardware's default rate
+  if (EnumDisplaySettingsW(nullptr, ENUM_CURRENT_SETTINGS, &mode) &&
+      mode.dmDisplayFrequency > 1) {
+    return mode.dmDisplayFrequency;
+  }
+  return 0;
+}
+
+}  // namespace Mana
@@ -0,0 +1,88 @@
+#include "pch.h"
+#include "mainloop/FrameStats.h"
+
+namespace Mana {
+
+static void LogHistogram([[maybe_unused]] const xchar* pName,
+                         [[maybe_unused]] const Histogram& histogram) {
+  ManaLogLnInfo(Channel::Perf,
+                _X("FrameStats %s us: n=%llu mean=%llu p50=%u p90=%u ")
+                    _X("p99=%u p99.9=%u max=%u"),
+                pName, histogram.GetCount(), histogram.GetMean(),
+                histogram.GetPercentile(50.0), histogram.GetPercentile(90.0),
+                histogram.GetPercentile(99.0), histogram.GetPercentile(99.9),
+                histogram.GetMax());
+}
+
+void FrameStats::AddFrame(const FrameRecord& record) {
+  FrameRecord& slot = history_[frames_ % HISTORY_FRAMES];
+  slot = record;
+  slot.frame = frames_;
+
+  frameTimes_.Record(record.frameMicros);
+  if (record.updates > 0) {
+    updateTimes_.Record(record.updateMicros);
+  }
+  renderTimes_.Record(record.renderMicros);
+
+  ++frames_;
+  updates_ += record.updates;
+  if (record.droppedUpdates > 0) {
+    droppedUpdates_ += record.droppedUpdates;
+    ++clampedFrames_;
+  }
+
+  if (spikeMicros_ > 0 && record.frameMicros > spikeMicros_) {
+    ++spikes_;
+    if (frames_ >= nextDumpFrame_) {
+      ManaLogLnWarning(Channel::Perf,
+                       _X("FrameStats: frame %llu took %u us ")
+                           _X("(threshold %u us), last %llu frames:"),
+                       slot.frame, record.frameMicros, spikeMicros_,
+                       (U64)(frames_ < HISTORY_FRAMES ? frames_
+                                                      : HISTORY_FRAMES));
+      LogHistory();
+      nextDumpFrame_ = frames_ + HISTORY_FRAMES;
+    }
+  }
+}
+
+void FrameStats::Reset() {
+  frameTimes_.Reset();
+  updateTimes_.Reset();
+  renderTimes_.Reset();
+  frames_ = 0;
+  updates_ = 0;
+  droppedUpdates_ = 0;
+  clampedFrames_ = 0;
+  spikes_ = 0;
+  nextDumpFrame_ = 0;
+}
+
+void FrameStats::LogSummary() const {
+  ManaLogLnInfo(Channel::Perf,
+                _X("FrameStats: %llu frames, %llu updates, ")
+                    _X("%llu dropped updates in %llu clamped frames, ")
+                    _X("%llu spikes over %u us"),
+                frames_, updates_, droppedUpdates_, clampedFrames_, spikes_,
+                spikeMicros_);
+  LogHistogram(_X("frame"), frameTimes_);
+  LogHistogram(_X("update"), updateTimes_);
+  LogHistogram(_X("render"), renderTimes_);
+}
+
+void FrameStats::LogHistory() const {
+  U64 first = frames_ > HISTORY_FRAMES ? frames_ - HISTORY_FRAMES : 0;
+  for (U64 frame = first; frame < frames_; ++frame) {
+    [[maybe_unused]] const FrameRecord& record =
+        history_[frame % HISTORY_FRAMES];
+    ManaLogLnInfo(Channel::Perf,
+                  _X("  frame %llu at %llu us: %u us, update %u us (%u steps, ")
+                      _X("%u dropped), render %u us"),
+                  record.frame, record.startMicros, record.frameMicros,
+                  record.updateMicros, (U32)record.updates,
+                  (U32)record.droppedUpdates, record.renderMicros);
+  }
+}
+
+}  // namespace Mana
@@ -0,0 +1,236 @@
+#include "pch.h"
+#include "mainloop/HeadlessGame.h"
+
+#include <stdlib.h>
+#include <vector>
+#include "audio/AudioMixer.h"
+#include "concurrency/JobSystem.h"
+#include "graphics/GraphicsNull.h"
+#include "mainloop/TimerWheel.h"
+#include "os/WindowNull.h"
+#include "utils/AsyncIO.h"
+#include "utils/LinearArena.h"
+#include "utils/MemoryTracker.h"
+#include "utils/ObjectPool.h"
+#include "utils/Profiler.h"
+#include "utils/Strings.h"
+
+namespace Mana {
+
+static const size_t HEADLESS_FRAME_ARENA_BYTES = 4 * 1024 * 1024;
+
+bool HeadlessGame::OnInit() {
+  // so a run that fails to start fails its test, until the loop runs
+  nReturnCode_ = 1;
+
+  if (!ManaGameBase::OnInit()) {
+    return false;
+  }
+
+  if (commandLine_.HasKey("updates")) {
+    updates_ = (U64)atoll(commandLine_.Get("updates").c_str());
+  }
+
+  g_pFrameArena = new LinearArena();
+  if (!g_pFrameArena->Init(HEADLESS_FRAME_ARENA_BYTES)) {
+    error_ = _X("Frame arena Init error");
+    return false;
+  }
+
+  pWindow_ = new WindowNull();
+  if (!pWindow_->CreateMainWindow(commandLine_, title_)) {
+    error_ = _X("CreateMainWindow error");
+    return false;
+  }
+
+  g_pEventMan = new EventManager();
+  g_pEventMan->Init();
+
+  // nothing reads devices, input is replayed or made up
+  if (commandLine_.HasKey("replay")) {
+    if (!replayer_.Open(Utf8ToXString(commandLine_.Get("replay")))) {
+      error_ = _X("Input replay Open error");
+      return false;
+    }
+    g_pEventMan->SetReplaying(true);
+    bUntilReplayEnds_ = !commandLine_.HasKey("updates");
+  } else {
+    U32 rate = DEFAULT_INPUT_RATE;
+    U32 seed = 1;
+    if (commandLine_.HasKey("input-rate")) {
+      rate = (U32)atoi(commandLine_.Get("input-rate").c_str());
+    }
+    if (commandLine_.HasKey("seed")) {
+      seed = (U32)atoi(commandLine_.Get("seed").c_str());
+    }
+    syntheticInput_.Init(seed, rate);
+  }
+  if (commandLine_.HasKey("record")) {
+    recorder_.Open(Utf8ToXString(commandLine_.Get("record")),
+                   MICROSEC_PER_UPDATE);
+  }
+
+  // the same steps as a real GPU, with the one null device
+  g_pGraphicsEngine = new GraphicsNull();
+  std::vector<GraphicsDeviceBase*> gpus;
+  if (!g_pGraphicsEngine->Init() ||
+      !g_pGraphicsEngine->EnumerateAdaptersAndFullScreenModes() ||
+      !g_pGraphicsEngine->GetSupportedGPUs(gpus) || gpus.empty() ||
+      !g_pGraphicsEngine->SelectGPU(gpus[0])) {
+    error_ = _X("GraphicsNull error");
+    return false;
+  }
+
+  g_pAudioEngine = new AudioMixer(&audioSink_, 44100, MICROSEC_PER_UPDATE);
+  if (!g_pAudioEngine->Init()) {
+    error_ = _X("AudioMixer Init error");
+    return false;
+  }
+
+  g_pJobSystem = new JobSystem();
+  if (!g_pJobSystem->Init()) {
+    error_ = _X("JobSystem Init error");
+    return false;
+  }
+
+  // scripts' LoadAudio reads through it (see WorkItemLoadAudio)
+  g_pAsyncIO = new AsyncIO();
+  if (!g_pAsyncIO->Init()) {
+    error_ = _X("AsyncIO Init error");
+    return false;
+  }
+
+  pWindow_->ShowWindow(0);
+  return true;
+}
+
+bool HeadlessGame::OnStartGameLoop() {
+  MANA_PROFILE_THREAD_NAME("Game Loop");
+
+  TimerWheel timers(MICROSEC_PER_UPDATE);
+  g_pTimerWheel = &timers;
+
+  g_clock.Reset();
+  U64 startMicros = g_clock.GetMicroseconds();
+  U64 events = 0;
+
+  for (U64 update = 0;
+       bUntilReplayEnds_ ? !replayer_.IsDone() : update < updates_;
+       ++update) {
+    MANA_PROFILE_FRAME();
+
+    // last frame's scratch memory is free again
+    g_pFrameArena->Reset();
+
+    FrameRecord frameRecord = {};
+    frameRecord.startMicros = g_clock.GetMicroseconds();
+
+    // one update per frame, so the tick is the update count
+    U64 tick = timers.GetTick();
+    if (replayer_.IsOpen()) {
+      replayer_.EnqueueDue(tick, *g_pEventMan);
+    } else {
+      syntheticInput_.EnqueueDue(tick, *g_pEventMan);
+    }
+
+    // drained into the frame's scratch memory, just big enough for what's
+    // queued. Events pushed meanwhile wait for the next frame.
+    SyncEventQueue& syncQueue = g_pEventMan->GetSyncQueue();
+    size_t numSyncEvents = 0;
+    size_t queued = syncQueue.Size();
+    SynchronizedEvent* pSyncEvents =
+        g_pFrameArena->AllocateArray<SynchronizedEvent>(queued);
+    if (queued > 0 && pSyncEvents) {
+      numSyncEvents = syncQueue.PopAll(pSyncEvents, queued);
+      recorder_.Record(tick, pSyncEvents, numSyncEvents);
+      events += numSyncEvents;
+    }
+    OnSyncEvents(pSyncEvents, numSyncEvents);
+
+    timers.Advance();
+    {
+      MANA_PROFILE_SCOPE("AudioBase::Update");
+      g_pAudioEngine->Update();
+    }
+    OnUpdate();
+
+    U64 doneMicros = g_clock.GetMicroseconds();
+    frameRecord.updates = 1;
+    frameRecord.updateMicros = (U32)(doneMicros - frameRecord.startMicros);
+    frameRecord.frameMicros = frameRecord.updateMicros;
+    frameStats_.AddFrame(frameRecord);
+  }
+
+  U64 elapsedMicros = g_clock.GetMicroseconds() - startMicros;
+  U64 updates = timers.GetTick();
+  g_pTimerWheel = nullptr;
+  recorder_.Close();
+
+  [[maybe_unused]] double seconds = elapsedMicros / 1000000.0;
+  [[maybe_unused]] double gameSeconds =
+      updates * (MICROSEC_PER_UPDATE / 1000000.0);
+  ManaLogLnInfo(Channel::Perf,
+                _X("Headless: %llu updates (%.1f s of game time) and %llu "
+                   "events in %.3f s, %.0f updates/s, %.1fx real time"),
+                updates, gameSeconds, events, seconds,
+                seconds > 0.0 ? updates / seconds : 0.0,
+                seconds > 0.0 ? gameSeconds / seconds : 0.0);
+  frameStats_.LogSummary();
+
+  nReturnCode_ = 0;
+  return true;
+}
+
+bool HeadlessGame::OnShutdown() {
+  if (!error_.empty()) {
+    ManaLogLnError(Channel::Init, _X("HeadlessGame: %s"), error_.c_str());
+  }
+
+  // allocation counts and fragmentation of every pool, which is what a
+  // soak test is looking for
+  ObjectPoolBase::LogAllStats();
+  LogMemorySnapshot();
+
+  // before the JobSystem, since its callbacks submit jobs
+  if (g_pAsyncIO) {
+    g_pAsyncIO->Uninit();
+    delete g_pAsyncIO;
+    g_pAsyncIO = nullptr;
+  }
+
+  if (g_pJobSystem) {
+    g_pJobSystem->Uninit();
+    delete g_pJobSystem;
+    g_pJobSystem = nullptr;
+  }
+
+  if (g_pAudioEngine) {
+    g_pAudioEngine->Uninit();
+    delete g_pAudioEngine;
+    g_pAudioEngine = nullptr;
+  }
+
+  if (g_pGraphicsEngine) {
+    g_pGraphicsEngine->Uninit();
+    delete g_pGraphicsEngine;
+    g_pGraphicsEngine = nullptr;
+  }
+
+  if (g_pEventMan) {
+    g_pEventMan->Uninit();
+    delete g_pEventMan;
+    g_pEventMan = nullptr;
+  }
+
+  delete pWindow_;
+  pWindow_ = nullptr;
+
+  if (g_pFrameArena) {
+    delete g_pFrameArena;
+    g_pFrameArena = nullptr;
+  }
+
+  return true;
+}
+
+}  // namespace Mana
@@ -12,6 +12,12 @@ bool ManaGameBase::OnInit() {
     return false;
   }
 
+  // e.g. --log-channels sound,graphics
+  if (commandLine_.HasKey("log-channels") &&
+      !ManaLogSetChannels(commandLine_.Get("log-channels").c_str())) {
+    ManaLogLnWarning(Channel::Init, _X("Unknown channel in --log-channels"));
+  }
+
   return true;
 }
 
@@ -24,4 +24,46 @@ StrongProcessPtr ProcessBase::RemoveChild() {
   return StrongProcessPtr();
 }
 
+void ProcessBase::SleepFor(unsigned long ms) {
+  if (state_ == State::RUNNING && ms > 0) {
+    state_ = State::SLEEPING;
+    sleepMs_ = ms;
+  }
+}
+
+void ProcessBase::ScheduleWake(TimerWheel& timers, bool* pWoken) {
+  ProcessBase* pThis = this;
+  wakeTimer_ = timers.Schedule(timers.MsToTicks(sleepMs_), [pThis, pWoken]() {
+    pThis->WakeUp();
+    *pWoken = true;
+  });
+  if (!wakeTimer_) {
+    // no timer to wake it, so don't sleep at all
+    WakeUp();
+  }
+}
+
+void ProcessBase::CancelWake(TimerWheel* pTimers) {
+  if (wakeTimer_ && pTimers) {
+    pTimers->Cancel(wakeTimer_);
+  }
+  wakeTimer_ = 0;
+}
+
+void ProcessBase::CountDownSleep(unsigned long deltaMs) {
+  if (deltaMs < sleepMs_) {
+    sleepMs_ -= deltaMs;
+  } else {
+    WakeUp();
+  }
+}
+
+void ProcessBase::WakeUp() {
+  wakeTimer_ = 0;
+  sleepMs_ = 0;
+  if (state_ == State::SLEEPING) {
+    state_ = State::RUNNING;
+  }
+}
+
 }  // namespace Mana
@@ -1,8 +1,22 @@
 #include "pch.h"
 #include "mainloop/ProcessManager.h"
 
+#include <atomic>
+#include "concurrency/JobSystem.h"
+#include "utils/Profiler.h"
+
 namespace Mana {
 
+static U32 LowestBit(U32 value) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward(&index, value);
+  return (U32)index;
+#else
+  return (U32)__builtin_ctz(value);
+#endif
+}
+
 ProcessManager::~ProcessManager() {
   ClearAllProcesses();
 }
@@ -12,29 +26,61 @@ ProcessManager::~ProcessManager() {
 // succeeded in the upper 32 bits and the number of process
 // chains that failed or were aborted in the lower 32 bits.
 unsigned int ProcessManager::UpdateProcesses(unsigned long deltaMs) {
+  MANA_PROFILE_SCOPE("ProcessManager::UpdateProcesses");
   unsigned short int successCount = 0;
   unsigned short int failCount = 0;
 
+  if (bUpdateOrderDirty_) {
+    BuildUpdateOrder();
+    bUpdateOrderDirty_ = false;
+  }
+
+  for (std::unique_ptr<ProcessArrayBase>& pArray : processArrays_) {
+    if (pArray) {
+      pArray->BeginTick();
+    }
+  }
+
+  // Update each wave, waiting for it before the next, then the typed
+  // processes of the phase. Serially, the waves' order is enough.
+  const UpdateEntry* pEntries = updateOrder_.data();
+  size_t count = updateOrder_.size();
+  bool bParallel = bParallel_ && g_pJobSystem;
+  size_t dead = 0;
+  size_t begin = 0;
+  for (U32 phase = 0; phase < PROCESS_PHASE_COUNT; ++phase) {
+    while (begin < count && pEntries[begin].phase == phase) {
+      size_t end = begin + 1;
+      while (end < count && pEntries[end].phase == phase &&
+             (!bParallel || pEntries[end].wave == pEntries[begin].wave)) {
+        ++end;
+      }
+      dead += UpdateWave(pEntries + begin, pEntries + end, deltaMs);
+      begin = end;
+    }
+
+    UpdateProcessArrays((ProcessPhase)phase, deltaMs, successCount,
+                        failCount);
+  }
+
+  if (dead == 0) {
+    // nothing to end, skip walking the list
+    return ((successCount << 16) | failCount);
+  }
+
   ProcessList::iterator it = processList_.begin();
   while (it != processList_.end()) {
-    // grab the next process
-    StrongProcessPtr pCurrProcess = (*it);
-
     // save the iterator and increment the old one in case we need to remove
     // this process from the list
     ProcessList::iterator thisIt = it;
     ++it;
 
-    // process is uninitialized, so initialize it
-    if (pCurrProcess->GetState() == ProcessBase::State::UNINITIALIZED)
-      pCurrProcess->VOnInit();
-
-    // give the process an update tick if it's running
-    if (pCurrProcess->GetState() == ProcessBase::State::RUNNING)
-      pCurrProcess->VOnUpdate(deltaMs);
-
     // check to see if the process is dead
-    if (pCurrProcess->IsDead()) {
+    // (without copying the pointer, since most processes aren't)
+    if ((*thisIt)->IsDead()) {
+      // grab the process, keeping it alive until it's removed
+      StrongProcessPtr pCurrProcess = (*thisIt);
+
       // run the appropriate exit function
       switch (pCurrProcess->GetState()) {
         case ProcessBase::State::SUCCEEDED: {
@@ -58,25 +104,294 @@ unsigned int ProcessManager::UpdateProcesses(unsigned long deltaMs) {
           ++failCount;
           break;
         }
+
+        default:
+          break;
       }
 
       // remove the process and destroy it
+      pCurrProcess->CancelWake(pTimers_);
       processList_.erase(thisIt);
+      bUpdateOrderDirty_ = true;
     }
   }
 
   return ((successCount << 16) | failCount);
 }
 
+void ProcessManager::UpdateProcessArrays(ProcessPhase phase,
+                                         unsigned long deltaMs,
+                                         unsigned short int& successCount,
+                                         unsigned short int& failCount) {
+  // By index, since a process adding a type never added before grows
+  // processArrays_. The new array's processes wait for the next tick.
+  for (size_t type = 0; type < processArrays_.size(); ++type) {
+    ProcessArrayBase* pArray = processArrays_[type].get();
+    if (pArray && pArray->GetCount(phase) > 0) {
+      pArray->Update(phase, deltaMs, arrayChildren_, successCount, failCount);
+    }
+  }
+
+  for (StrongProcessPtr& pChild : arrayChildren_) {
+    AttachProcess(pChild);
+  }
+  arrayChildren_.clear();
+}
+
+// Sorts the processes by phase, then by wave, keeping list order within
+// a wave. Both are counting sorts, so this is linear in the process count.
+// Processes waiting for a wake timer are left out.
+void ProcessManager::BuildUpdateOrder() {
+  MANA_PROFILE_SCOPE("ProcessManager::BuildUpdateOrder");
+  size_t count = 0;
+  size_t phaseStart[PROCESS_PHASE_COUNT + 1] = {};
+  for (const StrongProcessPtr& pProcess : processList_) {
+    if (!pProcess->IsWaitingForWake()) {
+      ++phaseStart[(size_t)pProcess->GetPhase() + 1];
+      ++count;
+    }
+  }
+  updateOrder_.resize(count);
+  sortScratch_.resize(count);
+
+  for (size_t phase = 0; phase < PROCESS_PHASE_COUNT; ++phase) {
+    phaseStart[phase + 1] += phaseStart[phase];
+  }
+
+  size_t phaseNext[PROCESS_PHASE_COUNT];
+  for (size_t phase = 0; phase < PROCESS_PHASE_COUNT; ++phase) {
+    phaseNext[phase] = phaseStart[phase];
+  }
+  for (const StrongProcessPtr& pProcess : processList_) {
+    if (!pProcess->IsWaitingForWake()) {
+      U32 phase = (U32)pProcess->GetPhase();
+      sortScratch_[phaseNext[phase]++] = {pProcess.get(), phase, 0};
+    }
+  }
+
+  for (size_t phase = 0; phase < PROCESS_PHASE_COUNT; ++phase) {
+    UpdateEntry* pBegin = sortScratch_.data() + phaseStart[phase];
+    UpdateEntry* pEnd = sortScratch_.data() + phaseStart[phase + 1];
+
+    // For each access bit, the wave after the last process that wrote
+    // it, and after the last process that read it. Nothing can go before
+    // |floor|, the wave after the last exclusive process.
+    U32 afterWrite[32] = {};
+    U32 afterRead[32] = {};
+    U32 floor = 0;
+    U32 waveCount = 0;
+
+    for (UpdateEntry* pEntry = pBegin; pEntry < pEnd; ++pEntry) {
+      ProcessBase* pProcess = pEntry->pProcess;
+      U32 wave = floor;
+
+      if (pProcess->IsExclusive()) {
+        // after everything so far
+        wave = waveCount;
+        floor = wave + 1;
+      } else {
+        for (U32 bits = pProcess->GetWrites(); bits; bits &= bits - 1) {
+          U32 bit = LowestBit(bits);
+          wave = afterWrite[bit] > wave ? afterWrite[bit] : wave;
+          wave = afterRead[bit] > wave ? afterRead[bit] : wave;
+        }
+        for (U32 bits = pProcess->GetReads(); bits; bits &= bits - 1) {
+          U32 bit = LowestBit(bits);
+          wave = afterWrite[bit] > wave ? afterWrite[bit] : wave;
+        }
+        for (U32 bits = pProcess->GetWrites(); bits; bits &= bits - 1) {
+          afterWrite[LowestBit(bits)] = wave + 1;
+        }
+        for (U32 bits = pProcess->GetReads(); bits; bits &= bits - 1) {
+          U32 bit = LowestBit(bits);
+          if (afterRead[bit] < wave + 1) {
+            afterRead[bit] = wave + 1;
+          }
+        }
+      }
+
+      pEntry->wave = wave;
+      waveCount = wave + 1 > waveCount ? wave + 1 : waveCount;
+    }
+
+    waveCounts_.assign(waveCount + 1, 0);
+    for (UpdateEntry* pEntry = pBegin; pEntry < pEnd; ++pEntry) {
+      ++waveCounts_[pEntry->wave + 1];
+    }
+    for (U32 wave = 0; wave < waveCount; ++wave) {
+      waveCounts_[wave + 1] += waveCounts_[wave];
+    }
+    UpdateEntry* pOut = updateOrder_.data() + phaseStart[phase];
+    for (UpdateEntry* pEntry = pBegin; pEntry < pEnd; ++pEntry) {
+      pOut[waveCounts_[pEntry->wave]++] = *pEntry;
+    }
+  }
+}
+
+size_t ProcessManager::UpdateWave(const UpdateEntry* pBegin,
+                                  const UpdateEntry* pEnd,
+                                  unsigned long deltaMs) {
+  size_t count = (size_t)(pEnd - pBegin);
+  size_t dead = 0;
+  JobHandle wave;
+  if (bParallel_ && g_pJobSystem && count >= MIN_PARALLEL_PROCESSES) {
+    wave = g_pJobSystem->CreateJob(nullptr, nullptr);
+  }
+
+  if (!wave.IsValid()) {
+    for (const UpdateEntry* pEntry = pBegin; pEntry < pEnd; ++pEntry) {
+      dead += UpdateOnCaller(pEntry->pProcess, deltaMs);
+    }
+    return dead;
+  }
+
+  // A few batches per thread, so the threads that finish first take
+  // the rest, but big enough to be worth a job.
+  size_t threads = g_pJobSystem->GetWorkerCount() + 1;
+  size_t batchSize = count / (threads * 4);
+  if (batchSize < MIN_BATCH_PROCESSES) {
+    batchSize = MIN_BATCH_PROCESSES;
+  }
+
+  // filled before any job starts, since the jobs point into it
+  batches_.clear();
+  for (const UpdateEntry* pEntry = pBegin; pEntry < pEnd;) {
+    size_t left = (size_t)(pEnd - pEntry);
+    const UpdateEntry* pBatchEnd =
+        pEntry + (left < batchSize ? left : batchSize);
+    batches_.push_back({pEntry, pBatchEnd, deltaMs, pTimers_ != nullptr, 0,
+                        0});
+    pEntry = pBatchEnd;
+  }
+  for (UpdateBatch& batch : batches_) {
+    g_pJobSystem->Run(UpdateBatchJob, &batch, wave);
+  }
+  g_pJobSystem->Submit(wave);
+
+  // the batches skip exclusive processes, they're updated here
+  for (const UpdateEntry* pEntry = pBegin; pEntry < pEnd; ++pEntry) {
+    if (pEntry->pProcess->IsExclusive()) {
+      dead += UpdateOnCaller(pEntry->pProcess, deltaMs);
+    }
+  }
+
+  g_pJobSystem->Wait(wave);
+  size_t slept = 0;
+  for (const UpdateBatch& batch : batches_) {
+    dead += batch.dead;
+    slept += batch.slept;
+  }
+
+  // the TimerWheel isn't thread safe, so the jobs leave this to us
+  if (slept > 0) {
+    for (const UpdateEntry* pEntry = pBegin; pEntry < pEnd; ++pEntry) {
+      if (pEntry->pProcess->NeedsWakeTimer()) {
+        pEntry->pProcess->ScheduleWake(*pTimers_, &bUpdateOrderDirty_);
+      }
+    }
+    bUpdateOrderDirty_ = true;
+  }
+  return dead;
+}
+
+size_t ProcessManager::UpdateOnCaller(ProcessBase* pProcess,
+                                      unsigned long deltaMs) {
+  U32 result = UpdateProcess(pProcess, deltaMs, pTimers_ != nullptr);
+  if (result & PROCESS_SLEPT) {
+    pProcess->ScheduleWake(*pTimers_, &bUpdateOrderDirty_);
+    bUpdateOrderDirty_ = true;
+  }
+  return (result & PROCESS_DIED) ? 1 : 0;
+}
+
+U32 ProcessManager::UpdateProcess(ProcessBase* pProcess,
+                                  unsigned long deltaMs,
+                                  bool bHasTimers) {
+  // without timers, sleeping processes count down every update
+  if (!bHasTimers && pProcess->IsSleeping())
+    pProcess->CountDownSleep(deltaMs);
+
+  // process is uninitialized, so initialize it
+  if (pProcess->GetState() == ProcessBase::State::UNINITIALIZED)
+    pProcess->VOnInit();
+
+  // give the process an update tick if it's running
+  if (pProcess->GetState() == ProcessBase::State::RUNNING)
+    pProcess->VOnUpdate(deltaMs);
+
+  if (pProcess->IsDead())
+    return PROCESS_DIED;
+  if (bHasTimers && pProcess->NeedsWakeTimer())
+    return PROCESS_SLEPT;
+  return 0;
+}
+
+void ProcessManager::UpdateBatchJob(void* pData) {
+  MANA_PROFILE_SCOPE("ProcessManager::UpdateBatch");
+  UpdateBatch* pBatch = (UpdateBatch*)pData;
+  for (const UpdateEntry* pEntry = pBatch->pBegin; pEntry < pBatch->pEnd;
+       ++pEntry) {
+    if (!pEntry->pProcess->IsExclusive()) {
+      U32 result =
+          UpdateProcess(pEntry->pProcess, pBatch->deltaMs, pBatch->bHasTimers);
+      pBatch->dead += (result & PROCESS_DIED) ? 1 : 0;
+      pBatch->slept += (result & PROCESS_SLEPT) ? 1 : 0;
+    }
+  }
+}
+
 // Attaches the process to the process list so it can be run on the next update.
 WeakProcessPtr ProcessManager::AttachProcess(StrongProcessPtr pProcess) {
   processList_.push_front(pProcess);
+  bUpdateOrderDirty_ = true;
   return WeakProcessPtr(pProcess);
 }
 
+ProcessBase* ProcessManager::GetProcess(ProcessHandle handle) const {
+  if (!handle.IsValid() || handle.type >= processArrays_.size() ||
+      !processArrays_[handle.type]) {
+    return nullptr;
+  }
+  return processArrays_[handle.type]->Get(handle.process);
+}
+
+void ProcessManager::SetTimerWheel(TimerWheel* pTimers) {
+  pTimers_ = pTimers;
+  for (std::unique_ptr<ProcessArrayBase>& pArray : processArrays_) {
+    if (pArray) {
+      pArray->SetTimerWheel(pTimers);
+    }
+  }
+}
+
+unsigned int ProcessManager::GetProcessCount() const {
+  size_t count = processList_.size();
+  for (const std::unique_ptr<ProcessArrayBase>& pArray : processArrays_) {
+    if (pArray) {
+      count += pArray->GetCount();
+    }
+  }
+  return (unsigned int)count;
+}
+
+U32 ProcessManager::NextProcessTypeIndex() {
+  static std::atomic<U32> nextIndex = 0;
+  return nextIndex.fetch_add(1, std::memory_order_relaxed);
+}
+
 // Clears all processes (and DOESN'T run any exit code)
 void ProcessManager::ClearAllProcesses() {
+  for (std::unique_ptr<ProcessArrayBase>& pArray : processArrays_) {
+    if (pArray) {
+      pArray->Clear();
+    }
+  }
+  for (StrongProcessPtr& pProcess : processList_) {
+    pProcess->CancelWake(pTimers_);
+  }
   processList_.clear();
+  updateOrder_.clear();
+  bUpdateOrderDirty_ = true;
 }
 
 // Aborts all processes.
@@ -90,11 +405,21 @@ void ProcessManager::AbortAllProcesses(bool immediate) {
 
     StrongProcessPtr pProcess = *tempIt;
     if (pProcess->IsAlive()) {
+      pProcess->CancelWake(pTimers_);
       pProcess->SetState(ProcessBase::State::ABORTED);
       if (immediate) {
         pProcess->VOnAbort();
         processList_.erase(tempIt);
       }
+      // the aborted sleepers end next tick
+      bUpdateOrderDirty_ = true;
+    }
+  }
+
+  // by index, since VOnAbort may add a process of a new type
+  for (size_t type = 0; type < processArrays_.size(); ++type) {
+    if (ProcessArrayBase* pArray = processArrays_[type].get()) {
+      pArray->AbortAll(immediate);
     }
   }
 }
@@ -0,0 +1,185 @@
+#include "pch.h"
+#include "mainloop/TimerWheel.h"
+
+#include "utils/Profiler.h"
+
+namespace Mana {
+
+TimerWheel* g_pTimerWheel = nullptr;
+
+TimerWheel::TimerWheel(U32 tickMicros)
+    : tickMicros_(tickMicros ? tickMicros : 1), timers_(_X("Timer")) {}
+
+TimerWheel::~TimerWheel() {
+  for (Timer*& pHead : slots_) {
+    while (pHead) {
+      Timer* pTimer = pHead;
+      Unlink(pTimer);
+      Free(pTimer);
+    }
+  }
+}
+
+TimerHandle TimerWheel::Schedule(U64 delayTicks, Callback callback) {
+  return Add(delayTicks, 0, callback);
+}
+
+TimerHandle TimerWheel::ScheduleRepeating(U64 delayTicks,
+                                          U64 periodTicks,
+                                          Callback callback) {
+  if (periodTicks == 0) {
+    periodTicks = 1;
+  }
+  return Add(delayTicks, periodTicks, callback);
+}
+
+bool TimerWheel::Cancel(TimerHandle handle) {
+  Timer* pTimer = timers_.Get(handle);
+  if (!pTimer) {
+    return false;
+  }
+
+  if (pTimer->slot == NO_SLOT) {
+    // Cancelled from a callback: its own, since no other is running.
+    // A one-shot timer already ran, a repeating one stops after this.
+    if (pTimer->period == 0 || pTimer->bCancelled) {
+      return false;
+    }
+    pTimer->bCancelled = true;
+    return true;
+  }
+
+  Unlink(pTimer);
+  Free(pTimer);
+  return true;
+}
+
+bool TimerWheel::IsScheduled(TimerHandle handle) const {
+  Timer* pTimer = timers_.Get(handle);
+  if (!pTimer) {
+    return false;
+  }
+  return pTimer->slot != NO_SLOT ||
+         (pTimer->period != 0 && !pTimer->bCancelled);
+}
+
+void TimerWheel::Advance(U64 ticks) {
+  MANA_PROFILE_SCOPE("TimerWheel::Advance");
+  for (U64 i = 0; i < ticks; ++i) {
+    if (count_ == 0) {
+      // nothing to cascade or run
+      tick_ += ticks - i;
+      return;
+    }
+
+    ++tick_;
+    for (U32 level = 1; level < LEVELS; ++level) {
+      // a level's slot comes due when the finer wheels wrap around
+      if (tick_ & ((1ull << (SLOT_BITS * level)) - 1)) {
+        break;
+      }
+      Cascade(level);
+    }
+    RunDue();
+  }
+}
+
+TimerHandle TimerWheel::Add(U64 delayTicks,
+                            U64 periodTicks,
+                            Callback& callback) {
+  Timer* pTimer = timers_.New();
+  if (!pTimer) {
+    ManaLogLnWarning(Channel::All, _X("TimerWheel: out of timers"));
+    return 0;
+  }
+
+  delayTicks = delayTicks < 1 ? 1 : delayTicks;
+  delayTicks = delayTicks > MAX_DELAY_TICKS ? MAX_DELAY_TICKS : delayTicks;
+  periodTicks =
+      periodTicks > MAX_DELAY_TICKS ? MAX_DELAY_TICKS : periodTicks;
+
+  pTimer->deadline = tick_ + delayTicks;
+  pTimer->period = periodTicks;
+  pTimer->bCancelled = false;
+  pTimer->callback = std::move(callback);
+  Insert(pTimer);
+  ++count_;
+  return timers_.GetHandle(pTimer);
+}
+
+void TimerWheel::Insert(Timer* pTimer) {
+  U64 delta = pTimer->deadline - tick_;
+  U32 level = 0;
+  while (level + 1 < LEVELS && delta >= (1ull << (SLOT_BITS * (level + 1)))) {
+    ++level;
+  }
+
+  U32 slot = level * SLOTS +
+             (U32)((pTimer->deadline >> (SLOT_BITS * level)) & (SLOTS - 1));
+  Timer*& pHead = slots_[slot];
+  pTimer->slot = slot;
+  pTimer->pPrev = nullptr;
+  pTimer->pNext = pHead;
+  if (pHead) {
+    pHead->pPrev = pTimer;
+  }
+  pHead = pTimer;
+}
+
+void TimerWheel::Unlink(Timer* pTimer) {
+  if (pTimer->pPrev) {
+    pTimer->pPrev->pNext = pTimer->pNext;
+  } else {
+    *GetList(pTimer->slot) = pTimer->pNext;
+  }
+  if (pTimer->pNext) {
+    pTimer->pNext->pPrev = pTimer->pPrev;
+  }
+  pTimer->pPrev = nullptr;
+  pTimer->pNext = nullptr;
+  pTimer->slot = NO_SLOT;
+}
+
+void TimerWheel::Cascade(U32 level) {
+  U32 slot =
+      level * SLOTS + (U32)((tick_ >> (SLOT_BITS * level)) & (SLOTS - 1));
+  Timer* pTimer = slots_[slot];
+  slots_[slot] = nullptr;
+
+  // now less than a slot of this level away, so they land further down
+  while (pTimer) {
+    Timer* pNext = pTimer->pNext;
+    Insert(pTimer);
+    pTimer = pNext;
+  }
+}
+
+void TimerWheel::RunDue() {
+  U32 slot = (U32)(tick_ & (SLOTS - 1));
+  pDue_ = slots_[slot];
+  slots_[slot] = nullptr;
+  for (Timer* pTimer = pDue_; pTimer; pTimer = pTimer->pNext) {
+    pTimer->slot = DUE_SLOT;
+  }
+
+  // one at a time off pDue_, so callbacks can cancel the ones left
+  while (pDue_) {
+    Timer* pTimer = pDue_;
+    Unlink(pTimer);
+    pTimer->callback();
+
+    if (pTimer->period != 0 && !pTimer->bCancelled) {
+      pTimer->deadline += pTimer->period;
+      Insert(pTimer);
+    } else {
+      Free(pTimer);
+    }
+  }
+}
+
+void TimerWheel::Free(Timer* pTimer) {
+  --count_;
+  timers_.Delete(pTimer);
+}
+
+}  // namespace Mana
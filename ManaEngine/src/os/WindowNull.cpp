@@ -0,0 +1,21 @@
+#include "pch.h"
+#include "os/WindowNull.h"
+
+namespace Mana {
+
+bool WindowNull::CreateMainWindow(CommandLine& /*commandLine*/,
+                                  const xstring& title) {
+  title_ = title;
+  return true;
+}
+
+bool WindowNull::ShowWindow(int /*nCmdShow*/) {
+  return true;
+}
+
+bool WindowNull::ToggleFullscreenWindowed() {
+  bFullscreen_ = !bFullscreen_;
+  return true;
+}
+
+}  // namespace Mana
@@ -0,0 +1,266 @@
+#include "pch.h"
+#include "utils/Archive.h"
+
+#include <string.h>
+#include "utils/Hash.h"
+
+namespace Mana {
+
+Archive* g_pAssetArchive = nullptr;
+
+// Decodes one LZ4 block (the raw block format, without the frame).
+// https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+// Every read and write is bounds checked, so a corrupt archive fails
+// instead of overrunning. Returns false unless exactly |destSize| bytes
+// were produced.
+static bool Lz4DecompressBlock(const U8* pSrc,
+                               size_t srcSize,
+                               U8* pDest,
+                               size_t destSize) {
+  const U8* pIn = pSrc;
+  const U8* pInEnd = pSrc + srcSize;
+  U8* pOut = pDest;
+  U8* pOutEnd = pDest + destSize;
+
+  while (pIn < pInEnd) {
+    U8 token = *pIn++;
+
+    // literals
+    size_t literalLen = token >> 4;
+    if (literalLen == 15) {
+      U8 b;
+      do {
+        if (pIn >= pInEnd) {
+          return false;
+        }
+        b = *pIn++;
+        literalLen += b;
+      } while (b == 255);
+    }
+    if (literalLen > (size_t)(pInEnd - pIn) ||
+        literalLen > (size_t)(pOutEnd - pOut)) {
+      return false;
+    }
+    memcpy(pOut, pIn, literalLen);
+    pIn += literalLen;
+    pOut += literalLen;
+
+    // the last sequence has no match
+    if (pIn == pInEnd) {
+      break;
+    }
+
+    // match
+    if (pInEnd - pIn < 2) {
+      return false;
+    }
+    size_t offset = pIn[0] | (pIn[1] << 8);
+    pIn += 2;
+    if (offset == 0 || offset > (size_t)(pOut - pDest)) {
+      return false;
+    }
+
+    size_t matchLen = token & 15;
+    if (matchLen == 15) {
+      U8 b;
+      do {
+        if (pIn >= pInEnd) {
+          return false;
+        }
+        b = *pIn++;
+        matchLen += b;
+      } while (b == 255);
+    }
+    matchLen += 4;
+    if (matchLen > (size_t)(pOutEnd - pOut)) {
+      return false;
+    }
+
+    // byte by byte, since the match may overlap what it's writing
+    const U8* pMatch = pOut - offset;
+    for (size_t i = 0; i < matchLen; ++i) {
+      pOut[i] = pMatch[i];
+    }
+    pOut += matchLen;
+  }
+
+  return pOut == pOutEnd;
+}
+
+bool Archive::Open(const xchar* fileName) {
+  Close();
+
+  if (!file_.Open(fileName)) {
+    return false;
+  }
+
+  const unsigned char* pData = file_.GetBuffer();
+  size_t size = file_.GetFileSize();
+
+  // validate everything Find and Read will touch, up front
+  const ArchiveHeader* pHeader = (const ArchiveHeader*)pData;
+  if (size < sizeof(ArchiveHeader) || memcmp(pHeader->magic, "MPAK", 4) != 0 ||
+      pHeader->version != VERSION || pHeader->bucketBits > 31) {
+    ManaLogLnError(Channel::Init, _X("Archive: %s is not a valid archive"),
+                   fileName);
+    file_.Close();
+    return false;
+  }
+
+  U64 bucketBytes = ((1ULL << pHeader->bucketBits) + 1) * sizeof(U32);
+  U64 tocBytes = (U64)pHeader->entryCount * sizeof(ArchiveEntry);
+  if (sizeof(ArchiveHeader) + bucketBytes > pHeader->tocOffset ||
+      pHeader->tocOffset + tocBytes > size ||
+      pHeader->tocOffset % alignof(ArchiveEntry) != 0) {
+    ManaLogLnError(Channel::Init, _X("Archive: %s has a bad table of contents"),
+                   fileName);
+    file_.Close();
+    return false;
+  }
+
+  const ArchiveEntry* pEntries =
+      (const ArchiveEntry*)(pData + pHeader->tocOffset);
+  for (U32 i = 0; i < pHeader->entryCount; ++i) {
+    const ArchiveEntry& entry = pEntries[i];
+    if (entry.offset > size || entry.storedSize > size - entry.offset) {
+      ManaLogLnError(Channel::Init, _X("Archive: %s is truncated"), fileName);
+      file_.Close();
+      return false;
+    }
+    // GetView hands out |size| bytes of a stored entry
+    if (!(entry.flags & FLAG_LZ4) && entry.storedSize != entry.size) {
+      ManaLogLnError(Channel::Init, _X("Archive: %s has a bad entry"),
+                     fileName);
+      file_.Close();
+      return false;
+    }
+  }
+
+  pHeader_ = pHeader;
+  pBuckets_ = (const U32*)(pData + sizeof(ArchiveHeader));
+  pEntries_ = pEntries;
+  return true;
+}
+
+void Archive::Close() {
+  pHeader_ = nullptr;
+  pBuckets_ = nullptr;
+  pEntries_ = nullptr;
+  file_.Close();
+}
+
+// static
+U64 Archive::HashPath(const xchar* path) {
+  // skip "./" prefixes
+  while (path[0] == '.' && (path[1] == '/' || path[1] == '\\')) {
+    path += 2;
+  }
+
+  U64 hash = FNV1A_64_OFFSET_BASIS;
+  for (const xchar* p = path; *p; ++p) {
+    U32 c = (U32)*p;
+#ifdef OS_WIN
+    // utf-16 to utf-8, so hashes match mpak.py's
+    if (c >= 0xD800 && c <= 0xDBFF && p[1] >= 0xDC00 && p[1] <= 0xDFFF) {
+      c = 0x10000 + ((c - 0xD800) << 10) + ((U32)p[1] - 0xDC00);
+      ++p;
+    }
+    U8 bytes[4];
+    size_t numBytes;
+    if (c < 0x80) {
+      bytes[0] = (U8)c;
+      numBytes = 1;
+    } else if (c < 0x800) {
+      bytes[0] = (U8)(0xC0 | (c >> 6));
+      bytes[1] = (U8)(0x80 | (c & 0x3F));
+      numBytes = 2;
+    } else if (c < 0x10000) {
+      bytes[0] = (U8)(0xE0 | (c >> 12));
+      bytes[1] = (U8)(0x80 | ((c >> 6) & 0x3F));
+      bytes[2] = (U8)(0x80 | (c & 0x3F));
+      numBytes = 3;
+    } else {
+      bytes[0] = (U8)(0xF0 | (c >> 18));
+      bytes[1] = (U8)(0x80 | ((c >> 12) & 0x3F));
+      bytes[2] = (U8)(0x80 | ((c >> 6) & 0x3F));
+      bytes[3] = (U8)(0x80 | (c & 0x3F));
+      numBytes = 4;
+    }
+#else
+    // already utf-8
+    U8 bytes[1] = {(U8)c};
+    size_t numBytes = 1;
+#endif
+    if (numBytes == 1) {
+      if (bytes[0] == '\\') {
+        bytes[0] = '/';
+      } else if (bytes[0] >= 'A' && bytes[0] <= 'Z') {
+        bytes[0] += 'a' - 'A';
+      }
+    }
+    hash = HashBytes64(bytes, numBytes, hash);
+  }
+
+  return hash;
+}
+
+const ArchiveEntry* Archive::Find(const xchar* path) const {
+  if (!pHeader_) {
+    return nullptr;
+  }
+
+  return Find(HashPath(path));
+}
+
+const ArchiveEntry* Archive::Find(U64 pathHash) const {
+  if (!pHeader_) {
+    return nullptr;
+  }
+
+  // entries are sorted by hash, and a bucket holds the entries
+  // whose hash starts with its (bucketBits)-bit prefix
+  U64 bucket = pHeader_->bucketBits ? pathHash >> (64 - pHeader_->bucketBits)
+                                    : 0;
+  U32 end = pBuckets_[bucket + 1];
+  if (end > pHeader_->entryCount) {
+    end = pHeader_->entryCount;
+  }
+
+  for (U32 i = pBuckets_[bucket]; i < end; ++i) {
+    if (pEntries_[i].pathHash == pathHash) {
+      return &pEntries_[i];
+    }
+  }
+
+  return nullptr;
+}
+
+const unsigned char* Archive::GetView(const ArchiveEntry* pEntry) const {
+  if (!pHeader_ || (pEntry->flags & FLAG_LZ4)) {
+    return nullptr;
+  }
+
+  return file_.GetBuffer() + pEntry->offset;
+}
+
+bool Archive::Read(const ArchiveEntry* pEntry, unsigned char* pDest) const {
+  if (!pHeader_) {
+    return false;
+  }
+
+  const unsigned char* pStored = file_.GetBuffer() + pEntry->offset;
+  if (pEntry->flags & FLAG_LZ4) {
+    return Lz4DecompressBlock(pStored, pEntry->storedSize, pDest,
+                              pEntry->size);
+  }
+
+  if (pEntry->storedSize != pEntry->size) {
+    return false;
+  }
+  if (pEntry->size > 0) {
+    memcpy(pDest, pStored, pEntry->size);
+  }
+  return true;
+}
+
+}  // namespace Mana
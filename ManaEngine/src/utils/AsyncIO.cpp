@@ -0,0 +1,374 @@
+#include "pch.h"
+#include "utils/AsyncIO.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include "utils/Archive.h"
+
+namespace Mana {
+
+AsyncIO* g_pAsyncIO = nullptr;
+
+// ThreadFunc doesn't take a user param,
+// so AsyncIO's threads find it through here.
+static AsyncIO* pInitializedAsyncIO = nullptr;
+
+unsigned long AsyncIOPoolThreadFunction(IThread* pThread);
+unsigned long AsyncIOCompletionThreadFunction(IThread* pThread);
+
+AsyncIO::AsyncIO() : backend_(AsyncIOBackend::None), pending_(0) {}
+
+AsyncIO::~AsyncIO() {
+  Uninit();
+}
+
+bool AsyncIO::Init(U32 poolThreads) {
+  if (backend_ != AsyncIOBackend::None || pInitializedAsyncIO) {
+    return false;
+  }
+  pInitializedAsyncIO = this;
+
+  if (InitNative()) {
+    pCompletionThread_ = ThreadFactory::Create(AsyncIOCompletionThreadFunction);
+    if (pCompletionThread_) {
+      pCompletionThread_->Start();
+      return true;
+    }
+    UninitNative();
+    backend_ = AsyncIOBackend::None;
+  }
+
+  if (InitThreadPool(poolThreads)) {
+    backend_ = AsyncIOBackend::ThreadPool;
+    return true;
+  }
+
+  ManaLogLnError(Channel::Init, _X("AsyncIO: Init failed"));
+  pInitializedAsyncIO = nullptr;
+  return false;
+}
+
+void AsyncIO::Uninit() {
+  if (backend_ == AsyncIOBackend::None) {
+    return;
+  }
+
+  WaitIdle();
+
+  if (backend_ == AsyncIOBackend::ThreadPool) {
+    UninitThreadPool();
+  } else {
+    pCompletionThread_->Stop();
+    WakeNativeCompletionThread();
+    pCompletionThread_->Join();
+    delete pCompletionThread_;
+    pCompletionThread_ = nullptr;
+    UninitNative();
+  }
+
+  backend_ = AsyncIOBackend::None;
+  pInitializedAsyncIO = nullptr;
+}
+
+bool AsyncIO::ReadAsync(const AsyncReadRequest& request) {
+  return ReadAsyncBatch(&request, 1) == 1;
+}
+
+size_t AsyncIO::ReadAsyncBatch(const AsyncReadRequest* pRequests,
+                               size_t count) {
+  if (backend_ == AsyncIOBackend::None) {
+    return 0;
+  }
+
+  // submit in chunks, so a big batch doesn't need a big allocation
+  const size_t CHUNK = 64;
+  AsyncRead* reads[CHUNK];
+  size_t numReads = 0;
+  size_t accepted = 0;
+
+  for (size_t i = 0; i < count; ++i) {
+    const AsyncReadRequest& request = pRequests[i];
+    if (!request.callback || (request.pDest && request.size == 0)) {
+      ManaLogLnError(Channel::All, _X("AsyncIO: invalid request for %s"),
+                     request.path.c_str());
+      continue;
+    }
+    ++accepted;
+
+    if (ReadFromArchive(request)) {
+      continue;
+    }
+
+    AsyncRead* pRead = new AsyncRead();
+    pRead->request = request;
+    pRead->pBuffer = request.pDest;
+    pRead->size = request.size;
+    pRead->bytesRead = 0;
+#ifdef OS_WIN
+    pRead->hFile = INVALID_HANDLE_VALUE;
+#else
+    pRead->fd = -1;
+#endif
+    pending_.fetch_add(1, std::memory_order_relaxed);
+
+    reads[numReads++] = pRead;
+    if (numReads == CHUNK) {
+      if (backend_ == AsyncIOBackend::ThreadPool) {
+        SubmitToThreadPool(reads, numReads);
+      } else {
+        SubmitNative(reads, numReads);
+      }
+      numReads = 0;
+    }
+  }
+
+  if (numReads > 0) {
+    if (backend_ == AsyncIOBackend::ThreadPool) {
+      SubmitToThreadPool(reads, numReads);
+    } else {
+      SubmitNative(reads, numReads);
+    }
+  }
+
+  return accepted;
+}
+
+void AsyncIO::WaitIdle() {
+  ScopedMutex lock(idleLock_);
+  while (pending_.load(std::memory_order_acquire) > 0) {
+    idleCondition_.Wait(idleLock_);
+  }
+}
+
+bool AsyncIO::PrepareBuffer(AsyncRead* pRead, U64 fileSize) {
+  const AsyncReadRequest& request = pRead->request;
+  if (request.offset > fileSize) {
+    return false;
+  }
+
+  if (request.size == 0) {
+    if (fileSize - request.offset > (U64)SIZE_MAX) {
+      return false;
+    }
+    pRead->size = (size_t)(fileSize - request.offset);
+  } else if (request.size > fileSize - request.offset) {
+    // would read past the end of the file
+    return false;
+  }
+
+  if (!pRead->pBuffer) {
+    pRead->pBuffer = new unsigned char[pRead->size];
+  }
+  return true;
+}
+
+bool AsyncIO::ReadFromArchive(const AsyncReadRequest& request) {
+  if (!g_pAssetArchive) {
+    return false;
+  }
+
+  const ArchiveEntry* pEntry = g_pAssetArchive->Find(request.path.c_str());
+  if (!pEntry) {
+    return false;
+  }
+
+  AsyncReadResult result = {request.path.c_str(), nullptr, 0, false,
+                            request.pUserData};
+
+  size_t size = request.size;
+  if (request.offset <= pEntry->size) {
+    if (size == 0) {
+      size = (size_t)(pEntry->size - request.offset);
+    }
+    if (size <= pEntry->size - request.offset) {
+      unsigned char* pBuffer =
+          request.pDest ? request.pDest : new unsigned char[size];
+
+      const unsigned char* pView = g_pAssetArchive->GetView(pEntry);
+      if (pView) {
+        memcpy(pBuffer, pView + request.offset, size);
+        result.bSuccess = true;
+      } else if (request.offset == 0 && size == pEntry->size) {
+        result.bSuccess = g_pAssetArchive->Read(pEntry, pBuffer);
+      } else {
+        // compressed, so decompress it all to get at the part we want
+        unsigned char* pWhole = new unsigned char[pEntry->size];
+        result.bSuccess = g_pAssetArchive->Read(pEntry, pWhole);
+        if (result.bSuccess) {
+          memcpy(pBuffer, pWhole + request.offset, size);
+        }
+        delete[] pWhole;
+      }
+
+      if (result.bSuccess) {
+        result.pBuffer = pBuffer;
+        result.bytesRead = size;
+      } else if (!request.pDest) {
+        delete[] pBuffer;
+      }
+    }
+  }
+
+  request.callback(result);
+  return true;
+}
+
+void AsyncIO::Complete(AsyncRead* pRead, bool bSuccess) {
+  const AsyncReadRequest& request = pRead->request;
+  if (!bSuccess) {
+    ManaLogLnWarning(Channel::All, _X("AsyncIO: failed to read %s"),
+                     request.path.c_str());
+    if (!request.pDest && pRead->pBuffer) {
+      delete[] pRead->pBuffer;
+    }
+    pRead->pBuffer = nullptr;
+  }
+
+  AsyncReadResult result = {request.path.c_str(), pRead->pBuffer,
+                            bSuccess ? pRead->size : 0, bSuccess,
+                            request.pUserData};
+  request.callback(result);
+
+  delete pRead;
+
+  // lock so WaitIdle can't miss the notification
+  if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    ScopedMutex lock(idleLock_);
+    idleCondition_.NotifyAll();
+  }
+}
+
+bool AsyncIO::InitThreadPool(U32 numThreads) {
+  if (numThreads == 0) {
+    numThreads = 1;
+  }
+
+  for (U32 i = 0; i < numThreads; ++i) {
+    IThread* pThread = ThreadFactory::Create(AsyncIOPoolThreadFunction);
+    if (!pThread) {
+      UninitThreadPool();
+      return false;
+    }
+    poolThreads_.push_back(pThread);
+  }
+
+  for (IThread* pThread : poolThreads_) {
+    pThread->Start();
+  }
+  return true;
+}
+
+void AsyncIO::UninitThreadPool() {
+  for (IThread* pThread : poolThreads_) {
+    pThread->Stop();
+  }
+  {
+    ScopedMutex lock(poolLock_);
+    poolCondition_.NotifyAll();
+  }
+  for (IThread* pThread : poolThreads_) {
+    pThread->Join();
+    delete pThread;
+  }
+  poolThreads_.clear();
+}
+
+void AsyncIO::SubmitToThreadPool(AsyncRead** ppReads, size_t count) {
+  ScopedMutex lock(poolLock_);
+  for (size_t i = 0; i < count; ++i) {
+    poolQueue_.push_back(ppReads[i]);
+  }
+  poolCondition_.NotifyAll();
+}
+
+void AsyncIO::ReadBlocking(AsyncRead* pRead) {
+  const AsyncReadRequest& request = pRead->request;
+
+  FILE* pFile = nullptr;
+#ifdef OS_WIN
+  _wfopen_s(&pFile, request.path.c_str(), L"rb");
+#else
+  pFile = fopen(request.path.c_str(), "rb");
+#endif
+  if (!pFile) {
+    Complete(pRead, false);
+    return;
+  }
+
+  // get the file size from the open file, to save a stat
+#ifdef OS_WIN
+  bool bOk = _fseeki64(pFile, 0, SEEK_END) == 0;
+  I64 fileSize = _ftelli64(pFile);
+  bOk = bOk && fileSize >= 0 && PrepareBuffer(pRead, (U64)fileSize) &&
+        _fseeki64(pFile, (I64)request.offset, SEEK_SET) == 0;
+#else
+  bool bOk = fseeko(pFile, 0, SEEK_END) == 0;
+  I64 fileSize = (I64)ftello(pFile);
+  bOk = bOk && fileSize >= 0 && PrepareBuffer(pRead, (U64)fileSize) &&
+        fseeko(pFile, (off_t)request.offset, SEEK_SET) == 0;
+#endif
+
+  if (bOk) {
+    pRead->bytesRead = fread(pRead->pBuffer, 1, pRead->size, pFile);
+    bOk = pRead->bytesRead == pRead->size;
+  }
+
+  fclose(pFile);
+  Complete(pRead, bOk);
+}
+
+unsigned long AsyncIOPoolThreadFunction(IThread* pThread) {
+  AsyncIO* pAsyncIO = pInitializedAsyncIO;
+  assert(pAsyncIO && "AsyncIO thread started without an AsyncIO");
+
+  while (true) {
+    AsyncIO::AsyncRead* pRead = nullptr;
+    {
+      ScopedMutex lock(pAsyncIO->poolLock_);
+      while (pAsyncIO->poolQueue_.empty() && !pThread->IsStopping()) {
+        pAsyncIO->poolCondition_.Wait(pAsyncIO->poolLock_);
+      }
+      // Uninit waits for reads in flight, so the queue is empty here
+      if (pAsyncIO->poolQueue_.empty()) {
+        break;
+      }
+      pRead = pAsyncIO->poolQueue_.front();
+      pAsyncIO->poolQueue_.pop_front();
+    }
+
+    pAsyncIO->ReadBlocking(pRead);
+  }
+
+  return 0;
+}
+
+unsigned long AsyncIOCompletionThreadFunction(IThread* pThread) {
+  AsyncIO* pAsyncIO = pInitializedAsyncIO;
+  assert(pAsyncIO && "AsyncIO thread started without an AsyncIO");
+
+  pAsyncIO->ProcessNativeCompletions(pThread);
+  return 0;
+}
+
+#if !defined(OS_WIN) && !defined(MANA_ASYNCIO_URING)
+
+// no native backend, so Init uses the thread pool
+
+bool AsyncIO::InitNative() {
+  return false;
+}
+
+void AsyncIO::UninitNative() {}
+
+void AsyncIO::SubmitNative(AsyncRead** ppReads, size_t count) {
+  assert(false && "AsyncIO has no native backend on this platform");
+}
+
+void AsyncIO::ProcessNativeCompletions(IThread* pThread) {}
+
+void AsyncIO::WakeNativeCompletionThread() {}
+
+#endif
+
+}  // namespace Mana
@@ -0,0 +1,310 @@
+#include "pch.h"
+#include "utils/AsyncIO.h"
+
+#ifdef MANA_ASYNCIO_URING
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace Mana {
+
+// Talks to io_uring with the raw system calls, so there's no liburing
+// dependency. See https://kernel.dk/io_uring.pdf for how the rings work.
+struct AsyncIOUring {
+  int ringFd = -1;
+
+  void* pSqRing = MAP_FAILED;
+  size_t sqRingSize = 0;
+  unsigned* pSqHead = nullptr;
+  unsigned* pSqTail = nullptr;
+  unsigned sqMask = 0;
+  unsigned* pSqArray = nullptr;
+  io_uring_sqe* pSqes = (io_uring_sqe*)MAP_FAILED;
+  size_t sqesSize = 0;
+
+  void* pCqRing = MAP_FAILED;
+  size_t cqRingSize = 0;
+  unsigned* pCqHead = nullptr;
+  unsigned* pCqTail = nullptr;
+  unsigned cqMask = 0;
+  io_uring_cqe* pCqes = nullptr;
+
+  // guards the submission ring and inFlight
+  Mutex submitLock;
+  ConditionVariable slotFree;
+  // reads the kernel owns, kept under MAX_IN_FLIGHT
+  // so the completion ring can't overflow
+  U32 inFlight = 0;
+  // SQEs written but not yet passed to io_uring_enter
+  U32 unsubmitted = 0;
+};
+
+// user_data of the NOP that wakes the completion thread
+static const U64 WAKE_USER_DATA = 0;
+
+// largest single read, since a read's length is 32 bits
+static const size_t MAX_READ_SIZE = 1u << 30;
+
+static int IoUringSetup(unsigned entries, io_uring_params* pParams) {
+  return (int)syscall(__NR_io_uring_setup, entries, pParams);
+}
+
+static int IoUringEnter(int ringFd,
+                        unsigned toSubmit,
+                        unsigned minComplete,
+                        unsigned flags) {
+  return (int)syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete,
+                      flags, nullptr, 0);
+}
+
+// Passes the unsubmitted SQEs to the kernel. Must hold submitLock.
+static void FlushSubmissions(AsyncIOUring* pUring) {
+  while (pUring->unsubmitted > 0) {
+    int submitted = IoUringEnter(pUring->ringFd, pUring->unsubmitted, 0, 0);
+    if (submitted < 0) {
+      if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+        continue;
+      }
+      // the SQEs stay in the ring and go with the next enter
+      ManaLogLnError(Channel::All, _X("AsyncIO: io_uring_enter failed (%d)"),
+                     errno);
+      return;
+    }
+    pUring->unsubmitted -= (U32)submitted;
+  }
+}
+
+// Writes a read to the submission ring, to go with the next flush.
+// Must hold submitLock.
+static void QueueRead(AsyncIOUring* pUring,
+                      int fd,
+                      unsigned char* pDest,
+                      size_t size,
+                      U64 offset,
+                      void* pUserData) {
+  unsigned tail = *pUring->pSqTail;
+  unsigned index = tail & pUring->sqMask;
+  io_uring_sqe* pSqe = &pUring->pSqes[index];
+  memset(pSqe, 0, sizeof(*pSqe));
+  pSqe->opcode = IORING_OP_READ;
+  pSqe->fd = fd;
+  pSqe->addr = (U64)(uintptr_t)pDest;
+  pSqe->len = (U32)(size < MAX_READ_SIZE ? size : MAX_READ_SIZE);
+  pSqe->off = offset;
+  pSqe->user_data = (U64)(uintptr_t)pUserData;
+  pUring->pSqArray[index] = index;
+  // the kernel reads the SQE once it sees the new tail
+  __atomic_store_n(pUring->pSqTail, tail + 1, __ATOMIC_RELEASE);
+  ++pUring->unsubmitted;
+}
+
+bool AsyncIO::InitNative() {
+  io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  int ringFd = IoUringSetup(MAX_IN_FLIGHT, &params);
+  if (ringFd < 0) {
+    // e.g. an old kernel, or io_uring disabled by a sandbox
+    ManaLogLnInfo(Channel::Init,
+                  _X("AsyncIO: io_uring unavailable (%d), using threads"),
+                  errno);
+    return false;
+  }
+
+  AsyncIOUring* pUring = new AsyncIOUring();
+  pUring->ringFd = ringFd;
+
+  pUring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(U32);
+  pUring->cqRingSize =
+      params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  pUring->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+
+  pUring->pSqRing = mmap(nullptr, pUring->sqRingSize, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+  pUring->pCqRing = mmap(nullptr, pUring->cqRingSize, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+  pUring->pSqes = (io_uring_sqe*)mmap(nullptr, pUring->sqesSize,
+                                      PROT_READ | PROT_WRITE,
+                                      MAP_SHARED | MAP_POPULATE, ringFd,
+                                      IORING_OFF_SQES);
+  if (pUring->pSqRing == MAP_FAILED || pUring->pCqRing == MAP_FAILED ||
+      pUring->pSqes == MAP_FAILED ||
+      params.cq_entries < MAX_IN_FLIGHT + 1) {
+    ManaLogLnError(Channel::Init, _X("AsyncIO: couldn't map io_uring rings"));
+    pUring_ = pUring;
+    UninitNative();
+    return false;
+  }
+
+  U8* pSq = (U8*)pUring->pSqRing;
+  pUring->pSqHead = (unsigned*)(pSq + params.sq_off.head);
+  pUring->pSqTail = (unsigned*)(pSq + params.sq_off.tail);
+  pUring->sqMask = *(unsigned*)(pSq + params.sq_off.ring_mask);
+  pUring->pSqArray = (unsigned*)(pSq + params.sq_off.array);
+
+  U8* pCq = (U8*)pUring->pCqRing;
+  pUring->pCqHead = (unsigned*)(pCq + params.cq_off.head);
+  pUring->pCqTail = (unsigned*)(pCq + params.cq_off.tail);
+  pUring->cqMask = *(unsigned*)(pCq + params.cq_off.ring_mask);
+  pUring->pCqes = (io_uring_cqe*)(pCq + params.cq_off.cqes);
+
+  pUring_ = pUring;
+  backend_ = AsyncIOBackend::IoUring;
+  return true;
+}
+
+void AsyncIO::UninitNative() {
+  if (!pUring_) {
+    return;
+  }
+
+  if (pUring_->pSqes != MAP_FAILED) {
+    munmap(pUring_->pSqes, pUring_->sqesSize);
+  }
+  if (pUring_->pCqRing != MAP_FAILED) {
+    munmap(pUring_->pCqRing, pUring_->cqRingSize);
+  }
+  if (pUring_->pSqRing != MAP_FAILED) {
+    munmap(pUring_->pSqRing, pUring_->sqRingSize);
+  }
+  close(pUring_->ringFd);
+
+  delete pUring_;
+  pUring_ = nullptr;
+}
+
+void AsyncIO::SubmitNative(AsyncRead** ppReads, size_t count) {
+  AsyncIOUring* pUring = pUring_;
+
+  // Opening is synchronous either way, so do it before taking the lock.
+  // Reads that fail here complete after the batch is submitted.
+  AsyncRead* failed[64];
+  size_t numFailed = 0;
+
+  for (size_t i = 0; i < count; ++i) {
+    AsyncRead* pRead = ppReads[i];
+    pRead->fd = open(pRead->request.path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (pRead->fd < 0 || fstat(pRead->fd, &st) != 0 ||
+        !PrepareBuffer(pRead, (U64)st.st_size)) {
+      assert(numFailed < sizeof(failed) / sizeof(failed[0]));
+      failed[numFailed++] = pRead;
+      ppReads[i] = nullptr;
+    }
+  }
+
+  {
+    ScopedMutex lock(pUring->submitLock);
+    for (size_t i = 0; i < count; ++i) {
+      AsyncRead* pRead = ppReads[i];
+      if (!pRead) {
+        continue;
+      }
+
+      while (pUring->inFlight >= MAX_IN_FLIGHT) {
+        // hand over what's queued, or nothing will complete
+        FlushSubmissions(pUring);
+        pUring->slotFree.Wait(pUring->submitLock);
+      }
+
+      ++pUring->inFlight;
+      QueueRead(pUring, pRead->fd, pRead->pBuffer, pRead->size,
+                pRead->request.offset, pRead);
+    }
+
+    // one system call for the whole batch
+    FlushSubmissions(pUring);
+  }
+
+  for (size_t i = 0; i < numFailed; ++i) {
+    if (failed[i]->fd >= 0) {
+      close(failed[i]->fd);
+    }
+    Complete(failed[i], false);
+  }
+}
+
+void AsyncIO::ProcessNativeCompletions(IThread* pThread) {
+  AsyncIOUring* pUring = pUring_;
+
+  while (true) {
+    int result = IoUringEnter(pUring->ringFd, 0, 1, IORING_ENTER_GETEVENTS);
+    if (result < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+      ManaLogLnError(Channel::All, _X("AsyncIO: io_uring_enter failed (%d)"),
+                     errno);
+    }
+
+    bool bWoken = false;
+    unsigned head = *pUring->pCqHead;
+    unsigned tail = __atomic_load_n(pUring->pCqTail, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+      io_uring_cqe* pCqe = &pUring->pCqes[head & pUring->cqMask];
+      U64 userData = pCqe->user_data;
+      I32 res = pCqe->res;
+      ++head;
+      // hand the slot back before handling it, since Complete can block
+      __atomic_store_n(pUring->pCqHead, head, __ATOMIC_RELEASE);
+
+      if (userData == WAKE_USER_DATA) {
+        bWoken = true;
+        continue;
+      }
+
+      AsyncRead* pRead = (AsyncRead*)(uintptr_t)userData;
+      if (res > 0) {
+        pRead->bytesRead += (size_t)res;
+        if (pRead->bytesRead < pRead->size) {
+          // a short read, or a file bigger than MAX_READ_SIZE
+          ScopedMutex lock(pUring->submitLock);
+          QueueRead(pUring, pRead->fd, pRead->pBuffer + pRead->bytesRead,
+                    pRead->size - pRead->bytesRead,
+                    pRead->request.offset + pRead->bytesRead, pRead);
+          FlushSubmissions(pUring);
+          continue;
+        }
+      }
+
+      {
+        ScopedMutex lock(pUring->submitLock);
+        --pUring->inFlight;
+        pUring->slotFree.NotifyOne();
+      }
+
+      close(pRead->fd);
+      pRead->fd = -1;
+      // res == 0 before the end means the file shrank under us
+      Complete(pRead, res >= 0 && pRead->bytesRead == pRead->size);
+    }
+
+    if (bWoken && pThread->IsStopping()) {
+      break;
+    }
+  }
+}
+
+void AsyncIO::WakeNativeCompletionThread() {
+  AsyncIOUring* pUring = pUring_;
+  ScopedMutex lock(pUring->submitLock);
+
+  unsigned tail = *pUring->pSqTail;
+  unsigned index = tail & pUring->sqMask;
+  io_uring_sqe* pSqe = &pUring->pSqes[index];
+  memset(pSqe, 0, sizeof(*pSqe));
+  pSqe->opcode = IORING_OP_NOP;
+  pSqe->user_data = WAKE_USER_DATA;
+  pUring->pSqArray[index] = index;
+  __atomic_store_n(pUring->pSqTail, tail + 1, __ATOMIC_RELEASE);
+  ++pUring->unsubmitted;
+
+  FlushSubmissions(pUring);
+}
+
+}  // namespace Mana
+
+#endif  // MANA_ASYNCIO_URING
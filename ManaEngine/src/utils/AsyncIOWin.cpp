@@ -0,0 +1,126 @@
+#include "pch.h"
+#include "utils/AsyncIO.h"
+
+#include <string.h>
+
+namespace Mana {
+
+// largest single ReadFile, since its length is a DWORD
+static const size_t MAX_READ_SIZE = 1u << 30;
+
+// Starts an overlapped read into |pDest|.
+// Returns false if ReadFile fails outright.
+static bool IssueRead(HANDLE hFile,
+                      OVERLAPPED* pOverlapped,
+                      unsigned char* pDest,
+                      size_t size,
+                      U64 offset) {
+  memset(pOverlapped, 0, sizeof(*pOverlapped));
+  pOverlapped->Offset = (DWORD)offset;
+  pOverlapped->OffsetHigh = (DWORD)(offset >> 32);
+
+  DWORD toRead = (DWORD)(size < MAX_READ_SIZE ? size : MAX_READ_SIZE);
+  // the completion is queued to the port even if ReadFile finishes
+  // right away, so success and ERROR_IO_PENDING are handled the same way
+  if (!ReadFile(hFile, pDest, toRead, nullptr, pOverlapped) &&
+      GetLastError() != ERROR_IO_PENDING) {
+    return false;
+  }
+  return true;
+}
+
+bool AsyncIO::InitNative() {
+  // one thread drains the port
+  hCompletionPort_ =
+      CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+  if (!hCompletionPort_) {
+    ManaLogLnError(Channel::Init,
+                   _X("AsyncIO: CreateIoCompletionPort failed (%u)"),
+                   GetLastError());
+    return false;
+  }
+
+  backend_ = AsyncIOBackend::CompletionPort;
+  return true;
+}
+
+void AsyncIO::UninitNative() {
+  if (hCompletionPort_) {
+    CloseHandle(hCompletionPort_);
+    hCompletionPort_ = nullptr;
+  }
+}
+
+void AsyncIO::SubmitNative(AsyncRead** ppReads, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    AsyncRead* pRead = ppReads[i];
+
+    pRead->hFile = CreateFileW(
+        pRead->request.path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN,
+        nullptr);
+    if (pRead->hFile == INVALID_HANDLE_VALUE) {
+      Complete(pRead, false);
+      continue;
+    }
+
+    LARGE_INTEGER fileSize;
+    bool bOk =
+        CreateIoCompletionPort(pRead->hFile, hCompletionPort_, 0, 0) &&
+        GetFileSizeEx(pRead->hFile, &fileSize) &&
+        PrepareBuffer(pRead, (U64)fileSize.QuadPart);
+
+    if (bOk && pRead->size == 0) {
+      // nothing to read, and a zero byte ReadFile isn't worth a round trip
+      CloseHandle(pRead->hFile);
+      Complete(pRead, true);
+      continue;
+    }
+
+    if (!bOk || !IssueRead(pRead->hFile, &pRead->overlapped, pRead->pBuffer,
+                           pRead->size, pRead->request.offset)) {
+      CloseHandle(pRead->hFile);
+      Complete(pRead, false);
+    }
+  }
+}
+
+void AsyncIO::ProcessNativeCompletions(IThread* pThread) {
+  while (true) {
+    DWORD bytes = 0;
+    ULONG_PTR key = 0;
+    OVERLAPPED* pOverlapped = nullptr;
+    BOOL bOk = GetQueuedCompletionStatus(hCompletionPort_, &bytes, &key,
+                                         &pOverlapped, INFINITE);
+    if (!pOverlapped) {
+      // WakeNativeCompletionThread, or the port was closed
+      if (pThread->IsStopping() || !bOk) {
+        break;
+      }
+      continue;
+    }
+
+    AsyncRead* pRead = CONTAINING_RECORD(pOverlapped, AsyncRead, overlapped);
+    if (bOk && bytes > 0) {
+      pRead->bytesRead += bytes;
+      if (pRead->bytesRead < pRead->size &&
+          IssueRead(pRead->hFile, &pRead->overlapped,
+                    pRead->pBuffer + pRead->bytesRead,
+                    pRead->size - pRead->bytesRead,
+                    pRead->request.offset + pRead->bytesRead)) {
+        // a file bigger than MAX_READ_SIZE
+        continue;
+      }
+    }
+
+    CloseHandle(pRead->hFile);
+    pRead->hFile = INVALID_HANDLE_VALUE;
+    Complete(pRead, bOk && pRead->bytesRead == pRead->size);
+  }
+}
+
+void AsyncIO::WakeNativeCompletionThread() {
+  PostQueuedCompletionStatus(hCompletionPort_, 0, 0, nullptr);
+}
+
+}  // namespace Mana
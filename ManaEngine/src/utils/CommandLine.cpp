@@ -1,6 +1,7 @@
 #include "pch.h"
 #include "target/TargetOS.h"
 #include "utils/CommandLine.h"
+#include <string.h>
 #include <utility>
 #ifdef OS_WIN
 #include <shellapi.h>
@@ -11,6 +12,16 @@ constexpr size_t MAX_ARG_VAL_LEN = 100;
 
 namespace Mana {
 
+// Like strncpy_s, which only MSVC has: false if |src| doesn't fit.
+static bool CopyArg(char* dest, const char* src) {
+  size_t len = strnlen(src, MAX_ARG_VAL_LEN);
+  if (len >= MAX_ARG_VAL_LEN) {
+    return false;
+  }
+  memcpy(dest, src, len + 1);
+  return true;
+}
+
 bool CommandLine::Parse(int argc, char* argv[]) {
   map_.clear();
 
@@ -56,7 +67,7 @@ bool CommandLine::Parse(int argc, char* argv[]) {
     isKey = len > 2 && arg[0] == '-' && arg[1] == '-';
 
     if (isKey) {
-      if (strncpy_s(key, MAX_ARG_VAL_LEN, &arg[2], MAX_ARG_VAL_LEN)) {
+      if (!CopyArg(key, &arg[2])) {
         return false;
       }
 
@@ -79,7 +90,7 @@ bool CommandLine::Parse(int argc, char* argv[]) {
         continue;
       }
 
-      if (strncpy_s(val, MAX_ARG_VAL_LEN, arg, MAX_ARG_VAL_LEN)) {
+      if (!CopyArg(val, arg)) {
         return false;
       }
 
@@ -111,7 +122,7 @@ std::string CommandLine::Get(const std::string& key) {
     value = map_.find(key)->second;
   }
 
-  return std::move(value);
+  return value;
 }
 
 }  // namespace Mana
@@ -0,0 +1,122 @@
+#include "pch.h"
+#include "utils/File.h"
+#include "utils/Archive.h"
+#include "utils/MemoryTracker.h"
+
+#ifndef OS_WIN
+
+namespace Mana {
+
+// Portable File implementation, for platforms other than Windows.
+// Same behavior as FileWin.cpp.
+
+File::~File() {
+  if (pBuf_) {
+    TaggedDeleteArray(pBuf_);
+    pBuf_ = nullptr;
+  }
+
+  Close();
+}
+
+bool File::Open(const xchar* fileName, const xchar* mode) {
+  pFile_ = fopen(fileName, mode);
+  if (!pFile_) {
+    return false;
+  }
+
+  fileName_ = fileName;
+  return true;
+}
+
+size_t File::Read(void* buf, size_t size, size_t count) {
+  if (!pFile_) {
+    return 0;
+  }
+
+  return fread(buf, size, count, pFile_);
+}
+
+size_t File::ReadAllBytes(const xchar* fileName) {
+  // packed assets skip the open and stat
+  if (g_pAssetArchive) {
+    const ArchiveEntry* pEntry = g_pAssetArchive->Find(fileName);
+    if (pEntry) {
+      pBuf_ = (unsigned char*)TaggedMalloc(MemoryTag::IO, pEntry->size);
+      if (!pBuf_ || !g_pAssetArchive->Read(pEntry, pBuf_)) {
+        TaggedDeleteArray(pBuf_);
+        pBuf_ = nullptr;
+        return 0;
+      }
+      fileSize_ = pEntry->size;
+      return fileSize_;
+    }
+  }
+
+  size_t fileSize = File::GetFileSize(fileName);
+  if (fileSize == 0) {
+    return 0;
+  }
+
+  // TaggedMalloc returns null instead of throwing, so a file too big to
+  // read in fails like any other read
+  pBuf_ = (unsigned char*)TaggedMalloc(MemoryTag::IO, fileSize);
+  if (!pBuf_) {
+    return 0;
+  }
+
+  if (!Open(fileName, _X("rb"))) {
+    return 0;
+  }
+
+  size_t pos = 0;
+  size_t bytesRead = 0;
+  size_t bytesLeft = fileSize;
+  size_t bytesAttempt = 0;
+  while (true) {
+    bytesAttempt = bytesLeft > 65535 ? 65535 : bytesLeft;
+    bytesRead = Read(&pBuf_[pos], 1, bytesAttempt);
+    pos += bytesRead;
+    bytesLeft -= bytesRead;
+    if (bytesLeft == 0 || (bytesRead < bytesAttempt && feof(pFile_) == 0)) {
+      // end of file
+      break;
+    } else if (bytesLeft > 0 && bytesRead < bytesAttempt) {
+      // error
+      fileSize = 0;
+      TaggedDeleteArray(pBuf_);
+      pBuf_ = nullptr;
+      break;
+    }
+  }
+
+  Close();
+
+  fileSize_ = fileSize;
+  return fileSize;
+}
+
+void File::Close() {
+  if (!pFile_) {
+    return;
+  }
+
+  fclose(pFile_);
+  pFile_ = nullptr;
+}
+
+// static
+size_t File::GetFileSize(const xchar* fileName) {
+  struct stat buf;
+
+  int result = stat(fileName, &buf);
+  if (result != 0) {
+    return 0;
+  }
+
+  return static_cast<size_t>(buf.st_size);
+}
+
+}  // namespace Mana
+
+#endif  // #ifndef OS_WIN
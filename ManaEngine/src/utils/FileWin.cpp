@@ -1,11 +1,13 @@
 #include "pch.h"
 #include "utils/File.h"
+#include "utils/Archive.h"
+#include "utils/MemoryTracker.h"
 
 namespace Mana {
 
 File::~File() {
   if (pBuf_) {
-    delete[] pBuf_;
+    TaggedDeleteArray(pBuf_);
     pBuf_ = nullptr;
   }
 
@@ -33,12 +35,29 @@ size_t File::Read(void* buf, size_t size, size_t count) {
 }
 
 size_t File::ReadAllBytes(const xchar* fileName) {
+  // packed assets skip the open and stat
+  if (g_pAssetArchive) {
+    const ArchiveEntry* pEntry = g_pAssetArchive->Find(fileName);
+    if (pEntry) {
+      pBuf_ = (unsigned char*)TaggedMalloc(MemoryTag::IO, pEntry->size);
+      if (!pBuf_ || !g_pAssetArchive->Read(pEntry, pBuf_)) {
+        TaggedDeleteArray(pBuf_);
+        pBuf_ = nullptr;
+        return 0;
+      }
+      fileSize_ = pEntry->size;
+      return fileSize_;
+    }
+  }
+
   size_t fileSize = File::GetFileSize(fileName);
   if (fileSize == 0) {
     return 0;
   }
 
-  pBuf_ = new unsigned char[fileSize];
+  // TaggedMalloc returns null instead of throwing, so a file too big to
+  // read in fails like any other read
+  pBuf_ = (unsigned char*)TaggedMalloc(MemoryTag::IO, fileSize);
   if (!pBuf_) {
     return 0;
   }
@@ -62,7 +81,7 @@ size_t File::ReadAllBytes(const xchar* fileName) {
     } else if (bytesLeft > 0 && bytesRead < bytesAttempt) {
       // error
       fileSize = 0;
-      delete[] pBuf_;
+      TaggedDeleteArray(pBuf_);
       pBuf_ = nullptr;
       break;
     }
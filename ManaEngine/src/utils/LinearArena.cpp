@@ -0,0 +1,58 @@
+#include "pch.h"
+#include "utils/LinearArena.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "utils/Memory.h"
+
+namespace Mana {
+
+LinearArena* g_pFrameArena = nullptr;
+
+// Aligned to a cache line, so allocations with the default alignment
+// never straddle more lines than they have to.
+static const size_t ARENA_BLOCK_ALIGNMENT = 64;
+
+LinearArena::~LinearArena() {
+  Uninit();
+}
+
+bool LinearArena::Init(size_t capacity) {
+  Uninit();
+
+  void* pAligned = nullptr;
+  if (capacity == 0 || !AlignedMalloc(ARENA_BLOCK_ALIGNMENT, capacity,
+                                      &pAligned, &pRaw_)) {
+    ManaLogLnError(Channel::Init,
+                   _X("LinearArena: couldn't allocate %llu bytes"),
+                   (U64)capacity);
+    pRaw_ = nullptr;
+    return false;
+  }
+
+  pBase_ = (unsigned char*)pAligned;
+  capacity_ = capacity;
+  offset_ = 0;
+  highWater_ = 0;
+  return true;
+}
+
+void LinearArena::Uninit() {
+  free(pRaw_);
+  pRaw_ = nullptr;
+  pBase_ = nullptr;
+  capacity_ = 0;
+  offset_ = 0;
+  highWater_ = 0;
+}
+
+void LinearArena::Rewind(size_t offset) {
+  assert(offset <= offset_ && "rewinding past the top of the arena");
+#ifdef _DEBUG
+  // so reads through stale pointers stand out
+  memset(pBase_ + offset, 0xDD, offset_ - offset);
+#endif
+  offset_ = offset;
+}
+
+}  // namespace Mana
@@ -0,0 +1,994 @@
+#include "pch.h"
+#include "utils/Logger.h"
+
+#include <ctype.h>
+#include <string.h>
+#include <algorithm>
+#include <thread>
+#include "utils/Profiler.h"
+
+namespace Mana {
+
+static Logger logger;
+
+std::atomic<U32> g_logChannelMask{(1u << LOG_CHANNEL_COUNT) - 1};
+
+// ThreadFunc doesn't take a user param,
+// so the writer thread finds the logger through here.
+static Logger* pInitializedLogger = nullptr;
+
+unsigned long LoggerThreadFunction(IThread* pThread);
+
+static const xchar* GetVerbosityString(Verbosity verbosity);
+static const xchar* GetChannelString(Channel channel);
+
+bool LogInit(const char* logFile,
+             RingOverflowPolicy policy,
+             LogFileFormat format) {
+  return logger.Init(logFile, policy, format);
+}
+
+void LogShutdown() {
+  logger.Uninit();
+}
+
+void LogFlush() {
+  logger.Flush();
+}
+
+LogStats GetLogStats() {
+  return logger.GetStats();
+}
+
+bool IsLogInitialized() {
+  return logger.IsInitialized();
+}
+
+void LogWrite(const LogSite& site, const LogArgs& args) {
+  logger.WriteArgs(site, args);
+}
+
+// names for --log-channels, indexed by Channel
+static const char* const CHANNEL_NAMES[] = {
+    "all", "init", "shutdown", "graphics", "sound", "input", "perf"};
+static_assert(sizeof(CHANNEL_NAMES) / sizeof(*CHANNEL_NAMES) ==
+                  LOG_CHANNEL_COUNT,
+              "name the new Channel");
+
+// compares the first |length| chars of |pName| with |pExpected|,
+// ignoring case
+static bool IsChannelName(const char* pName,
+                          size_t length,
+                          const char* pExpected) {
+  if (strlen(pExpected) != length) {
+    return false;
+  }
+
+  for (size_t i = 0; i < length; ++i) {
+    if (tolower((unsigned char)pName[i]) != pExpected[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool LogSetChannels(const char* channels) {
+  U32 mask = 0;
+
+  const char* pName = channels;
+  while (*pName) {
+    const char* pEnd = strchr(pName, ',');
+    size_t length = pEnd ? (size_t)(pEnd - pName) : strlen(pName);
+
+    // allow spaces around the names
+    while (length > 0 && *pName == ' ') {
+      ++pName;
+      --length;
+    }
+    while (length > 0 && pName[length - 1] == ' ') {
+      --length;
+    }
+
+    if (length > 0) {
+      size_t channel = 0;
+      while (channel < LOG_CHANNEL_COUNT &&
+             !IsChannelName(pName, length, CHANNEL_NAMES[channel])) {
+        ++channel;
+      }
+
+      if (channel == LOG_CHANNEL_COUNT) {
+        return false;
+      }
+      // "all" turns on everything, not just Channel::All
+      mask |= channel == (size_t)Channel::All ? (1u << LOG_CHANNEL_COUNT) - 1
+                                              : 1u << channel;
+    }
+
+    if (!pEnd) {
+      break;
+    }
+    pName = pEnd + 1;
+  }
+
+  g_logChannelMask.store(mask, std::memory_order_relaxed);
+  return true;
+}
+
+void LogError(Channel channel, bool newline, const xchar* format, ...) {
+  if (!logger.IsInitialized() || !IsLogEnabled(Verbosity::Error, channel))
+    return;
+
+  va_list args;
+  va_start(args, format);
+  logger.Write(Verbosity::Error, channel, newline, format, args);
+  va_end(args);
+}
+
+void LogWarning(Channel channel, bool newline, const xchar* format, ...) {
+  if (!logger.IsInitialized() || !IsLogEnabled(Verbosity::Warning, channel))
+    return;
+
+  va_list args;
+  va_start(args, format);
+  logger.Write(Verbosity::Warning, channel, newline, format, args);
+  va_end(args);
+}
+
+void LogInfo(Channel channel, bool newline, const xchar* format, ...) {
+  if (!logger.IsInitialized() || !IsLogEnabled(Verbosity::Info, channel))
+    return;
+
+  va_list args;
+  va_start(args, format);
+  logger.Write(Verbosity::Info, channel, newline, format, args);
+  va_end(args);
+}
+
+void LogVerbose(Channel channel, bool newline, const xchar* format, ...) {
+  if (!logger.IsInitialized() || !IsLogEnabled(Verbosity::Verbose, channel))
+    return;
+
+  va_list args;
+  va_start(args, format);
+  logger.Write(Verbosity::Verbose, channel, newline, format, args);
+  va_end(args);
+}
+
+Logger::~Logger() {
+  Uninit();
+}
+
+bool Logger::Init(const char* fileName,
+                  RingOverflowPolicy policy,
+                  LogFileFormat format) {
+  static_assert(sizeof(Record) <= RECORD_BYTES, "Record is too big");
+  static_assert(RECORD_DATA_BYTES % sizeof(xchar) == 0,
+                "text must not be split mid-character");
+
+  if (IsInitialized() || pInitializedLogger) {
+    return false;
+  }
+
+  pFile_ = OpenLogFile(fileName);
+  if (!pFile_) {
+    return false;
+  }
+
+  policy_ = policy;
+  format_ = format;
+  clock_.Reset();
+  timeOfDayAtInit_ = GetLocalTimeOfDay();
+  flushRequests_ = 0;
+  flushesDone_ = 0;
+  siteIds_.clear();
+
+  lastTimestamp_ = 0;
+
+  if (format_ == LogFileFormat::Binary) {
+    U8 header[16] = {'M', 'L', 'O', 'G'};
+    memcpy(header + 4, &BINARY_VERSION, sizeof(BINARY_VERSION));
+    memcpy(header + 8, &timeOfDayAtInit_, sizeof(timeOfDayAtInit_));
+    bytesWritten_.fetch_add(fwrite(header, 1, sizeof(header), pFile_),
+                            std::memory_order_relaxed);
+  }
+
+  pInitializedLogger = this;
+  pWriterThread_ = ThreadFactory::Create(LoggerThreadFunction);
+  if (!pWriterThread_) {
+    pInitializedLogger = nullptr;
+    fclose(pFile_);
+    pFile_ = nullptr;
+    return false;
+  }
+
+  bInitialized_.store(true, std::memory_order_release);
+  pWriterThread_->Start();
+  return true;
+}
+
+void Logger::Uninit() {
+  if (!IsInitialized()) {
+    return;
+  }
+
+  // anything logged from here on is ignored
+  bInitialized_.store(false, std::memory_order_release);
+
+  // the writer drains everything once more after it sees the stop
+  pWriterThread_->Stop();
+  WakeWriter();
+  pWriterThread_->Join();
+  delete pWriterThread_;
+  pWriterThread_ = nullptr;
+  pInitializedLogger = nullptr;
+
+  fclose(pFile_);
+  pFile_ = nullptr;
+
+  FreeRings();
+
+  // wake anyone stuck in Flush
+  ScopedMutex lock(wakeLock_);
+  flushesDone_ = flushRequests_;
+  flushed_.NotifyAll();
+}
+
+void Logger::Write(Verbosity verbosity,
+                   Channel channel,
+                   bool newline,
+                   const xchar* format,
+                   va_list args) {
+  ThreadRing* pRing = GetThreadRing();
+  if (!pRing) {
+    return;
+  }
+
+  U64 timestamp = clock_.GetMicroseconds();
+  xchar text[MAX_MESSAGE_CHARS];
+  int length = FormatText(text, MAX_MESSAGE_CHARS, format, args);
+  bool bTruncated = false;
+  if (length < 0) {
+    // an encoding error, or truncated where that's all we're told
+    text[MAX_MESSAGE_CHARS - 1] = 0;
+    length = (int)std::char_traits<xchar>::length(text);
+    bTruncated = (size_t)length == MAX_MESSAGE_CHARS - 1;
+  } else if ((size_t)length >= MAX_MESSAGE_CHARS) {
+    length = MAX_MESSAGE_CHARS - 1;
+    bTruncated = true;
+  }
+
+  PushMessage(pRing, timestamp, nullptr, verbosity, channel, text,
+              length * sizeof(xchar), newline, bTruncated);
+}
+
+void Logger::WriteArgs(const LogSite& site, const LogArgs& args) {
+  ThreadRing* pRing = GetThreadRing();
+  if (!pRing) {
+    return;
+  }
+
+  PushMessage(pRing, clock_.GetMicroseconds(), &site, site.verbosity,
+              site.channel, args.GetData(), args.GetSize(), site.newline,
+              args.IsTruncated());
+}
+
+void Logger::PushMessage(ThreadRing* pRing,
+                         U64 timestamp,
+                         const LogSite* pSite,
+                         Verbosity verbosity,
+                         Channel channel,
+                         const void* pData,
+                         size_t bytes,
+                         bool newline,
+                         bool bTruncated) {
+  if (bTruncated) {
+    pRing->truncated.store(
+        pRing->truncated.load(std::memory_order_relaxed) + 1,
+        std::memory_order_relaxed);
+  }
+
+  size_t numRecords =
+      bytes > 0 ? (bytes + RECORD_DATA_BYTES - 1) / RECORD_DATA_BYTES : 1;
+
+  // Drop the whole message rather than part of it. The writer only ever
+  // frees space, so if it fits now, every record will be pushed.
+  if (policy_ == RingOverflowPolicy::DropNewest &&
+      !pRing->ring.HasSpaceFor(numRecords)) {
+    pRing->dropped.store(pRing->dropped.load(std::memory_order_relaxed) + 1,
+                         std::memory_order_relaxed);
+    return;
+  }
+
+  const U8* pBytes = (const U8*)pData;
+  size_t pos = 0;
+  for (size_t i = 0; i < numRecords; ++i) {
+    // written in place, since most of a Record is usually unused
+    Record* pRecord = pRing->ring.BeginPush();
+    size_t count = bytes - pos < RECORD_DATA_BYTES ? bytes - pos
+                                                   : RECORD_DATA_BYTES;
+    pRecord->timestamp = timestamp;
+    pRecord->pSite = pSite;
+    pRecord->length = (U16)count;
+    pRecord->verbosity = (U8)verbosity;
+    pRecord->channel = (U8)channel;
+    if (i + 1 < numRecords) {
+      pRecord->flags = FLAG_CONTINUED;
+    } else {
+      pRecord->flags = newline ? FLAG_NEWLINE : 0;
+    }
+    memcpy(pRecord->data, pBytes + pos, count);
+    pRing->ring.EndPush();
+    pos += count;
+  }
+
+  pRing->logged.store(pRing->logged.load(std::memory_order_relaxed) + 1,
+                      std::memory_order_relaxed);
+
+  // Get errors to disk quickly, in case we're about to crash,
+  // and drain a busy thread's ring before it fills up.
+  if (verbosity == Verbosity::Error) {
+    WakeWriter();
+  } else if (pRing->ring.ProducerSize() >= RING_RECORDS / 2 &&
+             !pRing->bWakePending.load(std::memory_order_relaxed) &&
+             pRing->ring.Size() >= RING_RECORDS / 2) {
+    pRing->bWakePending.store(true, std::memory_order_relaxed);
+    WakeWriter();
+  }
+}
+
+void Logger::Flush() {
+  if (!IsInitialized()) {
+    return;
+  }
+
+  ScopedMutex lock(wakeLock_);
+  U64 request = ++flushRequests_;
+  bWakeRequested_ = true;
+  wake_.NotifyOne();
+  while (flushesDone_ < request) {
+    flushed_.Wait(wakeLock_);
+  }
+}
+
+LogStats Logger::GetStats() {
+  LogStats stats = {};
+  for (ThreadRing* pRing = pFirstRing_.load(std::memory_order_acquire); pRing;
+       pRing = pRing->pNext) {
+    stats.messagesLogged += pRing->logged.load(std::memory_order_relaxed);
+    stats.messagesDropped += pRing->dropped.load(std::memory_order_relaxed);
+    stats.messagesTruncated +=
+        pRing->truncated.load(std::memory_order_relaxed);
+  }
+  stats.bytesWritten = bytesWritten_.load(std::memory_order_relaxed);
+  stats.fileWrites = fileWrites_.load(std::memory_order_relaxed);
+  stats.threadRings = numRings_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+Logger::ThreadRing* Logger::GetThreadRing() {
+  // gives the ring back when the thread exits
+  struct RingOwner {
+    Logger* pLogger = nullptr;
+    ThreadRing* pRing = nullptr;
+    U32 generation = 0;
+    ~RingOwner() {
+      if (pRing) {
+        pLogger->ReleaseRing(pRing, generation);
+      }
+    }
+  };
+  thread_local RingOwner owner;
+
+  // a ring from before the last Uninit was freed
+  if (!owner.pRing ||
+      owner.generation != ringGeneration_.load(std::memory_order_relaxed)) {
+    owner.pLogger = this;
+    owner.pRing = AcquireRing(owner.generation);
+  }
+  return owner.pRing;
+}
+
+Logger::ThreadRing* Logger::AcquireRing(U32& generation) {
+  ThreadRing* pNewRing;
+  {
+    ScopedMutex lock(ringsLock_);
+    generation = ringGeneration_.load(std::memory_order_relaxed);
+
+    // a ring left behind by a thread that exited
+    for (ThreadRing* pRing = pFirstRing_.load(std::memory_order_relaxed);
+         pRing; pRing = pRing->pNext) {
+      bool bInUse = false;
+      if (pRing->bInUse.compare_exchange_strong(bInUse, true,
+                                                std::memory_order_acquire)) {
+        return pRing;
+      }
+    }
+
+    pNewRing = new (std::nothrow) ThreadRing(policy_);
+    if (!pNewRing) {
+      return nullptr;
+    }
+    pNewRing->pNext = pFirstRing_.load(std::memory_order_relaxed);
+    pFirstRing_.store(pNewRing, std::memory_order_release);
+    numRings_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // outside the lock, since going over budget logs
+  TrackAllocation(MemoryTag::Log, sizeof(ThreadRing));
+  return pNewRing;
+}
+
+void Logger::ReleaseRing(ThreadRing* pRing, U32 generation) {
+  ScopedMutex lock(ringsLock_);
+  if (generation == ringGeneration_.load(std::memory_order_relaxed)) {
+    pRing->bInUse.store(false, std::memory_order_release);
+  }
+}
+
+void Logger::FreeRings() {
+  U32 numFreed = 0;
+  {
+    ScopedMutex lock(ringsLock_);
+    ThreadRing* pRing =
+        pFirstRing_.exchange(nullptr, std::memory_order_acq_rel);
+    while (pRing) {
+      ThreadRing* pNext = pRing->pNext;
+      delete pRing;
+      pRing = pNext;
+      ++numFreed;
+    }
+    numRings_.store(0, std::memory_order_relaxed);
+    ringGeneration_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  for (U32 i = 0; i < numFreed; ++i) {
+    TrackFree(MemoryTag::Log, sizeof(ThreadRing));
+  }
+}
+
+unsigned long LoggerThreadFunction(IThread* pThread) {
+  pInitializedLogger->RunWriter(pThread);
+  return 0;
+}
+
+void Logger::RunWriter(IThread* pThread) {
+  MANA_PROFILE_THREAD_NAME("Log Writer");
+
+  while (true) {
+    bool bStopping = pThread->IsStopping();
+
+    U64 flushRequest;
+    {
+      ScopedMutex lock(wakeLock_);
+      flushRequest = flushRequests_;
+    }
+
+    Drain();
+
+    ScopedMutex lock(wakeLock_);
+    if (flushesDone_ < flushRequest) {
+      flushesDone_ = flushRequest;
+      flushed_.NotifyAll();
+    }
+
+    if (bStopping) {
+      break;
+    }
+
+    if (!bWakeRequested_ && !pThread->IsStopping()) {
+      wake_.WaitFor(wakeLock_, WRITE_INTERVAL_MS);
+    }
+    bWakeRequested_ = false;
+  }
+}
+
+void Logger::WakeWriter() {
+  ScopedMutex lock(wakeLock_);
+  bWakeRequested_ = true;
+  wake_.NotifyOne();
+}
+
+void Logger::Drain() {
+  records_.clear();
+  messages_.clear();
+
+  const size_t BATCH = 64;
+  Record batch[BATCH];
+
+  for (ThreadRing* pRing = pFirstRing_.load(std::memory_order_acquire); pRing;
+       pRing = pRing->pNext) {
+    size_t first = records_.size();
+
+    // at most one ring's worth per pass, so a thread that never stops
+    // logging can't keep the writer here forever
+    pRing->bWakePending.store(false, std::memory_order_relaxed);
+    size_t popped = 0;
+    while (popped < RING_RECORDS) {
+      size_t count = pRing->ring.PopAll(batch, BATCH);
+      if (count == 0) {
+        break;
+      }
+      records_.insert(records_.end(), batch, batch + count);
+      popped += count;
+    }
+
+    // The producer pushes a message's records back to back,
+    // so finish one we caught halfway.
+    while (records_.size() > first &&
+           (records_.back().flags & FLAG_CONTINUED)) {
+      std::optional<Record> next = pRing->ring.Pop();
+      if (next) {
+        records_.push_back(*next);
+      } else {
+        std::this_thread::yield();
+      }
+    }
+
+    for (size_t i = first; i < records_.size();) {
+      Message message = {records_[i].timestamp, i, 1};
+      while (records_[i].flags & FLAG_CONTINUED) {
+        ++i;
+        ++message.numRecords;
+      }
+      ++i;
+      messages_.push_back(message);
+    }
+  }
+
+  if (messages_.empty()) {
+    return;
+  }
+
+  // each ring is in order already, but threads are interleaved
+  std::stable_sort(messages_.begin(), messages_.end(),
+                   [](const Message& a, const Message& b) {
+                     return a.timestamp < b.timestamp;
+                   });
+
+  out_.clear();
+  for (const Message& message : messages_) {
+    payload_.clear();
+    for (size_t i = 0; i < message.numRecords; ++i) {
+      const Record& record = records_[message.firstRecord + i];
+      payload_.insert(payload_.end(), record.data,
+                      record.data + record.length);
+    }
+
+    if (format_ == LogFileFormat::Binary) {
+      WriteBinaryMessage(message);
+    } else {
+      WriteMessage(message);
+    }
+  }
+
+  size_t written = fwrite(out_.data(), 1, out_.size(), pFile_);
+  fflush(pFile_);
+  bytesWritten_.fetch_add(written, std::memory_order_relaxed);
+  fileWrites_.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void AppendNumber(xstring& line, U64 value, int digits) {
+  xchar buf[8];
+  for (int i = digits - 1; i >= 0; --i) {
+    buf[i] = (xchar)(_X('0') + value % 10);
+    value /= 10;
+  }
+  line.append(buf, digits);
+}
+
+void Logger::WriteMessage(const Message& message) {
+  const Record& first = records_[message.firstRecord];
+
+  // Format: [hh:mm:ss.fff] [VERBOSITY] [CHANNEL]: Message
+  const U64 MICROS_PER_DAY = 24ull * 60 * 60 * 1000000;
+  U64 millis = (timeOfDayAtInit_ + first.timestamp) % MICROS_PER_DAY / 1000;
+
+  line_.clear();
+  line_ += _X('[');
+  AppendNumber(line_, millis / 3600000, 2);
+  line_ += _X(':');
+  AppendNumber(line_, millis / 60000 % 60, 2);
+  line_ += _X(':');
+  AppendNumber(line_, millis / 1000 % 60, 2);
+  line_ += _X('.');
+  AppendNumber(line_, millis % 1000, 3);
+  line_ += _X("] ");
+  line_ += GetVerbosityString((Verbosity)first.verbosity);
+  line_ += _X(' ');
+  line_ += GetChannelString((Channel)first.channel);
+  line_ += _X(": ");
+
+  if (first.pSite) {
+    FormatArgs(first.pSite->format, payload_.data(), payload_.size(), line_);
+  } else {
+    size_t start = line_.size();
+    size_t chars = payload_.size() / sizeof(xchar);
+    line_.resize(start + chars);
+    memcpy(&line_[start], payload_.data(), chars * sizeof(xchar));
+  }
+
+  const Record& last = records_[message.firstRecord + message.numRecords - 1];
+  if (last.flags & FLAG_NEWLINE) {
+    line_ += _X('\n');
+  }
+
+  OutputToDebugger(line_.c_str());
+  AppendUtf8(line_.data(), line_.size(), out_);
+}
+
+// One argument captured by LogArgs.
+struct LogArg {
+  LogArgType type;
+  U64 bits;          // integers, pointers, and the bits of doubles
+  const U8* pChars;  // strings, not aligned or nul terminated
+  U16 length;        // in characters, or LogArgs::NULL_STRING
+};
+
+static bool ReadLogArg(const U8*& p, const U8* pEnd, LogArg& arg) {
+  if (p >= pEnd) {
+    return false;
+  }
+
+  arg.type = (LogArgType)*p;
+  const U8* pValue = p + 1;
+  size_t valueBytes;
+  switch (arg.type) {
+    case LogArgType::I32:
+    case LogArgType::U32:
+      valueBytes = 4;
+      break;
+    case LogArgType::I64:
+    case LogArgType::U64:
+    case LogArgType::F64:
+    case LogArgType::Pointer:
+      valueBytes = 8;
+      break;
+    case LogArgType::String:
+    case LogArgType::NarrowString: {
+      if (pEnd - pValue < (ptrdiff_t)sizeof(U16)) {
+        return false;
+      }
+      memcpy(&arg.length, pValue, sizeof(U16));
+      size_t charSize =
+          arg.type == LogArgType::String ? sizeof(xchar) : sizeof(char);
+      size_t chars = arg.length == LogArgs::NULL_STRING ? 0 : arg.length;
+      arg.pChars = pValue + sizeof(U16);
+      valueBytes = sizeof(U16) + chars * charSize;
+    } break;
+    default:
+      return false;
+  }
+
+  if ((size_t)(pEnd - pValue) < valueBytes) {
+    return false;
+  }
+
+  arg.bits = 0;
+  if (arg.type != LogArgType::String &&
+      arg.type != LogArgType::NarrowString) {
+    memcpy(&arg.bits, pValue, valueBytes);
+  }
+  p = pValue + valueBytes;
+  return true;
+}
+
+// LEB128, as in the .mlog format
+static void AppendVarint(std::string& out, U64 value) {
+  while (value >= 0x80) {
+    out += (char)(value | 0x80);
+    value >>= 7;
+  }
+  out += (char)value;
+}
+
+// zigzag, so small negative values stay small
+static void AppendSignedVarint(std::string& out, I64 value) {
+  AppendVarint(out, ((U64)value << 1) ^ (U64)(value >> 63));
+}
+
+void Logger::AppendString(const xchar* pText,
+                          size_t length,
+                          std::string& out) {
+  utf8_.clear();
+  AppendUtf8(pText, length, utf8_);
+  AppendVarint(out, utf8_.size());
+  out += utf8_;
+}
+
+void Logger::WriteBinaryMessage(const Message& message) {
+  const Record& first = records_[message.firstRecord];
+  const Record& last = records_[message.firstRecord + message.numRecords - 1];
+
+  // Batches can overlap a little in time (see Drain),
+  // so the delta is signed.
+  I64 timeDelta = (I64)(first.timestamp - lastTimestamp_);
+  lastTimestamp_ = first.timestamp;
+
+  if (!first.pSite) {
+    out_ += (char)CHUNK_TEXT;
+    out_ += (char)first.verbosity;
+    out_ += (char)first.channel;
+    out_ += (char)((last.flags & FLAG_NEWLINE) ? 1 : 0);
+    AppendSignedVarint(out_, timeDelta);
+
+    line_.resize(payload_.size() / sizeof(xchar));
+    memcpy(&line_[0], payload_.data(), line_.size() * sizeof(xchar));
+    AppendString(line_.data(), line_.size(), out_);
+    return;
+  }
+
+  U32 siteId = GetSiteId(*first.pSite);
+
+  // The ring holds fixed size values, which are quick to capture.
+  // The file gets varints and utf-8, which are smaller.
+  args_.clear();
+  const U8* p = payload_.data();
+  const U8* pEnd = p + payload_.size();
+  LogArg arg;
+  while (ReadLogArg(p, pEnd, arg)) {
+    args_ += (char)arg.type;
+    switch (arg.type) {
+      case LogArgType::I32:
+        AppendSignedVarint(args_, (I32)arg.bits);
+        break;
+      case LogArgType::I64:
+        AppendSignedVarint(args_, (I64)arg.bits);
+        break;
+      case LogArgType::U32:
+      case LogArgType::U64:
+      case LogArgType::Pointer:
+        AppendVarint(args_, arg.bits);
+        break;
+      case LogArgType::F64:
+        args_.append((const char*)&arg.bits, sizeof(arg.bits));
+        break;
+      case LogArgType::String:
+        // length + 1, so 0 can mean null
+        if (arg.length == LogArgs::NULL_STRING) {
+          AppendVarint(args_, 0);
+        } else {
+          stringArg_.resize(arg.length);
+          memcpy(&stringArg_[0], arg.pChars, arg.length * sizeof(xchar));
+          utf8_.clear();
+          AppendUtf8(stringArg_.data(), stringArg_.size(), utf8_);
+          AppendVarint(args_, utf8_.size() + 1);
+          args_ += utf8_;
+        }
+        break;
+      case LogArgType::NarrowString:
+        if (arg.length == LogArgs::NULL_STRING) {
+          AppendVarint(args_, 0);
+        } else {
+          AppendVarint(args_, (U64)arg.length + 1);
+          args_.append((const char*)arg.pChars, arg.length);
+        }
+        break;
+    }
+  }
+
+  out_ += (char)CHUNK_MESSAGE;
+  AppendVarint(out_, siteId);
+  AppendSignedVarint(out_, timeDelta);
+  AppendVarint(out_, args_.size());
+  out_ += args_;
+}
+
+U32 Logger::GetSiteId(const LogSite& site) {
+  auto search = siteIds_.find(&site);
+  if (search != siteIds_.end()) {
+    return search->second;
+  }
+
+  U32 siteId = (U32)siteIds_.size();
+  siteIds_[&site] = siteId;
+
+  out_ += (char)CHUNK_SITE;
+  AppendVarint(out_, siteId);
+  out_ += (char)site.verbosity;
+  out_ += (char)site.channel;
+  out_ += (char)(site.newline ? 1 : 0);
+  AppendVarint(out_, site.line);
+
+  size_t fileLength = strlen(site.file);
+  AppendVarint(out_, fileLength);
+  out_.append(site.file, fileLength);
+
+  AppendString(site.format, std::char_traits<xchar>::length(site.format),
+               out_);
+  return siteId;
+}
+
+static bool IsConversion(xchar c) {
+  for (const xchar* p = _X("diouxXeEfFgGaAcCsSpnZ"); *p; ++p) {
+    if (c == *p) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void Logger::FormatArgs(const xchar* format,
+                        const U8* pArgs,
+                        size_t size,
+                        xstring& out) {
+  const U8* p = pArgs;
+  const U8* pEnd = pArgs + size;
+  xchar text[MAX_MESSAGE_CHARS];
+
+  while (*format) {
+    if (*format != _X('%')) {
+      const xchar* pStart = format;
+      while (*format && *format != _X('%')) {
+        ++format;
+      }
+      out.append(pStart, format - pStart);
+      continue;
+    }
+    if (format[1] == _X('%')) {
+      out += _X('%');
+      format += 2;
+      continue;
+    }
+
+    // Copy the conversion spec, filling in any * width or precision,
+    // then print the next argument with it.
+    const xchar* pSpecStart = format++;
+    xchar spec[32];
+    size_t specLength = 0;
+    bool bValid = true;
+    spec[specLength++] = _X('%');
+    while (*format && !IsConversion(*format)) {
+      if (*format == _X('*')) {
+        LogArg width = {};
+        if (!ReadLogArg(p, pEnd, width)) {
+          bValid = false;
+        }
+        I32 value = (I32)width.bits;
+        U32 magnitude = value < 0 ? 0u - (U32)value : (U32)value;
+        xchar digits[12];
+        size_t numDigits = 0;
+        do {
+          digits[numDigits++] = (xchar)(_X('0') + magnitude % 10);
+          magnitude /= 10;
+        } while (magnitude > 0);
+        if (value < 0 && specLength < 20) {
+          spec[specLength++] = _X('-');
+        }
+        while (numDigits > 0 && specLength < 28) {
+          spec[specLength++] = digits[--numDigits];
+        }
+      } else if (specLength < 28) {
+        spec[specLength++] = *format;
+      } else {
+        bValid = false;
+      }
+      ++format;
+    }
+    if (!*format) {
+      out.append(pSpecStart);
+      break;
+    }
+
+    xchar conversion = *format++;
+    spec[specLength++] = conversion;
+    spec[specLength] = 0;
+    if (conversion == _X('n')) {
+      continue;
+    }
+
+    // show the spec itself when the argument is missing or the wrong kind
+    LogArg arg;
+    bool bStringSpec = conversion == _X('s') || conversion == _X('S') ||
+                       conversion == _X('Z');
+    if (!bValid || !ReadLogArg(p, pEnd, arg) ||
+        bStringSpec != (arg.type == LogArgType::String ||
+                        arg.type == LogArgType::NarrowString)) {
+      out.append(pSpecStart, format - pSpecStart);
+      continue;
+    }
+
+    int length = -1;
+    switch (arg.type) {
+      case LogArgType::I32:
+        length = FormatOne(text, MAX_MESSAGE_CHARS, spec, (int)arg.bits);
+        break;
+      case LogArgType::U32:
+        length = FormatOne(text, MAX_MESSAGE_CHARS, spec,
+                           (unsigned int)arg.bits);
+        break;
+      case LogArgType::I64:
+        length =
+            FormatOne(text, MAX_MESSAGE_CHARS, spec, (long long)arg.bits);
+        break;
+      case LogArgType::U64:
+        length = FormatOne(text, MAX_MESSAGE_CHARS, spec,
+                           (unsigned long long)arg.bits);
+        break;
+      case LogArgType::F64: {
+        double value;
+        memcpy(&value, &arg.bits, sizeof(value));
+        length = FormatOne(text, MAX_MESSAGE_CHARS, spec, value);
+      } break;
+      case LogArgType::Pointer:
+        length = FormatOne(text, MAX_MESSAGE_CHARS, spec,
+                           (void*)(uintptr_t)arg.bits);
+        break;
+      case LogArgType::String:
+        if (arg.length == LogArgs::NULL_STRING) {
+          length = FormatOne(text, MAX_MESSAGE_CHARS, spec, (xchar*)nullptr);
+        } else {
+          stringArg_.resize(arg.length);
+          memcpy(&stringArg_[0], arg.pChars, arg.length * sizeof(xchar));
+          length =
+              FormatOne(text, MAX_MESSAGE_CHARS, spec, stringArg_.c_str());
+        }
+        break;
+      case LogArgType::NarrowString:
+        if (arg.length == LogArgs::NULL_STRING) {
+          length = FormatOne(text, MAX_MESSAGE_CHARS, spec, (char*)nullptr);
+        } else {
+          narrowArg_.assign((const char*)arg.pChars, arg.length);
+          length =
+              FormatOne(text, MAX_MESSAGE_CHARS, spec, narrowArg_.c_str());
+        }
+        break;
+    }
+
+    if (length < 0) {
+      text[MAX_MESSAGE_CHARS - 1] = 0;
+      length = (int)std::char_traits<xchar>::length(text);
+    } else if ((size_t)length >= MAX_MESSAGE_CHARS) {
+      length = MAX_MESSAGE_CHARS - 1;
+    }
+    out.append(text, length);
+  }
+}
+
+int Logger::FormatOne(xchar* pDest,
+                      size_t destChars,
+                      const xchar* format,
+                      ...) {
+  va_list args;
+  va_start(args, format);
+  int length = FormatText(pDest, destChars, format, args);
+  va_end(args);
+  return length;
+}
+
+static const xchar* GetVerbosityString(Verbosity verbosity) {
+  switch (verbosity) {
+    case Mana::Verbosity::Error:
+      return _X("[ERROR]");
+    case Mana::Verbosity::Warning:
+      return _X("[WARNING]");
+    case Mana::Verbosity::Info:
+      return _X("[INFO]");
+    case Mana::Verbosity::Verbose:
+      return _X("[VERBOSE]");
+    default:
+      return _X("[MISSING VERBOSITY]");
+  }
+}
+
+static const xchar* GetChannelString(Channel channel) {
+  switch (channel) {
+    case Mana::Channel::All:
+      return _X("[ALL]");
+    case Mana::Channel::Init:
+      return _X("[INIT]");
+    case Mana::Channel::Shutdown:
+      return _X("[SHUTDOWN]");
+    case Mana::Channel::Graphics:
+      return _X("[GRAPHICS]");
+    case Mana::Channel::Sound:
+      return _X("[SOUND]");
+    case Mana::Channel::Input:
+      return _X("[INPUT]");
+    case Mana::Channel::Perf:
+      return _X("[PERF]");
+    default:
+      return _X("[MISSING CHANNEL]");
+  }
+}
+
+}  // namespace Mana
@@ -0,0 +1,48 @@
+#include "pch.h"
+#include "utils/Logger.h"
+
+#ifndef OS_WIN
+
+#include <stdarg.h>
+#include <sys/time.h>
+#include <time.h>
+
+namespace Mana {
+
+// Portable parts of Logger, for platforms other than Windows.
+// Same behavior as LogWin.cpp.
+
+FILE* Logger::OpenLogFile(const char* fileName) {
+  return fopen(fileName, "wb");
+}
+
+U64 Logger::GetLocalTimeOfDay() {
+  timeval now;
+  gettimeofday(&now, nullptr);
+
+  time_t seconds = now.tv_sec;
+  tm local;
+  localtime_r(&seconds, &local);
+
+  return (((U64)local.tm_hour * 60 + local.tm_min) * 60 + local.tm_sec) *
+             1000000 +
+         (U64)now.tv_usec;
+}
+
+int Logger::FormatText(xchar* pDest,
+                       size_t destChars,
+                       const xchar* format,
+                       va_list args) {
+  return vsnprintf(pDest, destChars, format, args);
+}
+
+void Logger::AppendUtf8(const xchar* pText, size_t length, std::string& out) {
+  // xchar is already utf-8 here
+  out.append(pText, length);
+}
+
+void Logger::OutputToDebugger(const xchar*) {}
+
+}  // namespace Mana
+
+#endif  // #ifndef OS_WIN
@@ -1,182 +1,56 @@
 #include "pch.h"
-#include "utils/Log.h"
-#include "concurrency/Mutex.h"
+#include "utils/Logger.h"
 #include "target/TargetOS.h"
-#include "utils/Strings.h"
-#include <cwchar> // _vscwprintf, vswprintf
-#include <string>
+#include <cwchar>  // _vsnwprintf_s
 
 namespace Mana {
 
-char logFile[20];
-Mutex logFileMutex;
-bool initialized = false;
+// Windows parts of Logger (see Log.cpp).
 
-static void Log(Verbosity verbosity,
-                Channel channel,
-                bool newline,
-                const wchar_t* format,
-                va_list args);
-static const wchar_t* GetVerbosityString(Verbosity verbosity);
-static const wchar_t* GetChannelString(Channel channel);
-static std::wstring GetTimeString();
-
-bool LogInit(const char* file) {
-  strncpy_s(logFile, 20, file, 20);
+FILE* Logger::OpenLogFile(const char* fileName) {
   FILE* pFile = nullptr;
-  initialized = fopen_s(&pFile, logFile, "w") == 0 && pFile;
-  if (initialized && pFile) {
-    std::fclose(pFile);
+  if (fopen_s(&pFile, fileName, "wb") != 0) {
+    return nullptr;
   }
-  return initialized;
-}
-
-void LogError(Channel channel, bool newline, const xchar* format, ...) {
-  if (!initialized)
-    return;
-
-  va_list args;
-  va_start(args, format);
-  Log(Verbosity::Error, channel, newline, format, args);
-  va_end(args);
+  return pFile;
 }
 
-void LogWarning(Channel channel, bool newline, const xchar* format, ...) {
-  if (!initialized)
-    return;
+U64 Logger::GetLocalTimeOfDay() {
+  SYSTEMTIME time;
+  GetLocalTime(&time);  // local time. Use GetSystemTime(&time) for UTC.
 
-  va_list args;
-  va_start(args, format);
-  Log(Verbosity::Warning, channel, newline, format, args);
-  va_end(args);
+  return (((U64)time.wHour * 60 + time.wMinute) * 60 + time.wSecond) *
+             1000000 +
+         (U64)time.wMilliseconds * 1000;
 }
 
-void LogInfo(Channel channel, bool newline, const xchar* format, ...) {
-  if (!initialized)
-    return;
-
-  va_list args;
-  va_start(args, format);
-  Log(Verbosity::Info, channel, newline, format, args);
-  va_end(args);
+int Logger::FormatText(xchar* pDest,
+                       size_t destChars,
+                       const xchar* format,
+                       va_list args) {
+  // returns -1 when it truncates, which Write handles
+  return _vsnwprintf_s(pDest, destChars, _TRUNCATE, format, args);
 }
 
-void LogVerbose(Channel channel, bool newline, const xchar* format, ...) {
-  if (!initialized)
+void Logger::AppendUtf8(const xchar* pText, size_t length, std::string& out) {
+  if (length == 0) {
     return;
-
-  va_list args;
-  va_start(args, format);
-  Log(Verbosity::Verbose, channel, newline, format, args);
-  va_end(args);
-}
-
-static void Log(Verbosity verbosity,
-                Channel channel,
-                bool newline,
-                const wchar_t* format,
-                va_list args) {
-  // Format: [hh:mm:ss.fff]: [VERBOSITY] [CHANNEL]: Message
-
-  std::wstring wtime = GetTimeString();
-  // wchar_t bufTime[20];
-  // GetTimeString(bufTime, 20);
-
-  wchar_t bufStart[80];
-  int written =
-      swprintf_s(bufStart, L"[%s] %s %s: ", wtime.c_str(),
-                 GetVerbosityString(verbosity), GetChannelString(channel));
-
-  std::wstring wstr(bufStart);
-
-  // get size of buf needed
-  int len = _vscwprintf(format, args);
-  if (len > 0) {
-    wchar_t* buf = new wchar_t[len + 1];
-
-    /*
-    On success, the total number of characters written is returned.
-    This count does not include the additional null-character automatically
-    appended at the end of the string. A negative number is returned on failure,
-    including when the resulting string to be written to ws would be longer
-    than n characters.
-    */
-    written = std::vswprintf(buf, len + 1, format, args);
-    if (written < 0) {
-      // buf too small
-      delete[] buf;
-      return;
-    }
-
-    wstr.append(buf);
-    delete[] buf;
-  }
-
-  if (newline) {
-    wstr.append(L"\n");
   }
 
-  OutputDebugStringW(wstr.c_str());
-
-  std::string utf8 = Utf16ToUtf8(wstr);
-
-  {
-    ScopedMutex lock(logFileMutex);
-    FILE* pFile = nullptr;
-    if (fopen_s(&pFile, Mana::logFile, "ab") == 0 && pFile) {
-      std::fwrite(utf8.c_str(), 1, utf8.length(), pFile);
-      std::fclose(pFile);
-    }
+  int bytes = WideCharToMultiByte(CP_UTF8, 0, pText, (int)length, nullptr, 0,
+                                  nullptr, nullptr);
+  if (bytes <= 0) {
+    return;
   }
-}
 
-static const wchar_t* GetVerbosityString(Verbosity verbosity) {
-  switch (verbosity) {
-    case Mana::Verbosity::Error:
-      return L"[ERROR]";
-    case Mana::Verbosity::Warning:
-      return L"[WARNING]";
-    case Mana::Verbosity::Info:
-      return L"[INFO]";
-    case Mana::Verbosity::Verbose:
-      return L"[VERBOSE]";
-    default:
-      return L"[MISSING VERBOSITY]";
-  }
+  size_t start = out.size();
+  out.resize(start + bytes);
+  WideCharToMultiByte(CP_UTF8, 0, pText, (int)length, &out[start], bytes,
+                      nullptr, nullptr);
 }
 
-static const wchar_t* GetChannelString(Channel channel) {
-  switch (channel) {
-    case Mana::Channel::All:
-      return L"[ALL]";
-    case Mana::Channel::Init:
-      return L"[INIT]";
-    case Mana::Channel::Shutdown:
-      return L"[SHUTDOWN]";
-    case Mana::Channel::Graphics:
-      return L"[GRAPHICS]";
-    case Mana::Channel::Sound:
-      return L"[SOUND]";
-    default:
-      return L"[MISSING CHANNEL]";
-  }
-}
-
-// output in form of "hh:mm:ss.fff"
-static std::wstring GetTimeString() {
-  SYSTEMTIME time;
-  GetLocalTime(&time);  // local time. Use GetSystemTime(&time) for UTC.
-
-  wchar_t bufTime[20];
-  int written = swprintf_s(bufTime, L"%02d:%02d:%02d.%03d", time.wHour,
-                           time.wMinute, time.wSecond, time.wMilliseconds);
-
-  std::wstring ret;
-  if (written > 0) {
-    ret.append(bufTime);
-  }
-
-  return ret;
+void Logger::OutputToDebugger(const xchar* pText) {
+  OutputDebugStringW(pText);
 }
 
 }  // namespace Mana
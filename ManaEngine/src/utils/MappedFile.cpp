@@ -0,0 +1,89 @@
+#include "pch.h"
+#include "utils/MappedFile.h"
+#include "utils/Archive.h"
+
+namespace Mana {
+
+MappedFile::~MappedFile() {
+  Close();
+}
+
+bool MappedFile::Open(const xchar* fileName, MemoryTag tag) {
+  Close();
+
+  // Stored entries of the packed assets are already mapped, so just point
+  // at them. Compressed ones go through File, which decompresses them, and
+  // skip Map so a loose file of the same name doesn't shadow the archive.
+  bool bCompressed = false;
+  if (g_pAssetArchive) {
+    const ArchiveEntry* pEntry = g_pAssetArchive->Find(fileName);
+    if (pEntry && !(pEntry->flags & Archive::FLAG_LZ4)) {
+      pData_ = g_pAssetArchive->GetView(pEntry);
+      size_ = pEntry->size;
+      bArchiveView_ = true;
+      return size_ > 0;
+    }
+    bCompressed = pEntry != nullptr;
+  }
+
+  if (!bCompressed && Map(fileName)) {
+    bMapped_ = true;
+    tag_ = tag;
+    TrackAllocation(tag_, size_);
+    return true;
+  }
+
+  // Some files can't be mapped (e.g. on some network drives, or when a
+  // 32 bit process is out of address space), so read them the old way.
+  pFile_ = new File();
+  size_ = pFile_->ReadAllBytes(fileName);
+  if (size_ == 0) {
+    delete pFile_;
+    pFile_ = nullptr;
+    return false;
+  }
+
+  pData_ = pFile_->GetBuffer();
+  return true;
+}
+
+bool MappedFile::Adopt(unsigned char* pBuffer, size_t size, MemoryTag tag) {
+  Close();
+
+  if (size == 0) {
+    delete[] pBuffer;
+    return false;
+  }
+
+  pAdopted_ = pBuffer;
+  pData_ = pBuffer;
+  size_ = size;
+  tag_ = tag;
+  TrackAllocation(tag_, size_);
+  return true;
+}
+
+void MappedFile::Close() {
+  if (bMapped_) {
+    Unmap();
+    TrackFree(tag_, size_);
+    bMapped_ = false;
+  }
+
+  if (pFile_) {
+    delete pFile_;
+    pFile_ = nullptr;
+  }
+
+  if (pAdopted_) {
+    delete[] pAdopted_;
+    pAdopted_ = nullptr;
+    TrackFree(tag_, size_);
+  }
+
+  bArchiveView_ = false;
+  pData_ = nullptr;
+  size_ = 0;
+}
+
+}  // namespace Mana
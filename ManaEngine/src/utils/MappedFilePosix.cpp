@@ -0,0 +1,56 @@
+#include "pch.h"
+#include "utils/MappedFile.h"
+
+#ifndef OS_WIN
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace Mana {
+
+// mmap implementation of MappedFile, for platforms other than Windows.
+
+bool MappedFile::Map(const xchar* fileName) {
+  fd_ = open(fileName, O_RDONLY);
+  if (fd_ < 0) {
+    return false;
+  }
+
+  struct stat buf;
+  if (fstat(fd_, &buf) != 0 || buf.st_size <= 0) {
+    // can't map an empty file
+    Unmap();
+    return false;
+  }
+
+  void* pData = mmap(nullptr, (size_t)buf.st_size, PROT_READ, MAP_PRIVATE,
+                     fd_, 0);
+  if (pData == MAP_FAILED) {
+    Unmap();
+    return false;
+  }
+
+  // decoders walk the file front to back, so ask for more read-ahead
+  madvise(pData, (size_t)buf.st_size, MADV_SEQUENTIAL);
+
+  pData_ = (const unsigned char*)pData;
+  size_ = (size_t)buf.st_size;
+  return true;
+}
+
+void MappedFile::Unmap() {
+  if (pData_) {
+    munmap((void*)pData_, size_);
+    pData_ = nullptr;
+  }
+
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+}
+
+}  // namespace Mana
+
+#endif  // #ifndef OS_WIN
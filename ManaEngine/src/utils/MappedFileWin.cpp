@@ -0,0 +1,57 @@
+#include "pch.h"
+#include "utils/MappedFile.h"
+
+namespace Mana {
+
+bool MappedFile::Map(const xchar* fileName) {
+  // FILE_FLAG_SEQUENTIAL_SCAN makes the cache manager read ahead more,
+  // since decoders walk the file front to back.
+  hFile_ = CreateFileW(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                       OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (hFile_ == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(hFile_, &fileSize) || fileSize.QuadPart == 0 ||
+      (U64)fileSize.QuadPart > (U64)SIZE_MAX) {
+    // can't map an empty file, and a 32 bit build can't map a huge one
+    Unmap();
+    return false;
+  }
+
+  hMapping_ = CreateFileMappingW(hFile_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!hMapping_) {
+    Unmap();
+    return false;
+  }
+
+  pData_ = (const unsigned char*)MapViewOfFile(hMapping_, FILE_MAP_READ, 0, 0,
+                                               0);
+  if (!pData_) {
+    Unmap();
+    return false;
+  }
+
+  size_ = (size_t)fileSize.QuadPart;
+  return true;
+}
+
+void MappedFile::Unmap() {
+  if (pData_) {
+    UnmapViewOfFile(pData_);
+    pData_ = nullptr;
+  }
+
+  if (hMapping_) {
+    CloseHandle(hMapping_);
+    hMapping_ = nullptr;
+  }
+
+  if (hFile_ != INVALID_HANDLE_VALUE) {
+    CloseHandle(hFile_);
+    hFile_ = INVALID_HANDLE_VALUE;
+  }
+}
+
+}  // namespace Mana
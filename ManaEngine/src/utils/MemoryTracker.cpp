@@ -0,0 +1,194 @@
+#include "pch.h"
+#include "utils/MemoryTracker.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <atomic>
+#include <cstddef>
+
+namespace Mana {
+
+namespace {
+
+struct TagCounters {
+  std::atomic<size_t> liveBytes;
+  std::atomic<size_t> peakBytes;
+  std::atomic<size_t> budgetBytes;
+  std::atomic<U64> allocations;
+  std::atomic<U64> frees;
+  // set while over budget, so the warning is logged once per overrun
+  std::atomic<bool> bOverBudget;
+};
+
+// In front of every TaggedMalloc block. Padded so the block after it
+// keeps malloc's alignment.
+struct alignas(std::max_align_t) TaggedHeader {
+  size_t size;
+  MemoryTag tag;
+};
+
+}  // namespace
+
+// Zero initialized before any constructor runs, so tagged allocations
+// from other globals' constructors are counted too.
+static TagCounters tagCounters[MEMORY_TAG_COUNT];
+
+static TagCounters& GetCounters(MemoryTag tag) {
+  assert((size_t)tag < MEMORY_TAG_COUNT);
+  return tagCounters[(size_t)tag];
+}
+
+const xchar* GetMemoryTagName(MemoryTag tag) {
+  switch (tag) {
+    case MemoryTag::Audio:
+      return _X("Audio");
+    case MemoryTag::Input:
+      return _X("Input");
+    case MemoryTag::Graphics:
+      return _X("Graphics");
+    case MemoryTag::IO:
+      return _X("IO");
+    case MemoryTag::Log:
+      return _X("Log");
+    case MemoryTag::Profiler:
+      return _X("Profiler");
+    default:
+      return _X("MISSING TAG");
+  }
+}
+
+void TrackAllocation(MemoryTag tag, size_t size) {
+  TagCounters& counters = GetCounters(tag);
+  counters.allocations.fetch_add(1, std::memory_order_relaxed);
+  size_t live =
+      counters.liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+
+  size_t peak = counters.peakBytes.load(std::memory_order_relaxed);
+  while (live > peak && !counters.peakBytes.compare_exchange_weak(
+                            peak, live, std::memory_order_relaxed)) {
+  }
+
+  size_t budget = counters.budgetBytes.load(std::memory_order_relaxed);
+  if (budget > 0 && live > budget &&
+      !counters.bOverBudget.exchange(true, std::memory_order_relaxed)) {
+    // Logging may allocate Log memory, but bOverBudget is already set,
+    // so it can't end up back here.
+    ManaLogLnWarning(Channel::All,
+                     _X("Memory %s over budget: %llu KB live, ")
+                         _X("budget %llu KB"),
+                     GetMemoryTagName(tag), (U64)live / 1024,
+                     (U64)budget / 1024);
+  }
+}
+
+void TrackFree(MemoryTag tag, size_t size) {
+  TagCounters& counters = GetCounters(tag);
+  counters.frees.fetch_add(1, std::memory_order_relaxed);
+  size_t live =
+      counters.liveBytes.fetch_sub(size, std::memory_order_relaxed) - size;
+
+  size_t budget = counters.budgetBytes.load(std::memory_order_relaxed);
+  if (live <= budget) {
+    counters.bOverBudget.store(false, std::memory_order_relaxed);
+  }
+}
+
+void* TaggedMalloc(MemoryTag tag, size_t size) {
+  if (size > (size_t)-1 - sizeof(TaggedHeader)) {
+    return nullptr;
+  }
+
+  TaggedHeader* pHeader = (TaggedHeader*)malloc(sizeof(TaggedHeader) + size);
+  if (!pHeader) {
+    return nullptr;
+  }
+
+  pHeader->size = size;
+  pHeader->tag = tag;
+  TrackAllocation(tag, size);
+  return pHeader + 1;
+}
+
+void* TaggedRealloc(MemoryTag tag, void* p, size_t size) {
+  if (!p) {
+    return TaggedMalloc(tag, size);
+  }
+  if (size > (size_t)-1 - sizeof(TaggedHeader)) {
+    return nullptr;
+  }
+
+  TaggedHeader* pHeader = (TaggedHeader*)p - 1;
+  assert(pHeader->tag == tag && "TaggedRealloc with another tag");
+  size_t oldSize = pHeader->size;
+
+  // like realloc, |p| is untouched if this fails
+  pHeader = (TaggedHeader*)realloc(pHeader, sizeof(TaggedHeader) + size);
+  if (!pHeader) {
+    return nullptr;
+  }
+
+  pHeader->size = size;
+  TrackFree(tag, oldSize);
+  TrackAllocation(tag, size);
+  return pHeader + 1;
+}
+
+void TaggedFree(void* p) {
+  if (!p) {
+    return;
+  }
+
+  TaggedHeader* pHeader = (TaggedHeader*)p - 1;
+  TrackFree(pHeader->tag, pHeader->size);
+  free(pHeader);
+}
+
+MemorySnapshot GetMemorySnapshot() {
+  MemorySnapshot snapshot;
+  for (size_t i = 0; i < MEMORY_TAG_COUNT; ++i) {
+    const TagCounters& counters = tagCounters[i];
+    MemoryTagStats& stats = snapshot.tags[i];
+    stats.pName = GetMemoryTagName((MemoryTag)i);
+    stats.liveBytes = counters.liveBytes.load(std::memory_order_relaxed);
+    stats.peakBytes = counters.peakBytes.load(std::memory_order_relaxed);
+    stats.budgetBytes = counters.budgetBytes.load(std::memory_order_relaxed);
+    stats.allocations = counters.allocations.load(std::memory_order_relaxed);
+    stats.frees = counters.frees.load(std::memory_order_relaxed);
+  }
+  return snapshot;
+}
+
+void LogMemorySnapshot() {
+  MemorySnapshot snapshot = GetMemorySnapshot();
+  for (const MemoryTagStats& stats : snapshot.tags) {
+    if (stats.allocations == 0) {
+      continue;
+    }
+
+    ManaLogLnInfo(Channel::All,
+                  _X("Memory %s: %llu KB live, peak %llu KB, ")
+                      _X("budget %llu KB, %llu allocs, %llu frees"),
+                  stats.pName, (U64)stats.liveBytes / 1024,
+                  (U64)stats.peakBytes / 1024, (U64)stats.budgetBytes / 1024,
+                  stats.allocations, stats.frees);
+  }
+}
+
+void SetMemoryBudget(MemoryTag tag, size_t budgetBytes) {
+  TagCounters& counters = GetCounters(tag);
+  counters.budgetBytes.store(budgetBytes, std::memory_order_relaxed);
+
+  size_t live = counters.liveBytes.load(std::memory_order_relaxed);
+  if (budgetBytes > 0 && live > budgetBytes) {
+    counters.bOverBudget.store(true, std::memory_order_relaxed);
+    ManaLogLnWarning(Channel::All,
+                     _X("Memory %s over budget: %llu KB live, ")
+                         _X("budget %llu KB"),
+                     GetMemoryTagName(tag), (U64)live / 1024,
+                     (U64)budgetBytes / 1024);
+  } else {
+    counters.bOverBudget.store(false, std::memory_order_relaxed);
+  }
+}
+
+}  // namespace Mana
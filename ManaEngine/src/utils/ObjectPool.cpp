@@ -0,0 +1,357 @@
+#include "pch.h"
+#include "utils/ObjectPool.h"
+
+#include <stdlib.h>
+#include "utils/Memory.h"
+
+namespace Mana {
+
+// Every pool, for GetAllStats. Function statics, since pools can be
+// globals constructed before this file's globals are.
+static Mutex& GetPoolListLock() {
+  static Mutex lock;
+  return lock;
+}
+
+static ObjectPoolBase*& GetFirstPool() {
+  static ObjectPoolBase* pFirstPool = nullptr;
+  return pFirstPool;
+}
+
+static size_t RoundUp(size_t size, size_t align) {
+  return (size + align - 1) & ~(align - 1);
+}
+
+ObjectPoolBase::ObjectPoolBase(const xchar* name,
+                               size_t objectSize,
+                               size_t objectAlign,
+                               U32 objectsPerChunk,
+                               U32 maxObjects)
+    : name_(name),
+      objectSize_(objectSize),
+      maxObjects_(maxObjects < MAX_OBJECTS ? maxObjects : MAX_OBJECTS) {
+  // small pools don't need a chunk bigger than the pool
+  objectsPerChunk_ = objectsPerChunk < maxObjects_ ? objectsPerChunk
+                                                   : maxObjects_;
+  if (objectsPerChunk_ == 0) {
+    objectsPerChunk_ = 1;
+  }
+
+  align_ = objectAlign > alignof(SlotHeader) ? objectAlign
+                                             : alignof(SlotHeader);
+  headerSize_ = RoundUp(sizeof(SlotHeader), align_);
+  stride_ = headerSize_ + RoundUp(objectSize, align_);
+
+  ScopedMutex lock(GetPoolListLock());
+  pNextPool_ = GetFirstPool();
+  if (pNextPool_) {
+    pNextPool_->pPrevPool_ = this;
+  }
+  GetFirstPool() = this;
+}
+
+ObjectPoolBase::~ObjectPoolBase() {
+  {
+    ScopedMutex lock(GetPoolListLock());
+    if (pPrevPool_) {
+      pPrevPool_->pNextPool_ = pNextPool_;
+    } else {
+      GetFirstPool() = pNextPool_;
+    }
+    if (pNextPool_) {
+      pNextPool_->pPrevPool_ = pPrevPool_;
+    }
+  }
+
+  size_t live = GetStats().liveObjects;
+  if (live > 0) {
+    ManaLogLnWarning(Channel::Shutdown,
+                     _X("ObjectPool %s: %llu objects were never freed"),
+                     name_.c_str(), (U64)live);
+  }
+
+  for (void* pRaw : rawChunks_) {
+    free(pRaw);
+  }
+}
+
+void* ObjectPoolBase::AllocateStorage() {
+  ScopedMutex lock(lock_);
+
+  void* pObject = nullptr;
+  if (TakeFreeSlotsLocked(&pObject, 1) == 0) {
+    return nullptr;
+  }
+
+  MarkLive(pObject);
+  ++allocations_;
+  return pObject;
+}
+
+void ObjectPoolBase::FreeStorage(void* pObject) {
+  if (!pObject) {
+    return;
+  }
+
+  ScopedMutex lock(lock_);
+  MarkFree(pObject);
+  ++frees_;
+  ReturnFreeSlotsLocked(&pObject, 1);
+}
+
+ObjectPoolStats ObjectPoolBase::GetStats() const {
+  ScopedMutex lock(lock_);
+
+  ObjectPoolStats stats;
+  stats.pName = name_.c_str();
+  stats.objectSize = objectSize_;
+  // a cache's frees can be reported before the allocations they match
+  stats.liveObjects =
+      allocations_ > frees_ ? (size_t)(allocations_ - frees_) : 0;
+  if (stats.liveObjects > slotsOut_) {
+    stats.liveObjects = slotsOut_;
+  }
+  stats.peakObjects = peakSlotsOut_;
+  stats.cachedSlots =
+      slotsOut_ > stats.liveObjects ? slotsOut_ - stats.liveObjects : 0;
+  stats.capacity = chunks_.size() * objectsPerChunk_;
+  stats.chunks = chunks_.size();
+  stats.emptyChunks = 0;
+  for (U32 slotsOut : chunkSlotsOut_) {
+    if (slotsOut == 0) {
+      ++stats.emptyChunks;
+    }
+  }
+  stats.allocations = allocations_;
+  stats.frees = frees_;
+  stats.failedAllocations = failedAllocations_;
+  return stats;
+}
+
+void ObjectPoolBase::LogStats() const {
+  ObjectPoolStats stats = GetStats();
+
+  // how much of the pool's memory isn't holding a live object
+  [[maybe_unused]] U64 unusedPercent =
+      stats.capacity
+          ? (U64)(stats.capacity - stats.liveObjects) * 100 / stats.capacity
+          : 0;
+
+  ManaLogLnInfo(Channel::All,
+                _X("ObjectPool %s (%llu bytes each): %llu live, peak %llu, ")
+                _X("%llu cached, %llu slots in %llu chunks (%llu empty, ")
+                _X("%llu%% unused), %llu allocs, %llu frees, %llu failed"),
+                stats.pName, (U64)stats.objectSize, (U64)stats.liveObjects,
+                (U64)stats.peakObjects, (U64)stats.cachedSlots,
+                (U64)stats.capacity, (U64)stats.chunks,
+                (U64)stats.emptyChunks, unusedPercent, stats.allocations,
+                stats.frees, stats.failedAllocations);
+}
+
+// static
+void ObjectPoolBase::GetAllStats(std::vector<ObjectPoolStats>& stats) {
+  stats.clear();
+
+  ScopedMutex lock(GetPoolListLock());
+  for (ObjectPoolBase* pPool = GetFirstPool(); pPool;
+       pPool = pPool->pNextPool_) {
+    stats.push_back(pPool->GetStats());
+  }
+}
+
+// static
+void ObjectPoolBase::LogAllStats() {
+  ScopedMutex lock(GetPoolListLock());
+  for (ObjectPoolBase* pPool = GetFirstPool(); pPool;
+       pPool = pPool->pNextPool_) {
+    pPool->LogStats();
+  }
+}
+
+void* ObjectPoolBase::GetObject(PoolHandle handle) const {
+  U32 index = GetPoolHandleIndex(handle);
+  U32 generation = handle >> POOL_HANDLE_INDEX_BITS;
+
+  ScopedMutex lock(lock_);
+  if (handle == 0 || index >= numSlots_) {
+    return nullptr;
+  }
+
+  SlotHeader* pHeader = GetHeader(index);
+  if (pHeader->state.load(std::memory_order_relaxed) !=
+      (generation | LIVE_BIT)) {
+    return nullptr;
+  }
+
+  return GetObjectOf(pHeader);
+}
+
+PoolHandle ObjectPoolBase::GetObjectHandle(const void* pObject) const {
+  SlotHeader* pHeader = GetHeaderOf(pObject);
+  U32 state = pHeader->state.load(std::memory_order_relaxed);
+  assert((state & LIVE_BIT) && "GetHandle of a deleted object");
+
+  return ((state & GENERATION_MASK) << POOL_HANDLE_INDEX_BITS) |
+         pHeader->index;
+}
+
+void ObjectPoolBase::DestroyLiveObjects(void (*pDestroy)(void* pObject)) {
+  // only called by ~ObjectPool, when no other thread may use the pool.
+  // Not locked, since a destructor may delete other objects of the pool.
+  size_t live = 0;
+  for (U32 i = 0; i < numSlots_; ++i) {
+    SlotHeader* pHeader = GetHeader(i);
+    if (pHeader->state.load(std::memory_order_relaxed) & LIVE_BIT) {
+      if (live++ == 0) {
+        ManaLogLnWarning(Channel::Shutdown,
+                         _X("ObjectPool %s: deleting objects still live"),
+                         name_.c_str());
+      }
+
+      void* pObject = GetObjectOf(pHeader);
+      pDestroy(pObject);
+      FreeStorage(pObject);
+    }
+  }
+}
+
+ObjectPoolBase::SlotHeader* ObjectPoolBase::GetHeader(U32 index) const {
+  return (SlotHeader*)(chunks_[index / objectsPerChunk_] +
+                       (index % objectsPerChunk_) * stride_);
+}
+
+size_t ObjectPoolBase::TakeFreeSlots(void** ppObjects,
+                                     size_t count,
+                                     PendingCounts& pending) {
+  ScopedMutex lock(lock_);
+  AddPendingCountsLocked(pending);
+  return TakeFreeSlotsLocked(ppObjects, count);
+}
+
+void ObjectPoolBase::ReturnFreeSlots(void* const* ppObjects,
+                                     size_t count,
+                                     PendingCounts& pending) {
+  ScopedMutex lock(lock_);
+  AddPendingCountsLocked(pending);
+  ReturnFreeSlotsLocked(ppObjects, count);
+}
+
+size_t ObjectPoolBase::TakeFreeSlotsLocked(void** ppObjects, size_t count) {
+  size_t taken = 0;
+  while (taken < count) {
+    U32 index;
+    if (freeHead_ != INVALID_INDEX) {
+      index = freeHead_;
+      freeHead_ = GetHeader(index)->nextFree;
+    } else {
+      if (numSlots_ >= maxObjects_) {
+        break;
+      }
+
+      if (numSlots_ == chunks_.size() * objectsPerChunk_) {
+        void* pChunk = nullptr;
+        void* pRaw = nullptr;
+        if (!AlignedMalloc(align_, stride_ * objectsPerChunk_, &pChunk,
+                           &pRaw)) {
+          ManaLogLnError(Channel::All,
+                         _X("ObjectPool %s: couldn't allocate a chunk"),
+                         name_.c_str());
+          break;
+        }
+        chunks_.push_back((unsigned char*)pChunk);
+        rawChunks_.push_back(pRaw);
+        chunkSlotsOut_.push_back(0);
+      }
+
+      // slots are set up the first time they're used
+      index = numSlots_++;
+      SlotHeader* pHeader = new (GetHeader(index)) SlotHeader();
+      pHeader->index = index;
+      pHeader->nextFree = INVALID_INDEX;
+    }
+
+    ++chunkSlotsOut_[index / objectsPerChunk_];
+    ++slotsOut_;
+    ppObjects[taken++] = GetObjectOf(GetHeader(index));
+  }
+
+  if (slotsOut_ > peakSlotsOut_) {
+    peakSlotsOut_ = slotsOut_;
+  }
+  if (taken == 0 && count > 0) {
+    ++failedAllocations_;
+  }
+  return taken;
+}
+
+void ObjectPoolBase::ReturnFreeSlotsLocked(void* const* ppObjects,
+                                           size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    SlotHeader* pHeader = GetHeaderOf(ppObjects[i]);
+    pHeader->nextFree = freeHead_;
+    freeHead_ = pHeader->index;
+    --chunkSlotsOut_[pHeader->index / objectsPerChunk_];
+    --slotsOut_;
+  }
+}
+
+void ObjectPoolBase::MarkLive(void* pObject) {
+  SlotHeader* pHeader = GetHeaderOf(pObject);
+
+  // generations run 1 to GENERATION_MASK, so a handle is never 0
+  U32 generation =
+      pHeader->state.load(std::memory_order_relaxed) & GENERATION_MASK;
+  generation = generation % GENERATION_MASK + 1;
+  pHeader->state.store(generation | LIVE_BIT, std::memory_order_relaxed);
+}
+
+void ObjectPoolBase::MarkFree(void* pObject) {
+  SlotHeader* pHeader = GetHeaderOf(pObject);
+  U32 state = pHeader->state.load(std::memory_order_relaxed);
+  assert((state & LIVE_BIT) && "freeing an object twice");
+
+  // only the owner of a live object writes its state,
+  // so a plain store is enough
+  pHeader->state.store(state & GENERATION_MASK, std::memory_order_relaxed);
+}
+
+void ObjectPoolBase::AddPendingCountsLocked(PendingCounts& pending) {
+  allocations_ += pending.allocations;
+  frees_ += pending.frees;
+  pending = PendingCounts();
+}
+
+void* ObjectPoolCache::AllocateStorage() {
+  if (count_ == 0) {
+    count_ = (U32)pool_.TakeFreeSlots(slots_, BATCH, pending_);
+    if (count_ == 0) {
+      return nullptr;
+    }
+  }
+
+  void* pObject = slots_[--count_];
+  pool_.MarkLive(pObject);
+  ++pending_.allocations;
+  return pObject;
+}
+
+void ObjectPoolCache::FreeStorage(void* pObject) {
+  if (!pObject) {
+    return;
+  }
+
+  pool_.MarkFree(pObject);
+  ++pending_.frees;
+  if (count_ == CAPACITY) {
+    pool_.ReturnFreeSlots(slots_ + CAPACITY - BATCH, BATCH, pending_);
+    count_ -= BATCH;
+  }
+  slots_[count_++] = pObject;
+}
+
+void ObjectPoolCache::Flush() {
+  pool_.ReturnFreeSlots(slots_, count_, pending_);
+  count_ = 0;
+}
+
+}  // namespace Mana
@@ -0,0 +1,360 @@
+#include "pch.h"
+#include "utils/Profiler.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <new>
+#include <vector>
+#include "concurrency/Mutex.h"
+#include "utils/MemoryTracker.h"
+
+namespace Mana {
+
+std::atomic<U32> g_profilerGeneration{0};
+
+namespace {
+
+// A finished zone, or a frame mark (pName == nullptr, end = frame index).
+struct ProfileEvent {
+  const char* pName;
+  U64 begin;
+  U64 end;
+};
+
+// One thread's events.
+// Buffers are never freed: a thread's buffer goes back to the list when
+// it exits, for the next new thread.
+struct ThreadBuffer {
+  std::atomic<bool> bInUse{true};
+  ThreadBuffer* pNext = nullptr;
+  U32 id = 0;          // the trace's tid
+  char name[32] = {};  // written under Profiler::buffersLock_
+  // The capture pEvents[0, count) belong to. The owning thread sets it
+  // (after count) on its first event in a capture.
+  std::atomic<U32> generation{0};
+  std::atomic<size_t> count{0};
+  std::atomic<U64> dropped{0};
+  // allocated by the owning thread on its first event in any capture
+  ProfileEvent* pEvents = nullptr;
+};
+
+class Profiler {
+ public:
+  // per thread: EVENTS_PER_THREAD * sizeof(ProfileEvent) bytes,
+  // allocated the first time the thread records
+  static const size_t EVENTS_PER_THREAD = 64 * 1024;
+
+  bool BeginCapture();
+  bool EndCapture(const xchar* traceFile);
+  ProfilerStats GetStats();
+
+  void SetThreadName(const char* name);
+  void FrameMark();
+  void Record(const char* pName, U64 begin, U64 end, U32 generation);
+
+ private:
+  ThreadBuffer* GetThreadBuffer();
+  ThreadBuffer* AcquireBuffer();
+  bool WriteTrace(const xchar* traceFile,
+                  U32 generation,
+                  double ticksPerMicrosecond);
+
+  Mutex captureLock_;  // Begin/EndCapture
+  U64 captureStartTicks_ = 0;
+  std::chrono::steady_clock::time_point captureStartTime_;
+  std::atomic<U64> frames_{0};
+  ProfilerStats stats_ = {};
+
+  Mutex buffersLock_;  // for AcquireBuffer and thread names
+  // only ever prepended to, so Record can walk it without the lock
+  std::atomic<ThreadBuffer*> pFirstBuffer_{nullptr};
+  U32 numBuffers_ = 0;
+};
+
+Profiler profiler;
+
+// Writes |text| as a JSON string body.
+void WriteJsonString(FILE* pFile, const char* text) {
+  for (const char* p = text; *p; ++p) {
+    unsigned char c = (unsigned char)*p;
+    if (c == '"' || c == '\\') {
+      fputc('\\', pFile);
+      fputc(c, pFile);
+    } else if (c < 0x20) {
+      fprintf(pFile, "\\u%04x", c);
+    } else {
+      fputc(c, pFile);
+    }
+  }
+}
+
+}  // namespace
+
+bool ProfilerBeginCapture() {
+  return profiler.BeginCapture();
+}
+
+bool ProfilerEndCapture(const xchar* traceFile) {
+  return profiler.EndCapture(traceFile);
+}
+
+bool IsProfilerCapturing() {
+  return (g_profilerGeneration.load(std::memory_order_relaxed) & 1) != 0;
+}
+
+void ProfilerSetThreadName(const char* name) {
+  profiler.SetThreadName(name);
+}
+
+void ProfilerFrameMark() {
+  profiler.FrameMark();
+}
+
+ProfilerStats GetProfilerStats() {
+  return profiler.GetStats();
+}
+
+void ProfilerEndZone(const char* name, U64 begin, U32 generation) {
+  profiler.Record(name, begin, ProfilerNow(), generation);
+}
+
+bool Profiler::BeginCapture() {
+  ScopedMutex lock(captureLock_);
+
+  U32 generation = g_profilerGeneration.load(std::memory_order_relaxed);
+  if (generation & 1) {
+    return false;
+  }
+
+  frames_.store(0, std::memory_order_relaxed);
+  captureStartTime_ = std::chrono::steady_clock::now();
+  captureStartTicks_ = ProfilerNow();
+  g_profilerGeneration.store(generation + 1, std::memory_order_release);
+  return true;
+}
+
+bool Profiler::EndCapture(const xchar* traceFile) {
+  ScopedMutex lock(captureLock_);
+
+  U32 generation = g_profilerGeneration.load(std::memory_order_relaxed);
+  if (!(generation & 1)) {
+    return false;
+  }
+  // zones still open, or ending while we write, aren't recorded
+  g_profilerGeneration.store(generation + 1, std::memory_order_release);
+
+  // calibrate the ticks against steady_clock over the whole capture
+  U64 endTicks = ProfilerNow();
+  double microseconds = std::chrono::duration<double, std::micro>(
+                            std::chrono::steady_clock::now() -
+                            captureStartTime_)
+                            .count();
+  double ticksPerMicrosecond =
+      microseconds > 0.0 ? (endTicks - captureStartTicks_) / microseconds
+                         : 1.0;
+
+  return WriteTrace(traceFile, generation, ticksPerMicrosecond);
+}
+
+ProfilerStats Profiler::GetStats() {
+  ScopedMutex lock(captureLock_);
+  return stats_;
+}
+
+void Profiler::SetThreadName(const char* name) {
+  ThreadBuffer* pBuffer = GetThreadBuffer();
+  if (!pBuffer) {
+    return;
+  }
+
+  ScopedMutex lock(buffersLock_);
+  size_t length = std::min(strlen(name), sizeof(pBuffer->name) - 1);
+  memcpy(pBuffer->name, name, length);
+  pBuffer->name[length] = '\0';
+}
+
+void Profiler::FrameMark() {
+  U32 generation = g_profilerGeneration.load(std::memory_order_relaxed);
+  if (!(generation & 1)) {
+    return;
+  }
+  Record(nullptr, ProfilerNow(),
+         frames_.fetch_add(1, std::memory_order_relaxed), generation);
+}
+
+void Profiler::Record(const char* pName,
+                      U64 begin,
+                      U64 end,
+                      U32 generation) {
+  // the capture ended (and maybe another started) since the zone began
+  if (g_profilerGeneration.load(std::memory_order_acquire) != generation) {
+    return;
+  }
+
+  ThreadBuffer* pBuffer = GetThreadBuffer();
+  if (!pBuffer) {
+    return;
+  }
+
+  if (pBuffer->generation.load(std::memory_order_relaxed) != generation) {
+    // the thread's first event in this capture
+    if (!pBuffer->pEvents) {
+      // Not TaggedNewArray, which throws: this runs in a zone's
+      // destructor, so out of memory just skips the event.
+      pBuffer->pEvents = (ProfileEvent*)TaggedMalloc(
+          MemoryTag::Profiler, EVENTS_PER_THREAD * sizeof(ProfileEvent));
+      if (!pBuffer->pEvents) {
+        return;
+      }
+    }
+    pBuffer->count.store(0, std::memory_order_relaxed);
+    pBuffer->dropped.store(0, std::memory_order_relaxed);
+    pBuffer->generation.store(generation, std::memory_order_release);
+  }
+
+  size_t count = pBuffer->count.load(std::memory_order_relaxed);
+  if (count == EVENTS_PER_THREAD) {
+    pBuffer->dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  pBuffer->pEvents[count] = {pName, begin, end};
+  pBuffer->count.store(count + 1, std::memory_order_release);
+}
+
+ThreadBuffer* Profiler::GetThreadBuffer() {
+  // gives the buffer back when the thread exits
+  struct BufferOwner {
+    ThreadBuffer* pBuffer = nullptr;
+    ~BufferOwner() {
+      if (pBuffer) {
+        pBuffer->bInUse.store(false, std::memory_order_release);
+      }
+    }
+  };
+  thread_local BufferOwner owner;
+
+  if (!owner.pBuffer) {
+    owner.pBuffer = AcquireBuffer();
+  }
+  return owner.pBuffer;
+}
+
+ThreadBuffer* Profiler::AcquireBuffer() {
+  ScopedMutex lock(buffersLock_);
+
+  // a buffer left behind by a thread that exited
+  for (ThreadBuffer* pBuffer = pFirstBuffer_.load(std::memory_order_relaxed);
+       pBuffer; pBuffer = pBuffer->pNext) {
+    bool bInUse = false;
+    if (pBuffer->bInUse.compare_exchange_strong(bInUse, true,
+                                                std::memory_order_acquire)) {
+      pBuffer->name[0] = '\0';
+      return pBuffer;
+    }
+  }
+
+  ThreadBuffer* pNewBuffer = new (std::nothrow) ThreadBuffer();
+  if (!pNewBuffer) {
+    return nullptr;
+  }
+  pNewBuffer->id = ++numBuffers_;
+  pNewBuffer->pNext = pFirstBuffer_.load(std::memory_order_relaxed);
+  pFirstBuffer_.store(pNewBuffer, std::memory_order_release);
+  return pNewBuffer;
+}
+
+bool Profiler::WriteTrace(const xchar* traceFile,
+                          U32 generation,
+                          double ticksPerMicrosecond) {
+  stats_ = {};
+
+  FILE* pFile = nullptr;
+#ifdef OS_WIN
+  _wfopen_s(&pFile, traceFile, _X("wb"));
+#else
+  pFile = fopen(traceFile, "wb");
+#endif
+  if (!pFile) {
+    ManaLogLnError(Channel::All, _X("Profiler: can't open %s"), traceFile);
+    return false;
+  }
+
+  auto toMicroseconds = [&](U64 ticks) {
+    return ticks > captureStartTicks_
+               ? (ticks - captureStartTicks_) / ticksPerMicrosecond
+               : 0.0;
+  };
+
+  fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", pFile);
+  bool bFirst = true;
+  auto beginEvent = [&]() {
+    fputs(bFirst ? "" : ",\n", pFile);
+    bFirst = false;
+  };
+
+  std::vector<ProfileEvent> events;
+  ScopedMutex lock(buffersLock_);
+  for (ThreadBuffer* pBuffer = pFirstBuffer_.load(std::memory_order_acquire);
+       pBuffer; pBuffer = pBuffer->pNext) {
+    if (pBuffer->generation.load(std::memory_order_acquire) != generation) {
+      continue;  // the thread recorded nothing in this capture
+    }
+
+    // the owning thread may still be adding events, past count
+    size_t count = pBuffer->count.load(std::memory_order_acquire);
+    events.assign(pBuffer->pEvents, pBuffer->pEvents + count);
+    ++stats_.threads;
+    stats_.zonesDropped += pBuffer->dropped.load(std::memory_order_relaxed);
+
+    beginEvent();
+    fprintf(pFile,
+            "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+            "\"args\":{\"name\":\"",
+            pBuffer->id);
+    if (pBuffer->name[0]) {
+      WriteJsonString(pFile, pBuffer->name);
+    } else {
+      fprintf(pFile, "Thread %u", pBuffer->id);
+    }
+    fputs("\"}}", pFile);
+
+    // Zones are recorded as they end, so children come before their
+    // parents. The viewer wants parents first.
+    std::sort(events.begin(), events.end(),
+              [](const ProfileEvent& a, const ProfileEvent& b) {
+                return a.begin != b.begin ? a.begin < b.begin : a.end > b.end;
+              });
+
+    for (const ProfileEvent& event : events) {
+      beginEvent();
+      if (!event.pName) {
+        ++stats_.frames;
+        fprintf(pFile,
+                "{\"name\":\"Frame\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,"
+                "\"tid\":%u,\"ts\":%.3f,\"args\":{\"frame\":%llu}}",
+                pBuffer->id, toMicroseconds(event.begin), event.end);
+        continue;
+      }
+
+      ++stats_.zones;
+      fputs("{\"name\":\"", pFile);
+      WriteJsonString(pFile, event.pName);
+      fprintf(pFile, "\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,"
+              "\"dur\":%.3f}",
+              pBuffer->id, toMicroseconds(event.begin),
+              (event.end - event.begin) / ticksPerMicrosecond);
+    }
+  }
+
+  fputs("\n]}\n", pFile);
+  bool bWritten = !ferror(pFile);
+  bWritten = fclose(pFile) == 0 && bWritten;
+  if (!bWritten) {
+    ManaLogLnError(Channel::All, _X("Profiler: can't write %s"), traceFile);
+  }
+  return bWritten;
+}
+
+}  // namespace Mana
@@ -0,0 +1,276 @@
+# Decodes binary .mlog files written by Mana::Logger (LogFileFormat::Binary)
+# into the same text the engine writes with LogFileFormat::Text.
+# Run help to see usage:
+#   `python mlog.py -h`
+#
+# Format (see utils/Logger.h): fixed size integers are little endian, "var"
+# is LEB128, "svar" is a zigzag LEB128, "str" is a var length + utf-8.
+#   header    "MLOG", U16 version, U16 0,
+#             U64 local time of day at LogInit in microseconds
+#   chunks    each starts with a U8 kind:
+#   SITE      var id, U8 verbosity, U8 channel, U8 newline, var line,
+#             str file, str format
+#   MESSAGE   var site id, svar microseconds since the previous chunk,
+#             var length + arguments
+#   TEXT      U8 verbosity, U8 channel, U8 newline,
+#             svar microseconds since the previous chunk, str text
+#
+# Each argument is a U8 LogArgType (see utils/Log.h), then a svar for signed
+# integers, a var for unsigned ones and pointers, a little endian double, or
+# a var length + 1 (0 for null) and utf-8 for strings.
+
+import argparse
+import re
+import struct
+import sys
+
+MAGIC = b'MLOG'
+VERSION = 1
+
+HEADER = struct.Struct('<4sHHQ')  # magic, version, 0, time_of_day_at_init
+FLAGS = struct.Struct('<BBB')     # verbosity, channel, newline
+F64 = struct.Struct('<d')
+
+CHUNK_SITE = 1
+CHUNK_MESSAGE = 2
+CHUNK_TEXT = 3
+
+# LogArgType
+ARG_I32 = 1
+ARG_U32 = 2
+ARG_I64 = 3
+ARG_U64 = 4
+ARG_F64 = 5
+ARG_POINTER = 6
+ARG_STRING = 7
+ARG_NARROW_STRING = 8
+
+VERBOSITIES = ['ERROR', 'WARNING', 'INFO', 'VERBOSE']
+CHANNELS = ['ALL', 'INIT', 'SHUTDOWN', 'GRAPHICS', 'SOUND', 'INPUT', 'PERF']
+
+MICROS_PER_DAY = 24 * 60 * 60 * 1000000
+
+# printf conversion specs, including the MSVC length modifiers
+SPEC = re.compile(r'%([-+ #0]*)(\*|\d+)?(?:\.(\*|\d*))?'
+                  r'(hh|h|ll|l|j|z|t|L|I64|I32|I|w)?'
+                  r'([diouxXeEfFgGaAcCsSpnZ%])')
+
+class Site:
+    def __init__(self, verbosity, channel, newline, line, file, format):
+        self.verbosity = verbosity
+        self.channel = channel
+        self.newline = newline
+        self.line = line
+        self.file = file
+        self.format = format
+        self.count = 0
+
+class Reader:
+    def __init__(self, data: bytes):
+        self.data = data
+        self.pos = 0
+
+    def read(self, size: int) -> bytes:
+        if self.pos + size > len(self.data):
+            raise EOFError()
+        value = self.data[self.pos:self.pos + size]
+        self.pos += size
+        return value
+
+    def unpack(self, layout: struct.Struct):
+        return layout.unpack(self.read(layout.size))
+
+    def read_var(self) -> int:
+        value = 0
+        shift = 0
+        while True:
+            byte = self.read(1)[0]
+            value |= (byte & 0x7f) << shift
+            if byte < 0x80:
+                return value
+            shift += 7
+
+    def read_svar(self) -> int:
+        value = self.read_var()
+        return (value >> 1) ^ -(value & 1)
+
+    def read_string(self) -> str:
+        return self.read(self.read_var()).decode('utf-8', errors='replace')
+
+def read_args(data: bytes) -> list:
+    reader = Reader(data)
+    args = []
+    try:
+        while reader.pos < len(data):
+            kind = reader.read(1)[0]
+            if kind in (ARG_I32, ARG_I64):
+                args.append((kind, reader.read_svar()))
+            elif kind in (ARG_U32, ARG_U64, ARG_POINTER):
+                args.append((kind, reader.read_var()))
+            elif kind == ARG_F64:
+                args.append((kind, reader.unpack(F64)[0]))
+            elif kind in (ARG_STRING, ARG_NARROW_STRING):
+                length = reader.read_var()
+                value = None
+                if length > 0:
+                    value = reader.read(length - 1).decode('utf-8',
+                                                           errors='replace')
+                args.append((kind, value))
+            else:
+                break
+    except EOFError:
+        pass
+    return args
+
+def format_message(format: str, args: list) -> str:
+    # Like Logger::FormatArgs: a spec without a matching argument
+    # is left in the text as it is.
+    args = list(args)
+
+    def next_arg():
+        return args.pop(0) if args else None
+
+    def replace(match):
+        flags, width, precision, _, conversion = match.groups()
+        if conversion == '%':
+            return '%'
+
+        for star in ('width', 'precision'):
+            if (width if star == 'width' else precision) == '*':
+                arg = next_arg()
+                if arg is None or arg[0] not in (ARG_I32, ARG_U32):
+                    return match.group(0)
+                if star == 'width':
+                    width = str(arg[1])
+                else:
+                    precision = str(arg[1])
+
+        if conversion == 'n':
+            return ''
+
+        arg = next_arg()
+        if arg is None:
+            return match.group(0)
+        kind, value = arg
+
+        is_string_spec = conversion in 'sSZ'
+        is_string = kind in (ARG_STRING, ARG_NARROW_STRING)
+        if is_string_spec != is_string:
+            return match.group(0)
+
+        spec = '%' + flags + (width or '')
+        if precision is not None:
+            spec += '.' + precision
+
+        if is_string:
+            return (spec + 's') % ('(null)' if value is None else value)
+        if conversion in 'cC':
+            return (spec + 's') % chr(value & 0x10ffff)
+        if conversion == 'p':
+            return (spec + 's') % ('%016X' % value)
+        if conversion in 'aA':
+            return (spec + 's') % float(value).hex()
+        if conversion in 'diu':
+            return (spec + 'd') % value
+        return (spec + conversion) % value
+
+    return SPEC.sub(replace, format)
+
+def format_prefix(time_of_day: int, timestamp: int, verbosity: int,
+                  channel: int) -> str:
+    millis = (time_of_day + timestamp) % MICROS_PER_DAY // 1000
+    verbosity_name = (VERBOSITIES[verbosity] if verbosity < len(VERBOSITIES)
+                      else 'MISSING VERBOSITY')
+    channel_name = (CHANNELS[channel] if channel < len(CHANNELS)
+                    else 'MISSING CHANNEL')
+    return '[%02d:%02d:%02d.%03d] [%s] [%s]: ' % (
+        millis // 3600000, millis // 60000 % 60, millis // 1000 % 60,
+        millis % 1000, verbosity_name, channel_name)
+
+def read_log(path: str, on_line) -> dict:
+    with open(path, 'rb') as f:
+        reader = Reader(f.read())
+
+    magic, version, _, time_of_day = reader.unpack(HEADER)
+    if magic != MAGIC or version != VERSION:
+        raise ValueError('%s is not a version %d .mlog file' % (path, VERSION))
+
+    sites = {}
+    timestamp = 0
+    try:
+        while reader.pos < len(reader.data):
+            kind = reader.read(1)[0]
+            if kind == CHUNK_SITE:
+                site_id = reader.read_var()
+                verbosity, channel, newline = reader.unpack(FLAGS)
+                line = reader.read_var()
+                file = reader.read_string()
+                format = reader.read_string()
+                sites[site_id] = Site(verbosity, channel, newline, line, file,
+                                      format)
+            elif kind == CHUNK_MESSAGE:
+                site_id = reader.read_var()
+                timestamp += reader.read_svar()
+                args = read_args(reader.read(reader.read_var()))
+                site = sites.get(site_id)
+                if site is None:
+                    raise ValueError('message for unknown site %d' % site_id)
+                site.count += 1
+                text = format_message(site.format, args)
+                on_line(format_prefix(time_of_day, timestamp, site.verbosity,
+                                      site.channel) + text +
+                        ('\n' if site.newline else ''))
+            elif kind == CHUNK_TEXT:
+                verbosity, channel, newline = reader.unpack(FLAGS)
+                timestamp += reader.read_svar()
+                text = reader.read_string()
+                on_line(format_prefix(time_of_day, timestamp, verbosity,
+                                      channel) + text +
+                        ('\n' if newline else ''))
+            else:
+                raise ValueError('unknown chunk %d at offset %d' %
+                                 (kind, reader.pos - 1))
+    except EOFError:
+        # the game didn't get to finish the last batch
+        print('%s: truncated at offset %d' % (path, reader.pos),
+              file=sys.stderr)
+    return sites
+
+def decode(path: str, dest: str) -> int:
+    out = open(dest, 'w', encoding='utf-8', newline='') if dest else sys.stdout
+    try:
+        read_log(path, out.write)
+    finally:
+        if dest:
+            out.close()
+    return 0
+
+def list_sites(path: str) -> int:
+    sites = read_log(path, lambda line: None)
+    for site_id, site in sorted(sites.items()):
+        print('%5d %8d  %s:%d  %s' % (site_id, site.count, site.file,
+                                      site.line, site.format))
+    return 0
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description='Decodes binary .mlog files.')
+    subparsers = parser.add_subparsers(dest='command', required=True)
+    decode_parser = subparsers.add_parser('decode', help='write the log as text')
+    decode_parser.add_argument('log')
+    decode_parser.add_argument('-o', '--output',
+                               help='text file to write (default: stdout)')
+    sites_parser = subparsers.add_parser(
+        'sites', help='list each call site with its message count')
+    sites_parser.add_argument('log')
+    args = parser.parse_args()
+
+    try:
+        if args.command == 'decode':
+            return decode(args.log, args.output)
+        return list_sites(args.log)
+    except (OSError, ValueError) as e:
+        print(e, file=sys.stderr)
+        return 1
+
+if __name__ == '__main__':
+    sys.exit(main())
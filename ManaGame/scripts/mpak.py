@@ -0,0 +1,223 @@
+# Builds and inspects .mpak asset archives, read at runtime by Mana::Archive.
+# Run help to see usage:
+#   `python mpak.py -h`
+#
+# Format (all integers little endian):
+#   header      32 bytes, see HEADER below
+#   buckets     U32[(1 << bucket_bits) + 1]: index of the first TOC entry
+#               whose hash starts with each (bucket_bits)-bit prefix
+#   toc         ENTRY[entry_count], sorted by path hash
+#   names       nul terminated utf-8 paths, for tools only
+#   data        each entry starts on a 4K boundary
+#
+# Paths are relative to the packed folder, with '/' separators and ASCII
+# letters lowercased, then hashed with 64 bit FNV-1a (see utils/Hash.h).
+
+import argparse
+import os
+import struct
+import sys
+
+MAGIC = b'MPAK'
+VERSION = 1
+ALIGNMENT = 4096
+FLAG_LZ4 = 1
+
+HEADER = struct.Struct('<4sIIIQQ')  # magic, version, entry_count,
+                                    # bucket_bits, toc_offset, names_offset
+ENTRY = struct.Struct('<QQIIII')    # path_hash, offset, stored_size, size,
+                                    # flags, name_offset
+
+FNV1A_64_OFFSET_BASIS = 0xcbf29ce484222325
+FNV1A_64_PRIME = 0x100000001b3
+
+# Only compress when it saves at least this much,
+# since already compressed files (ogg, png) just get slower to load.
+MIN_COMPRESSION_SAVINGS = 0.1
+
+def normalize_path(path: str) -> bytes:
+    path = path.replace('\\', '/')
+    while path.startswith('./'):
+        path = path[2:]
+    # ASCII only, to match Archive::HashPath
+    return bytes(c + 32 if 65 <= c <= 90 else c for c in path.encode('utf-8'))
+
+def hash_path(path: str) -> int:
+    h = FNV1A_64_OFFSET_BASIS
+    for c in normalize_path(path):
+        h ^= c
+        h = (h * FNV1A_64_PRIME) & 0xffffffffffffffff
+    return h
+
+def lz4_compress(src: bytes) -> bytes:
+    # Greedy LZ4 block compressor. Slow, but only runs at build time.
+    # https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+    MIN_MATCH = 4
+    LAST_LITERALS = 5
+    MF_LIMIT = 12
+    MAX_OFFSET = 65535
+
+    out = bytearray()
+    n = len(src)
+    table = {}
+    anchor = 0
+    pos = 0
+
+    def write_length(length: int):
+        while length >= 255:
+            out.append(255)
+            length -= 255
+        out.append(length)
+
+    while pos + MF_LIMIT < n:
+        key = src[pos:pos + MIN_MATCH]
+        candidate = table.get(key)
+        table[key] = pos
+        if candidate is None or pos - candidate > MAX_OFFSET:
+            pos += 1
+            continue
+
+        # extend the match, stopping short of the last literals
+        match_len = MIN_MATCH
+        limit = n - LAST_LITERALS
+        while (pos + match_len < limit and
+               src[candidate + match_len] == src[pos + match_len]):
+            match_len += 1
+
+        literal_len = pos - anchor
+        ml = match_len - MIN_MATCH
+        out.append((min(literal_len, 15) << 4) | min(ml, 15))
+        if literal_len >= 15:
+            write_length(literal_len - 15)
+        out += src[anchor:pos]
+        out += struct.pack('<H', pos - candidate)
+        if ml >= 15:
+            write_length(ml - 15)
+
+        pos += match_len
+        anchor = pos
+
+    # the block always ends with literals
+    literal_len = n - anchor
+    out.append(min(literal_len, 15) << 4)
+    if literal_len >= 15:
+        write_length(literal_len - 15)
+    out += src[anchor:]
+    return bytes(out)
+
+def align(value: int) -> int:
+    return (value + ALIGNMENT - 1) & ~(ALIGNMENT - 1)
+
+def pack(src_dir: str, dest: str, compress: bool) -> int:
+    entries = []
+    seen = {}
+    for root, dirs, files in os.walk(src_dir):
+        dirs.sort()
+        for name in sorted(files):
+            full_path = os.path.join(root, name)
+            rel_path = os.path.relpath(full_path, src_dir).replace('\\', '/')
+            path_hash = hash_path(rel_path)
+            if path_hash in seen:
+                print(f'ERROR: {rel_path} and {seen[path_hash]} hash the same '
+                      f'(or differ only in case)')
+                return 1
+            seen[path_hash] = rel_path
+
+            with open(full_path, 'rb') as f:
+                data = f.read()
+            stored = data
+            flags = 0
+            if compress and len(data) > 0:
+                compressed = lz4_compress(data)
+                if len(compressed) <= len(data) * (1 - MIN_COMPRESSION_SAVINGS):
+                    stored = compressed
+                    flags = FLAG_LZ4
+            entries.append([path_hash, rel_path, stored, len(data), flags])
+
+    entries.sort(key=lambda e: e[0])
+
+    # about one entry per bucket
+    bucket_bits = 0
+    while (1 << bucket_bits) < len(entries):
+        bucket_bits += 1
+    buckets = []
+    i = 0
+    for bucket in range(1 << bucket_bits):
+        while (i < len(entries) and
+               (entries[i][0] >> (64 - bucket_bits) if bucket_bits else 0) <
+               bucket):
+            i += 1
+        buckets.append(i)
+    buckets.append(len(entries))
+
+    names = bytearray()
+    name_offsets = []
+    for e in entries:
+        name_offsets.append(len(names))
+        names += e[1].encode('utf-8') + b'\0'
+
+    # 8 byte aligned, so the runtime can read the TOC in place
+    toc_offset = (HEADER.size + 4 * len(buckets) + 7) & ~7
+    names_offset = toc_offset + ENTRY.size * len(entries)
+    offset = align(names_offset + len(names))
+    offsets = []
+    for e in entries:
+        offsets.append(offset)
+        offset = align(offset + len(e[2]))
+
+    with open(dest, 'wb') as f:
+        f.write(HEADER.pack(MAGIC, VERSION, len(entries), bucket_bits,
+                            toc_offset, names_offset))
+        f.write(struct.pack(f'<{len(buckets)}I', *buckets))
+        f.write(b'\0' * (toc_offset - f.tell()))
+        for e, data_offset, name_offset in zip(entries, offsets, name_offsets):
+            f.write(ENTRY.pack(e[0], data_offset, len(e[2]), e[3], e[4],
+                               name_offset))
+        f.write(names)
+        for e, data_offset in zip(entries, offsets):
+            f.write(b'\0' * (data_offset - f.tell()))
+            f.write(e[2])
+
+    raw_size = sum(e[3] for e in entries)
+    stored_size = sum(len(e[2]) for e in entries)
+    print(f'Packed {len(entries)} files ({raw_size} bytes, {stored_size} '
+          f'stored) into {dest}')
+    return 0
+
+def list_archive(path: str) -> int:
+    with open(path, 'rb') as f:
+        data = f.read()
+    magic, version, count, bucket_bits, toc_offset, names_offset = \
+        HEADER.unpack_from(data, 0)
+    if magic != MAGIC or version != VERSION:
+        print(f'ERROR: {path} is not a version {VERSION} mpak archive')
+        return 1
+
+    for i in range(count):
+        path_hash, offset, stored_size, size, flags, name_offset = \
+            ENTRY.unpack_from(data, toc_offset + i * ENTRY.size)
+        name_start = names_offset + name_offset
+        name = data[name_start:data.index(b'\0', name_start)].decode('utf-8')
+        lz4 = 'lz4' if flags & FLAG_LZ4 else '   '
+        print(f'{path_hash:016x} {offset:10} {stored_size:10} {size:10} '
+              f'{lz4} {name}')
+    return 0
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description='Builds and inspects .mpak asset archives.')
+    sub = parser.add_subparsers(dest='command', required=True)
+    pack_parser = sub.add_parser('pack', help='pack a folder into an archive')
+    pack_parser.add_argument('src_dir')
+    pack_parser.add_argument('dest')
+    pack_parser.add_argument('--no-compress', action='store_true',
+                             help='store every entry uncompressed')
+    list_parser = sub.add_parser('list', help='list an archive\'s entries')
+    list_parser.add_argument('archive')
+    args = parser.parse_args()
+
+    if args.command == 'pack':
+        return pack(args.src_dir, args.dest, not args.no_compress)
+    return list_archive(args.archive)
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -9,6 +9,8 @@ from pathlib import Path
 import shutil
 import sys
 
+import mpak
+
 arch = 'x64'        # x64
 config = 'debug'    # debug, profile, release
 
@@ -57,6 +59,10 @@ def main() -> int:
                         help='build configuration',
                         choices=['debug', 'profile', 'release'],
                         default='debug')
+    parser.add_argument('-p', '--pack',
+                        help='pack assets/final into game/assets.mpak '
+                             'instead of copying loose files',
+                        action='store_true')
     args = parser.parse_args()
     config = args.config
 
@@ -81,8 +87,14 @@ def main() -> int:
     print('Copying files to game folder...')
     should_copy_pdb_files = (config == 'debug' or config == 'profile')
 
-    print('  assets/final')
-    shutil.copytree(f'{assets_path}final/', game_path, dirs_exist_ok=True)
+    if args.pack:
+        print('  assets/final -> assets.mpak')
+        if mpak.pack(f'{assets_path}final/', f'{game_path}assets.mpak',
+                     True) != 0:
+            return 1
+    else:
+        print('  assets/final')
+        shutil.copytree(f'{assets_path}final/', game_path, dirs_exist_ok=True)
 
     print('  ogg-vorbis dlls')
     copy_files_glob(f'{ogg_path}*.dll', game_path)
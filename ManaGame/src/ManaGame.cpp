@@ -6,16 +6,28 @@
 #include "audio/WorkItemLoadAudio.h"
 #include "concurrency/IThread.h"
 #include "concurrency/IWorkItem.h"
+#include "concurrency/JobSystem.h"
 #include "concurrency/NamedMutex.h"
 #include "config/ConfigManager.h"
 #include "debugging/DebugWin.h"
 #include "events/EventManager.h"
+#include "events/InputRecording.h"
 #include "graphics/GraphicsDirectX11Win.h"
 #include "input/InputWin.h"
+#include "mainloop/FramePacer.h"
+#include "mainloop/FrameStats.h"
+#include "mainloop/HeadlessGame.h"
 #include "mainloop/ManaGameBase.h"
+#include "mainloop/TimerWheel.h"
 #include "os/WindowWin.h"
 #include "ui/SimpleMessageBox.h"
+#include "utils/Archive.h"
+#include "utils/AsyncIO.h"
 #include "utils/CommandLine.h"
+#include "utils/LinearArena.h"
+#include "utils/MemoryTracker.h"
+#include "utils/ObjectPool.h"
+#include "utils/Profiler.h"
 #include "utils/ScopedComInitializer.h"
 #include "utils/Strings.h"
 
@@ -28,8 +40,6 @@ const float PanIncrement = 0.02f;
 Mana::AudioFileHandle oggFile;
 Mana::AudioFileHandle jumpSFX;
 
-Mana::IThread* g_pLoadThread = nullptr;
-
 #define MAX_LOADSTRING 100
 
 WCHAR szTitle[MAX_LOADSTRING];        // The title bar text
@@ -45,6 +55,11 @@ namespace Mana {
 
 uint64_t g_fps;
 
+// 60 frames per second =
+// 60 frames per 1000000 microseconds = 1000000 / 60 = ~16,666.
+// We actually want it smaller than 60 FPS
+const uint64_t MICROSEC_PER_UPDATE = 16000;
+
 DWORD WINAPI GameLoopThreadFunction(LPVOID lpParam);
 
 class GameLoopThread {
@@ -60,6 +75,17 @@ class GameLoopThread {
   }
 
   HWND hwnd_ = nullptr;
+  // with --profile, the capture ends after this many frames
+  U32 profileFrames_ = 0;
+  // --fps and --vsync, the pacer is set up on the game loop thread
+  FramePacerMode pacerMode_ = FramePacerMode::TargetFps;
+  U32 targetFps_ = 60;
+  // read by the main thread only after Join
+  FrameStats frameStats_;
+  FramePacer pacer_;
+  // --record and --replay, opened before the thread starts
+  InputRecorder recorder_;
+  InputReplayer replayer_;
 
  private:
   HANDLE hThread_ = nullptr;
@@ -84,6 +110,7 @@ bool GameLoopThread::Init(HWND hwnd) {
 
 DWORD WINAPI GameLoopThreadFunction(LPVOID lpParam) {
   GameLoopThread* pThread = (GameLoopThread*)lpParam;
+  MANA_PROFILE_THREAD_NAME("Game Loop");
 
   // Using a fixed timestep loop per Game Loop Pattern.
   // http://gameprogrammingpatterns.com/game-loop.html
@@ -96,22 +123,37 @@ DWORD WINAPI GameLoopThreadFunction(LPVOID lpParam) {
   uint64_t previous = g_clock.GetMicroseconds();
   uint64_t lag = 0;  // aka, the accumulator
 
-  // 60 frames per second =
-  // 60 frames per 1000000 microseconds = 1000000 / 60 = ~16,666.
-  // We actually want it smaller than 60 FPS
-  uint64_t MICROSEC_PER_UPDATE = 16000;
-
   // TODO: Figure out what a good number is for this on
   //       our slowest supported machine. No idea yet.
+  // Past this, the steps still owed are dropped (counted in frameStats_),
+  // so a slow frame can't leave the loop further and further behind.
   int MAX_UPDATES = 10;
   int max_updates;
+  FrameRecord frameRecord;
 
   int numFrames = 0;
   uint64_t lastFPSCalculation = g_clock.GetMicroseconds();
 
-  std::vector<SynchronizedEvent> syncEvents;
+  U32 profiledFrames = 0;
+
+  // ticks once per update step, so timers run on game time
+  TimerWheel timers((U32)MICROSEC_PER_UPDATE);
+  g_pTimerWheel = &timers;
+
+  // Without pacing, the loop spins a whole core running frames faster
+  // than the display shows them.
+  if (!pThread->pacer_.Init(pThread->pacerMode_, pThread->targetFps_)) {
+    ManaLogLnWarning(Channel::Perf, _X("FramePacer Init failed, uncapped"));
+  }
 
   while (!pThread->bStopping_.load(std::memory_order_acquire)) {
+    MANA_PROFILE_FRAME();
+
+    // last frame's scratch memory is free again
+    g_pFrameArena->Reset();
+
+    pThread->pacer_.WaitForNextFrame();
+
     current = g_clock.GetMicroseconds();
     elapsed = current - previous;
     if (elapsed < 0)
@@ -119,49 +161,109 @@ DWORD WINAPI GameLoopThreadFunction(LPVOID lpParam) {
     previous = current;
     lag += elapsed;
 
-    // get raw input events from the main thread
-    if (!g_pEventMan->GetSyncQueue().Empty_NoLock()) {
-      g_pEventMan->GetSyncQueue().PopAll(syncEvents);
+    // The timers tick once per update, so their tick is the number of
+    // updates so far, which recordings are stamped with.
+    if (pThread->replayer_.IsOpen()) {
+      pThread->replayer_.EnqueueDue(timers.GetTick(), *g_pEventMan);
+    }
 
-      if (syncEvents.size() > 1) {
+    // get raw input events from the main thread, into the frame's scratch
+    // memory, just big enough for what's queued. Events pushed meanwhile
+    // wait for the next frame.
+    SyncEventQueue& syncQueue = g_pEventMan->GetSyncQueue();
+    size_t numSyncEvents = 0;
+    size_t queued = syncQueue.Size();
+    SynchronizedEvent* pSyncEvents =
+        g_pFrameArena->AllocateArray<SynchronizedEvent>(queued);
+    if (queued > 0 && pSyncEvents) {
+      numSyncEvents = syncQueue.PopAll(pSyncEvents, queued);
+      pThread->recorder_.Record(timers.GetTick(), pSyncEvents, numSyncEvents);
+
+      if (numSyncEvents > 1) {
         OutputDebugStringW((std::wstring(L"game-loop syncEvents: ") +
-                            std::to_wstring(syncEvents.size()) + L"\n")
+                            std::to_wstring(numSyncEvents) + L"\n")
                                .c_str());
       }
     }
 
     // TODO: OnProcessInput();
 
+    frameRecord = {};
+    frameRecord.startMicros = current;
+    uint64_t updatesStart = g_clock.GetMicroseconds();
+
     max_updates = MAX_UPDATES;
     while (lag >= MICROSEC_PER_UPDATE && max_updates > 0) {
       // TODO: OnUpdate();
-      g_pAudioEngine->Update();
+      timers.Advance();
+      {
+        MANA_PROFILE_SCOPE("AudioBase::Update");
+        g_pAudioEngine->Update();
+      }
 
       lag -= MICROSEC_PER_UPDATE;
       --max_updates;
+      ++frameRecord.updates;
+    }
+
+    if (lag >= MICROSEC_PER_UPDATE) {
+      uint64_t dropped = lag / MICROSEC_PER_UPDATE;
+      frameRecord.droppedUpdates =
+          (U16)(dropped < UINT16_MAX ? dropped : UINT16_MAX);
+      lag %= MICROSEC_PER_UPDATE;
     }
 
+    uint64_t updatesDone = g_clock.GetMicroseconds();
+    frameRecord.updateMicros = (U32)(updatesDone - updatesStart);
+
     ++numFrames;
     // if 1 second elapsed, recalculate FPS
     if (current - lastFPSCalculation >= 1000000) {
       g_fps = numFrames;
       numFrames = 0;
       lastFPSCalculation += 1000000;
+      LogMemorySnapshot();
       InvalidateRect(pThread->hwnd_, nullptr, TRUE);
     }
 
     // TODO: OnRender(lag / (double)MICROSEC_PER_UPDATE);
+
+    uint64_t frameDone = g_clock.GetMicroseconds();
+    frameRecord.renderMicros = (U32)(frameDone - updatesDone);
+    frameRecord.frameMicros = (U32)(frameDone - current);
+    pThread->frameStats_.AddFrame(frameRecord);
+
+#ifdef MANA_PROFILING_ENABLED
+    if (pThread->profileFrames_ > 0 &&
+        ++profiledFrames == pThread->profileFrames_) {
+      ProfilerEndCapture(_X("ManaProfile.json"));
+    }
+#endif
   }
 
+  pThread->pacer_.Uninit();
+  pThread->recorder_.Close();
+  g_pTimerWheel = nullptr;
   return 0;
 }
 
 GameLoopThread gameThread;
 
+const size_t FRAME_ARENA_BYTES = 4 * 1024 * 1024;
+
+// Warnings when a subsystem's tagged memory grows past these.
+// Audio covers the PcmCache budget plus streaming buffers and mapped oggs.
+const size_t AUDIO_MEMORY_BUDGET = 128 * 1024 * 1024;
+const size_t INPUT_MEMORY_BUDGET = 64 * 1024;
+// (each thread that logs has a 64 KB ring)
+const size_t LOG_MEMORY_BUDGET = 4 * 1024 * 1024;
+
 class ManaGame : public ManaGameBase {
  public:
   ManaGame(HINSTANCE hInstance, int nCmdShow)
-      : hInstance_(hInstance), nCmdShow_(nCmdShow) {}
+      : hInstance_(hInstance),
+        nCmdShow_(nCmdShow),
+        loadAudioPool_(_X("WorkItemLoadAudio"), 8) {}
   ~ManaGame() final {}
 
   //uint64_t GetFps() final { return g_fps; }
@@ -177,6 +279,7 @@ class ManaGame : public ManaGameBase {
   ScopedComInitializer com_;
   HINSTANCE hInstance_;
   int nCmdShow_;
+  ObjectPool<WorkItemLoadAudio> loadAudioPool_;
 };
 
 bool ManaGame::OnInit() {
@@ -187,6 +290,54 @@ bool ManaGame::OnInit() {
 
   ManaGameBase::OnInit();
 
+#ifdef MANA_PROFILING_ENABLED
+  // --profile [frames] captures loading and the first frames (300 by
+  // default) to ManaProfile.json, for chrome://tracing or ui.perfetto.dev.
+  if (commandLine_.HasKey("profile")) {
+    std::string frames = commandLine_.Get("profile");
+    gameThread.profileFrames_ =
+        frames.empty() ? 300 : (U32)atoi(frames.c_str());
+    ProfilerBeginCapture();
+  }
+#endif
+
+  // --spike-ms N logs the last frames' timings when a frame takes longer
+  // than N ms (0 turns it off)
+  if (commandLine_.HasKey("spike-ms")) {
+    gameThread.frameStats_.SetSpikeThreshold(
+        (U32)atoi(commandLine_.Get("spike-ms").c_str()) * 1000);
+  }
+
+  // The game loop runs at 60 fps by default. --fps N runs it at N
+  // (0 is uncapped), --vsync at the display's refresh rate.
+  if (commandLine_.HasKey("vsync")) {
+    gameThread.pacerMode_ = FramePacerMode::VSync;
+  } else if (commandLine_.HasKey("fps")) {
+    gameThread.targetFps_ = (U32)atoi(commandLine_.Get("fps").c_str());
+    if (gameThread.targetFps_ == 0) {
+      gameThread.pacerMode_ = FramePacerMode::Uncapped;
+    }
+  }
+
+  SetMemoryBudget(MemoryTag::Audio, AUDIO_MEMORY_BUDGET);
+  SetMemoryBudget(MemoryTag::Input, INPUT_MEMORY_BUDGET);
+  SetMemoryBudget(MemoryTag::Log, LOG_MEMORY_BUDGET);
+
+  // Mount the packed assets, if prepare_game_win.py built them (--pack).
+  // Without them, assets are loaded from loose files.
+  g_pAssetArchive = new Archive();
+  if (!g_pAssetArchive->Open(_X("assets.mpak"))) {
+    delete g_pAssetArchive;
+    g_pAssetArchive = nullptr;
+  }
+
+  // per-frame scratch memory for the game loop thread
+  g_pFrameArena = new LinearArena();
+  if (!g_pFrameArena->Init(FRAME_ARENA_BYTES)) {
+    error_ = _X("Frame arena Init error");
+    return false;
+  }
+
   // TODO: init ConfigManager and load game configs
 
   pWindow_ = new WindowWin(hInstance_, nCmdShow_, WndProc);
@@ -199,6 +350,26 @@ bool ManaGame::OnInit() {
   g_pEventMan = new EventManager();
   g_pEventMan->Init();
 
+  // --record FILE saves the input the game loop consumes, --replay FILE
+  // plays a recording back instead of live input, for repeatable runs.
+  // Both at once records the replay again, like HeadlessGame.
+  if (commandLine_.HasKey("replay")) {
+    if (!gameThread.replayer_.Open(Utf8ToUtf16(commandLine_.Get("replay")))) {
+      error_ = _X("Input replay Open error");
+      return false;
+    }
+    if (gameThread.replayer_.GetTickMicros() != MICROSEC_PER_UPDATE) {
+      ManaLogLnWarning(Channel::Input,
+                       _X("Input replay was recorded at %u us per update"),
+                       gameThread.replayer_.GetTickMicros());
+    }
+    g_pEventMan->SetReplaying(true);
+  }
+  if (commandLine_.HasKey("record")) {
+    gameThread.recorder_.Open(Utf8ToUtf16(commandLine_.Get("record")),
+                              (U32)MICROSEC_PER_UPDATE);
+  }
+
   // init input engine
   g_pInputEngine = new InputWin(GetWindow()->GetHWnd());
   g_pInputEngine->Init();
@@ -241,18 +412,30 @@ bool ManaGame::OnInit() {
   g_pAudioEngine = new AudioWin();
   g_pAudioEngine->Init();
 
-  // instead of loading audio synchronously, we'll use a separate thread
-  // while this main thread could render an animated "Loading" image.
+  // instead of loading audio synchronously, we'll use the job system's
+  // worker threads (one per hardware thread), while this main thread
+  // could render an animated "Loading" image.
 
-  // the "load thread" will always exist throughout the life of the app,
-  // but can be suspended when we don't need it,
-  // so the OS scheduler won't uneccessarily context-switch to it.
-  g_pLoadThread = ThreadFactory::Create();
-  g_pLoadThread->Start();
+  // the job system's workers will always exist throughout the life of the
+  // app, but sleep when there are no jobs,
+  // so the OS scheduler won't uneccessarily context-switch to them.
+  g_pJobSystem = new JobSystem();
+  if (!g_pJobSystem->Init()) {
+    error_ = _X("JobSystem Init error");
+    return false;
+  }
+
+  // keeps asset reads in flight while the workers decode the ones that
+  // have arrived
+  g_pAsyncIO = new AsyncIO();
+  if (!g_pAsyncIO->Init()) {
+    error_ = _X("AsyncIO Init error");
+    return false;
+  }
 
-  // queue up the stuff that will be loaded in the load thread.
+  // queue up the stuff that will be loaded on the workers.
   // we call these "WorkItems"
-  WorkItemLoadAudio* pLoadOgg = new WorkItemLoadAudio(
+  WorkItemLoadAudio* pLoadOgg = loadAudioPool_.New(
       g_pAudioEngine, _X("music/Kefka - NinjaGaiden - Evading the Enemy-loop.ogg"),
       AudioCategory::Music, AudioFormat::Ogg, 18060);
 
@@ -260,30 +443,31 @@ bool ManaGame::OnInit() {
   //    g_pAudioEngine, _X("003 - Grandpa's Theme-loop.ogg"),
   //    AudioCategory::Music, AudioFormat::Ogg);
 
-  WorkItemLoadAudio* pLoadJumpSFX = new WorkItemLoadAudio(
+  WorkItemLoadAudio* pLoadJumpSFX = loadAudioPool_.New(
       g_pAudioEngine, _X("sound/jump001.ogg"), AudioCategory::Sound,
       AudioFormat::Ogg, 0, 3);
 
-  g_pLoadThread->EnqueueWorkItem(pLoadOgg);
-  g_pLoadThread->EnqueueWorkItem(pLoadJumpSFX);
+  // group the work items under one parent job, so we only have to
+  // wait on the parent. Both files are read at once, and each one is
+  // decoded on a worker as soon as its read completes.
+  JobHandle loadJob = g_pJobSystem->CreateJob(nullptr, nullptr);
+  pLoadOgg->LoadAsync(loadJob);
+  pLoadJumpSFX->LoadAsync(loadJob);
+  g_pJobSystem->Submit(loadJob);
 
   // TODO: this should run in our game loop,
   //       since it has to show animation.
 
   // Wait for all work items (audio files) to finish loading.
-  // We poll here instead of using a wait-function,
+  // We poll here instead of using JobSystem::Wait,
   // so we may render an animated "Loading" image.
-  while (!g_pLoadThread->IsAllItemsProcessed()) {
+  while (!g_pJobSystem->IsDone(loadJob)) {
     // Probably don't need to do a full-blown busy-wait.
     // Our Loading animation can still move.
     Sleep(100);
 
     // TODO: render Loading animation here
   }
-  // TODO: Instead of clearing the processed items like this,
-  //       maybe we can use shared_ptrs within the LoadThread instead?
-  //       Although, we still need to get the handle like below. hmm
-  g_pLoadThread->ClearProcessedItems();
 
   // cache the audio engine's sound handle, which we later use
   // to play/pause/stop/etc the sound
@@ -291,9 +475,9 @@ bool ManaGame::OnInit() {
   jumpSFX = pLoadJumpSFX->GetHandleIfDoneProcessing();
 
   // the work items are not needed anymore
-  delete pLoadOgg;
+  loadAudioPool_.Delete(pLoadOgg);
   pLoadOgg = nullptr;
-  delete pLoadJumpSFX;
+  loadAudioPool_.Delete(pLoadJumpSFX);
   pLoadJumpSFX = nullptr;
 
   if (!pWindow_->ShowWindow(SW_SHOWNORMAL)) {
@@ -323,19 +507,36 @@ bool ManaGame::OnStartGameLoop() {
 
   gameThread.Stop();
   gameThread.Join();
+  gameThread.frameStats_.LogSummary();
+  gameThread.pacer_.LogStats();
 
   nReturnCode_ = (int)msg.wParam;
   return true;
 }
 
 bool ManaGame::OnShutdown() {
+  // the game was closed before --profile's frames were up
+  if (IsProfilerCapturing()) {
+    ProfilerEndCapture(_X("ManaProfile.json"));
+  }
+
+  // allocation counts and fragmentation of every pool, before
+  // their owners go away
+  ObjectPoolBase::LogAllStats();
+  LogMemorySnapshot();
+
   // shutdown engine systems in reverse order to prevent deadlocks
 
-  if (g_pLoadThread) {
-    g_pLoadThread->Stop();
-    g_pLoadThread->Join();
-    delete g_pLoadThread;
-    g_pLoadThread = nullptr;
+  if (g_pAsyncIO) {
+    g_pAsyncIO->Uninit();
+    delete g_pAsyncIO;
+    g_pAsyncIO = nullptr;
+  }
+
+  if (g_pJobSystem) {
+    g_pJobSystem->Uninit();
+    delete g_pJobSystem;
+    g_pJobSystem = nullptr;
   }
 
   if (g_pAudioEngine) {
@@ -362,6 +563,16 @@ bool ManaGame::OnShutdown() {
     g_pEventMan = nullptr;
   }
 
+  if (g_pFrameArena) {
+    delete g_pFrameArena;
+    g_pFrameArena = nullptr;
+  }
+
+  if (g_pAssetArchive) {
+    delete g_pAssetArchive;
+    g_pAssetArchive = nullptr;
+  }
+
   return true;
 }
 
@@ -374,28 +585,59 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
   UNREFERENCED_PARAMETER(hPrevInstance);
   UNREFERENCED_PARAMETER(lpCmdLine);
 
+  MANA_PROFILE_THREAD_NAME("Main");
+
+  // --headless runs the engine without a window, GPU or sound device,
+  // for soak and throughput tests (see HeadlessGame)
+  Mana::CommandLine commandLine;
+  commandLine.Parse(0, nullptr);
+  bool bHeadless = commandLine.HasKey("headless");
+
   // Prevent multiple instances (within the same session - "Local\")
   // Change the name after the slash for each game.
+  // Headless runs don't count, so tests can run side by side.
   Mana::ScopedNamedMutex singleInstance(
       _X("Local\\overworldsoft_unnamed_arpg"));
-  if (!singleInstance.TryLock()) {
+  if (!bHeadless && !singleInstance.TryLock()) {
     Mana::SimpleMessageBox::Show(
         title.c_str(),
         _X("Game is already running. This instance will close."));
     return 1;
   }
 
-  ManaLogInit("ManaLog.txt");
+  // --binary-log writes ManaLog.mlog instead, which is cheaper to write.
+  // Turn it into text with scripts/mlog.py.
+  if (commandLine.HasKey("binary-log")) {
+    ManaLogInit("ManaLog.mlog", Mana::RingOverflowPolicy::DropNewest,
+                Mana::LogFileFormat::Binary);
+  } else {
+    ManaLogInit("ManaLog.txt");
+  }
 
-  g_pGame = new Mana::ManaGame(hInstance, nCmdShow);
+  if (bHeadless) {
+    g_pGame = new Mana::HeadlessGame();
+  } else {
+    g_pGame = new Mana::ManaGame(hInstance, nCmdShow);
+  }
   if (!g_pGame->Run(0, nullptr, _X("Untitled Game"))) {
-    Mana::SimpleMessageBox::Show(_X("Error"), g_pGame->GetLastError().c_str());
+    // nobody is there to close a message box in a headless run
+    if (bHeadless) {
+      ManaLogLnError(Mana::Channel::Init, _X("%s"),
+                     g_pGame->GetLastError().c_str());
+      ManaLogShutdown();
+    } else {
+      Mana::SimpleMessageBox::Show(_X("Error"),
+                                   g_pGame->GetLastError().c_str());
+    }
     return 1;
   }
 
   int returnCode = g_pGame->GetReturnCode();
   delete g_pGame;
   g_pGame = nullptr;
+
+  // write out whatever the writer thread hasn't yet
+  ManaLogShutdown();
   return returnCode;
 }
 
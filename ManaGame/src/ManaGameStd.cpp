@@ -0,0 +1,33 @@
+#include "Globals.h"
+#include "target/TargetOS.h"
+
+#ifndef OS_WIN
+
+#include "mainloop/HeadlessGame.h"
+#include "utils/CommandLine.h"
+
+// Entry point for platforms other than Windows, where the only backends
+// are the null ones, so it always runs headless (--headless is implied).
+// See HeadlessGame for the options.
+int main(int argc, char** argv) {
+  Mana::CommandLine commandLine;
+  commandLine.Parse(argc, argv);
+  if (commandLine.HasKey("binary-log")) {
+    ManaLogInit("ManaLog.mlog", Mana::RingOverflowPolicy::DropNewest,
+                Mana::LogFileFormat::Binary);
+  } else {
+    ManaLogInit("ManaLog.txt");
+  }
+
+  g_pGame = new Mana::HeadlessGame();
+  g_pGame->Run(argc, argv, _X("Untitled Game"));
+
+  int returnCode = g_pGame->GetReturnCode();
+  delete g_pGame;
+  g_pGame = nullptr;
+
+  ManaLogShutdown();
+  return returnCode;
+}
+
+#endif  // #ifndef OS_WIN